@@ -0,0 +1,314 @@
+#define _USE_MATH_DEFINES // for MSVC to define M_PI etc.
+#include "angular-integration.hpp"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "data.hpp"
+#include "util.hpp"
+#include "shaders.hpp"
+
+/* The importance scheme combines three sets of directions:
+ *  * horizon set: a Fibonacci lattice with the zenith angles made denser near the horizon, where incident radiance
+ *    changes fastest, fixed in the frame of the scattering point;
+ *  * view peak set: directions distributed around the view direction according to the shape of the total scattering
+ *    phase function, so that its forward peak gets enough samples;
+ *  * Sun peak set: the same distribution around the Sun, which is where the incident radiance of the second order
+ *    peaks because of forward scattering of sunlight.
+ * The peak sets are tabulated around the north pole and rotated to the actual directions in the shader. Each sample
+ * is weighted by the balance heuristic of multiple importance sampling, i.e. by the inverse of the sum of the
+ * densities of all the sets at the sample's direction, so that the combined estimate is unbiased.
+ */
+
+namespace
+{
+
+constexpr int horizonBinCount=128; // bins of uniform width in cos(zenith angle)
+constexpr int phaseBinCount=180;   // bins of uniform width in angle from the peak direction
+constexpr int phaseTabulationAltitudeCount=16;
+// Ratio of maximum to minimum density of the horizon set
+constexpr double horizonDensityContrast=5;
+// Fraction of the peak sets that is distributed uniformly, so that no direction has too small density
+constexpr double peakSetUniformFraction=0.25;
+constexpr double goldenRatio=1.6180339887499;
+
+std::vector<double> phaseShape; // per phase bin, sums over wavelengths and normalized altitudes
+
+// Piecewise-constant densities per steradian, with cumulative probabilities for inverse transform sampling
+struct BinnedDensity
+{
+    std::vector<double> density;
+    std::vector<double> binProbabilityBegin; // has one more element than density, the last one being 1
+
+    // Finds the bin containing cumulative probability u, and the fraction of the bin probability below u
+    std::pair<int,double> locate(const double u) const
+    {
+        const auto it=std::upper_bound(binProbabilityBegin.begin(), binProbabilityBegin.end(), u);
+        const int bin=std::clamp(int(it-binProbabilityBegin.begin())-1, 0, int(density.size())-1);
+        const auto binProbability=binProbabilityBegin[bin+1]-binProbabilityBegin[bin];
+        const auto fraction = binProbability>0 ? (u-binProbabilityBegin[bin])/binProbability : 0.5;
+        return {bin, std::clamp(fraction, 0., 1.)};
+    }
+};
+
+BinnedDensity makeBinnedDensity(std::vector<double> const& unnormalizedDensity, std::vector<double> const& binSolidAngles)
+{
+    BinnedDensity result;
+    double total=0;
+    for(unsigned n=0; n<unnormalizedDensity.size(); ++n)
+        total += unnormalizedDensity[n]*binSolidAngles[n];
+    result.binProbabilityBegin.push_back(0);
+    for(unsigned n=0; n<unnormalizedDensity.size(); ++n)
+    {
+        result.density.push_back(unnormalizedDensity[n]/total);
+        result.binProbabilityBegin.push_back(result.binProbabilityBegin.back() + result.density.back()*binSolidAngles[n]);
+    }
+    result.binProbabilityBegin.back()=1;
+    return result;
+}
+
+BinnedDensity makeHorizonDensity()
+{
+    const double R=atmo.earthRadius, H=atmo.atmosphereHeight;
+    // The horizon is at cos(zenith angle) from 0 on the ground to this value at the top of the atmosphere
+    const double cosHorizonAtTOA=-std::sqrt(1-sqr(R/(R+H)));
+    const double center=cosHorizonAtTOA/2;
+    const double width=std::abs(center)+0.05;
+
+    std::vector<double> weights, solidAngles;
+    constexpr double binWidth=2./horizonBinCount;
+    for(int n=0; n<horizonBinCount; ++n)
+    {
+        const double z=-1+(n+0.5)*binWidth;
+        weights.push_back(1+(horizonDensityContrast-1)*std::exp(-sqr((z-center)/width)));
+        solidAngles.push_back(2*M_PI*binWidth);
+    }
+    return makeBinnedDensity(weights, solidAngles);
+}
+
+double phaseBinCosBegin(const int bin) { return std::cos(M_PI*bin/phaseBinCount); }
+
+BinnedDensity makePeakDensity()
+{
+    std::vector<double> solidAngles;
+    for(int n=0; n<phaseBinCount; ++n)
+        solidAngles.push_back(2*M_PI*(phaseBinCosBegin(n)-phaseBinCosBegin(n+1)));
+
+    std::vector<double> shape=phaseShape;
+    double shapeIntegral=0;
+    for(unsigned n=0; n<shape.size(); ++n)
+        shapeIntegral += shape[n]*solidAngles[n];
+    if(shape.size()!=phaseBinCount || !(shapeIntegral>0) || !std::isfinite(shapeIntegral))
+    {
+        shape.assign(phaseBinCount, 1.);
+        shapeIntegral=4*M_PI;
+    }
+
+    std::vector<double> weights;
+    for(const auto value : shape)
+        weights.push_back((1-peakSetUniformFraction)*value/shapeIntegral + peakSetUniformFraction/(4*M_PI));
+    return makeBinnedDensity(weights, solidAngles);
+}
+
+glm::vec3 directionFromCosAndAzimuth(const double cosPolarAngle, const double azimuth)
+{
+    const double sinPolarAngle=std::sqrt(std::max(0., 1-sqr(cosPolarAngle)));
+    return glm::vec3(std::cos(azimuth)*sinPolarAngle, std::sin(azimuth)*sinPolarAngle, cosPolarAngle);
+}
+
+std::vector<glm::vec3> makeHorizonSet(BinnedDensity const& density, const int pointCount)
+{
+    constexpr double binWidth=2./horizonBinCount;
+    std::vector<glm::vec3> dirs;
+    for(int k=0; k<pointCount; ++k)
+    {
+        const double n=k+0.5;
+        const auto [bin, fraction]=density.locate(n/pointCount);
+        const double z=-1+(bin+fraction)*binWidth;
+        dirs.push_back(directionFromCosAndAzimuth(z, n*(2*M_PI*goldenRatio)));
+    }
+    return dirs;
+}
+
+// Directions around the north pole; azimuthOffset lets two sets around coinciding poles not coincide themselves
+std::vector<glm::vec3> makePeakSet(BinnedDensity const& density, const int pointCount, const double azimuthOffset)
+{
+    std::vector<glm::vec3> dirs;
+    for(int k=0; k<pointCount; ++k)
+    {
+        const double n=k+0.5;
+        const auto [bin, fraction]=density.locate(n/pointCount);
+        const double cosBegin=phaseBinCosBegin(bin), cosEnd=phaseBinCosBegin(bin+1);
+        // Uniform in cosine within the bin, as the density is constant per steradian there
+        const double cosAngle=cosBegin+fraction*(cosEnd-cosBegin);
+        dirs.push_back(directionFromCosAndAzimuth(cosAngle, n*(2*M_PI*goldenRatio)+azimuthOffset));
+    }
+    return dirs;
+}
+
+QString arrayToString(const char*const type, std::vector<glm::vec3> const& array)
+{
+    QString str=QString("%1[](").arg(type);
+    for(unsigned n=0; n<array.size(); ++n)
+        str += (n ? ",\n    " : "\n    ")+toString(array[n]);
+    return str+")";
+}
+
+QString arrayToString(const char*const type, std::vector<double> const& array)
+{
+    QString str=QString("%1[](").arg(type);
+    for(unsigned n=0; n<array.size(); ++n)
+        str += (n%8 ? "," : n ? ",\n    " : "\n    ")+toString(float(array[n]));
+    return str+")";
+}
+
+}
+
+void tabulateScatteringPhaseShape()
+{
+    virtualSourceFiles[DENSITIES_SHADER_FILENAME]=makeScattererDensityFunctionsSrc();
+    virtualSourceFiles[TABULATE_SCATTERING_PHASE_FILENAME]=1+R"(
+#version 330
+#include "version.h.glsl"
+#include "const.h.glsl"
+#include "total-scattering-coefficient.h.glsl"
+
+out vec4 coefficient;
+
+void main()
+{
+    // Angles are at the centers of the bins
+    CONST float angle = PI*gl_FragCoord.x/)"+toString(phaseBinCount)+R"(;
+    // Denser sampling at low altitudes, where most of the scattering happens
+    CONST float altitude = atmosphereHeight*sqr(gl_FragCoord.y/)"+toString(phaseTabulationAltitudeCount)+R"();
+    coefficient = totalScatteringCoefficient(altitude, cos(angle));
+}
+)";
+    const auto program=compileShaderProgram(TABULATE_SCATTERING_PHASE_FILENAME, "scattering phase tabulation shader program");
+
+    GLuint texture=0, fbo=0;
+    gl.glGenTextures(1, &texture);
+    gl.glBindTexture(GL_TEXTURE_2D, texture);
+    gl.glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, phaseBinCount, phaseTabulationAltitudeCount, 0, GL_RGBA, GL_FLOAT, nullptr);
+    gl.glBindTexture(GL_TEXTURE_2D, 0);
+    gl.glGenFramebuffers(1, &fbo);
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    checkFramebufferStatus("framebuffer for scattering phase tabulation");
+
+    program->bind();
+    gl.glViewport(0, 0, phaseBinCount, phaseTabulationAltitudeCount);
+    renderQuad();
+
+    std::vector<glm::vec4> data(phaseBinCount*phaseTabulationAltitudeCount);
+    gl.glReadPixels(0, 0, phaseBinCount, phaseTabulationAltitudeCount, GL_RGBA, GL_FLOAT, data.data());
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl.glDeleteFramebuffers(1, &fbo);
+    gl.glDeleteTextures(1, &texture);
+
+    // Each altitude contributes its normalized shape, so that the dense lower layers don't hide the phase
+    // functions of the scatterers that dominate higher up
+    phaseShape.assign(phaseBinCount, 0.);
+    for(int altIndex=0; altIndex<phaseTabulationAltitudeCount; ++altIndex)
+    {
+        const auto row=data.data()+altIndex*phaseBinCount;
+        double integral=0;
+        for(int n=0; n<phaseBinCount; ++n)
+        {
+            const auto binSolidAngle=2*M_PI*(phaseBinCosBegin(n)-phaseBinCosBegin(n+1));
+            integral += binSolidAngle*(row[n][0]+row[n][1]+row[n][2]+row[n][3]);
+        }
+        if(!(integral>0) || !std::isfinite(integral))
+            continue; // no scatterers at this altitude
+        for(int n=0; n<phaseBinCount; ++n)
+            phaseShape[n] += std::max(0.f, row[n][0]+row[n][1]+row[n][2]+row[n][3]) / integral;
+    }
+}
+
+void makeScatteringDensityIntegrationSrc(const AngularIntegrationScheme scheme, const int pointCount)
+{
+    virtualHeaderFiles[SCATTERING_DENSITY_INTEGRATION_HEADER_FILENAME]=
+        "const int scatteringDensityIntegrationPoints="+toString(pointCount)+";\n"
+        "// Returns direction to the source of the incident ray in xyz and the solid angle it represents in w\n"
+        "vec4 scatteringDensityIntegrationSample(int index, vec3 viewDir, vec3 sunDir);\n";
+
+    const QString head=1+R"(
+#version 330
+#include "version.h.glsl"
+#include "const.h.glsl"
+#include "common-functions.h.glsl"
+#include "scattering-density-integration.h.glsl"
+)";
+    const int peakSetSize=pointCount/4;
+    if(scheme==AngularIntegrationScheme::Uniform || peakSetSize==0)
+    {
+        virtualSourceFiles[SCATTERING_DENSITY_INTEGRATION_SHADER_FILENAME]=head+R"(
+vec4 scatteringDensityIntegrationSample(const int index, const vec3 viewDir, const vec3 sunDir)
+{
+    return vec4(sphereIntegrationSampleDir(index, scatteringDensityIntegrationPoints),
+                sphereIntegrationSolidAngleDifferential(scatteringDensityIntegrationPoints));
+}
+)";
+        return;
+    }
+
+    const int horizonSetSize=pointCount-2*peakSetSize;
+    const auto horizonDensity=makeHorizonDensity();
+    const auto peakDensity=makePeakDensity();
+
+    virtualSourceFiles[SCATTERING_DENSITY_INTEGRATION_SHADER_FILENAME]=head+R"(
+const int horizonSetSize=)"+toString(horizonSetSize)+R"(;
+const int peakSetSize=)"+toString(peakSetSize)+R"(;
+const int horizonBinCount=)"+toString(horizonBinCount)+R"(;
+const int phaseBinCount=)"+toString(phaseBinCount)+R"(;
+const vec3 horizonSetDirs[horizonSetSize]=)"+arrayToString("vec3", makeHorizonSet(horizonDensity, horizonSetSize))+R"(;
+// Around the north pole
+const vec3 viewPeakSetDirs[peakSetSize]=)"+arrayToString("vec3", makePeakSet(peakDensity, peakSetSize, 0))+R"(;
+const vec3 sunPeakSetDirs[peakSetSize]=)"+arrayToString("vec3", makePeakSet(peakDensity, peakSetSize, M_PI))+R"(;
+// Densities per steradian in bins of uniform width in cos(zenith angle)
+const float horizonSetDensity[horizonBinCount]=)"+arrayToString("float", horizonDensity.density)+R"(;
+// Densities per steradian in bins of uniform width in angle from the peak direction
+const float peakSetDensity[phaseBinCount]=)"+arrayToString("float", peakDensity.density)+R"(;
+
+float horizonDensityAt(const vec3 dir)
+{
+    return horizonSetDensity[clamp(int((dir.z+1)/2*horizonBinCount), 0, horizonBinCount-1)];
+}
+
+float peakDensityAt(const float cosAngleFromPeak)
+{
+    CONST float angle=acos(clamp(cosAngleFromPeak, -1., 1.));
+    return peakSetDensity[clamp(int(angle/PI*phaseBinCount), 0, phaseBinCount-1)];
+}
+
+// Rotates dir so that the north pole goes to the given pole. The basis is from Duff et al. "Building an Orthonormal
+// Basis, Revisited", JCGT 6(1), 2017.
+vec3 rotateNorthPoleTo(const vec3 dir, const vec3 pole)
+{
+    CONST float s = pole.z>=0 ? 1. : -1.;
+    CONST float a = -1/(s+pole.z);
+    CONST float b = pole.x*pole.y*a;
+    CONST vec3 tangent1 = vec3(1+s*sqr(pole.x)*a, s*b, -s*pole.x);
+    CONST vec3 tangent2 = vec3(b, s+sqr(pole.y)*a, -pole.y);
+    return dir.x*tangent1 + dir.y*tangent2 + dir.z*pole;
+}
+
+vec4 scatteringDensityIntegrationSample(const int index, const vec3 viewDir, const vec3 sunDir)
+{
+    vec3 dir;
+    if(index < horizonSetSize)
+        dir = horizonSetDirs[index];
+    else if(index < horizonSetSize+peakSetSize)
+        dir = rotateNorthPoleTo(viewPeakSetDirs[index-horizonSetSize], viewDir);
+    else
+        dir = rotateNorthPoleTo(sunPeakSetDirs[index-horizonSetSize-peakSetSize], sunDir);
+
+    // Balance heuristic
+    CONST float density = horizonSetSize*horizonDensityAt(dir) +
+                          peakSetSize*(peakDensityAt(dot(dir, viewDir)) + peakDensityAt(dot(dir, sunDir)));
+    return vec4(dir, 1/density);
+}
+)";
+}
@@ -0,0 +1,15 @@
+#ifndef INCLUDE_ONCE_29E84925_6752_4385_8750_9DD4544F95A5
+#define INCLUDE_ONCE_29E84925_6752_4385_8750_9DD4544F95A5
+
+#include "../common/types.hpp"
+
+// Tabulates the shape of the total scattering phase function, i.e. of totalScatteringCoefficient() averaged over
+// altitudes, for the importance sampling scheme. Must be called for each wavelength set after the total scattering
+// coefficient source has been generated.
+void tabulateScatteringPhaseShape();
+// Generates the source of scatteringDensityIntegrationSample() that computeScatteringDensity() uses to pick
+// incident directions and their solid angles. The importance scheme needs tabulateScatteringPhaseShape() to be
+// called first.
+void makeScatteringDensityIntegrationSrc(AngularIntegrationScheme scheme, int pointCount);
+
+#endif
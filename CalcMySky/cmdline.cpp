@@ -1,5 +1,6 @@
 #include "cmdline.hpp"
 
+#include <climits>
 #include <iomanip>
 #include <optional>
 #include <iostream>
@@ -17,6 +18,8 @@
 
 #include "data.hpp"
 #include "util.hpp"
+#include "sweep.hpp"
+#include "../common/OffscreenGL.hpp"
 #include "../ShowMySky/api/ShowMySky/AtmosphereRenderer.hpp"
 
 namespace
@@ -174,12 +177,37 @@ void handleCmdLine()
     const QCommandLineOption textureSavePrecisionOpt("texture-save-precision","Number of bits of precision when saving 3D textures, from 1 to 24. Smaller number improves compressibility. Too small destroys fidelity.","bits");
     const QCommandLineOption dbgNoSaveTexturesOpt("no-save-tex","Don't save textures, only save shaders and other fast-to-compute data; don't run the long 4D "
                                                                 "textures computations (for debugging)");
+    const QCommandLineOption stageTimingsOpt("timings-json","Measure wall and GPU time of each computation stage and save them to a JSON file. "
+                                                            "This makes the computation wait for the GPU at the end of each stage.","file");
+    const QCommandLineOption eventStreamOpt("events","Send progress and timing events as JSON lines to the given destination: \"fd:N\" for an open "
+                                                     "file descriptor, \"unix:PATH\" for a listening Unix domain socket, or a file path. "
+                                                     "Like --timings-json, this makes the computation wait for the GPU at the end of each stage.",
+                                            "destination");
     const QCommandLineOption dbgNoEDSTexturesOpt("no-eds-tex","Don't compute/save eclipsed double scattering textures (for debugging)");
     const QCommandLineOption dbgSaveGroundIrradianceOpt("save-irradiance","Save intermediate ground irradiance textures (for debugging)");
     const QCommandLineOption dbgSaveScatDensityOrder2FromGroundOpt("save-scat-density2-from-ground","Save order 2 scattering density from ground (for debugging)");
     const QCommandLineOption dbgSaveScatDensityOpt("save-scat-density","Save scattering density textures (for debugging)");
     const QCommandLineOption dbgSaveDeltaScatteringOpt("save-delta-scattering","Save delta scattering textures for each order (for debugging)");
     const QCommandLineOption dbgSaveAccumScatteringOpt("save-accum-scattering","Save accumulated multiple scattering textures for each order (for debugging)");
+    const QCommandLineOption dbgAngularIntegrationReportOpt("angular-integration-report","Compare scattering density of orders 3 and higher computed "
+                                                                  "using both angular integration schemes to that computed using the uniform scheme "
+                                                                  "with the given number of points (for debugging)","points");
+    const QCommandLineOption dbgRadialQuadratureReportOpt("radial-quadrature-report","Compute single scattering, multiple scattering and "
+                                                                "light pollution textures also with twice as many radial integration "
+                                                                "points, and report the estimated quadrature errors (for debugging)");
+    const QCommandLineOption tuneOpt("tune","Instead of computing the textures, find the smallest numbers of integration points and transmittance "
+                                            "and irradiance texture sizes that reach the given relative error, print the predicted computation "
+                                            "time and write an atmosphere description with these parameters","relative error");
+    const QCommandLineOption tuneOutputOpt("tune-output","File to write the tuned atmosphere description to, by default tuned.atmo in "
+                                                         "the output directory","file");
+    const QCommandLineOption sweepOpt("sweep","Compute a model for each job in the given sweep file, which overrides entries of the "
+                                              "atmosphere description, reusing the results of the stages not affected by the overrides",
+                                      "file");
+    const QCommandLineOption batchOpt("batch","Compute a model for each atmosphere description listed in the given manifest file, one "
+                                              "path per line, in a single process. Several descriptions can also be given as arguments",
+                                      "manifest");
+    // Applied in selectOffscreenGLBackend() before the application is created, declared here to appear in the help
+    const QCommandLineOption glBackendOpt(GL_BACKEND_OPTION_NAME, GL_BACKEND_OPTION_DESCRIPTION, "backend");
     const QCommandLineOption dbgSaveLightPollutionIntermediateOpt("save-light-pollution","Save intermediate light pollution textures (for debugging)");
     const QList options{
                         helpOpt,
@@ -187,6 +215,13 @@ void handleCmdLine()
                         textureOutputDirOpt,
                         saveResultAsRadianceOpt,
                         textureSavePrecisionOpt,
+                        stageTimingsOpt,
+                        eventStreamOpt,
+                        tuneOpt,
+                        tuneOutputOpt,
+                        sweepOpt,
+                        batchOpt,
+                        glBackendOpt,
                         dbgNoEDSTexturesOpt,
                         dbgNoSaveTexturesOpt,
                         printOpenGLInfoAndQuit,
@@ -198,10 +233,12 @@ void handleCmdLine()
                         dbgSaveDeltaScatteringOpt,
                         dbgSaveAccumScatteringOpt,
                         dbgSaveLightPollutionIntermediateOpt,
+                        dbgAngularIntegrationReportOpt,
+                        dbgRadialQuadratureReportOpt,
                        };
     parser.addOptions(options);
-    const std::pair<QString, QString> positionalArgument("atmosphere-description.atmo",
-                                                         "Atmosphere description file");
+    const std::pair<QString, QString> positionalArgument("atmosphere-description.atmo...",
+                                                         "Atmosphere description files");
     parser.addPositionalArgument("atmo-descr", positionalArgument.second, positionalArgument.first);
     parser.process(*qApp);
 
@@ -238,6 +275,12 @@ void handleCmdLine()
         opts.dbgSaveAccumScattering=true;
     if(parser.isSet(dbgSaveLightPollutionIntermediateOpt))
         opts.dbgSaveLightPollutionIntermediateTextures=true;
+    if(parser.isSet(dbgRadialQuadratureReportOpt))
+        opts.dbgRadialQuadratureReport=true;
+    if(parser.isSet(stageTimingsOpt))
+        opts.stageTimingsPath=parser.value(stageTimingsOpt).toStdString();
+    if(parser.isSet(eventStreamOpt))
+        opts.eventStreamDestination=parser.value(eventStreamOpt).toStdString();
     if(parser.isSet(openglDebug))
         opts.openglDebug=true;
     if(parser.isSet(openglDebugFull))
@@ -260,16 +303,72 @@ void handleCmdLine()
         }
     }
 
-    const auto posArgs=parser.positionalArguments();
-    if(posArgs.size()>1)
+    if(parser.isSet(dbgAngularIntegrationReportOpt))
     {
-        std::cerr << "Too many arguments\n";
+        bool ok=false;
+        opts.angularIntegrationReferencePoints=parser.value(dbgAngularIntegrationReportOpt).toUInt(&ok);
+        if(!ok || opts.angularIntegrationReferencePoints<1 || opts.angularIntegrationReferencePoints>INT_MAX)
+        {
+            std::cerr << "Number of reference angular integration points must be a positive integer.\n";
+            throw MustQuit{};
+        }
+    }
+
+    if(parser.isSet(tuneOpt))
+    {
+        bool ok=false;
+        opts.tuningTargetError=parser.value(tuneOpt).toDouble(&ok);
+        if(!ok || !(opts.tuningTargetError>0 && opts.tuningTargetError<1))
+        {
+            std::cerr << "Target relative error for tuning must be a number between 0 and 1.\n";
+            throw MustQuit{};
+        }
+        opts.tunedAtmoPath = parser.isSet(tuneOutputOpt) ? parser.value(tuneOutputOpt).toStdString()
+                                                          : atmo.textureOutputDir+"/tuned.atmo";
+    }
+    else if(parser.isSet(tuneOutputOpt))
+    {
+        std::cerr << "--tune-output requires --tune\n";
         throw MustQuit{};
     }
-    if(!posArgs.isEmpty())
+    if(parser.isSet(sweepOpt))
+    {
+        if(parser.isSet(tuneOpt))
+        {
+            std::cerr << "--sweep can't be used together with --tune\n";
+            throw MustQuit{};
+        }
+        opts.sweepPath=parser.value(sweepOpt).toStdString();
+    }
+
+    const auto posArgs=parser.positionalArguments();
+    if(parser.isSet(batchOpt) || posArgs.size()>1)
+    {
+        if(!opts.sweepPath.empty() || parser.isSet(tuneOpt))
+        {
+            std::cerr << "Batch processing can't be combined with --sweep or --tune\n";
+            throw MustQuit{};
+        }
+        if(parser.isSet(batchOpt))
+        {
+            if(!posArgs.isEmpty())
+            {
+                std::cerr << "With --batch, atmosphere descriptions are only taken from the manifest\n";
+                throw MustQuit{};
+            }
+            loadBatchManifest(parser.value(batchOpt));
+        }
+        else
+        {
+            loadBatch(posArgs);
+        }
+    }
+    else if(!posArgs.isEmpty())
     {
         const auto atmoDescrFileName=posArgs[0];
         atmo.parse(atmoDescrFileName, AtmosphereParameters::ForceNoEDSTextures{opts.dbgNoEDSTextures});
+        if(!opts.sweepPath.empty())
+            loadSweep(QString::fromStdString(opts.sweepPath), atmoDescrFileName);
     }
     else if(!opts.printOpenGLInfoAndQuit)
     {
@@ -19,5 +19,11 @@ constexpr char COMPUTE_ECLIPSED_DOUBLE_SCATTERING_FILENAME[]="compute-eclipsed-d
 constexpr char SINGLE_SCATTERING_ECLIPSED_FILENAME[]="single-scattering-eclipsed.frag";
 constexpr char DOUBLE_SCATTERING_ECLIPSED_FILENAME[]="double-scattering-eclipsed.frag";
 constexpr char COMPUTE_INDIRECT_IRRADIANCE_FILENAME[]="compute-indirect-irradiance.frag";
+constexpr char SCATTERING_DENSITY_INTEGRATION_SHADER_FILENAME[]="scattering-density-integration.frag";
+constexpr char SCATTERING_DENSITY_INTEGRATION_HEADER_FILENAME[]="scattering-density-integration.h.glsl";
+constexpr char TABULATE_SCATTERING_PHASE_FILENAME[]="tabulate-scattering-phase.frag";
+constexpr char TABULATE_PROFILES_FILENAME[]="tabulate-profiles.frag";
+constexpr char RADIAL_QUADRATURE_SHADER_FILENAME[]="radial-quadrature.frag";
+constexpr char RADIAL_QUADRATURE_HEADER_FILENAME[]="radial-quadrature.h.glsl";
 
 #endif
@@ -43,6 +43,8 @@ enum TextureId
     TEX_LIGHT_POLLUTION_DELTA_SCATTERING,
     TEX_LIGHT_POLLUTION_SCATTERING_LUMINANCE,
     TEX_LIGHT_POLLUTION_SCATTERING_PREV_ORDER,
+    TEX_NUMBER_DENSITY_TABLE,
+    TEX_PHASE_FUNCTION_TABLE,
 
     TEX_COUNT
 };
@@ -65,6 +67,13 @@ struct Options
     bool dbgSaveDeltaScattering=false;
     bool dbgSaveAccumScattering=false;
     bool dbgSaveLightPollutionIntermediateTextures=false;
+    std::string stageTimingsPath; // empty means no timing
+    std::string eventStreamDestination; // empty means no event stream
+    unsigned angularIntegrationReferencePoints=0; // 0 means no accuracy report
+    bool dbgRadialQuadratureReport=false;
+    double tuningTargetError=0; // 0 means no tuning
+    std::string tunedAtmoPath;
+    std::string sweepPath; // empty means a single model is computed
 };
 inline Options opts;
 inline AtmosphereParameters atmo;
@@ -0,0 +1,172 @@
+#include "event-stream.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QCoreApplication>
+#ifdef Q_OS_UNIX
+#   include <cerrno>
+#   include <csignal>
+#   include <cstring>
+#   include <sys/resource.h>
+#   include <sys/socket.h>
+#   include <sys/un.h>
+#   include <unistd.h>
+#endif
+
+#include "config.h"
+#include "util.hpp"
+
+namespace
+{
+
+QFile stream;
+std::string currentJob;
+std::chrono::steady_clock::time_point streamOpenTime;
+
+// Returns -1 if unknown
+long long peakResidentMemory()
+{
+#ifdef Q_OS_UNIX
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage)!=0)
+        return -1;
+# ifdef Q_OS_MACOS
+    return usage.ru_maxrss; // bytes
+# else
+    return usage.ru_maxrss*1024LL; // kibibytes
+# endif
+#else
+    return -1;
+#endif
+}
+
+int parseFileDescriptor(std::string const& destination)
+{
+    bool ok=false;
+    const int fd=QString::fromStdString(destination.substr(3)).toInt(&ok);
+    if(!ok || fd<0)
+    {
+        std::cerr << "Bad file descriptor in event stream destination \"" << destination << "\"\n";
+        throw MustQuit{};
+    }
+    return fd;
+}
+
+#ifdef Q_OS_UNIX
+int connectToUnixSocket(std::string const& path)
+{
+    sockaddr_un address{};
+    address.sun_family=AF_UNIX;
+    if(path.size() >= sizeof address.sun_path)
+    {
+        std::cerr << "Path of the event stream socket \"" << path << "\" is too long\n";
+        throw MustQuit{};
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    const int fd=socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd<0)
+    {
+        std::cerr << "Failed to create event stream socket: " << std::strerror(errno) << "\n";
+        throw MustQuit{};
+    }
+    if(::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof address)!=0)
+    {
+        std::cerr << "Failed to connect to event stream socket \"" << path << "\": " << std::strerror(errno) << "\n";
+        ::close(fd);
+        throw MustQuit{};
+    }
+    return fd;
+}
+#endif
+
+}
+
+void openEventStream(std::string const& destination)
+{
+    bool opened;
+    if(destination.rfind("fd:", 0)==0)
+    {
+        opened=stream.open(parseFileDescriptor(destination), QFile::WriteOnly|QFile::Unbuffered, QFile::DontCloseHandle);
+    }
+    else if(destination.rfind("unix:", 0)==0)
+    {
+#ifdef Q_OS_UNIX
+        const auto fd=connectToUnixSocket(destination.substr(5));
+        opened=stream.open(fd, QFile::WriteOnly|QFile::Unbuffered, QFile::AutoCloseHandle);
+#else
+        std::cerr << "Unix domain sockets aren't supported for the event stream on this platform\n";
+        throw MustQuit{};
+#endif
+    }
+    else
+    {
+        stream.setFileName(QString::fromStdString(destination));
+        opened=stream.open(QFile::WriteOnly|QFile::Unbuffered);
+    }
+    if(!opened)
+    {
+        std::cerr << "Failed to open event stream \"" << destination << "\": " << stream.errorString().toStdString() << "\n";
+        throw MustQuit{};
+    }
+#ifdef Q_OS_UNIX
+    // If the listener goes away, we want a write error instead of being killed
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    streamOpenTime=std::chrono::steady_clock::now();
+    emitEvent("start", {{"version", PROJECT_VERSION},
+                        {"command_line", qApp->arguments().join(' ')}});
+}
+
+bool eventStreamIsOpen()
+{
+    return stream.isOpen();
+}
+
+void setEventStreamJob(std::string const& jobName)
+{
+    currentJob=jobName;
+}
+
+void emitEvent(QString const& kind, QJsonObject fields)
+{
+    if(!stream.isOpen()) return;
+
+    fields["event"]=kind;
+    fields["time_s"]=std::chrono::duration<double>(std::chrono::steady_clock::now()-streamOpenTime).count();
+    if(!currentJob.empty())
+        fields["job"]=QString::fromStdString(currentJob);
+    if(kind!="start")
+    {
+        if(const auto peakMemory=peakResidentMemory(); peakMemory>=0)
+            fields["peak_memory_bytes"]=double(peakMemory);
+    }
+
+    const auto line=QJsonDocument(fields).toJson(QJsonDocument::Compact)+'\n';
+    if(stream.write(line)!=line.size())
+    {
+        // Losing the listener is no reason to abort a long computation
+        std::cerr << "\nWARNING: failed to write to event stream, closing it: " << stream.errorString().toStdString() << "\n";
+        stream.close();
+    }
+}
+
+void reportProgress(std::string const& what, const unsigned long long done, const unsigned long long total)
+{
+    if(!stream.isOpen()) return;
+    emitEvent("progress", {{"what", QString::fromStdString(what)},
+                           {"done", double(done)},
+                           {"total", double(total)}});
+}
+
+void reportFileWritten(std::string const& path)
+{
+    if(!stream.isOpen()) return;
+    const QFileInfo file(QString::fromStdString(path));
+    emitEvent("bytes_written", {{"path", file.absoluteFilePath()},
+                                {"bytes", double(file.size())}});
+}
@@ -0,0 +1,32 @@
+#ifndef INCLUDE_ONCE_79C275F7_D573_4F92_AF2F_89BF508A54AE
+#define INCLUDE_ONCE_79C275F7_D573_4F92_AF2F_89BF508A54AE
+
+#include <string>
+#include <QJsonObject>
+
+// The event stream lets a scheduler follow the computation: each event is a JSON object on its own line, with the
+// "event" member naming the kind of the event and "time_s" being the wall time since the stream was opened. When a
+// sweep or a batch is computed, the events of each job have the "job" member too. The kinds are:
+//  * "start": the version and the command line;
+//  * "job_start", "job_end": a job of a sweep or a batch, the latter with its wall time;
+//  * "stage_start", "stage_end": a run of a StageTimer scope, the latter with its wall and GPU time;
+//  * "progress": layers or samples done out of the total in a long computation, sent after each of them is done, so
+//    the last one has "done" equal to "total";
+//  * "bytes_written": a file has been saved;
+//  * "summary": the summed stage timings, as in the --timings-json file, sent at the end of the computation.
+// All the events except "start" also carry the peak resident memory of the process, if it's known.
+
+// Opens the destination given on the command line: "fd:N" for a file descriptor inherited from the parent process,
+// "unix:PATH" for a Unix domain socket that a listener has bound, or a path of a file to create.
+void openEventStream(std::string const& destination);
+bool eventStreamIsOpen();
+// Names the current job of a sweep or a batch; empty string means that no job is being computed
+void setEventStreamJob(std::string const& jobName);
+// Does nothing if the stream isn't open
+void emitEvent(QString const& kind, QJsonObject fields={});
+
+void reportProgress(std::string const& what, unsigned long long done, unsigned long long total);
+// Reads the size of the file, so must be called after it's closed
+void reportFileWritten(std::string const& path);
+
+#endif
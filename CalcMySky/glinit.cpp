@@ -1,8 +1,11 @@
 #include "glinit.hpp"
 
+#include <vector>
 #include <iostream>
+#include <QOffscreenSurface>
 #include "util.hpp"
 #include "data.hpp"
+#include "../common/OffscreenGL.hpp"
 
 void initBuffers()
 {
@@ -35,11 +38,6 @@ void initTexturesAndFramebuffers()
         gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
         gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
     }
-    setupTexture(TEX_TRANSMITTANCE,atmo.transmittanceTexW,atmo.transmittanceTexH);
-    setupTexture(TEX_DELTA_IRRADIANCE,atmo.irradianceTexW,atmo.irradianceTexH);
-    setupTexture(TEX_IRRADIANCE,atmo.irradianceTexW,atmo.irradianceTexH);
-
-    const auto width=atmo.scatTexWidth(), height=atmo.scatTexHeight(), depth=atmo.scatTexDepth();
     for(const auto tex : {TEX_DELTA_SCATTERING,TEX_DELTA_SCATTERING_DENSITY})
     {
         gl.glBindTexture(GL_TEXTURE_3D,textures[tex]);
@@ -47,15 +45,8 @@ void initTexturesAndFramebuffers()
         gl.glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
         gl.glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
         gl.glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_WRAP_R,GL_CLAMP_TO_EDGE);
-        setupTexture(tex,width,height,depth);
     }
-    setupTexture(TEX_MULTIPLE_SCATTERING,width,height,depth);
-    // XXX: keep in sync with its use in GLSL computeDoubleScatteringEclipsedDensitySample() and EclipsedDoubleScatteringPrecomputer's constructor
-    setupTexture(TEX_ECLIPSED_DOUBLE_SCATTERING, atmo.eclipseAngularIntegrationPoints, atmo.radialIntegrationPoints);
-
-    setupTexture(TEX_LIGHT_POLLUTION_SCATTERING           , atmo.lightPollutionTextureSize[0], atmo.lightPollutionTextureSize[1]);
-    setupTexture(TEX_LIGHT_POLLUTION_DELTA_SCATTERING     , atmo.lightPollutionTextureSize[0], atmo.lightPollutionTextureSize[1]);
-    setupTexture(TEX_LIGHT_POLLUTION_SCATTERING_PREV_ORDER, atmo.lightPollutionTextureSize[0], atmo.lightPollutionTextureSize[1]);
+    allocateTextures();
 
     gl.glGenFramebuffers(FBO_COUNT,fbos);
 }
@@ -71,42 +62,49 @@ void checkLimits()
     }
 }
 
-std::pair<std::unique_ptr<QOffscreenSurface>, std::unique_ptr<QOpenGLContext>> initOpenGL()
+void allocateTextures()
 {
-    QSurfaceFormat format;
-    format.setMajorVersion(3);
-    format.setMinorVersion(3);
-    format.setProfile(QSurfaceFormat::CoreProfile);
-
-    auto context = std::make_unique<QOpenGLContext>();
-    context->setFormat(format);
-    context->create();
-    if(!context->isValid())
-    {
-        std::cerr << "Failed to create OpenGL "
-            << format.majorVersion() << '.'
-            << format.minorVersion() << " context\n";
-        throw MustQuit{};
-    }
+    // The sizes the textures were last allocated with
+    static std::vector<GLsizei> allocatedSizes;
+    const std::vector<GLsizei> sizes{atmo.transmittanceTexW, atmo.transmittanceTexH,
+                                     atmo.irradianceTexW, atmo.irradianceTexH,
+                                     atmo.scatTexWidth(), atmo.scatTexHeight(), atmo.scatTexDepth(),
+                                     atmo.eclipseAngularIntegrationPoints, atmo.radialIntegrationPoints,
+                                     atmo.lightPollutionTextureSize[0], atmo.lightPollutionTextureSize[1]};
+    if(sizes==allocatedSizes)
+        return;
 
-    auto surface = std::make_unique<QOffscreenSurface>();
-    surface->setFormat(format);
-    surface->create();
-    if(!surface->isValid())
-    {
-        std::cerr << "Failed to create OpenGL "
-            << format.majorVersion() << '.'
-            << format.minorVersion() << " offscreen surface\n";
-        throw MustQuit{};
-    }
+    checkLimits();
+    setupTexture(TEX_TRANSMITTANCE,atmo.transmittanceTexW,atmo.transmittanceTexH);
+    setupTexture(TEX_DELTA_IRRADIANCE,atmo.irradianceTexW,atmo.irradianceTexH);
+    setupTexture(TEX_IRRADIANCE,atmo.irradianceTexW,atmo.irradianceTexH);
+
+    const auto width=atmo.scatTexWidth(), height=atmo.scatTexHeight(), depth=atmo.scatTexDepth();
+    for(const auto tex : {TEX_DELTA_SCATTERING,TEX_DELTA_SCATTERING_DENSITY})
+        setupTexture(tex,width,height,depth);
+    setupTexture(TEX_MULTIPLE_SCATTERING,width,height,depth);
+    // XXX: keep in sync with its use in GLSL computeDoubleScatteringEclipsedDensitySample() and EclipsedDoubleScatteringPrecomputer's constructor
+    setupTexture(TEX_ECLIPSED_DOUBLE_SCATTERING, atmo.eclipseAngularIntegrationPoints, atmo.radialIntegrationPoints);
 
-    context->makeCurrent(surface.get());
+    setupTexture(TEX_LIGHT_POLLUTION_SCATTERING           , atmo.lightPollutionTextureSize[0], atmo.lightPollutionTextureSize[1]);
+    setupTexture(TEX_LIGHT_POLLUTION_DELTA_SCATTERING     , atmo.lightPollutionTextureSize[0], atmo.lightPollutionTextureSize[1]);
+    setupTexture(TEX_LIGHT_POLLUTION_SCATTERING_PREV_ORDER, atmo.lightPollutionTextureSize[0], atmo.lightPollutionTextureSize[1]);
+
+    // These are created on demand with the scattering texture size
+    for(const auto& [name, texture] : accumulatedSingleScatteringTextures)
+        gl.glDeleteTextures(1, &texture);
+    accumulatedSingleScatteringTextures.clear();
+
+    allocatedSizes=sizes;
+}
+
+std::pair<std::unique_ptr<QOffscreenSurface>, std::unique_ptr<QOpenGLContext>> initOpenGL()
+{
+    auto [surface, context] = createOffscreenGLContext();
 
     if(!gl.initializeOpenGLFunctions())
     {
-        std::cerr << "Failed to initialize OpenGL "
-            << format.majorVersion() << '.'
-            << format.minorVersion() << " functions\n";
+        std::cerr << "Failed to initialize OpenGL 3.3 functions\n";
         throw MustQuit{};
     }
 
@@ -128,7 +126,6 @@ std::pair<std::unique_ptr<QOffscreenSurface>, std::unique_ptr<QOpenGLContext>> i
         setupDebugPrintCallback(*context, opts.openglDebugFull);
     initBuffers();
     initTexturesAndFramebuffers();
-    checkLimits();
 
     return {std::move(surface),std::move(context)};
 }
@@ -6,5 +6,8 @@
 class QOpenGLContext;
 class QOffscreenSurface;
 std::pair<std::unique_ptr<QOffscreenSurface>, std::unique_ptr<QOpenGLContext>> initOpenGL();
+// (Re)allocates the textures with the sizes required by the current atmosphere description. Does nothing if they
+// already have these sizes, so that consecutive jobs of a batch with the same sizes keep the storage.
+void allocateTextures();
 
 #endif
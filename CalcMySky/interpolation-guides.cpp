@@ -7,6 +7,7 @@
 #include <iostream>
 #include <QFile>
 #include "util.hpp"
+#include "event-stream.hpp"
 #include "../common/util.hpp"
 
 /* Glossary:
@@ -387,139 +388,112 @@ void generateInterpolationGuides2D(glm::vec4 const*const data,
     }
 }
 
-void generateInterpolationGuidesForScatteringTexture(const std::string_view filePath, std::vector<glm::vec4> const& pixels,
-                                                     std::vector<int> const& sizes)
+namespace
+{
+void openGuidesFile(QFile& out, QByteArray const& filePath, const uint16_t (&sizes)[4])
+{
+    out.setFileName(filePath);
+    if(!out.open(QFile::WriteOnly))
+    {
+        std::cerr << "failed to open interpolation guides file for writing: " << out.errorString().toStdString() << "\n";
+        throw MustQuit{};
+    }
+    if(out.write(reinterpret_cast<const char*>(sizes), sizeof sizes) != sizeof sizes)
+    {
+        std::cerr << "failed to write interpolation guides header: " << out.errorString().toStdString() << "\n";
+        throw MustQuit{};
+    }
+}
+}
+
+ScatteringTextureGuidesGenerator::ScatteringTextureGuidesGenerator(const std::string_view filePath,
+                                                                   std::vector<int> const& sizes)
+    : vzaPointCount_(sizes[0])
+    , dVSLayerCount_(sizes[1])
+    , szaLayerCount_(sizes[2])
+    , altLayerCount_(sizes[3])
 {
-    std::cerr << indentOutput() << "Generating interpolation guides:\n";
-    const auto filePathQt = QByteArray::fromRawData(filePath.data(), filePath.size());
+    const auto filePathQt = QByteArray(filePath.data(), filePath.size());
     const std::string_view ext = ".f32";
     if(!filePathQt.endsWith(ext.data()))
     {
         std::cerr << "wrong input filename extension\n";
         throw MustQuit{};
     }
+    const auto basePath = filePathQt.left(filePathQt.size() - ext.size());
 
-    const auto altLayerCount = sizes[3];
-    const auto szaLayerCount = sizes[2];
-    const auto dVSLayerCount = sizes[1];
-    const auto vzaPointCount = sizes[0];
-    // Handle dimensions VZA-dotViewSun
-    {
-        OutputIndentIncrease incr;
-        std::cerr << indentOutput() << "Generating interpolation guides for VZA-dotViewSun dimensions... ";
-
-        const auto outputFilePath = filePathQt.left(filePathQt.size() - ext.size()) + "-dims01.guides2d";
-        QFile out(outputFilePath);
-        if(!out.open(QFile::WriteOnly))
-        {
-            std::cerr << "failed to open interpolation guides file for writing: " << out.errorString().toStdString() << "\n";
-            throw MustQuit{};
-        }
-        {
-            // Guides represent points between rows, so there's one less of them than rows.
-            uint16_t outputSizes[4] = {uint16_t(sizes[0]), uint16_t(sizes[1]-1), uint16_t(sizes[2]), uint16_t(sizes[3])};
-            if(out.write(reinterpret_cast<const char*>(outputSizes), sizeof outputSizes) != sizeof outputSizes)
-            {
-                std::cerr << "failed to write interpolation guides header: " << out.errorString().toStdString() << "\n";
-                throw MustQuit{};
-            }
-        }
+    // Guides represent points between rows, so there's one less of them than rows.
+    openGuidesFile(outVZA_dVS_, basePath + "-dims01.guides2d",
+                   {uint16_t(sizes[0]), uint16_t(sizes[1]-1), uint16_t(sizes[2]), uint16_t(sizes[3])});
+    openGuidesFile(outVZA_SZA_, basePath + "-dims02.guides2d",
+                   {uint16_t(sizes[0]), uint16_t(sizes[1]), uint16_t(sizes[2]-1), uint16_t(sizes[3])});
 
-        uint16_t rowStride = vzaPointCount, height = dVSLayerCount;
-        std::vector<int16_t> angles(rowStride*(height-1));
-        for(int altIndex = 0; altIndex < altLayerCount; ++altIndex)
-        {
-            std::ostringstream ss;
-            ss << altIndex << " of " << altLayerCount << " layers done ";
-            std::cerr << ss.str();
+    anglesVZA_dVS_.resize(vzaPointCount_*(dVSLayerCount_-1));
+    anglesVZA_SZA_.resize(vzaPointCount_*dVSLayerCount_*(szaLayerCount_-1));
+}
 
-            for(int szaIndex = 0; szaIndex < szaLayerCount; ++szaIndex)
-            {
-                const int altSliceOffset = altIndex*szaLayerCount*dVSLayerCount*vzaPointCount;
-                const int szaSubsliceOffset = szaIndex*vzaPointCount*dVSLayerCount;
-                const int aboveHorizonHalfSpaceOffset = vzaPointCount/2 + 1; // +1 skips zenith point, because it may have an extraneous maximum
-                const int aboveHorizonHalfSpaceSize = vzaPointCount/2 - 1;   // -1 takes into account the +1 in the offset
-                std::fill(angles.begin(), angles.end(), 0.f);
-                generateInterpolationGuides2D(&pixels[altSliceOffset + szaSubsliceOffset + aboveHorizonHalfSpaceOffset],
-                                              aboveHorizonHalfSpaceSize, height, rowStride,
-                                              angles.data()+aboveHorizonHalfSpaceOffset, altIndex, szaIndex, "SZA", true);
-                out.write(reinterpret_cast<const char*>(angles.data()), angles.size()*sizeof angles[0]);
-            }
+void ScatteringTextureGuidesGenerator::processAltitudeSlice(glm::vec4 const*const pixels, const int altIndex)
+{
+    if(altIndex != altLayersDone_)
+    {
+        std::cerr << "internal error: altitude layers are expected to come in order, but got layer " << altIndex
+                  << " instead of " << altLayersDone_ << "\n";
+        throw MustQuit{};
+    }
 
-            // Clear previous status and reset cursor position
-            const auto statusWidth=ss.tellp();
-            std::cerr << std::string(statusWidth, '\b') << std::string(statusWidth, ' ')
-                      << std::string(statusWidth, '\b');
-        }
-        std::cerr << "done\n";
-        std::cerr << indentOutput() << "Saving interpolation guides to \"" << outputFilePath.toStdString() << "\"... ";
+    const int aboveHorizonHalfSpaceOffset = vzaPointCount_/2 + 1; // +1 skips zenith point, because it may have an extraneous maximum
+    const int aboveHorizonHalfSpaceSize = vzaPointCount_/2 - 1;   // -1 takes into account the +1 in the offset
 
-        out.close();
-        if(out.error())
+    // Handle dimensions VZA-dotViewSun
+    {
+        const int rowStride = vzaPointCount_, height = dVSLayerCount_;
+        for(int szaIndex = 0; szaIndex < szaLayerCount_; ++szaIndex)
         {
-            std::cerr << "failed to write file: " << out.errorString().toStdString() << "\n";
-            throw MustQuit{};
+            const int szaSubsliceOffset = szaIndex*vzaPointCount_*dVSLayerCount_;
+            std::fill(anglesVZA_dVS_.begin(), anglesVZA_dVS_.end(), 0);
+            generateInterpolationGuides2D(&pixels[szaSubsliceOffset + aboveHorizonHalfSpaceOffset],
+                                          aboveHorizonHalfSpaceSize, height, rowStride,
+                                          anglesVZA_dVS_.data()+aboveHorizonHalfSpaceOffset, altIndex, szaIndex, "SZA", true);
+            outVZA_dVS_.write(reinterpret_cast<const char*>(anglesVZA_dVS_.data()), anglesVZA_dVS_.size()*sizeof anglesVZA_dVS_[0]);
         }
-        std::cerr << "done\n";
     }
     // Handle dimensions VZA-SZA
     {
-        OutputIndentIncrease incr;
-        std::cerr << indentOutput() << "Generating interpolation guides for VZA-SZA dimensions... ";
-
-        const auto outputFilePath = filePathQt.left(filePathQt.size() - ext.size()) + "-dims02.guides2d";
-        QFile out(outputFilePath);
-        if(!out.open(QFile::WriteOnly))
+        const int rowStride = vzaPointCount_*dVSLayerCount_, height = szaLayerCount_;
+        std::fill(anglesVZA_SZA_.begin(), anglesVZA_SZA_.end(), 0);
+        for(int dVSIndex = 0; dVSIndex < dVSLayerCount_; ++dVSIndex)
         {
-            std::cerr << "failed to open interpolation guides file for writing: " << out.errorString().toStdString() << "\n";
-            throw MustQuit{};
-        }
-        {
-            // Guides represent points between rows, so there's one less of them than rows.
-            uint16_t outputSizes[4] = {uint16_t(sizes[0]), uint16_t(sizes[1]), uint16_t(sizes[2]-1), uint16_t(sizes[3])};
-            if(out.write(reinterpret_cast<const char*>(outputSizes), sizeof outputSizes) != sizeof outputSizes)
-            {
-                std::cerr << "failed to write interpolation guides header: " << out.errorString().toStdString() << "\n";
-                throw MustQuit{};
-            }
+            const int dVSSubsliceOffset = vzaPointCount_*dVSIndex;
+            generateInterpolationGuides2D(&pixels[dVSSubsliceOffset + aboveHorizonHalfSpaceOffset],
+                                          aboveHorizonHalfSpaceSize, height, rowStride,
+                                          anglesVZA_SZA_.data() + dVSSubsliceOffset + aboveHorizonHalfSpaceOffset,
+                                          altIndex, dVSIndex, "dotViewSun", false/*same rows, no need to recheck*/);
         }
+        outVZA_SZA_.write(reinterpret_cast<const char*>(anglesVZA_SZA_.data()), anglesVZA_SZA_.size()*sizeof anglesVZA_SZA_[0]);
+    }
 
-        uint16_t rowStride = vzaPointCount*dVSLayerCount, height = szaLayerCount;
-        std::vector<int16_t> angles(rowStride*(height-1));
-        for(int altIndex = 0; altIndex < altLayerCount; ++altIndex)
-        {
-            std::ostringstream ss;
-            ss << altIndex << " of " << altLayerCount << " layers done ";
-            std::cerr << ss.str();
-
-            std::fill(angles.begin(), angles.end(), 0.f);
-            for(int dVSIndex = 0; dVSIndex < dVSLayerCount; ++dVSIndex)
-            {
-                const int altSliceOffset = altIndex*szaLayerCount*dVSLayerCount*vzaPointCount;
-                const int dVSSubsliceOffset = vzaPointCount*dVSIndex;
-                const int aboveHorizonHalfSpaceOffset = vzaPointCount/2 + 1; // +1 skips zenith point, because it may have an extraneous maximum
-                const int aboveHorizonHalfSpaceSize = vzaPointCount/2 - 1;   // -1 takes into account the +1 in the offset
-                generateInterpolationGuides2D(&pixels[altSliceOffset + dVSSubsliceOffset + aboveHorizonHalfSpaceOffset],
-                                              aboveHorizonHalfSpaceSize, height, rowStride,
-                                              angles.data() + dVSSubsliceOffset + aboveHorizonHalfSpaceOffset,
-                                              altIndex, dVSIndex, "dotViewSun", false/*same rows, no need to recheck*/);
-            }
-            out.write(reinterpret_cast<const char*>(angles.data()), angles.size()*sizeof angles[0]);
+    ++altLayersDone_;
+}
 
-            // Clear previous status and reset cursor position
-            const auto statusWidth=ss.tellp();
-            std::cerr << std::string(statusWidth, '\b') << std::string(statusWidth, ' ')
-                      << std::string(statusWidth, '\b');
-        }
-        std::cerr << "done\n";
-        std::cerr << indentOutput() << "Saving interpolation guides to \"" << outputFilePath.toStdString() << "\"... ";
+void ScatteringTextureGuidesGenerator::finish()
+{
+    if(altLayersDone_ != altLayerCount_)
+    {
+        std::cerr << "internal error: interpolation guides were generated for " << altLayersDone_
+                  << " altitude layers out of " << altLayerCount_ << "\n";
+        throw MustQuit{};
+    }
 
-        out.close();
-        if(out.error())
+    for(auto* out : {&outVZA_dVS_, &outVZA_SZA_})
+    {
+        std::cerr << indentOutput() << "Saving interpolation guides to \"" << out->fileName().toStdString() << "\"... ";
+        out->close();
+        if(out->error())
         {
-            std::cerr << "failed to write file: " << out.errorString().toStdString() << "\n";
+            std::cerr << "failed to write file: " << out->errorString().toStdString() << "\n";
             throw MustQuit{};
         }
         std::cerr << "done\n";
+        reportFileWritten(out->fileName().toStdString());
     }
 }
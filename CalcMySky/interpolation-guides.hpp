@@ -1,10 +1,33 @@
+#ifndef INCLUDE_ONCE_4A8F3C5E_92D1_4B6E_A7C0_3E5D18F2B964
+#define INCLUDE_ONCE_4A8F3C5E_92D1_4B6E_A7C0_3E5D18F2B964
+
 #include <vector>
+#include <cstdint>
 #include <string_view>
+#include <QFile>
 #include <glm/glm.hpp>
 
-void generateInterpolationGuides2D(glm::vec4 const* data, unsigned vecIndex,
-                                   unsigned width, unsigned height, unsigned rowStride,
-                                   bool detailedSideIsWidth, uint8_t* angles);
-void generateInterpolationGuidesForScatteringTexture(std::string_view filePath,
-                                                     std::vector<glm::vec4> const& pixels,
-                                                     std::vector<int> const& sizes);
+void generateInterpolationGuides2D(glm::vec4 const* data,
+                                   unsigned width, unsigned height, unsigned rowStride, int16_t* angles,
+                                   int altIndex, int secondDimIndex, const char* secondDimName,
+                                   bool needCheckForMultipleMaxima);
+
+/*
+ * Generates interpolation guides for a 4D scattering texture, one altitude layer at a time, so that
+ * the texture can be streamed from the GPU instead of being kept in host memory as a whole. The guides
+ * are written to "-dims01.guides2d" and "-dims02.guides2d" files next to the texture file.
+ */
+class ScatteringTextureGuidesGenerator
+{
+    QFile outVZA_dVS_, outVZA_SZA_;
+    std::vector<int16_t> anglesVZA_dVS_, anglesVZA_SZA_;
+    int vzaPointCount_, dVSLayerCount_, szaLayerCount_, altLayerCount_;
+    int altLayersDone_ = 0;
+public:
+    ScatteringTextureGuidesGenerator(std::string_view scatteringTextureFilePath, std::vector<int> const& sizes);
+    // Layers must be supplied in order of increasing altIndex
+    void processAltitudeSlice(glm::vec4 const* pixels, int altIndex);
+    void finish();
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <sstream>
 #include <complex>
 #include <memory>
+#include <algorithm>
 #include <random>
 #include <chrono>
 #include <cmath>
@@ -13,7 +14,7 @@
 #include <QRegularExpression>
 #include <QOffscreenSurface>
 #include <QSurfaceFormat>
-#include <QApplication>
+#include <QGuiApplication>
 #include <QImage>
 #include <QFile>
 
@@ -23,9 +24,19 @@
 #include "glinit.hpp"
 #include "cmdline.hpp"
 #include "shaders.hpp"
+#include "stage-timing.hpp"
+#include "event-stream.hpp"
+#include "angular-integration.hpp"
+#include "profile-tables.hpp"
+#include "quadrature.hpp"
+#include "tuner.hpp"
+#include "sweep.hpp"
 #include "interpolation-guides.hpp"
 #include "../common/EclipsedDoubleScatteringPrecomputer.hpp"
 #include "../common/TextureAverageComputer.hpp"
+#include "../common/OffscreenGL.hpp"
+#include "../common/kernels.hpp"
+#include "../common/error-statistics.hpp"
 #include "../common/timing.hpp"
 
 QOpenGLFunctions_3_3_Core gl;
@@ -84,6 +95,7 @@ void render3DTexLayers(QOpenGLShaderProgram& program, const std::string_view wha
         renderQuad();
         gl.glFinish();
         OPENGL_DEBUG_CHECK_ERROR("glFinish() FAILED in render3DTexLayers()");
+        reportProgress(std::string(whatIsBeingDone), layer+1, atmo.scatTexDepth());
 
         // Clear previous status and reset cursor position
         const auto statusWidth=ss.tellp();
@@ -98,23 +110,95 @@ void render3DTexLayers(QOpenGLShaderProgram& program, const std::string_view wha
     std::cerr << "done\n";
 }
 
+size_t scatteringTextureTexelCount()
+{
+    return size_t(atmo.scatTexWidth())*atmo.scatTexHeight()*atmo.scatTexDepth();
+}
+
+size_t lightPollutionTextureTexelCount()
+{
+    return size_t(atmo.lightPollutionTextureSize[0])*atmo.lightPollutionTextureSize[1];
+}
+
+// Prints the mean, the 99th percentile and the maximum of the relative errors of the tested data with respect to the
+// reference, multiplied by errorScale
+void printRelativeErrors(std::string const& what, std::vector<glm::vec4> const& reference,
+                         std::vector<glm::vec4> const& tested, const double errorScale=1)
+{
+    auto errors=relativeComponentErrors(reference, tested);
+    if(errors.empty())
+    {
+        std::cerr << indentOutput() << what << ": reference is zero, nothing to compare\n";
+        return;
+    }
+    for(auto& err : errors) err*=errorScale;
+    std::cerr << indentOutput() << what << ": relative error " << computeErrorStatistics(errors) << "\n";
+}
+
+bool radialQuadratureCheckEnabled()
+{
+    // Without the 4D textures computed there would be nothing to compare
+    return opts.dbgRadialQuadratureReport && !opts.dbgNoSaveTextures;
+}
+
+// The reference for the radial quadrature check uses twice as many samples per ray
+void makeReferenceRadialQuadratureSrc()
+{
+    makeRadialQuadratureSrc(2*rayQuadraturePointCount(atmo.radialQuadrature, atmo.radialIntegrationPoints));
+}
+
+void reportRadialQuadratureError(std::string const& what, std::vector<glm::vec4> const& reference,
+                                 std::vector<glm::vec4> const& tested)
+{
+    // With the error proportional to h^p, where h is the sample spacing, the error of the tested data is
+    // 2^p/(2^p-1) times their difference from the reference computed with h/2
+    const double errorGrowth=std::pow(2., rayQuadratureConvergenceOrder(atmo.radialQuadrature));
+    printRelativeErrors("Estimated radial quadrature error of "+what, reference, tested, errorGrowth/(errorGrowth-1));
+}
+
+// Calls the computation, which must compile its shader programs itself, to fill the texture. If the radial quadrature
+// check is enabled, the computation is first done with the reference quadrature, and the quadrature error of the
+// actual result is reported. The argument of the computation tells whether it's the reference run.
+void computeWithRadialQuadratureCheck(std::string const& what, const GLenum target, const TextureId texture,
+                                      const size_t texelCount, std::function<void(bool reference)> const& compute)
+{
+    if(!radialQuadratureCheckEnabled())
+    {
+        compute(false);
+        return;
+    }
+    makeReferenceRadialQuadratureSrc();
+    compute(true);
+    const auto reference=readTexture(target, textures[texture], texelCount);
+    makeRadialQuadratureSrc(atmo.radialIntegrationPoints);
+    compute(false);
+    reportRadialQuadratureError(what, reference, readTexture(target, textures[texture], texelCount));
+}
+
 void computeTransmittance(const unsigned texIndex)
 {
-    const auto program=compileShaderProgram("compute-transmittance.frag", "transmittance computation shader program");
+    const StageTimer timer("transmittance");
+    const auto sharedStageKey=transmittanceStageKey(texIndex);
+    if(!restoreSharedStageResult("transmittance", sharedStageKey, GL_TEXTURE_2D, {textures[TEX_TRANSMITTANCE]}))
+    {
+        const auto program=compileShaderProgram("compute-transmittance.frag", "transmittance computation shader program");
 
-    std::cerr << indentOutput() << "Computing transmittance... ";
+        std::cerr << indentOutput() << "Computing transmittance... ";
 
-    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_TRANSMITTANCE]);
-    assert(fbos[FBO_TRANSMITTANCE]);
-    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_TRANSMITTANCE],0);
-    checkFramebufferStatus("framebuffer for transmittance texture");
+        gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_TRANSMITTANCE]);
+        assert(fbos[FBO_TRANSMITTANCE]);
+        gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_TRANSMITTANCE],0);
+        checkFramebufferStatus("framebuffer for transmittance texture");
 
-    program->bind();
-    gl.glViewport(0, 0, atmo.transmittanceTexW, atmo.transmittanceTexH);
-    renderQuad();
+        program->bind();
+        gl.glViewport(0, 0, atmo.transmittanceTexW, atmo.transmittanceTexH);
+        renderQuad();
 
-    gl.glFinish();
-    std::cerr << "done\n";
+        gl.glFinish();
+        std::cerr << "done\n";
+        keepSharedStageResult(sharedStageKey, GL_TEXTURE_2D, textures[TEX_TRANSMITTANCE],
+                              {atmo.transmittanceTexW, atmo.transmittanceTexH, 1});
+    }
 
     saveTexture(GL_TEXTURE_2D,textures[TEX_TRANSMITTANCE],"transmittance texture",
                 atmo.textureOutputDir+"/transmittance-wlset"+std::to_string(texIndex)+".f32",
@@ -125,25 +209,34 @@ void computeTransmittance(const unsigned texIndex)
 
 void computeDirectGroundIrradiance(const unsigned texIndex)
 {
-    const auto program=compileShaderProgram("compute-direct-irradiance.frag", "direct ground irradiance computation shader program");
+    const StageTimer timer("direct ground irradiance");
+    const auto sharedStageKey=directGroundIrradianceStageKey(texIndex);
+    // Both textures get the same direct irradiance, so only one of them is kept
+    if(!restoreSharedStageResult("direct ground irradiance", sharedStageKey, GL_TEXTURE_2D,
+                                 {textures[TEX_DELTA_IRRADIANCE], textures[TEX_IRRADIANCE]}))
+    {
+        const auto program=compileShaderProgram("compute-direct-irradiance.frag", "direct ground irradiance computation shader program");
 
-    std::cerr << indentOutput() << "Computing direct ground irradiance... ";
+        std::cerr << indentOutput() << "Computing direct ground irradiance... ";
 
-    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_IRRADIANCE]);
-    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_DELTA_IRRADIANCE],0);
-    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT1,textures[TEX_IRRADIANCE],0);
-    checkFramebufferStatus("framebuffer for irradiance texture");
-    setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1});
+        gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_IRRADIANCE]);
+        gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_DELTA_IRRADIANCE],0);
+        gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT1,textures[TEX_IRRADIANCE],0);
+        checkFramebufferStatus("framebuffer for irradiance texture");
+        setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1});
 
-    program->bind();
+        program->bind();
 
-    setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+        setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
 
-    gl.glViewport(0, 0, atmo.irradianceTexW, atmo.irradianceTexH);
-    renderQuad();
+        gl.glViewport(0, 0, atmo.irradianceTexW, atmo.irradianceTexH);
+        renderQuad();
 
-    gl.glFinish();
-    std::cerr << "done\n";
+        gl.glFinish();
+        std::cerr << "done\n";
+        keepSharedStageResult(sharedStageKey, GL_TEXTURE_2D, textures[TEX_DELTA_IRRADIANCE],
+                              {atmo.irradianceTexW, atmo.irradianceTexH, 1});
+    }
 
     saveIrradiance(1,texIndex);
     gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
@@ -152,22 +245,19 @@ void computeDirectGroundIrradiance(const unsigned texIndex)
 static constexpr char renderShaderFileName[]="render.frag";
 constexpr char viewDirFuncFileName[]="calc-view-dir.frag";
 constexpr char viewDirStubFunc[]="#version 330\nvec3 calcViewDir() { return vec3(0); }";
-void saveZeroOrderScatteringRenderingShader(const unsigned texIndex)
+
+// Compiles the program whose main source is mainSrcFileName, taking the sources set up in virtualSourceFiles, and saves
+// the sources, except the stub of view direction function, to outputDir for the renderer
+std::unique_ptr<QOpenGLShaderProgram> compileAndSaveShaderProgram(QString const& mainSrcFileName, const char*const description,
+                                                                  QString const& outputDir)
 {
     std::vector<std::pair<QString, QString>> sourcesToSave;
-    virtualSourceFiles[viewDirFuncFileName]=viewDirStubFunc;
-    virtualSourceFiles[renderShaderFileName]=getShaderSrc(renderShaderFileName,IgnoreCache{})
-            .replace(QRegularExpression("\\b(RENDERING_ANY_ZERO_SCATTERING)\\b"), "1 /*\\1*/")
-            .replace(QRegularExpression("\\b(RENDERING_ZERO_SCATTERING)\\b"), "1 /*\\1*/");
-    const auto program=compileShaderProgram(renderShaderFileName,
-                                            "zero-order scattering rendering shader program",
-                                            UseGeomShader{false}, &sourcesToSave);
+    auto program=compileShaderProgram(mainSrcFileName, description, UseGeomShader{false}, &sourcesToSave);
     for(const auto& [filename, src] : sourcesToSave)
     {
         if(filename==viewDirFuncFileName) continue;
 
-        const auto filePath=QString("%1/shaders/zero-order-scattering/%2/%3")
-                                .arg(atmo.textureOutputDir.c_str()).arg(texIndex).arg(filename);
+        const auto filePath=outputDir+"/"+filename;
         std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
         QFile file(filePath);
         if(!file.open(QFile::WriteOnly))
@@ -184,74 +274,49 @@ void saveZeroOrderScatteringRenderingShader(const unsigned texIndex)
         }
         std::cerr << "done\n";
     }
+    return program;
+}
+
+void saveZeroOrderScatteringRenderingShader(const unsigned texIndex)
+{
+    virtualSourceFiles[viewDirFuncFileName]=viewDirStubFunc;
+    virtualSourceFiles[renderShaderFileName]=getShaderSrc(renderShaderFileName,IgnoreCache{})
+            .replace(QRegularExpression("\\b(RENDERING_ANY_ZERO_SCATTERING)\\b"), "1 /*\\1*/")
+            .replace(QRegularExpression("\\b(RENDERING_ZERO_SCATTERING)\\b"), "1 /*\\1*/");
+    const auto outputDir=QString("%1/shaders/zero-order-scattering/%2").arg(atmo.textureOutputDir.c_str()).arg(texIndex);
+    compileAndSaveShaderProgram(renderShaderFileName, "zero-order scattering rendering shader program", outputDir);
 }
 
 void saveEclipsedZeroOrderScatteringRenderingShader(const unsigned texIndex)
 {
-    std::vector<std::pair<QString, QString>> sourcesToSave;
     virtualSourceFiles[viewDirFuncFileName]=viewDirStubFunc;
     virtualSourceFiles[renderShaderFileName]=getShaderSrc(renderShaderFileName,IgnoreCache{})
             .replace(QRegularExpression("\\b(RENDERING_ANY_ZERO_SCATTERING)\\b"), "1 /*\\1*/")
             .replace(QRegularExpression("\\b(RENDERING_ECLIPSED_ZERO_SCATTERING)\\b"), "1 /*\\1*/");
-    const auto program=compileShaderProgram(renderShaderFileName,
-                                            "eclipsed zero-order scattering rendering shader program",
-                                            UseGeomShader{false}, &sourcesToSave);
-    for(const auto& [filename, src] : sourcesToSave)
-    {
-        if(filename==viewDirFuncFileName) continue;
-
-        const auto filePath=QString("%1/shaders/eclipsed-zero-order-scattering/%2/%3")
-                                .arg(atmo.textureOutputDir.c_str()).arg(texIndex).arg(filename);
-        std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
-        QFile file(filePath);
-        if(!file.open(QFile::WriteOnly))
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        file.write(src.toUtf8());
-        file.flush();
-        if(file.error())
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        std::cerr << "done\n";
-    }
+    const auto outputDir=QString("%1/shaders/eclipsed-zero-order-scattering/%2").arg(atmo.textureOutputDir.c_str()).arg(texIndex);
+    compileAndSaveShaderProgram(renderShaderFileName, "eclipsed zero-order scattering rendering shader program", outputDir);
 }
 
 void saveMultipleScatteringRenderingShader(const unsigned texIndex)
 {
-    std::vector<std::pair<QString, QString>> sourcesToSave;
     virtualSourceFiles[viewDirFuncFileName]=viewDirStubFunc;
     const QString macroToReplace = opts.saveResultAsRadiance ? "RENDERING_MULTIPLE_SCATTERING_RADIANCE" : "RENDERING_MULTIPLE_SCATTERING_LUMINANCE";
     virtualSourceFiles[renderShaderFileName]=getShaderSrc(renderShaderFileName,IgnoreCache{})
                                                 .replace(QRegularExpression("\\b("+macroToReplace+")\\b"), "1 /*\\1*/");
-    const auto program=compileShaderProgram(renderShaderFileName,
-                                            "multiple scattering rendering shader program",
-                                            UseGeomShader{false}, &sourcesToSave);
-    for(const auto& [filename, src] : sourcesToSave)
-    {
-        if(filename==viewDirFuncFileName) continue;
+    const auto outputDir = opts.saveResultAsRadiance ? QString("%1/shaders/multiple-scattering/%2").arg(atmo.textureOutputDir.c_str()).arg(texIndex)
+                                                     : QString("%1/shaders/multiple-scattering").arg(atmo.textureOutputDir.c_str());
+    compileAndSaveShaderProgram(renderShaderFileName, "multiple scattering rendering shader program", outputDir);
+}
 
-        const auto filePath = opts.saveResultAsRadiance ? QString("%1/shaders/multiple-scattering/%2/%3").arg(atmo.textureOutputDir.c_str()).arg(texIndex).arg(filename)
-                                                        : QString("%1/shaders/multiple-scattering/%2").arg(atmo.textureOutputDir.c_str()).arg(filename);
-        std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
-        QFile file(filePath);
-        if(!file.open(QFile::WriteOnly))
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        file.write(src.toUtf8());
-        file.flush();
-        if(file.error())
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        std::cerr << "done\n";
-    }
+// Saves the shader that renders multiple scattering for several wavelength sets in a single pass,
+// writing radiance of each set into its own color attachment. Only makes sense in radiance mode.
+void saveMultipleScatteringMRTRenderingShader()
+{
+    virtualSourceFiles[viewDirFuncFileName]=viewDirStubFunc;
+    virtualSourceFiles[renderShaderFileName]=getShaderSrc(renderShaderFileName,IgnoreCache{})
+                                                .replace(QRegularExpression("\\b(RENDERING_MULTIPLE_SCATTERING_RADIANCE_MRT)\\b"), "1 /*\\1*/");
+    const auto outputDir=QString("%1/shaders/multiple-scattering-mrt").arg(atmo.textureOutputDir.c_str());
+    compileAndSaveShaderProgram(renderShaderFileName, "multi-wavelength-set multiple scattering rendering shader program", outputDir);
 }
 
 void saveSingleScatteringRenderingShader(const unsigned texIndex, AtmosphereParameters::Scatterer const& scatterer, const SingleScatteringRenderMode renderMode)
@@ -259,7 +324,6 @@ void saveSingleScatteringRenderingShader(const unsigned texIndex, AtmospherePara
     virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc()+
         "vec4 currentPhaseFunction(float dotViewSun) { return phaseFunction_"+scatterer.name+"(dotViewSun); }\n";
 
-    std::vector<std::pair<QString, QString>> sourcesToSave;
     virtualSourceFiles[viewDirFuncFileName]=viewDirStubFunc;
     const auto renderModeDefine = renderMode==SSRM_ON_THE_FLY ? "RENDERING_SINGLE_SCATTERING_ON_THE_FLY" :
                                   scatterer.phaseFunctionType==PhaseFunctionType::General ? "RENDERING_SINGLE_SCATTERING_PRECOMPUTED_RADIANCE"
@@ -270,32 +334,10 @@ void saveSingleScatteringRenderingShader(const unsigned texIndex, AtmospherePara
                                  .replace(QRegularExpression("\\b(RENDERING_ANY_NORMAL_SINGLE_SCATTERING)\\b"), "1 /*\\1*/")
                                  .replace(QRegularExpression("\\b(PHASE_FUNCTION_IS_EMBEDDED)\\b"), phaseFuncIsEmbedded ? "1" : "0")
                                  .replace(QRegularExpression(QString("\\b(%1)\\b").arg(renderModeDefine)), "1 /*\\1*/");
-    const auto program=compileShaderProgram(renderShaderFileName,
-                                            "single scattering rendering shader program",
-                                            UseGeomShader{false}, &sourcesToSave);
-    for(const auto& [filename, src] : sourcesToSave)
-    {
-        if(filename==viewDirFuncFileName) continue;
-
-        const auto filePath = scatterer.phaseFunctionType==PhaseFunctionType::General || renderMode==SSRM_ON_THE_FLY ?
-           QString("%1/shaders/single-scattering/%2/%3/%4/%5").arg(atmo.textureOutputDir.c_str()).arg(toString(renderMode)).arg(texIndex).arg(scatterer.name).arg(filename) :
-           QString("%1/shaders/single-scattering/%2/%3/%4").arg(atmo.textureOutputDir.c_str()).arg(toString(renderMode)).arg(scatterer.name).arg(filename);
-        std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
-        QFile file(filePath);
-        if(!file.open(QFile::WriteOnly))
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        file.write(src.toUtf8());
-        file.flush();
-        if(file.error())
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        std::cerr << "done\n";
-    }
+    const auto outputDir = scatterer.phaseFunctionType==PhaseFunctionType::General || renderMode==SSRM_ON_THE_FLY ?
+       QString("%1/shaders/single-scattering/%2/%3/%4").arg(atmo.textureOutputDir.c_str()).arg(toString(renderMode)).arg(texIndex).arg(scatterer.name) :
+       QString("%1/shaders/single-scattering/%2/%3").arg(atmo.textureOutputDir.c_str()).arg(toString(renderMode)).arg(scatterer.name);
+    compileAndSaveShaderProgram(renderShaderFileName, "single scattering rendering shader program", outputDir);
 }
 
 void saveEclipsedSingleScatteringRenderingShader(const unsigned texIndex, AtmosphereParameters::Scatterer const& scatterer, const SingleScatteringRenderMode renderMode)
@@ -304,7 +346,6 @@ void saveEclipsedSingleScatteringRenderingShader(const unsigned texIndex, Atmosp
     virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc()+
         "vec4 currentPhaseFunction(float dotViewSun) { return phaseFunction_"+scatterer.name+"(dotViewSun); }\n";
 
-    std::vector<std::pair<QString, QString>> sourcesToSave;
     static constexpr char renderShaderFileName[]="render.frag";
     const auto renderModeDefine = renderMode==SSRM_ON_THE_FLY ? "RENDERING_ECLIPSED_SINGLE_SCATTERING_ON_THE_FLY" :
                                   scatterer.phaseFunctionType==PhaseFunctionType::General ? "RENDERING_ECLIPSED_SINGLE_SCATTERING_PRECOMPUTED_RADIANCE"
@@ -313,32 +354,10 @@ void saveEclipsedSingleScatteringRenderingShader(const unsigned texIndex, Atmosp
                                     .replace(QRegularExpression("\\b(RENDERING_ANY_SINGLE_SCATTERING)\\b"), "1 /*\\1*/")
                                     .replace(QRegularExpression("\\b(RENDERING_ANY_ECLIPSED_SINGLE_SCATTERING)\\b"), "1 /*\\1*/")
                                     .replace(QRegularExpression(QString("\\b(%1)\\b").arg(renderModeDefine)), "1 /*\\1*/");
-    const auto program=compileShaderProgram(renderShaderFileName,
-                                            "single scattering rendering shader program",
-                                            UseGeomShader{false}, &sourcesToSave);
-    for(const auto& [filename, src] : sourcesToSave)
-    {
-        if(filename==viewDirFuncFileName) continue;
-
-        const auto filePath = scatterer.phaseFunctionType==PhaseFunctionType::General || renderMode==SSRM_ON_THE_FLY ?
-            QString("%1/shaders/single-scattering-eclipsed/%2/%3/%4/%5").arg(atmo.textureOutputDir.c_str()).arg(toString(renderMode)).arg(texIndex).arg(scatterer.name).arg(filename) :
-            QString("%1/shaders/single-scattering-eclipsed/%2/%3/%4").arg(atmo.textureOutputDir.c_str()).arg(toString(renderMode)).arg(scatterer.name).arg(filename);
-        std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
-        QFile file(filePath);
-        if(!file.open(QFile::WriteOnly))
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        file.write(src.toUtf8());
-        file.flush();
-        if(file.error())
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        std::cerr << "done\n";
-    }
+    const auto outputDir = scatterer.phaseFunctionType==PhaseFunctionType::General || renderMode==SSRM_ON_THE_FLY ?
+        QString("%1/shaders/single-scattering-eclipsed/%2/%3/%4").arg(atmo.textureOutputDir.c_str()).arg(toString(renderMode)).arg(texIndex).arg(scatterer.name) :
+        QString("%1/shaders/single-scattering-eclipsed/%2/%3").arg(atmo.textureOutputDir.c_str()).arg(toString(renderMode)).arg(scatterer.name);
+    compileAndSaveShaderProgram(renderShaderFileName, "single scattering rendering shader program", outputDir);
 }
 
 void saveEclipsedSingleScatteringComputationShader(const unsigned texIndex, AtmosphereParameters::Scatterer const& scatterer)
@@ -347,81 +366,32 @@ void saveEclipsedSingleScatteringComputationShader(const unsigned texIndex, Atmo
     virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc()+
         "vec4 currentPhaseFunction(float dotViewSun) { return phaseFunction_"+scatterer.name+"(dotViewSun); }\n";
 
-    std::vector<std::pair<QString, QString>> sourcesToSave;
     static constexpr char renderShaderFileName[]="compute-eclipsed-single-scattering.frag";
     virtualSourceFiles[renderShaderFileName]=getShaderSrc(renderShaderFileName,IgnoreCache{})
         .replace(QRegularExpression(QString("\\b(%1)\\b").arg(scatterer.phaseFunctionType==PhaseFunctionType::General ?
                                                                   "COMPUTE_RADIANCE" : "COMPUTE_LUMINANCE")), "1 /*\\1*/");
-    const auto program=compileShaderProgram(renderShaderFileName,
-                                            "single scattering rendering shader program",
-                                            UseGeomShader{false}, &sourcesToSave);
-    for(const auto& [filename, src] : sourcesToSave)
-    {
-        if(filename==viewDirFuncFileName) continue;
-
-        const auto filePath = QString("%1/shaders/single-scattering-eclipsed/precomputation/%2/%3/%4")
-                                    .arg(atmo.textureOutputDir.c_str())
-                                    .arg(texIndex)
-                                    .arg(scatterer.name)
-                                    .arg(filename);
-        std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
-        QFile file(filePath);
-        if(!file.open(QFile::WriteOnly))
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        file.write(src.toUtf8());
-        file.flush();
-        if(file.error())
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        std::cerr << "done\n";
-    }
+    const auto outputDir = QString("%1/shaders/single-scattering-eclipsed/precomputation/%2/%3")
+                                .arg(atmo.textureOutputDir.c_str())
+                                .arg(texIndex)
+                                .arg(scatterer.name);
+    compileAndSaveShaderProgram(renderShaderFileName, "single scattering rendering shader program", outputDir);
 }
 
 void saveEclipsedDoubleScatteringRenderingShader(const unsigned texIndex)
 {
     virtualSourceFiles.erase(DOUBLE_SCATTERING_ECLIPSED_FILENAME);
 
-    std::vector<std::pair<QString, QString>> sourcesToSave;
     virtualSourceFiles[viewDirFuncFileName]=viewDirStubFunc;
     const QString macroToReplace = opts.saveResultAsRadiance ? "RENDERING_ECLIPSED_DOUBLE_SCATTERING_PRECOMPUTED_RADIANCE"
                                                              : "RENDERING_ECLIPSED_DOUBLE_SCATTERING_PRECOMPUTED_LUMINANCE";
     virtualSourceFiles[renderShaderFileName]=getShaderSrc(renderShaderFileName,IgnoreCache{})
         .replace(QRegularExpression("\\b("+macroToReplace+")\\b"), "1 /*\\1*/");
-    const auto program=compileShaderProgram(renderShaderFileName,
-                                            "double scattering rendering shader program",
-                                            UseGeomShader{false}, &sourcesToSave);
-    for(const auto& [filename, src] : sourcesToSave)
-    {
-        if(filename==viewDirFuncFileName) continue;
-
-        const auto filePath = opts.saveResultAsRadiance ? QString("%1/shaders/double-scattering-eclipsed/precomputed/%2/%3")
-                                                                    .arg(atmo.textureOutputDir.c_str())
-                                                                    .arg(texIndex)
-                                                                    .arg(filename)
-                                                        : QString("%1/shaders/double-scattering-eclipsed/precomputed/%2")
-                                                                    .arg(atmo.textureOutputDir.c_str())
-                                                                    .arg(filename);
-        std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
-        QFile file(filePath);
-        if(!file.open(QFile::WriteOnly))
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        file.write(src.toUtf8());
-        file.flush();
-        if(file.error())
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        std::cerr << "done\n";
-    }
+    const auto outputDir = opts.saveResultAsRadiance ? QString("%1/shaders/double-scattering-eclipsed/precomputed/%2")
+                                                                .arg(atmo.textureOutputDir.c_str())
+                                                                .arg(texIndex)
+                                                     : QString("%1/shaders/double-scattering-eclipsed/precomputed")
+                                                                .arg(atmo.textureOutputDir.c_str());
+    compileAndSaveShaderProgram(renderShaderFileName, "double scattering rendering shader program", outputDir);
 }
 
 void saveLightPollutionRenderingShader(const unsigned texIndex)
@@ -432,45 +402,44 @@ void saveLightPollutionRenderingShader(const unsigned texIndex)
         return;
     }
 
-    std::vector<std::pair<QString, QString>> sourcesToSave;
     virtualSourceFiles[viewDirFuncFileName]=viewDirStubFunc;
     const QString macroToReplace = opts.saveResultAsRadiance ? "RENDERING_LIGHT_POLLUTION_RADIANCE" : "RENDERING_LIGHT_POLLUTION_LUMINANCE";
     virtualSourceFiles[renderShaderFileName]=getShaderSrc(renderShaderFileName,IgnoreCache{})
                                                 .replace(QRegularExpression("\\b("+macroToReplace+")\\b"), "1 /*\\1*/")
                                                 .replace(QRegularExpression("\\b(RENDERING_ANY_LIGHT_POLLUTION)\\b"), "1/*\\1*/");
-    const auto program=compileShaderProgram(renderShaderFileName,
-                                            "light pollution rendering shader program",
-                                            UseGeomShader{false}, &sourcesToSave);
-    for(const auto& [filename, src] : sourcesToSave)
-    {
-        if(filename==viewDirFuncFileName) continue;
+    const auto outputDir = opts.saveResultAsRadiance ? QString("%1/shaders/light-pollution/%2").arg(atmo.textureOutputDir.c_str()).arg(texIndex)
+                                                     : QString("%1/shaders/light-pollution").arg(atmo.textureOutputDir.c_str());
+    compileAndSaveShaderProgram(renderShaderFileName, "light pollution rendering shader program", outputDir);
+}
 
-        const auto filePath = opts.saveResultAsRadiance ? QString("%1/shaders/light-pollution/%2/%3").arg(atmo.textureOutputDir.c_str()).arg(texIndex).arg(filename)
-                                                        : QString("%1/shaders/light-pollution/%2").arg(atmo.textureOutputDir.c_str()).arg(filename);
-        std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
-        QFile file(filePath);
-        if(!file.open(QFile::WriteOnly))
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        file.write(src.toUtf8());
-        file.flush();
-        if(file.error())
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        std::cerr << "done\n";
+
+void saveScatteringTexture(const GLuint texture, std::string const& filePath, std::vector<int> const& sizes,
+                           const bool needsInterpolationGuides)
+{
+    if(!needsInterpolationGuides || opts.dbgNoSaveTextures)
+    {
+        saveTexture(GL_TEXTURE_3D, texture, "single scattering texture", filePath, sizes);
+        return;
     }
-}
 
+    const StageTimer timer("interpolation guides");
+    std::cerr << indentOutput() << "Interpolation guides will be generated while saving the texture\n";
+    ScatteringTextureGuidesGenerator guidesGenerator(filePath, sizes);
+    saveTexture(GL_TEXTURE_3D, texture, "single scattering texture", filePath, sizes,
+                [&guidesGenerator](glm::vec4 const*const altitudeSlice, const int altIndex)
+                { guidesGenerator.processAltitudeSlice(altitudeSlice, altIndex); });
+    guidesGenerator.finish();
+}
 
 void accumulateSingleScattering(const unsigned texIndex, AtmosphereParameters::Scatterer const& scatterer)
 {
-    gl.glBlendFunc(GL_ONE, GL_ONE);
-    gl.glEnable(GL_BLEND);
     auto& targetTexture=accumulatedSingleScatteringTextures[scatterer.name];
+    // The first wavelength set overwrites the texture, since it may still hold the result of a previous sweep job
+    gl.glBlendFunc(GL_ONE, GL_ONE);
+    if(texIndex>0)
+        gl.glEnable(GL_BLEND);
+    else
+        gl.glDisable(GL_BLEND);
     if(!targetTexture)
     {
         gl.glGenTextures(1, &targetTexture);
@@ -480,7 +449,6 @@ void accumulateSingleScattering(const unsigned texIndex, AtmosphereParameters::S
         gl.glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
         gl.glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_WRAP_R,GL_CLAMP_TO_EDGE);
         setupTexture(targetTexture, atmo.scatTexWidth(),atmo.scatTexHeight(),atmo.scatTexDepth());
-        gl.glDisable(GL_BLEND);
     }
     gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_SINGLE_SCATTERING]);
     gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0, targetTexture,0);
@@ -503,15 +471,13 @@ void accumulateSingleScattering(const unsigned texIndex, AtmosphereParameters::S
         const auto filePath = atmo.textureOutputDir+"/single-scattering/"+scatterer.name.toStdString()+"-xyzw.f32";
         const std::vector<int> sizes{atmo.scatteringTextureSize[0], atmo.scatteringTextureSize[1],
                                      atmo.scatteringTextureSize[2], atmo.scatteringTextureSize[3]};
-        const auto data = saveTexture(GL_TEXTURE_3D,targetTexture, "single scattering texture",
-                                      filePath, sizes, ReturnTextureData{true});
-        if(scatterer.needsInterpolationGuides && !opts.dbgNoSaveTextures)
-            generateInterpolationGuidesForScatteringTexture(filePath, data, sizes);
+        saveScatteringTexture(targetTexture, filePath, sizes, scatterer.needsInterpolationGuides);
     }
 }
 
 void computeSingleScattering(const unsigned texIndex, AtmosphereParameters::Scatterer const& scatterer)
 {
+    const StageTimer timer("single scattering: "+scatterer.name.toStdString());
     gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_DELTA_SCATTERING]);
     gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0, textures[TEX_DELTA_SCATTERING],0);
     checkFramebufferStatus("framebuffer for first scattering");
@@ -520,17 +486,30 @@ void computeSingleScattering(const unsigned texIndex, AtmosphereParameters::Scat
 
     const auto src=makeScattererDensityFunctionsSrc()+
                     "float scattererDensity(float alt) { return scattererNumberDensity_"+scatterer.name+"(alt); }\n"+
-                    "vec4 scatteringCrossSection() { return "+toString(scatterer.scatteringCrossSection(atmo.allWavelengths[texIndex]))+"; }\n";
+                    // Not a literal, so that the renderer can select the wavelength set at run time
+                    "vec4 scatteringCrossSection() { return scatteringCrossSection_"+scatterer.name+"; }\n";
     virtualSourceFiles[DENSITIES_SHADER_FILENAME]=src;
     virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc()+
         "vec4 currentPhaseFunction(float dotViewSun) { return phaseFunction_"+scatterer.name+"(dotViewSun); }\n";
-    const auto program=compileShaderProgram("compute-single-scattering.frag",
-                                            "single scattering computation shader program",
-                                            UseGeomShader{});
-    program->bind();
-    setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
-
-    render3DTexLayers(*program, "Computing single scattering layers");
+    const auto sharedStageKey=singleScatteringStageKey(texIndex, scatterer);
+    if(!restoreSharedStageResult("single scattering", sharedStageKey, GL_TEXTURE_3D, {textures[TEX_DELTA_SCATTERING]}))
+    {
+        computeWithRadialQuadratureCheck("single scattering by \""+scatterer.name.toStdString()+"\"",
+                                         GL_TEXTURE_3D, TEX_DELTA_SCATTERING, scatteringTextureTexelCount(),
+                                         [](const bool reference)
+        {
+            const auto program=compileShaderProgram("compute-single-scattering.frag",
+                                                    "single scattering computation shader program",
+                                                    UseGeomShader{});
+            program->bind();
+            setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+
+            render3DTexLayers(*program, reference ? "Computing reference single scattering layers"
+                                                  : "Computing single scattering layers");
+        });
+        keepSharedStageResult(sharedStageKey, GL_TEXTURE_3D, textures[TEX_DELTA_SCATTERING],
+                              {atmo.scatTexWidth(), atmo.scatTexHeight(), atmo.scatTexDepth()});
+    }
 
     gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
 
@@ -542,10 +521,7 @@ void computeSingleScattering(const unsigned texIndex, AtmosphereParameters::Scat
                                 "/"+scatterer.name.toStdString()+".f32";
         const std::vector<int> sizes{atmo.scatteringTextureSize[0], atmo.scatteringTextureSize[1],
                                      atmo.scatteringTextureSize[2], atmo.scatteringTextureSize[3]};
-        const auto data = saveTexture(GL_TEXTURE_3D,textures[TEX_DELTA_SCATTERING], "single scattering texture",
-                                      filePath, sizes, ReturnTextureData{true});
-        if(scatterer.needsInterpolationGuides && !opts.dbgNoSaveTextures)
-            generateInterpolationGuidesForScatteringTexture(filePath, data, sizes);
+        saveScatteringTexture(textures[TEX_DELTA_SCATTERING], filePath, sizes, scatterer.needsInterpolationGuides);
         break;
     }
     case PhaseFunctionType::Achromatic:
@@ -651,27 +627,67 @@ void computeScatteringOrder1AndScatteringDensityOrder2(const unsigned texIndex)
     gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
 }
 
-void computeScatteringDensity(const unsigned scatteringOrder, const unsigned texIndex)
+std::unique_ptr<QOpenGLShaderProgram> makeScatteringDensityProgram(const unsigned scatteringOrder)
 {
-    assert(scatteringOrder>2);
-
-    gl.glViewport(0, 0, atmo.scatTexWidth(), atmo.scatTexHeight());
-    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_MULTIPLE_SCATTERING]);
-    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_DELTA_SCATTERING_DENSITY],0);
-
     virtualSourceFiles[COMPUTE_SCATTERING_DENSITY_FILENAME]=getShaderSrc(COMPUTE_SCATTERING_DENSITY_FILENAME,IgnoreCache{})
                                          .replace(QRegularExpression("\\bRADIATION_IS_FROM_GROUND_ONLY\\b"), "false")
                                          .replace(QRegularExpression("\\bSCATTERING_ORDER\\b"), QString::number(scatteringOrder));
     // recompile the program
-    const std::unique_ptr<QOpenGLShaderProgram> program=compileShaderProgram(COMPUTE_SCATTERING_DENSITY_FILENAME,
-                                                                             "scattering density computation shader program",
-                                                                             UseGeomShader{});
+    std::unique_ptr<QOpenGLShaderProgram> program=compileShaderProgram(COMPUTE_SCATTERING_DENSITY_FILENAME,
+                                                                       "scattering density computation shader program",
+                                                                       UseGeomShader{});
     program->bind();
 
     setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE   ,0,"transmittanceTexture");
     setUniformTexture(*program,GL_TEXTURE_2D,TEX_DELTA_IRRADIANCE,1,"irradianceTexture");
     setUniformTexture(*program,GL_TEXTURE_3D,TEX_DELTA_SCATTERING,2,"multipleScatteringTexture");
+    return program;
+}
+
+std::vector<glm::vec4> computeScatteringDensityForComparison(const unsigned scatteringOrder,
+                                                              const AngularIntegrationScheme scheme, const int pointCount)
+{
+    makeScatteringDensityIntegrationSrc(scheme, pointCount);
+    const auto program=makeScatteringDensityProgram(scatteringOrder);
+    render3DTexLayers(*program, "Computing scattering density using "+toString(scheme).toStdString()+
+                                " scheme with "+std::to_string(pointCount)+" points");
+
+    return readTexture(GL_TEXTURE_3D, textures[TEX_DELTA_SCATTERING_DENSITY], scatteringTextureTexelCount());
+}
+
+// Compares scattering density computed with both angular integration schemes to the one computed with the
+// uniform scheme using opts.angularIntegrationReferencePoints points
+void reportAngularIntegrationAccuracy(const unsigned scatteringOrder)
+{
+    if(opts.dbgNoSaveTextures) return; // there will be nothing to compare
+
+    std::cerr << indentOutput() << "Checking accuracy of angular integration for order " << scatteringOrder << " scattering density:\n";
+    OutputIndentIncrease incr;
+
+    const auto reference=computeScatteringDensityForComparison(scatteringOrder, AngularIntegrationScheme::Uniform,
+                                                               opts.angularIntegrationReferencePoints);
+    for(const auto scheme : {AngularIntegrationScheme::Uniform, AngularIntegrationScheme::Importance})
+    {
+        const auto tested=computeScatteringDensityForComparison(scatteringOrder, scheme, atmo.angularIntegrationPoints);
+        printRelativeErrors(toString(scheme).toStdString()+" scheme with "+std::to_string(atmo.angularIntegrationPoints)+
+                            " points", reference, tested);
+    }
+
+    makeScatteringDensityIntegrationSrc(atmo.angularIntegrationScheme, atmo.angularIntegrationPoints);
+}
+
+void computeScatteringDensity(const unsigned scatteringOrder, const unsigned texIndex)
+{
+    assert(scatteringOrder>2);
+
+    gl.glViewport(0, 0, atmo.scatTexWidth(), atmo.scatTexHeight());
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_MULTIPLE_SCATTERING]);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_DELTA_SCATTERING_DENSITY],0);
+
+    if(opts.angularIntegrationReferencePoints)
+        reportAngularIntegrationAccuracy(scatteringOrder);
 
+    const auto program=makeScatteringDensityProgram(scatteringOrder);
     render3DTexLayers(*program, "Computing scattering density layers");
     saveScatteringDensity(scatteringOrder,texIndex);
     gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
@@ -692,6 +708,7 @@ void computeIndirectIrradianceOrder1(const unsigned scattererIndex)
     gl.glEnablei(GL_BLEND, 1); // Total irradiance is always accumulated
 
     const auto& scatterer=atmo.scatterers[scattererIndex];
+    const StageTimer timer("indirect irradiance");
 
     virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc()+
         "vec4 currentPhaseFunction(float dotViewSun) { return phaseFunction_"+scatterer.name+"(dotViewSun); }\n";
@@ -715,6 +732,7 @@ void computeIndirectIrradianceOrder1(const unsigned scattererIndex)
 void computeIndirectIrradiance(const unsigned scatteringOrder, const unsigned texIndex)
 {
     assert(scatteringOrder>2);
+    const StageTimer timer("indirect irradiance");
     gl.glViewport(0, 0, atmo.irradianceTexW, atmo.irradianceTexH);
 
     gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_IRRADIANCE]);
@@ -793,15 +811,21 @@ void computeMultipleScatteringFromDensity(const unsigned scatteringOrder, const
     gl.glViewport(0, 0, atmo.scatTexWidth(), atmo.scatTexHeight());
 
     {
-        const auto program=compileShaderProgram("compute-multiple-scattering.frag",
-                                                "multiple scattering computation shader program",
-                                                UseGeomShader{});
-        program->bind();
+        computeWithRadialQuadratureCheck("order "+std::to_string(scatteringOrder)+" scattering",
+                                         GL_TEXTURE_3D, TEX_DELTA_SCATTERING, scatteringTextureTexelCount(),
+                                         [](const bool reference)
+        {
+            const auto program=compileShaderProgram("compute-multiple-scattering.frag",
+                                                    "multiple scattering computation shader program",
+                                                    UseGeomShader{});
+            program->bind();
 
-        setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
-        setUniformTexture(*program,GL_TEXTURE_3D,TEX_DELTA_SCATTERING_DENSITY,1,"scatteringDensityTexture");
+            setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+            setUniformTexture(*program,GL_TEXTURE_3D,TEX_DELTA_SCATTERING_DENSITY,1,"scatteringDensityTexture");
 
-        render3DTexLayers(*program, "Computing multiple scattering layers");
+            render3DTexLayers(*program, reference ? "Computing reference multiple scattering layers"
+                                                  : "Computing multiple scattering layers");
+        });
 
         if(opts.dbgSaveDeltaScattering)
         {
@@ -822,6 +846,8 @@ void computeMultipleScattering(const unsigned texIndex)
     {
         std::cerr << indentOutput() << "Working on scattering orders 1 and 2:\n";
         OutputIndentIncrease incr;
+        // Single scattering is computed interleaved with order 2, so it's nested in this stage
+        const StageTimer timer("scattering orders 1 and 2");
 
         computeScatteringOrder1AndScatteringDensityOrder2(texIndex);
         if(atmo.scatteringOrdersToCompute >= 2)
@@ -833,6 +859,7 @@ void computeMultipleScattering(const unsigned texIndex)
     {
         std::cerr << indentOutput() << "Working on scattering order " << scatteringOrder << ":\n";
         OutputIndentIncrease incr;
+        const StageTimer timer("scattering order "+std::to_string(scatteringOrder));
 
         computeScatteringDensity(scatteringOrder,texIndex);
         computeIndirectIrradiance(scatteringOrder,texIndex);
@@ -869,33 +896,9 @@ std::unique_ptr<QOpenGLShaderProgram> saveEclipsedDoubleScatteringComputationSha
     virtualSourceFiles[SINGLE_SCATTERING_ECLIPSED_FILENAME]=getShaderSrc(SINGLE_SCATTERING_ECLIPSED_FILENAME,IgnoreCache{})
                                        .replace(QRegularExpression("\\bCOMPUTE_TOTAL_SCATTERING_COEFFICIENT;"), scatCoefDef)
                                        .replace(QRegularExpression("\\b(ALL_SCATTERERS_AT_ONCE_WITH_PHASE_FUNCTION)\\b"), "1 /*\\1*/");
-    std::vector<std::pair<QString, QString>> sourcesToSave;
-    auto program=compileShaderProgram(COMPUTE_ECLIPSED_DOUBLE_SCATTERING_FILENAME,
-                                      "eclipsed double scattering computation shader program",
-                                      UseGeomShader{false}, &sourcesToSave);
-    for(const auto& [filename, src] : sourcesToSave)
-    {
-        if(filename==viewDirFuncFileName) continue;
-
-        const auto filePath = QString("%1/shaders/double-scattering-eclipsed/precomputation/%2/%3").arg(atmo.textureOutputDir.c_str())
-                                    .arg(texIndex).arg(filename);
-        std::cerr << indentOutput() << "Saving shader \"" << filePath << "\"...";
-        QFile file(filePath);
-        if(!file.open(QFile::WriteOnly))
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        file.write(src.toUtf8());
-        file.flush();
-        if(file.error())
-        {
-            std::cerr << " failed: " << file.errorString().toStdString() << "\"\n";
-            throw MustQuit{};
-        }
-        std::cerr << "done\n";
-    }
-    return program;
+    const auto outputDir = QString("%1/shaders/double-scattering-eclipsed/precomputation/%2").arg(atmo.textureOutputDir.c_str()).arg(texIndex);
+    return compileAndSaveShaderProgram(COMPUTE_ECLIPSED_DOUBLE_SCATTERING_FILENAME,
+                                       "eclipsed double scattering computation shader program", outputDir);
 }
 
 void computeEclipsedDoubleScattering(const unsigned texIndex)
@@ -904,6 +907,7 @@ void computeEclipsedDoubleScattering(const unsigned texIndex)
 
     if(opts.dbgNoEDSTextures || opts.dbgNoSaveTextures) return;
 
+    const StageTimer timer("eclipsed double scattering");
     std::cerr << indentOutput() << "Computing eclipsed double scattering... ";
     const auto time0=std::chrono::steady_clock::now();
 
@@ -948,6 +952,7 @@ void computeEclipsedDoubleScattering(const unsigned texIndex)
             precomputer.computeRadianceOnCoarseGrid(*program, textures[TEX_ECLIPSED_DOUBLE_SCATTERING], unusedTextureUnitNum,
                                                     cameraAltitude, sunZenithAngle, sunZenithAngle, 0, atmo.earthMoonDistance);
             numPointsPerSet = precomputer.appendCoarseGridSamplesTo(dataToSave);
+            reportProgress("Computing eclipsed double scattering", altIndex*texSizeBySZA+szaIndex+1, texSizeBySZA*texSizeByAltitude);
 
             // Clear previous status and reset cursor position
             const auto statusWidth=ss.tellp();
@@ -970,16 +975,16 @@ void computeEclipsedDoubleScattering(const unsigned texIndex)
             // Initialize the accumulator with the first layer...
             eclipsedDoubleScatteringAccumulatorTexture = std::move(dataToSave);
             // ... and apply the weight.
-            for(auto& v : eclipsedDoubleScatteringAccumulatorTexture)
-                v = rad2lum*v;
+            auto& accum = eclipsedDoubleScatteringAccumulatorTexture;
+            transformVectors(rad2lum, accum.data(), accum.size());
         }
         else
         {
             // Blend the new texture data into the accumulator.
             auto& accum = eclipsedDoubleScatteringAccumulatorTexture;
             const auto& src = dataToSave;
-            for(size_t i = 0; i < accum.size(); ++i)
-                accum[i] += rad2lum * src[i];
+            assert(accum.size() == src.size());
+            accumulateTransformedVectors(rad2lum, src.data(), accum.data(), accum.size());
         }
         const auto time1=std::chrono::steady_clock::now();
         std::cerr << "done in " << formatDeltaTime(time0, time1) << "\n";
@@ -1001,7 +1006,10 @@ void computeEclipsedDoubleScattering(const unsigned texIndex)
             out.write(reinterpret_cast<const char*>(&size), sizeof size);
         auto& texture = opts.saveResultAsRadiance ? dataToSave : eclipsedDoubleScatteringAccumulatorTexture;
         if(opts.textureSavePrecision)
+        {
+            std::cerr << "mask: 0x" << std::hex << texDataRoundingMask(opts.textureSavePrecision) << std::dec << " ... ";
             roundTexData(&texture[0][0], 4*texture.size(), opts.textureSavePrecision);
+        }
         out.write(reinterpret_cast<const char*>(texture.data()), texture.size()*sizeof texture[0]);
         out.close();
         if(out.error())
@@ -1010,13 +1018,12 @@ void computeEclipsedDoubleScattering(const unsigned texIndex)
             throw MustQuit{};
         }
         std::cerr << "done\n";
+        reportFileWritten(path);
     }
 }
 
 void computeLightPollutionSingleScattering(const unsigned texIndex)
 {
-    std::cerr << indentOutput() << "Computing light pollution single scattering... ";
-
     gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_LIGHT_POLLUTION]);
     gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0, textures[TEX_LIGHT_POLLUTION_SCATTERING],0);
     gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT1, textures[TEX_LIGHT_POLLUTION_DELTA_SCATTERING],0);
@@ -1027,14 +1034,21 @@ void computeLightPollutionSingleScattering(const unsigned texIndex)
 
     const auto src=makeScattererDensityFunctionsSrc();
     virtualSourceFiles[DENSITIES_SHADER_FILENAME]=src;
-    const auto program=compileShaderProgram("compute-light-pollution-single-scattering.frag",
-                                            "shader program to compute single scattering of light pollution");
-    program->bind();
-    setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
-    renderQuad();
+    computeWithRadialQuadratureCheck("light pollution single scattering",
+                                     GL_TEXTURE_2D, TEX_LIGHT_POLLUTION_DELTA_SCATTERING, lightPollutionTextureTexelCount(),
+                                     [](const bool reference)
+    {
+        std::cerr << indentOutput() << (reference ? "Computing reference light pollution single scattering... "
+                                                  : "Computing light pollution single scattering... ");
+        const auto program=compileShaderProgram("compute-light-pollution-single-scattering.frag",
+                                                "shader program to compute single scattering of light pollution");
+        program->bind();
+        setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+        renderQuad();
 
-    gl.glFinish();
-    std::cerr << "done\n";
+        gl.glFinish();
+        std::cerr << "done\n";
+    });
 
     gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
 
@@ -1053,6 +1067,14 @@ void computeLightPollutionMultipleScattering(const unsigned texIndex)
 
     const auto src=makeScattererDensityFunctionsSrc();
     virtualSourceFiles[DENSITIES_SHADER_FILENAME]=src;
+    std::unique_ptr<QOpenGLShaderProgram> referenceProgram;
+    if(radialQuadratureCheckEnabled())
+    {
+        makeReferenceRadialQuadratureSrc();
+        referenceProgram=compileShaderProgram("compute-light-pollution-multiple-scattering.frag",
+                                              "reference shader program to compute higher-order scattering of light pollution");
+        makeRadialQuadratureSrc(atmo.radialIntegrationPoints);
+    }
     const auto program=compileShaderProgram("compute-light-pollution-multiple-scattering.frag",
                                             "shader program to compute higher-order scattering of light pollution");
 
@@ -1076,6 +1098,18 @@ void computeLightPollutionMultipleScattering(const unsigned texIndex)
             gl.glBlitFramebuffer(0,0,width,height, 0,0,width,height, GL_COLOR_BUFFER_BIT,GL_NEAREST);
             gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT2, 0,0);
         }
+        std::vector<glm::vec4> reference;
+        if(referenceProgram)
+        {
+            // Only render the delta scattering, so as not to add the reference to the accumulated scattering
+            setDrawBuffers({GL_NONE, GL_COLOR_ATTACHMENT1});
+            referenceProgram->bind();
+            setUniformTexture(*referenceProgram,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+            setUniformTexture(*referenceProgram,GL_TEXTURE_2D,TEX_LIGHT_POLLUTION_SCATTERING_PREV_ORDER,1,"lightPollutionScatteringTexture");
+            renderQuad();
+            reference=readTexture(GL_TEXTURE_2D, textures[TEX_LIGHT_POLLUTION_DELTA_SCATTERING],
+                                  lightPollutionTextureTexelCount());
+        }
         setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1});
         gl.glEnablei(GL_BLEND, 0);
 
@@ -1087,6 +1121,14 @@ void computeLightPollutionMultipleScattering(const unsigned texIndex)
         gl.glFinish();
         std::cerr << "done\n";
 
+        if(referenceProgram)
+        {
+            OutputIndentIncrease incr;
+            reportRadialQuadratureError("light pollution scattering order "+std::to_string(scatteringOrder), reference,
+                                        readTexture(GL_TEXTURE_2D, textures[TEX_LIGHT_POLLUTION_DELTA_SCATTERING],
+                                                    lightPollutionTextureTexelCount()));
+        }
+
         if(!opts.dbgSaveLightPollutionIntermediateTextures)
             continue;
 
@@ -1135,143 +1177,141 @@ void accumulateLightPollutionLuminanceTexture(const unsigned texIndex)
     gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
 }
 
-int main(int argc, char** argv)
+// Computes and saves all the textures and shaders for the current atmosphere description. Returns the wall time it took.
+double computeAtmosphereModel()
 {
-    [[maybe_unused]] UTF8Console utf8console;
-
-    qInstallMessageHandler(qtMessageHandler);
-    QApplication app(argc, argv);
-    app.setApplicationName("CalcMySky");
-    app.setApplicationVersion(PROJECT_VERSION);
+    if(opts.saveResultAsRadiance)
+        for(auto& scatterer : atmo.scatterers)
+            scatterer.phaseFunctionType=PhaseFunctionType::General;
 
-    try
+    if(atmo.textureOutputDir.length() && atmo.textureOutputDir.back()=='/')
+        atmo.textureOutputDir.pop_back(); // Make the paths a bit nicer (without double slashes)
+    for(const auto& scatterer : atmo.scatterers)
     {
-        handleCmdLine();
-
-        std::cerr << qApp->applicationName() << ' ' << qApp->applicationVersion() << '\n';
-        std::cerr << "Compiled against Qt " << QT_VERSION_MAJOR << "." << QT_VERSION_MINOR << "." << QT_VERSION_PATCH << "\n";
-        std::cerr << "Running on " << QSysInfo::prettyProductName().toStdString() << " " << QSysInfo::currentCpuArchitecture() << "\n";
-
-        [[maybe_unused]] const auto glCtxAndSfc = initOpenGL();
-
-        if(opts.saveResultAsRadiance)
-            for(auto& scatterer : atmo.scatterers)
-                scatterer.phaseFunctionType=PhaseFunctionType::General;
-
-        if(atmo.textureOutputDir.length() && atmo.textureOutputDir.back()=='/')
-            atmo.textureOutputDir.pop_back(); // Make the paths a bit nicer (without double slashes)
-        for(const auto& scatterer : atmo.scatterers)
+        for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
         {
-            for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
-            {
-                createDirs(atmo.textureOutputDir+"/shaders/single-scattering-eclipsed/precomputation/"+
-                           std::to_string(texIndex)+"/"+scatterer.name.toStdString());
-                createDirs(atmo.textureOutputDir+"/shaders/single-scattering-eclipsed/"+singleScatteringRenderModeNames[SSRM_ON_THE_FLY]+"/"+
-                           std::to_string(texIndex)+"/"+scatterer.name.toStdString());
-                createDirs(atmo.textureOutputDir+"/shaders/single-scattering/"+singleScatteringRenderModeNames[SSRM_ON_THE_FLY]+"/"+
-                           std::to_string(texIndex)+"/"+scatterer.name.toStdString());
-                if(scatterer.phaseFunctionType==PhaseFunctionType::General)
-                {
-                    createDirs(atmo.textureOutputDir+"/shaders/single-scattering/"+singleScatteringRenderModeNames[SSRM_PRECOMPUTED]+"/"+
-                               std::to_string(texIndex)+"/"+scatterer.name.toStdString());
-                    createDirs(atmo.textureOutputDir+"/shaders/single-scattering-eclipsed/"+singleScatteringRenderModeNames[SSRM_PRECOMPUTED]+"/"+
-                               std::to_string(texIndex)+"/"+scatterer.name.toStdString());
-                }
-            }
-            if(scatterer.phaseFunctionType!=PhaseFunctionType::General)
+            createDirs(atmo.textureOutputDir+"/shaders/single-scattering-eclipsed/precomputation/"+
+                       std::to_string(texIndex)+"/"+scatterer.name.toStdString());
+            createDirs(atmo.textureOutputDir+"/shaders/single-scattering-eclipsed/"+singleScatteringRenderModeNames[SSRM_ON_THE_FLY]+"/"+
+                       std::to_string(texIndex)+"/"+scatterer.name.toStdString());
+            createDirs(atmo.textureOutputDir+"/shaders/single-scattering/"+singleScatteringRenderModeNames[SSRM_ON_THE_FLY]+"/"+
+                       std::to_string(texIndex)+"/"+scatterer.name.toStdString());
+            if(scatterer.phaseFunctionType==PhaseFunctionType::General)
             {
                 createDirs(atmo.textureOutputDir+"/shaders/single-scattering/"+singleScatteringRenderModeNames[SSRM_PRECOMPUTED]+"/"+
-                           scatterer.name.toStdString());
+                           std::to_string(texIndex)+"/"+scatterer.name.toStdString());
                 createDirs(atmo.textureOutputDir+"/shaders/single-scattering-eclipsed/"+singleScatteringRenderModeNames[SSRM_PRECOMPUTED]+"/"+
-                           scatterer.name.toStdString());
+                           std::to_string(texIndex)+"/"+scatterer.name.toStdString());
             }
         }
-        createDirs(atmo.textureOutputDir+"/shaders/double-scattering-eclipsed/precomputed/");
-        for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
+        if(scatterer.phaseFunctionType!=PhaseFunctionType::General)
         {
-            createDirs(atmo.textureOutputDir+"/shaders/zero-order-scattering/"+std::to_string(texIndex));
-            createDirs(atmo.textureOutputDir+"/shaders/eclipsed-zero-order-scattering/"+std::to_string(texIndex));
-            if(opts.saveResultAsRadiance)
-                createDirs(atmo.textureOutputDir+"/shaders/double-scattering-eclipsed/precomputed/"+std::to_string(texIndex));
-            createDirs(atmo.textureOutputDir+"/shaders/double-scattering-eclipsed/precomputation/"+std::to_string(texIndex));
-            createDirs(atmo.textureOutputDir+"/single-scattering/"+std::to_string(texIndex));
+            createDirs(atmo.textureOutputDir+"/shaders/single-scattering/"+singleScatteringRenderModeNames[SSRM_PRECOMPUTED]+"/"+
+                       scatterer.name.toStdString());
+            createDirs(atmo.textureOutputDir+"/shaders/single-scattering-eclipsed/"+singleScatteringRenderModeNames[SSRM_PRECOMPUTED]+"/"+
+                       scatterer.name.toStdString());
         }
-        createDirs(atmo.textureOutputDir+"/shaders/multiple-scattering/");
-        if(opts.saveResultAsRadiance)
-            for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
-                createDirs(atmo.textureOutputDir+"/shaders/multiple-scattering/"+std::to_string(texIndex));
-        createDirs(atmo.textureOutputDir+"/shaders/light-pollution/");
+    }
+    createDirs(atmo.textureOutputDir+"/shaders/double-scattering-eclipsed/precomputed/");
+    for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
+    {
+        createDirs(atmo.textureOutputDir+"/shaders/zero-order-scattering/"+std::to_string(texIndex));
+        createDirs(atmo.textureOutputDir+"/shaders/eclipsed-zero-order-scattering/"+std::to_string(texIndex));
         if(opts.saveResultAsRadiance)
-            for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
-                createDirs(atmo.textureOutputDir+"/shaders/light-pollution/"+std::to_string(texIndex));
+            createDirs(atmo.textureOutputDir+"/shaders/double-scattering-eclipsed/precomputed/"+std::to_string(texIndex));
+        createDirs(atmo.textureOutputDir+"/shaders/double-scattering-eclipsed/precomputation/"+std::to_string(texIndex));
+        createDirs(atmo.textureOutputDir+"/single-scattering/"+std::to_string(texIndex));
+    }
+    createDirs(atmo.textureOutputDir+"/shaders/multiple-scattering/");
+    if(opts.saveResultAsRadiance)
+    {
+        for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
+            createDirs(atmo.textureOutputDir+"/shaders/multiple-scattering/"+std::to_string(texIndex));
+        createDirs(atmo.textureOutputDir+"/shaders/multiple-scattering-mrt/");
+    }
+    createDirs(atmo.textureOutputDir+"/shaders/light-pollution/");
+    if(opts.saveResultAsRadiance)
+        for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
+            createDirs(atmo.textureOutputDir+"/shaders/light-pollution/"+std::to_string(texIndex));
 
+    {
+        std::cerr << "Writing parameters to output description file...";
+        const auto target=atmo.textureOutputDir+"/params.atmo";
+        QFile file(target.c_str());
+        if(!file.open(QFile::WriteOnly))
         {
-            std::cerr << "Writing parameters to output description file...";
-            const auto target=atmo.textureOutputDir+"/params.atmo";
-            QFile file(target.c_str());
-            if(!file.open(QFile::WriteOnly))
-            {
-                std::cerr << " FAILED to open \"" << target << "\": " << file.errorString() << "\n";
-                throw MustQuit{};
-            }
-            QTextStream out(&file);
-            out << "version: " << AtmosphereParameters::FORMAT_VERSION << "\n";
-            if(opts.saveResultAsRadiance)
-                out << AtmosphereParameters::ALL_TEXTURES_ARE_RADIANCES_DIRECTIVE << "\n";
-            if(opts.dbgNoEDSTextures)
-                out << AtmosphereParameters::NO_ECLIPSED_DOUBLE_SCATTERING_TEXTURES_DIRECTIVE << "\n";
-            out << "# These spectra override the spectra further down the document. This is to make sure\n# we have all the required spectra inlined, rather than just references to files.\n";
-            out << AtmosphereParameters::WAVELENGTHS_KEY << ": min=" << atmo.allWavelengths.front().x
-                << "nm,max=" << atmo.allWavelengths.back().w << "nm,count=" << 4*atmo.allWavelengths.size() << "\n";
-            out << AtmosphereParameters::SOLAR_IRRADIANCE_AT_TOA_KEY << ": "
-                << AtmosphereParameters::spectrumToString(atmo.solarIrradianceAtTOA) << "\n";
-            out << "\n#Copy of original atmosphere description\n" << atmo.descriptionFileText;
-            out.flush();
-            file.close();
-            if(file.error())
-            {
-                std::cerr << " FAILED to write to \"" << target << "\": " << file.errorString() << "\n";
-                throw MustQuit{};
-            }
-            std::cerr << " done\n";
+            std::cerr << " FAILED to open \"" << target << "\": " << file.errorString() << "\n";
+            throw MustQuit{};
+        }
+        QTextStream out(&file);
+        out << "version: " << AtmosphereParameters::FORMAT_VERSION << "\n";
+        if(opts.saveResultAsRadiance)
+            out << AtmosphereParameters::ALL_TEXTURES_ARE_RADIANCES_DIRECTIVE << "\n";
+        if(opts.dbgNoEDSTextures)
+            out << AtmosphereParameters::NO_ECLIPSED_DOUBLE_SCATTERING_TEXTURES_DIRECTIVE << "\n";
+        out << "# These spectra override the spectra further down the document. This is to make sure\n# we have all the required spectra inlined, rather than just references to files.\n";
+        out << AtmosphereParameters::WAVELENGTHS_KEY << ": min=" << atmo.allWavelengths.front().x
+            << "nm,max=" << atmo.allWavelengths.back().w << "nm,count=" << 4*atmo.allWavelengths.size() << "\n";
+        out << AtmosphereParameters::SOLAR_IRRADIANCE_AT_TOA_KEY << ": "
+            << AtmosphereParameters::spectrumToString(atmo.solarIrradianceAtTOA) << "\n";
+        out << "\n#Copy of original atmosphere description\n" << atmo.descriptionFileText;
+        out.flush();
+        file.close();
+        if(file.error())
+        {
+            std::cerr << " FAILED to write to \"" << target << "\": " << file.errorString() << "\n";
+            throw MustQuit{};
         }
+        std::cerr << " done\n";
+    }
 
-        const auto timeBegin=std::chrono::steady_clock::now();
+    const auto timeBegin=std::chrono::steady_clock::now();
 
-        // Initialize texture averager before anything to make it emit possible
-        // warnings not mixing them into computation status reports.
-        TextureAverageComputer{gl, 10, 10, GL_RGBA32F, 0};
+    for(unsigned texIndex=0;texIndex<atmo.allWavelengths.size();++texIndex)
+    {
+        std::cerr << "Working on wavelengths " << atmo.allWavelengths[texIndex][0] << ", "
+                                               << atmo.allWavelengths[texIndex][1] << ", "
+                                               << atmo.allWavelengths[texIndex][2] << ", "
+                                               << atmo.allWavelengths[texIndex][3] << " nm"
+                     " (set " << texIndex+1 << " of " << atmo.allWavelengths.size() << "):\n";
+        OutputIndentIncrease incr;
 
-        for(unsigned texIndex=0;texIndex<atmo.allWavelengths.size();++texIndex)
+        initConstHeader(atmo.allWavelengths[texIndex]);
+        virtualSourceFiles[COMPUTE_TRANSMITTANCE_SHADER_FILENAME]=
+            makeTransmittanceComputeFunctionsSrc(atmo.allWavelengths[texIndex]);
+        virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc();
+        virtualSourceFiles[TOTAL_SCATTERING_COEFFICIENT_SHADER_FILENAME]=makeTotalScatteringCoefSrc();
+        makeRadialQuadratureSrc(atmo.radialIntegrationPoints);
         {
-            std::cerr << "Working on wavelengths " << atmo.allWavelengths[texIndex][0] << ", "
-                                                   << atmo.allWavelengths[texIndex][1] << ", "
-                                                   << atmo.allWavelengths[texIndex][2] << ", "
-                                                   << atmo.allWavelengths[texIndex][3] << " nm"
-                         " (set " << texIndex+1 << " of " << atmo.allWavelengths.size() << "):\n";
-            OutputIndentIncrease incr;
-
-            initConstHeader(atmo.allWavelengths[texIndex]);
-            virtualSourceFiles[COMPUTE_TRANSMITTANCE_SHADER_FILENAME]=
-                makeTransmittanceComputeFunctionsSrc(atmo.allWavelengths[texIndex]);
-            virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc();
-            virtualSourceFiles[TOTAL_SCATTERING_COEFFICIENT_SHADER_FILENAME]=makeTotalScatteringCoefSrc();
-            virtualHeaderFiles[RADIANCE_TO_LUMINANCE_HEADER_FILENAME]="const mat4 radianceToLuminance=" +
-                                                  toString(radianceToLuminance(texIndex, atmo.allWavelengths)) + ";\n";
+            // See initConstHeader() for the meaning of WLSET_UNIFORM_INDEX
+            QStringList matrices;
+            for(unsigned i=0; i<atmo.allWavelengths.size(); ++i)
+                matrices << toString(radianceToLuminance(i, atmo.allWavelengths));
+            virtualHeaderFiles[RADIANCE_TO_LUMINANCE_HEADER_FILENAME]=
+                "#ifdef WLSET_UNIFORM_INDEX\n"
+                "const mat4 radianceToLuminancePerWLSet[wlSetCount]=mat4[](" + matrices.join(", ") + ");\n"
+                "#define radianceToLuminance radianceToLuminancePerWLSet[wlSetIndex]\n"
+                "#else\n"
+                "const mat4 radianceToLuminance=" + matrices[texIndex] + ";\n"
+                "#endif\n";
+        }
+        tabulateProfiles();
 
-            saveZeroOrderScatteringRenderingShader(texIndex);
-            saveEclipsedZeroOrderScatteringRenderingShader(texIndex);
+        saveZeroOrderScatteringRenderingShader(texIndex);
+        saveEclipsedZeroOrderScatteringRenderingShader(texIndex);
 
-            {
-                std::cerr << indentOutput() << "Computing parts of scattering order 1:\n";
-                OutputIndentIncrease incr;
+        {
+            std::cerr << indentOutput() << "Computing parts of scattering order 1:\n";
+            OutputIndentIncrease incr;
 
-                computeTransmittance(texIndex);
-                // We'll use ground irradiance to take into account the contribution of light scattered by the ground to the
-                // sky color. Irradiance will also be needed when we want to draw the ground itself.
-                computeDirectGroundIrradiance(texIndex);
-            }
+            computeTransmittance(texIndex);
+            // We'll use ground irradiance to take into account the contribution of light scattered by the ground to the
+            // sky color. Irradiance will also be needed when we want to draw the ground itself.
+            computeDirectGroundIrradiance(texIndex);
+        }
 
+        {
+            const StageTimer timer("light pollution");
             computeLightPollutionSingleScattering(texIndex);
             computeLightPollutionMultipleScattering(texIndex);
             if(opts.saveResultAsRadiance)
@@ -1285,25 +1325,99 @@ int main(int argc, char** argv)
                 accumulateLightPollutionLuminanceTexture(texIndex);
             }
             saveLightPollutionRenderingShader(texIndex);
+        }
 
-            computeMultipleScattering(texIndex);
-            if(opts.saveResultAsRadiance)
-            {
-                saveMultipleScatteringRenderingShader(texIndex);
-                saveEclipsedDoubleScatteringRenderingShader(texIndex);
-            }
+        if(atmo.angularIntegrationScheme==AngularIntegrationScheme::Importance || opts.angularIntegrationReferencePoints)
+            tabulateScatteringPhaseShape();
+        makeScatteringDensityIntegrationSrc(atmo.angularIntegrationScheme, atmo.angularIntegrationPoints);
+        computeMultipleScattering(texIndex);
+        if(opts.saveResultAsRadiance)
+        {
+            saveMultipleScatteringRenderingShader(texIndex);
+            if(texIndex==0)
+                saveMultipleScatteringMRTRenderingShader();
+            saveEclipsedDoubleScatteringRenderingShader(texIndex);
+        }
 
-            computeEclipsedDoubleScattering(texIndex);
+        computeEclipsedDoubleScattering(texIndex);
 
+    }
+    if(!opts.saveResultAsRadiance)
+    {
+        saveMultipleScatteringRenderingShader(-1);
+        saveEclipsedDoubleScatteringRenderingShader(-1);
+    }
+
+    const auto timeEnd=std::chrono::steady_clock::now();
+    std::cerr << "Finished in " << formatDeltaTime(timeBegin, timeEnd) << "\n";
+    return std::chrono::duration<double>(timeEnd-timeBegin).count();
+}
+
+int main(int argc, char** argv)
+{
+    [[maybe_unused]] UTF8Console utf8console;
+
+    qInstallMessageHandler(qtMessageHandler);
+    try
+    {
+        selectOffscreenGLBackend(argc, argv);
+    }
+    catch(ShowMySky::Error const& ex)
+    {
+        std::cerr << QObject::tr("Error: %1\n").arg(ex.what());
+        return 1;
+    }
+    // Widgets aren't used, and the GUI application is enough for OpenGL without their start-up cost
+    QGuiApplication app(argc, argv);
+    app.setApplicationName("CalcMySky");
+    app.setApplicationVersion(PROJECT_VERSION);
+
+    try
+    {
+        handleCmdLine();
+        if(!opts.eventStreamDestination.empty())
+            openEventStream(opts.eventStreamDestination);
+
+        std::cerr << qApp->applicationName() << ' ' << qApp->applicationVersion() << '\n';
+        std::cerr << "Compiled against Qt " << QT_VERSION_MAJOR << "." << QT_VERSION_MINOR << "." << QT_VERSION_PATCH << "\n";
+        std::cerr << "Running on " << QSysInfo::prettyProductName().toStdString() << " " << QSysInfo::currentCpuArchitecture() << "\n";
+
+        if(opts.tuningTargetError>0)
+        {
+            tuneIntegrationParameters();
+            return 0;
         }
-        if(!opts.saveResultAsRadiance)
+
+        [[maybe_unused]] const auto glCtxAndSfc = initOpenGL();
+
+        // Initialize texture averager before anything to make it emit possible
+        // warnings not mixing them into computation status reports.
+        TextureAverageComputer{gl, 10, 10, GL_RGBA32F, 0};
+
+        if(!sweepJobCount())
         {
-            saveMultipleScatteringRenderingShader(-1);
-            saveEclipsedDoubleScatteringRenderingShader(-1);
+            saveStageTimings(computeAtmosphereModel());
+            return 0;
         }
 
-        const auto timeEnd=std::chrono::steady_clock::now();
-        std::cerr << "Finished in " << formatDeltaTime(timeBegin, timeEnd) << "\n";
+        const auto sweepTimeBegin=std::chrono::steady_clock::now();
+        std::vector<std::pair<std::string, double>> jobTimes;
+        for(unsigned jobIndex=0; jobIndex<sweepJobCount(); ++jobIndex)
+        {
+            const auto name=sweepJobName(jobIndex).toStdString();
+            std::cerr << "Starting job \"" << name << "\" (" << jobIndex+1 << " of " << sweepJobCount() << ")\n";
+            setEventStreamJob(name);
+            emitEvent("job_start", {{"index", int(jobIndex)}, {"count", int(sweepJobCount())}});
+            setupSweepJob(jobIndex);
+            allocateTextures();
+            jobTimes.emplace_back(name, computeAtmosphereModel());
+            emitEvent("job_end", {{"wall_time_s", jobTimes.back().second}});
+        }
+        const auto sweepTimeEnd=std::chrono::steady_clock::now();
+        std::cerr << "All " << sweepJobCount() << " jobs finished in " << formatDeltaTime(sweepTimeBegin, sweepTimeEnd) << ":\n";
+        for(const auto& [name, time] : jobTimes)
+            std::cerr << "  " << name << ": " << time << " s\n";
+        saveStageTimings(std::chrono::duration<double>(sweepTimeEnd-sweepTimeBegin).count(), jobTimes);
     }
     catch(ParsingError const& ex)
     {
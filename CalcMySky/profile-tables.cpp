@@ -0,0 +1,232 @@
+#include "profile-tables.hpp"
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "data.hpp"
+#include "util.hpp"
+#include "shaders.hpp"
+#include "stage-timing.hpp"
+
+namespace
+{
+
+bool tablesReady=false;
+// Tabulation errors larger than this deserve a hint to the user
+constexpr double largeTabulationError=1e-3;
+
+int numberDensityTableRows() { return atmo.scatterers.size()+atmo.absorbers.size(); }
+int phaseFunctionTableRows() { return atmo.scatterers.size(); }
+
+// Maximum relative error of linear interpolation between even points at odd points. Values much smaller than the
+// maximum of the profile don't affect the results, so their relative errors are not counted.
+double maxInterpolationError(std::vector<double> const& values)
+{
+    double maxValue=0;
+    for(const auto v : values)
+        maxValue=std::max(maxValue, std::abs(v));
+    if(!(maxValue>0)) return 0;
+
+    double maxError=0;
+    for(unsigned n=1; n+1<values.size(); n+=2)
+    {
+        const auto interpolated=(values[n-1]+values[n+1])/2;
+        const auto error=std::abs(interpolated-values[n])/std::max(std::abs(values[n]), 1e-6*maxValue);
+        maxError=std::max(maxError, error);
+    }
+    return maxError;
+}
+
+void reportTabulationError(std::string const& what, const double error)
+{
+    std::cerr << indentOutput() << what << ": max relative error " << error;
+    if(error>largeTabulationError)
+        std::cerr << " (consider increasing \"profile tabulation points\")";
+    std::cerr << "\n";
+}
+
+void setupTable(const TextureId id, const GLint sampler, const GLenum internalFormat, const GLenum format,
+                const GLsizei width, const GLsizei height, std::vector<GLfloat> const& data)
+{
+    gl.glActiveTexture(GL_TEXTURE0+sampler);
+    gl.glBindTexture(GL_TEXTURE_2D, textures[id]);
+    gl.glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, data.data());
+    gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+    gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+    gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    // The tables stay bound to their units, so that the programs only need their samplers set
+    gl.glActiveTexture(GL_TEXTURE0);
+}
+
+}
+
+bool profileTablesReady()
+{
+    return tablesReady;
+}
+
+void setProfileTableSamplers(QOpenGLShaderProgram& program)
+{
+    if(!tablesReady) return;
+
+    const auto densityTableLocation=program.uniformLocation("numberDensityTable");
+    const auto phaseFunctionTableLocation=program.uniformLocation("phaseFunctionTable");
+    if(densityTableLocation<0 && phaseFunctionTableLocation<0) return;
+
+    program.bind();
+    if(densityTableLocation>=0)
+        program.setUniformValue(densityTableLocation, NUMBER_DENSITY_TABLE_SAMPLER);
+    if(phaseFunctionTableLocation>=0)
+        program.setUniformValue(phaseFunctionTableLocation, PHASE_FUNCTION_TABLE_SAMPLER);
+}
+
+QString makeNumberDensityTableLookupSrc()
+{
+    const auto size=atmo.profileTabulationPoints;
+    return 1+R"(
+#if USE_PROFILE_TABLES
+uniform sampler2D numberDensityTable;
+float numberDensityFromTable(const int row, const float altitude)
+{
+    CONST float x = sqrt(clamp(altitude/atmosphereHeight, 0., 1.));
+    return texture(numberDensityTable, vec2((x*)"+toString(size-1)+"+0.5)/"+toString(size)+", "
+                                             "(row+0.5)/"+toString(numberDensityTableRows())+R"()).r;
+}
+#endif
+)";
+}
+
+QString makePhaseFunctionTableLookupSrc()
+{
+    const auto size=atmo.profileTabulationPoints;
+    return 1+R"(
+#if USE_PROFILE_TABLES
+uniform sampler2D phaseFunctionTable;
+vec4 phaseFunctionFromTable(const int row, const float dotViewSun)
+{
+    CONST float x = sqrt(acos(clamp(dotViewSun, -1., 1.))/PI);
+    return texture(phaseFunctionTable, vec2((x*)"+toString(size-1)+"+0.5)/"+toString(size)+", "
+                                            "(row+0.5)/"+toString(phaseFunctionTableRows())+R"());
+}
+#endif
+)";
+}
+
+void tabulateProfiles()
+{
+    tablesReady=false; // the tabulation itself must evaluate the profiles directly
+    if(!atmo.profileTabulationPoints) return;
+    const int densityRows=numberDensityTableRows(), phaseRows=phaseFunctionTableRows();
+    if(densityRows+phaseRows==0) return;
+
+    const StageTimer timer("profile tabulation");
+    std::cerr << indentOutput() << "Tabulating profiles... ";
+
+    // Tabulating at twice the resolution lets us check the tables at midpoints between their entries
+    const int tableSize=atmo.profileTabulationPoints;
+    const int checkSize=2*tableSize-1;
+    const int rowCount=densityRows+phaseRows;
+
+    QString cases;
+    int row=0;
+    for(const auto& scatterer : atmo.scatterers)
+        cases += QString("    case %1: value = vec4(scattererNumberDensity_%2(altitude)); break;\n").arg(row++).arg(scatterer.name);
+    for(const auto& absorber : atmo.absorbers)
+        cases += QString("    case %1: value = vec4(absorberNumberDensity_%2(altitude)); break;\n").arg(row++).arg(absorber.name);
+    for(const auto& scatterer : atmo.scatterers)
+        cases += QString("    case %1: value = phaseFunction_%2(dotViewSun); break;\n").arg(row++).arg(scatterer.name);
+
+    virtualSourceFiles[DENSITIES_SHADER_FILENAME]=makeScattererDensityFunctionsSrc();
+    virtualSourceFiles[TABULATE_PROFILES_FILENAME]=1+R"(
+#version 330
+#include "version.h.glsl"
+#include "const.h.glsl"
+#include "densities.h.glsl"
+#include "phase-functions.h.glsl"
+
+out vec4 value;
+
+void main()
+{
+    CONST int row = int(gl_FragCoord.y);
+    CONST float x = (gl_FragCoord.x-0.5)/)"+toString(checkSize-1)+R"(;
+    CONST float altitude = atmosphereHeight*sqr(x);
+    CONST float dotViewSun = cos(PI*sqr(x));
+    value = vec4(0);
+    switch(row)
+    {
+)"+cases+R"(
+    }
+}
+)";
+    const auto program=compileShaderProgram(TABULATE_PROFILES_FILENAME, "profile tabulation shader program");
+
+    GLuint texture=0, fbo=0;
+    gl.glGenTextures(1, &texture);
+    gl.glBindTexture(GL_TEXTURE_2D, texture);
+    gl.glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, checkSize, rowCount, 0, GL_RGBA, GL_FLOAT, nullptr);
+    gl.glBindTexture(GL_TEXTURE_2D, 0);
+    gl.glGenFramebuffers(1, &fbo);
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    checkFramebufferStatus("framebuffer for profile tabulation");
+
+    program->bind();
+    gl.glViewport(0, 0, checkSize, rowCount);
+    renderQuad();
+
+    std::vector<glm::vec4> data(size_t(checkSize)*rowCount);
+    gl.glReadPixels(0, 0, checkSize, rowCount, GL_RGBA, GL_FLOAT, data.data());
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl.glDeleteFramebuffers(1, &fbo);
+    gl.glDeleteTextures(1, &texture);
+
+    std::vector<GLfloat> densityTable, phaseFunctionTable;
+    for(int r=0; r<rowCount; ++r)
+    {
+        for(int n=0; n<checkSize; n+=2)
+        {
+            const auto& v=data[size_t(r)*checkSize+n];
+            if(r<densityRows)
+                densityTable.push_back(v[0]);
+            else
+                phaseFunctionTable.insert(phaseFunctionTable.end(), {v[0], v[1], v[2], v[3]});
+        }
+    }
+    setupTable(TEX_NUMBER_DENSITY_TABLE, NUMBER_DENSITY_TABLE_SAMPLER, GL_R32F, GL_RED, tableSize, densityRows, densityTable);
+    setupTable(TEX_PHASE_FUNCTION_TABLE, PHASE_FUNCTION_TABLE_SAMPLER, GL_RGBA32F, GL_RGBA, tableSize, phaseRows, phaseFunctionTable);
+    std::cerr << "done\n";
+
+    {
+        std::cerr << indentOutput() << "Tabulation errors at midpoints between table entries:\n";
+        OutputIndentIncrease incr;
+        const auto rowValues=[&](const int r, const int component)
+        {
+            std::vector<double> values;
+            for(int n=0; n<checkSize; ++n)
+                values.push_back(data[size_t(r)*checkSize+n][component]);
+            return values;
+        };
+        row=0;
+        for(const auto& scatterer : atmo.scatterers)
+            reportTabulationError("number density of scatterer \""+scatterer.name.toStdString()+"\"",
+                                  maxInterpolationError(rowValues(row++, 0)));
+        for(const auto& absorber : atmo.absorbers)
+            reportTabulationError("number density of absorber \""+absorber.name.toStdString()+"\"",
+                                  maxInterpolationError(rowValues(row++, 0)));
+        for(const auto& scatterer : atmo.scatterers)
+        {
+            double error=0;
+            for(int c=0; c<4; ++c)
+                error=std::max(error, maxInterpolationError(rowValues(row, c)));
+            reportTabulationError("phase function of scatterer \""+scatterer.name.toStdString()+"\"", error);
+            ++row;
+        }
+    }
+
+    tablesReady=true;
+}
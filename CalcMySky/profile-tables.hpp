@@ -0,0 +1,30 @@
+#ifndef INCLUDE_ONCE_3B0BD359_7100_4AE4_A34E_D5F4E2CE0A97
+#define INCLUDE_ONCE_3B0BD359_7100_4AE4_A34E_D5F4E2CE0A97
+
+#include <QString>
+#include <QOpenGLShaderProgram>
+
+// Number densities of all scatterers and absorbers, and phase functions of all scatterers, can be tabulated into
+// textures, so that precomputation shaders look them up instead of evaluating the GLSL code from the atmosphere
+// description at each integration step. Rows of the tables follow the order of species in the description,
+// absorbers going after scatterers in the number density table.
+//
+// Altitude is mapped to texture coordinate as sqrt(altitude/atmosphereHeight), giving more resolution near the
+// ground, where most profiles change fastest. Scattering angle is mapped as sqrt(angle/PI), giving more resolution in
+// the forward scattering peak.
+
+constexpr GLint NUMBER_DENSITY_TABLE_SAMPLER=14;
+constexpr GLint PHASE_FUNCTION_TABLE_SAMPLER=15;
+
+// Tabulates the profiles for the current wavelength set and reports the tabulation errors. Does nothing unless the
+// atmosphere description requests tabulation. Must be called after the phase functions source has been generated.
+void tabulateProfiles();
+// Whether the generated sources of the precomputation shaders should look the profiles up in the tables
+bool profileTablesReady();
+// Points the table samplers of the program, if it has them, to the texture units the tables are bound to
+void setProfileTableSamplers(QOpenGLShaderProgram& program);
+// GLSL functions doing the lookups, to be included in the generated densities and phase functions sources
+QString makeNumberDensityTableLookupSrc();
+QString makePhaseFunctionTableLookupSrc();
+
+#endif
@@ -0,0 +1,186 @@
+#include "quadrature.hpp"
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#include "data.hpp"
+#include "util.hpp"
+
+namespace
+{
+
+// Ensures the literal is a float in GLSL even if the value happens to be integer
+QString glslFloat(const double x)
+{
+    auto str=QString::number(x, 'g', 17);
+    if(!str.contains('.') && !str.contains('e'))
+        str += ".";
+    return str;
+}
+
+QString glslFloatArray(std::vector<double> const& values)
+{
+    QString list;
+    for(const auto v : values)
+        list += (list.isEmpty() ? "" : ",")+glslFloat(v);
+    return QString("float[%1](%2)").arg(values.size()).arg(list);
+}
+
+}
+
+QuadratureRule gaussLegendreRule(const int order)
+{
+    assert(order>0);
+    QuadratureRule rule;
+    rule.nodes.resize(order);
+    rule.weights.resize(order);
+    // Roots of the Legendre polynomial P_order via Newton's method, starting from the Tricomi approximation. The
+    // rule is symmetric, so only half of the roots need to be found.
+    for(int i=0; i<(order+1)/2; ++i)
+    {
+        double x=std::cos(M_PI*(i+0.75)/(order+0.5));
+        double derivative=1;
+        for(int iter=0; iter<100; ++iter)
+        {
+            double p0=1, p1=x;
+            for(int k=2; k<=order; ++k)
+            {
+                const auto p2=((2*k-1)*x*p1-(k-1)*p0)/k;
+                p0=p1;
+                p1=p2;
+            }
+            derivative=order*(x*p1-p0)/(x*x-1);
+            const auto dx=p1/derivative;
+            x-=dx;
+            if(std::abs(dx)<1e-16) break;
+        }
+        const auto weight=2/((1-x*x)*derivative*derivative);
+        // Map from [-1,1] to [0,1]
+        rule.nodes[i]=(1-x)/2;
+        rule.nodes[order-1-i]=(1+x)/2;
+        rule.weights[i]=rule.weights[order-1-i]=weight/2;
+    }
+    return rule;
+}
+
+int gaussLegendrePanelCount(const int pointCount)
+{
+    return std::max(1, (pointCount+gaussLegendrePanelOrder-1)/gaussLegendrePanelOrder);
+}
+
+QString makeQuadratureRuleArraysSrc(QString const& prefix, QuadratureRule const& rule)
+{
+    return QString("const float %1Nodes[%2]=%3;\n"
+                   "const float %1Weights[%2]=%4;\n").arg(prefix).arg(rule.nodes.size())
+                                                     .arg(glslFloatArray(rule.nodes))
+                                                     .arg(glslFloatArray(rule.weights));
+}
+
+int rayQuadraturePointCount(const QuadratureScheme scheme, const int pointCount)
+{
+    if(scheme==QuadratureScheme::GaussLegendre)
+        return gaussLegendrePanelCount(pointCount)*gaussLegendrePanelOrder;
+    return pointCount;
+}
+
+int rayQuadratureConvergenceOrder(const QuadratureScheme scheme)
+{
+    if(scheme==QuadratureScheme::GaussLegendre)
+        return 2*gaussLegendrePanelOrder;
+    return 2;
+}
+
+QString rayQuadratureStructSrc()
+{
+    return 1+R"(
+struct RayQuadrature
+{
+    float origin; // distance from the ray origin to the point the samples are counted from
+    float scale;  // length that the unit of the sampling variable is stretched to
+    float uMin;   // sampling variable at the ray origin
+    float du;     // step of the sampling variable
+    bool sinhMapping;
+};
+)";
+}
+
+QString makeRayQuadratureDeclarationsSrc(QString const& name)
+{
+    return QString("RayQuadrature %1Init(float rayLength, float cosZenithAngle, float altitude);\n"
+                   "vec2 %1Sample(RayQuadrature quadrature, int n);\n").arg(name);
+}
+
+QString makeRayQuadratureSrc(QString const& name, const QuadratureScheme scheme, const int pointCount)
+{
+    QString src;
+    switch(scheme)
+    {
+    case QuadratureScheme::Midpoint:
+        src = R"(
+RayQuadrature NAMEInit(const float rayLength, const float cosZenithAngle, const float altitude)
+{
+    return RayQuadrature(0., 1., 0., rayLength/NAMEPoints, false);
+}
+
+vec2 NAMESample(const RayQuadrature quadrature, const int n)
+{
+    return vec2((n+0.5)*quadrature.du, quadrature.du);
+}
+)";
+        break;
+    case QuadratureScheme::GaussLegendre:
+        src = makeQuadratureRuleArraysSrc(name, gaussLegendreRule(gaussLegendrePanelOrder)) + R"(
+// Here du is the length of a panel
+RayQuadrature NAMEInit(const float rayLength, const float cosZenithAngle, const float altitude)
+{
+    return RayQuadrature(0., 1., 0., rayLength/)"+toString(gaussLegendrePanelCount(pointCount))+R"(, false);
+}
+
+vec2 NAMESample(const RayQuadrature quadrature, const int n)
+{
+    CONST int panel=n/)"+toString(gaussLegendrePanelOrder)+R"(, node=n%)"+toString(gaussLegendrePanelOrder)+R"(;
+    return vec2((panel+NAMENodes[node])*quadrature.du, NAMEWeights[node]*quadrature.du);
+}
+)";
+        break;
+    case QuadratureScheme::AltitudeAdapted:
+        src = R"(
+// The samples are densest at the point of the ray closest to the center of the Earth, where the atmosphere along the ray
+// is densest, and get sparser away from it as the density is expected to fall off, with the scale height given in the
+// atmosphere description. Away from the tangent point the density falls off exponentially, so the midpoint rule is
+// applied in the variable u=log(1+d/scale), where d is the distance from the closest point. Near the tangent point it
+// falls off as a Gaussian, and the variable is u=asinh(d/scale), which keeps the integrand smooth there.
+const float NAMEScaleHeight=)"+toString(atmo.quadratureScaleHeight)+R"(;
+RayQuadrature NAMEInit(const float rayLength, const float cosZenithAngle, const float altitude)
+{
+    CONST float r=earthRadius+altitude;
+    CONST float closestDist=clamp(-r*cosZenithAngle, 0., rayLength);
+    CONST float closestR=safeSqrt(sqr(r)+sqr(closestDist)+2*r*closestDist*cosZenithAngle);
+    CONST float closestCosZenithAngle=abs(r*cosZenithAngle+closestDist)/max(closestR, 1.);
+    // Distance over which the altitude grows by one scale height near the closest point
+    CONST float curvatureTerm=sqrt(NAMEScaleHeight/(2*max(closestR, 1.)));
+    CONST float scale=NAMEScaleHeight/(closestCosZenithAngle+curvatureTerm);
+    CONST float xMin=closestDist/scale, xMax=(rayLength-closestDist)/scale;
+    if(closestCosZenithAngle<curvatureTerm)
+    {
+        CONST float uMin=-asinh(xMin);
+        return RayQuadrature(closestDist, scale, uMin, (asinh(xMax)-uMin)/NAMEPoints, true);
+    }
+    CONST float uMin=-log(1+xMin);
+    return RayQuadrature(closestDist, scale, uMin, (log(1+xMax)-uMin)/NAMEPoints, false);
+}
+
+vec2 NAMESample(const RayQuadrature quadrature, const int n)
+{
+    CONST float u=quadrature.uMin+(n+0.5)*quadrature.du;
+    if(quadrature.sinhMapping)
+        return vec2(quadrature.origin+quadrature.scale*sinh(u), quadrature.scale*cosh(u)*quadrature.du);
+    CONST float expU=exp(abs(u));
+    return vec2(quadrature.origin+sign(u)*quadrature.scale*(expU-1), quadrature.scale*expU*quadrature.du);
+}
+)";
+        break;
+    }
+    return src.replace("NAME", name);
+}
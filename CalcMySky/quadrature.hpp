@@ -0,0 +1,40 @@
+#ifndef INCLUDE_ONCE_EDB17AB3_FA8E_45AE_BC4B_01B2347F46B4
+#define INCLUDE_ONCE_EDB17AB3_FA8E_45AE_BC4B_01B2347F46B4
+
+#include <vector>
+#include <QString>
+#include "../common/types.hpp"
+
+// Number of nodes in each panel of composite Gauss-Legendre rules. Four nodes integrate polynomials up to degree 7
+// exactly, which is plenty for the smooth integrands along a ray, while keeping the panels short enough to follow the
+// exponential decay of number densities with altitude.
+constexpr int gaussLegendrePanelOrder=4;
+
+// Nodes and weights of a quadrature rule on [0,1]. The weights sum to 1.
+struct QuadratureRule
+{
+    std::vector<double> nodes;
+    std::vector<double> weights;
+};
+
+QuadratureRule gaussLegendreRule(int order);
+// Number of panels of a composite Gauss-Legendre rule that uses at least the given number of points
+int gaussLegendrePanelCount(int pointCount);
+// GLSL declarations of "const float <prefix>Nodes[order]" and "const float <prefix>Weights[order]"
+QString makeQuadratureRuleArraysSrc(QString const& prefix, QuadratureRule const& rule);
+
+// Quadratures along rays are generated into GLSL as a pair of functions:
+//  RayQuadrature <name>Init(float rayLength, float cosZenithAngle, float altitude) prepares the quadrature for a ray,
+//  vec2 <name>Sample(RayQuadrature quadrature, int n) returns the distance from the ray origin to the n-th sample and
+//                                                    the weight of the sample.
+// The samples are numbered from 0 to <name>Points-1, and the caller must define this constant to the value returned
+// by rayQuadraturePointCount(). The source of the functions needs const.h.glsl and common-functions.h.glsl.
+QString rayQuadratureStructSrc();
+QString makeRayQuadratureDeclarationsSrc(QString const& name);
+QString makeRayQuadratureSrc(QString const& name, QuadratureScheme scheme, int pointCount);
+// Actual number of samples used by the scheme when at least pointCount samples were requested
+int rayQuadraturePointCount(QuadratureScheme scheme, int pointCount);
+// Power of the sample spacing the quadrature error is proportional to for smooth integrands
+int rayQuadratureConvergenceOrder(QuadratureScheme scheme);
+
+#endif
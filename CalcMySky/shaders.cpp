@@ -1,15 +1,18 @@
 #include "shaders.hpp"
 
 #include <set>
+#include <map>
 #include <iomanip>
 #include <iostream>
 #include <QRegularExpression>
-#include <QApplication>
+#include <QCoreApplication>
 #include <QFile>
 #include <QDir>
 
 #include "data.hpp"
 #include "util.hpp"
+#include "profile-tables.hpp"
+#include "quadrature.hpp"
 
 #include "config.h"
 
@@ -43,28 +46,72 @@ int lightPollutionAngularIntegrationPoints=)" + toString(atmo.lightPollutionAngu
 const int eclipseAngularIntegrationPoints=)" + toString(atmo.eclipseAngularIntegrationPoints) + R"(;
 const int numTransmittanceIntegrationPoints=)" + toString(atmo.numTransmittanceIntegrationPoints) + R"(;
 )";
-    for(auto const& scatterer : atmo.scatterers)
-        header += "const vec4 scatteringCrossSection_"+scatterer.name+"="+toString(scatterer.scatteringCrossSection(wavelengths))+";\n";
     const auto wlI=atmo.wavelengthsIndex(wavelengths);
-    header += "const vec4 groundAlbedo="+toString(atmo.groundAlbedo[wlI])+";\n";
-    header += "const vec4 solarIrradianceAtTOA="+toString(atmo.solarIrradianceAtTOA[wlI])+";\n";
-    header += "const vec4 lightPollutionRelativeRadiance="+toString(atmo.lightPollutionRelativeRadiance[wlI])+";\n";
-    header += "const vec4 wavelengths="+toString(wavelengths)+";\n";
-    header += "const int wlSetIndex="+toString(int(wlI))+";\n";
+    header += "const int wlSetCount="+toString(int(atmo.allWavelengths.size()))+";\n";
+
+    // The renderer can draw all the wavelength sets with a single program: it then defines WLSET_UNIFORM_INDEX and
+    // selects the set via the wlSetIndex uniform, while the per-set constants are looked up in arrays of all the sets.
+    QString perSetConstants, allSetsConstants;
+    const auto addConstant=[&](QString const& name, std::vector<glm::vec4> const& valuePerSet)
+    {
+        perSetConstants += "const vec4 "+name+"="+toString(valuePerSet[wlI])+";\n";
+        QStringList values;
+        for(auto const& value : valuePerSet)
+            values << toString(value);
+        allSetsConstants += "const vec4 "+name+"PerWLSet[wlSetCount]=vec4[]("+values.join(", ")+");\n"
+                            "#define "+name+" "+name+"PerWLSet[wlSetIndex]\n";
+    };
+    for(auto const& scatterer : atmo.scatterers)
+    {
+        std::vector<glm::vec4> crossSections;
+        for(auto const& wls : atmo.allWavelengths)
+            crossSections.push_back(scatterer.scatteringCrossSection(wls));
+        addConstant("scatteringCrossSection_"+scatterer.name, crossSections);
+    }
+    addConstant("groundAlbedo", atmo.groundAlbedo);
+    addConstant("solarIrradianceAtTOA", atmo.solarIrradianceAtTOA);
+    addConstant("lightPollutionRelativeRadiance", atmo.lightPollutionRelativeRadiance);
+    addConstant("wavelengths", atmo.allWavelengths);
+
+    header += "#ifdef WLSET_UNIFORM_INDEX\n"
+              "uniform int wlSetIndex;\n"
+              +allSetsConstants+
+              "#else\n"
+              "const int wlSetIndex="+toString(int(wlI))+";\n"
+              +perSetConstants+
+              "#endif\n";
 
     header+="#endif\n"; // close the include guard
     virtualHeaderFiles[CONSTANTS_HEADER_FILENAME]=header;
 }
 
+// When profile tabulation is enabled, the generated function bodies are wrapped in "#if USE_PROFILE_TABLES" blocks
+// choosing between the table lookup and the code from the atmosphere description. The choice is made when the shader
+// is compiled, see compileShaderProgram().
+QString withOptionalTableLookup(QString const& body, QString const& lookup)
+{
+    if(!atmo.profileTabulationPoints)
+        return body;
+    return "#if USE_PROFILE_TABLES\n"
+           "    return "+lookup+";\n"
+           "#else\n"
+           +body+
+           "#endif\n";
+}
+
 QString makeDensitiesFunctions()
 {
     QString header;
     QString src;
+    if(atmo.profileTabulationPoints)
+        src += makeNumberDensityTableLookupSrc();
+    int tableRow=0;
     for(auto const& scatterer : atmo.scatterers)
     {
         src += "float scattererNumberDensity_"+scatterer.name+"(float altitude)\n"
                "{\n"
-               +scatterer.numberDensity+
+               +withOptionalTableLookup(scatterer.numberDensity,
+                                        QString("numberDensityFromTable(%1, altitude)").arg(tableRow++))+
                "}\n";
         header += "float scattererNumberDensity_"+scatterer.name+"(float altitude);\n";
     }
@@ -72,7 +119,8 @@ QString makeDensitiesFunctions()
     {
         src += "float absorberNumberDensity_"+absorber.name+"(float altitude)\n"
                "{\n"
-               +absorber.numberDensity+
+               +withOptionalTableLookup(absorber.numberDensity,
+                                        QString("numberDensityFromTable(%1, altitude)").arg(tableRow++))+
                "}\n";
         header += "float absorberNumberDensity_"+absorber.name+"(float altitude);\n";
     }
@@ -93,52 +141,55 @@ QString makeTransmittanceComputeFunctionsSrc(glm::vec4 const& wavelengths)
 #include "const.h.glsl"
 #include "common-functions.h.glsl"
 )";
-    const QString opticalDepthFunctionTemplate=R"(
-vec4 opticalDepthToAtmosphereBorder_##agentSpecies(float altitude, float cosZenithAngle, vec4 crossSection)
+    // All the species are integrated in a single loop, so that the geometry of each sample is computed once. Each
+    // species has its own scalar accumulator, and the cross sections are applied only at the end.
+    QString sums, accumulation, depth;
+    for(auto const& scatterer : atmo.scatterers)
+    {
+        sums += "    float scattererSum_"+scatterer.name+"=0;\n";
+        accumulation += "        scattererSum_"+scatterer.name+"+=weight*scattererNumberDensity_"+scatterer.name+"(currAlt);\n";
+        depth += "        +scattererSum_"+scatterer.name+"*"+toString(scatterer.extinctionCrossSection(wavelengths))+"\n";
+    }
+    for(auto const& absorber : atmo.absorbers)
+    {
+        sums += "    float absorberSum_"+absorber.name+"=0;\n";
+        accumulation += "        absorberSum_"+absorber.name+"+=weight*absorberNumberDensity_"+absorber.name+"(currAlt);\n";
+        depth += "        +absorberSum_"+absorber.name+"*"+toString(absorber.crossSection(wavelengths))+"\n";
+    }
+
+    const auto scheme=atmo.transmittanceQuadrature;
+    const QString quadrature = "\n"+rayQuadratureStructSrc()+
+        "const int transmittanceQuadraturePoints="+
+            toString(rayQuadraturePointCount(scheme, atmo.numTransmittanceIntegrationPoints))+";\n"+
+        makeRayQuadratureSrc("transmittanceQuadrature", scheme, atmo.numTransmittanceIntegrationPoints);
+
+    const QString computeFunction = quadrature + R"(
+// This assumes that ray doesn't intersect Earth
+vec4 computeTransmittanceToAtmosphereBorder(float cosZenithAngle, float altitude)
 {
     CONST float integrInterval=distanceToAtmosphereBorder(cosZenithAngle, altitude);
 
     CONST float R=earthRadius;
     CONST float r1=R+altitude;
-    CONST float l=integrInterval;
     CONST float mu=cosZenithAngle;
-    // Using midpoint rule for quadrature
-    CONST float dl=integrInterval/numTransmittanceIntegrationPoints;
-    float sum=0;
-    for(int n=0;n<numTransmittanceIntegrationPoints;++n)
+)" + sums + R"(
+    // Using )"+toString(scheme)+R"( rule for quadrature
+    CONST RayQuadrature quadrature=transmittanceQuadratureInit(integrInterval, mu, altitude);
+    for(int n=0;n<transmittanceQuadraturePoints;++n)
     {
-        CONST float dist=(n+0.5)*dl;
+        CONST vec2 distAndWeight=transmittanceQuadratureSample(quadrature, n);
+        CONST float dist=distAndWeight.x;
+        CONST float weight=distAndWeight.y;
         /* From law of cosines: r₂²=r₁²+l²+2r₁lμ */
         CONST float currAlt=-R+safeSqrt(sqr(r1)+sqr(dist)+2*r1*dist*mu);
-        sum+=agent##NumberDensity_##agentSpecies(currAlt);
+)" + accumulation + R"(
     }
-    return sum*dl*crossSection;
-}
-)";
-    QString opticalDepthFunctions;
-    QString computeFunction = R"(
-// This assumes that ray doesn't intersect Earth
-vec4 computeTransmittanceToAtmosphereBorder(float cosZenithAngle, float altitude)
-{
-    CONST vec4 depth=
-)";
-    for(auto const& scatterer : atmo.scatterers)
-    {
-        opticalDepthFunctions += QString(opticalDepthFunctionTemplate).replace("##agentSpecies",scatterer.name).replace("agent##","scatterer");
-        computeFunction += "        +opticalDepthToAtmosphereBorder_"+scatterer.name+
-                             "(altitude,cosZenithAngle,"+toString(scatterer.extinctionCrossSection(wavelengths))+")\n";
-    }
-    for(auto const& absorber : atmo.absorbers)
-    {
-        opticalDepthFunctions += QString(opticalDepthFunctionTemplate).replace("##agentSpecies",absorber.name).replace("agent##","absorber");
-        computeFunction += "        +opticalDepthToAtmosphereBorder_"+absorber.name+
-                             "(altitude,cosZenithAngle,"+toString(absorber.crossSection(wavelengths))+")\n";
-    }
-    computeFunction += R"(      ;
+    CONST vec4 depth=vec4(0)
+)" + depth + R"(      ;
     return depth; // Exponentiation will take place in sampling functions. This way we avoid underflow in texture values.
 }
 )";
-    return head+makeDensitiesFunctions()+opticalDepthFunctions+computeFunction;
+    return head+makeDensitiesFunctions()+computeFunction;
 }
 
 QString makeScattererDensityFunctionsSrc()
@@ -159,12 +210,16 @@ QString makePhaseFunctionsSrc()
 #include "const.h.glsl"
 
 )";
+    if(atmo.profileTabulationPoints)
+        src += makePhaseFunctionTableLookupSrc();
     QString header;
+    int tableRow=0;
     for(auto const& scatterer : atmo.scatterers)
     {
         src += "vec4 phaseFunction_"+scatterer.name+"(float dotViewSun)\n"
                "{\n"
-               +scatterer.phaseFunction+
+               +withOptionalTableLookup(scatterer.phaseFunction,
+                                        QString("phaseFunctionFromTable(%1, dotViewSun)").arg(tableRow++))+
                "}\n";
         header += "vec4 phaseFunction_"+scatterer.name+"(float dotViewSun);\n";
     }
@@ -198,6 +253,25 @@ vec4 totalScatteringCoefficient(float altitude, float dotViewInc)
     return src;
 }
 
+void makeRadialQuadratureSrc(const int pointCount)
+{
+    const auto scheme=atmo.radialQuadrature;
+    virtualHeaderFiles[RADIAL_QUADRATURE_HEADER_FILENAME]=1+R"(
+#ifndef INCLUDE_ONCE_4C067C8C_D1E2_4468_84EC_D3BF7AE0C44A
+#define INCLUDE_ONCE_4C067C8C_D1E2_4468_84EC_D3BF7AE0C44A
+)" + rayQuadratureStructSrc() +
+        "const int radialQuadraturePoints="+toString(rayQuadraturePointCount(scheme, pointCount))+";\n"+
+        makeRayQuadratureDeclarationsSrc("radialQuadrature")+
+        "#endif\n";
+    virtualSourceFiles[RADIAL_QUADRATURE_SHADER_FILENAME]=1+R"(
+#version 330
+#include "version.h.glsl"
+#include "const.h.glsl"
+#include "common-functions.h.glsl"
+#include "radial-quadrature.h.glsl"
+)" + makeRayQuadratureSrc("radialQuadrature", scheme, pointCount);
+}
+
 QString getShaderSrc(QString const& fileName, IgnoreCache ignoreCache)
 {
     if(!ignoreCache)
@@ -247,14 +321,25 @@ void defineDisabledDefinitions(QString& source)
     }
 }
 
-std::unique_ptr<QOpenGLShader> compileShader(QOpenGLShader::ShaderType type, QString source, QString const& description,
-                                             QString* processedSource = nullptr)
+// Compiled shaders are kept for reuse by later programs: most programs share the vertex and geometry shaders and
+// the common functions, and the jobs of a sweep compile many identical sources. The key is the type of the shader
+// and its source with the headers included.
+std::map<std::pair<int/*QOpenGLShader::ShaderType*/, QString>, std::unique_ptr<QOpenGLShader>> compiledShaders;
+// Linked programs stay valid after their shaders are deleted, so the cache can simply be emptied when it gets this
+// large, as long as this is not done while a program is being assembled
+constexpr size_t maxCompiledShadersCached=1024;
+
+QOpenGLShader* compileShader(QOpenGLShader::ShaderType type, QString source, QString const& description,
+                             QString* processedSource = nullptr)
 {
-    auto shader=std::make_unique<QOpenGLShader>(type);
     defineDisabledDefinitions(source);
     source=withHeadersIncluded(source, description);
     if(processedSource)
         *processedSource = source;
+
+    if(const auto it=compiledShaders.find({int(type), source}); it!=compiledShaders.end())
+        return it->second.get();
+    auto shader=std::make_unique<QOpenGLShader>(type);
     if(!shader->compileSourceCode(source))
     {
         std::cerr << "Failed to compile " << description.toStdString() << ":\n"
@@ -281,10 +366,10 @@ std::unique_ptr<QOpenGLShader> compileShader(QOpenGLShader::ShaderType type, QSt
         std::cerr << "Warnings while compiling " << description.toStdString() << ":\n"
                   << shader->log().toStdString() << "\n";
     }
-    return shader;
+    return (compiledShaders[{int(type), source}]=std::move(shader)).get();
 }
 
-std::unique_ptr<QOpenGLShader> compileShader(QOpenGLShader::ShaderType type, QString const& filename, QString* processedSource = nullptr)
+QOpenGLShader* compileShader(QOpenGLShader::ShaderType type, QString const& filename, QString* processedSource = nullptr)
 { return compileShader(type, getShaderSrc(filename), filename, processedSource); }
 
 QString withHeadersIncluded(QString src, QString const& filename)
@@ -369,29 +454,30 @@ std::unique_ptr<QOpenGLShaderProgram> compileShaderProgram(QString const& mainSr
                                                            const char* description, const UseGeomShader useGeomShader,
                                                            std::vector<std::pair<QString, QString>>* sourcesToSave)
 {
+    if(compiledShaders.size()>=maxCompiledShadersCached)
+        compiledShaders.clear();
     auto program=std::make_unique<QOpenGLShaderProgram>();
 
     auto shaderFileNames=getShaderFileNamesToLinkWith(mainSrcFileName);
     shaderFileNames.insert(mainSrcFileName);
 
-    std::vector<std::unique_ptr<QOpenGLShader>> shaders;
+    // The renderer has no profile tables, so the shaders saved for it must evaluate the profiles directly
+    const bool useProfileTables = profileTablesReady() && !sourcesToSave;
+
     for(const auto& filename : shaderFileNames)
     {
         QString processedSource;
-        shaders.emplace_back(compileShader(QOpenGLShader::Fragment, filename, &processedSource));
-        program->addShader(shaders.back().get());
+        const auto source=getShaderSrc(filename).replace(QRegularExpression("\\b(USE_PROFILE_TABLES)\\b"),
+                                                         useProfileTables ? "1 /*\\1*/" : "0 /*\\1*/");
+        program->addShader(compileShader(QOpenGLShader::Fragment, source, filename, &processedSource));
         if(sourcesToSave)
             sourcesToSave->push_back({filename, processedSource});
     }
 
-    shaders.emplace_back(compileShader(QOpenGLShader::Vertex, "shader.vert"));
-    program->addShader(shaders.back().get());
+    program->addShader(compileShader(QOpenGLShader::Vertex, "shader.vert"));
 
     if(useGeomShader)
-    {
-        shaders.emplace_back(compileShader(QOpenGLShader::Geometry, "shader.geom"));
-        program->addShader(shaders.back().get());
-    }
+        program->addShader(compileShader(QOpenGLShader::Geometry, "shader.geom"));
 
     if(!program->link())
     {
@@ -399,6 +485,8 @@ std::unique_ptr<QOpenGLShaderProgram> compileShaderProgram(QString const& mainSr
         std::cerr << "Failed to link " << description << "\n";
         throw MustQuit{};
     }
+    if(useProfileTables)
+        setProfileTableSamplers(*program);
     return program;
 }
 
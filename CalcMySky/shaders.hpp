@@ -18,4 +18,6 @@ QString makeScattererDensityFunctionsSrc();
 QString makeTransmittanceComputeFunctionsSrc(glm::vec4 const& wavelengths);
 QString makeTotalScatteringCoefSrc();
 QString makePhaseFunctionsSrc();
+// Generates the quadrature along view rays used for single and multiple scattering, at least pointCount samples per ray
+void makeRadialQuadratureSrc(int pointCount);
 #endif
@@ -0,0 +1,160 @@
+#include "stage-timing.hpp"
+
+#include <vector>
+#include <iomanip>
+#include <iterator>
+#include <iostream>
+#include <algorithm>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QCoreApplication>
+
+#include "config.h"
+#include "data.hpp"
+#include "util.hpp"
+#include "event-stream.hpp"
+
+namespace
+{
+
+struct StageTiming
+{
+    std::string name;
+    unsigned runs=0;
+    double wallTime=0; // s
+    double gpuTime=0;  // s
+};
+// In the order of first start of each stage, so that outer stages precede the nested ones
+std::vector<StageTiming> stageTimings;
+
+StageTiming& findOrAddStage(std::string const& name)
+{
+    for(auto& stage : stageTimings)
+        if(stage.name==name)
+            return stage;
+    stageTimings.push_back({name});
+    return stageTimings.back();
+}
+
+bool stageTimingEnabled()
+{
+    return !opts.stageTimingsPath.empty() || eventStreamIsOpen();
+}
+
+// Lists the stages from the slowest one, so that the bottlenecks come first
+void printStageTimingsReport(const double totalWallTime)
+{
+    auto stages=stageTimings;
+    std::stable_sort(stages.begin(), stages.end(),
+                     [](StageTiming const& a, StageTiming const& b) { return a.wallTime > b.wallTime; });
+    size_t nameWidth=std::string("Stage").size();
+    for(const auto& stage : stages)
+        nameWidth=std::max(nameWidth, stage.name.size());
+
+    std::cerr << "Time spent in computation stages (nested stages are included in the enclosing ones):\n";
+    std::cerr << "  " << std::left << std::setw(nameWidth) << "Stage" << std::right
+              << "  runs      wall, s       GPU, s  share of total\n";
+    const auto oldFlags=std::cerr.flags();
+    const auto oldPrecision=std::cerr.precision();
+    std::cerr << std::fixed << std::setprecision(3);
+    for(const auto& stage : stages)
+    {
+        std::cerr << "  " << std::left << std::setw(nameWidth) << stage.name << std::right
+                  << std::setw(6) << stage.runs
+                  << std::setw(13) << stage.wallTime
+                  << std::setw(13) << stage.gpuTime
+                  << std::setprecision(1) << std::setw(15) << 100*stage.wallTime/totalWallTime << "%\n"
+                  << std::setprecision(3);
+    }
+    std::cerr.flags(oldFlags);
+    std::cerr.precision(oldPrecision);
+}
+
+}
+
+StageTimer::StageTimer(std::string name)
+    : name(std::move(name))
+{
+    if(!stageTimingEnabled()) return;
+
+    findOrAddStage(this->name);
+    emitEvent("stage_start", {{"stage", QString::fromStdString(this->name)}});
+    gl.glGenQueries(std::size(queries), queries);
+    gl.glQueryCounter(queries[0], GL_TIMESTAMP);
+    wallTimeBegin=std::chrono::steady_clock::now();
+}
+
+StageTimer::~StageTimer()
+{
+    if(!queries[0]) return;
+
+    gl.glQueryCounter(queries[1], GL_TIMESTAMP);
+    GLuint64 gpuTimeBegin=0, gpuTimeEnd=0;
+    gl.glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &gpuTimeBegin);
+    // This waits for the GPU to finish the commands of the stage, so wall time includes them too
+    gl.glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &gpuTimeEnd);
+    const auto wallTimeEnd=std::chrono::steady_clock::now();
+    gl.glDeleteQueries(std::size(queries), queries);
+
+    auto& stage=findOrAddStage(name);
+    ++stage.runs;
+    const double wallTime=std::chrono::duration<double>(wallTimeEnd-wallTimeBegin).count();
+    const double gpuTime=1e-9*(gpuTimeEnd-gpuTimeBegin);
+    stage.wallTime += wallTime;
+    stage.gpuTime += gpuTime;
+    emitEvent("stage_end", {{"stage", QString::fromStdString(name)},
+                            {"wall_time_s", wallTime},
+                            {"gpu_time_s", gpuTime}});
+}
+
+void saveStageTimings(const double totalWallTime, std::vector<std::pair<std::string, double>> const& jobWallTimes)
+{
+    if(!stageTimingEnabled()) return;
+
+    printStageTimingsReport(totalWallTime);
+
+    QJsonArray stages;
+    for(const auto& stage : stageTimings)
+    {
+        stages.append(QJsonObject{{"name", QString::fromStdString(stage.name)},
+                                  {"runs", int(stage.runs)},
+                                  {"wall_time_s", stage.wallTime},
+                                  {"gpu_time_s", stage.gpuTime}});
+    }
+    QJsonObject root{{"version", PROJECT_VERSION},
+                     {"command_line", qApp->arguments().join(' ')},
+                     {"gl_renderer", reinterpret_cast<const char*>(gl.glGetString(GL_RENDERER))},
+                     {"gl_version", reinterpret_cast<const char*>(gl.glGetString(GL_VERSION))},
+                     {"total_wall_time_s", totalWallTime},
+                     {"stages", stages}};
+    if(!jobWallTimes.empty())
+    {
+        QJsonArray jobs;
+        for(const auto& [name, wallTime] : jobWallTimes)
+            jobs.append(QJsonObject{{"name", QString::fromStdString(name)}, {"wall_time_s", wallTime}});
+        root["jobs"]=jobs;
+    }
+    // The job of the last event has finished, and the summary covers all of them
+    setEventStreamJob("");
+    emitEvent("summary", root);
+
+    if(opts.stageTimingsPath.empty()) return;
+
+    std::cerr << "Saving stage timings to \"" << opts.stageTimingsPath << "\"... ";
+    QFile file(QString::fromStdString(opts.stageTimingsPath));
+    if(!file.open(QFile::WriteOnly))
+    {
+        std::cerr << "failed to open file: " << file.errorString().toStdString() << "\n";
+        throw MustQuit{};
+    }
+    file.write(QJsonDocument(root).toJson());
+    file.close();
+    if(file.error())
+    {
+        std::cerr << "failed to write file: " << file.errorString().toStdString() << "\n";
+        throw MustQuit{};
+    }
+    std::cerr << "done\n";
+}
@@ -0,0 +1,37 @@
+#ifndef INCLUDE_ONCE_CF81B055_E4BA_45B0_883D_9665F85AC786
+#define INCLUDE_ONCE_CF81B055_E4BA_45B0_883D_9665F85AC786
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <qopengl.h>
+
+// Measures wall and GPU time of a computation stage while in scope. Runs of stages with the same name, e.g. the same
+// stage for different wavelength sets, are summed. Stages may nest, then the outer stage's times include those of the
+// inner ones.
+//
+// Each run is also reported to the event stream, if it's open.
+//
+// Nothing is measured unless stage timings or an event stream were requested on the command line, because reading the
+// GPU timer makes us wait for the GPU at the end of each stage.
+class StageTimer
+{
+public:
+    explicit StageTimer(std::string name);
+    ~StageTimer();
+    StageTimer(StageTimer const&)=delete;
+    StageTimer& operator=(StageTimer const&)=delete;
+
+private:
+    std::string name;
+    std::chrono::steady_clock::time_point wallTimeBegin;
+    GLuint queries[2]={};
+};
+
+// Prints a report of where the time went, sends the summed stage timings to the event stream and writes them to
+// opts.stageTimingsPath as JSON. Does nothing unless the stages were measured. When several models were computed in
+// one run, the wall time of each job is included too.
+void saveStageTimings(double totalWallTime, std::vector<std::pair<std::string, double>> const& jobWallTimes={});
+
+#endif
@@ -0,0 +1,453 @@
+#include "sweep.hpp"
+
+#include <set>
+#include <cassert>
+#include <map>
+#include <new>
+#include <memory>
+#include <iostream>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+
+#include "data.hpp"
+#include "util.hpp"
+
+namespace
+{
+
+struct Override
+{
+    QString section;   // e.g. `scatterer "aerosols"` in lower case, empty for top-level entries
+    QString key;       // simplified and in lower case, as the parser compares it
+    QStringList lines; // the entry as it will appear in the description, with its code block if it has one
+    int lineNumber;
+};
+
+struct Job
+{
+    QString name;
+    std::vector<Override> overrides;
+    QString descrFileName; // for error messages and relative paths of spectrum files
+    QString descriptionText;
+    std::set<QString> stageKeys;
+};
+
+std::vector<Job> jobs;
+std::string baseOutputDir;
+unsigned currentJob=0;
+
+struct SharedStageResult
+{
+    GLenum target;
+    std::array<GLsizei,3> size;
+    std::vector<glm::vec4> data;
+    QString jobName;
+};
+std::map<QString, SharedStageResult> sharedStageResults;
+
+const QRegularExpression codeBlockMarker("^\\s*```\\s*$");
+const QRegularExpression sectionHeader("^(scatterer|absorber) \"[^\"]+\"$");
+
+QString entryKey(QString const& line)
+{
+    return line.split('#')[0].split(':')[0].simplified().toLower();
+}
+
+// Finds the lines [first,last] of the entry with the key in the section, or at the top level if the section is empty.
+// If the entry is absent, first is -1 and last is the line before which it should be inserted, i.e. the closing brace
+// of the section or the end of the text; if the section is absent too, last is also -1.
+std::pair<int,int> findEntry(QStringList const& lines, QString const& section, QString const& key)
+{
+    QString currentSection;
+    int sectionEnd=-1;
+    for(int i=0; i<lines.size(); ++i)
+    {
+        if(lines[i].contains(codeBlockMarker))
+        {
+            // A code block that doesn't belong to the entry being looked for, skip it entirely
+            for(++i; i<lines.size() && !lines[i].contains(codeBlockMarker); ++i);
+            continue;
+        }
+        const auto lineKey=entryKey(lines[i]);
+        if(lineKey.isEmpty() || lineKey=="{")
+            continue;
+        if(lineKey=="}")
+        {
+            if(!currentSection.isEmpty() && currentSection==section)
+                sectionEnd=i;
+            currentSection.clear();
+            continue;
+        }
+        if(currentSection.isEmpty() && lineKey.contains(sectionHeader))
+        {
+            currentSection=lineKey;
+            continue;
+        }
+        if(currentSection!=section || lineKey!=key)
+            continue;
+
+        int last=i;
+        if(last+1<lines.size() && lines[last+1].contains(codeBlockMarker))
+            for(last+=2; last<lines.size()-1 && !lines[last].contains(codeBlockMarker); ++last);
+        return {i, last};
+    }
+    return {-1, section.isEmpty() ? int(lines.size()) : sectionEnd};
+}
+
+QString applyOverrides(QString const& baseText, Job const& job, QString const& sweepFileName)
+{
+    auto lines=baseText.split('\n');
+    for(const auto& ovr : job.overrides)
+    {
+        auto [first,last]=findEntry(lines, ovr.section, ovr.key);
+        if(first>=0)
+            lines.erase(lines.begin()+first, lines.begin()+last+1);
+        else if(last>=0)
+            first=last;
+        else
+            throw ParsingError{sweepFileName, ovr.lineNumber, QString("there's no %1 in the base atmosphere description").arg(ovr.section)};
+        for(int i=0; i<ovr.lines.size(); ++i)
+            lines.insert(first+i, ovr.lines[i]);
+    }
+    return lines.join('\n');
+}
+
+// The textures are allocated once for all the jobs, so the jobs mustn't change anything that determines their sizes
+bool sameTextureSizes(AtmosphereParameters const& a, AtmosphereParameters const& b)
+{
+    return a.allWavelengths==b.allWavelengths &&
+           a.transmittanceTexW==b.transmittanceTexW && a.transmittanceTexH==b.transmittanceTexH &&
+           a.irradianceTexW==b.irradianceTexW && a.irradianceTexH==b.irradianceTexH &&
+           a.scatteringTextureSize==b.scatteringTextureSize &&
+           a.eclipsedSingleScatteringTextureSize==b.eclipsedSingleScatteringTextureSize &&
+           a.eclipsedDoubleScatteringTextureSize==b.eclipsedDoubleScatteringTextureSize &&
+           a.lightPollutionTextureSize==b.lightPollutionTextureSize &&
+           a.radialIntegrationPoints==b.radialIntegrationPoints &&
+           a.eclipseAngularIntegrationPoints==b.eclipseAngularIntegrationPoints;
+}
+
+QString transmittanceKey(AtmosphereParameters const& atmo, const unsigned texIndex)
+{
+    QString key=QString("transmittance: geometry %1 %2; texture %3x%4; points %5, quadrature %6, scale height %7; "
+                        "wavelengths %8; profile points %9\n")
+                    .arg(toString(atmo.earthRadius)).arg(toString(atmo.atmosphereHeight))
+                    .arg(atmo.transmittanceTexW).arg(atmo.transmittanceTexH)
+                    .arg(atmo.numTransmittanceIntegrationPoints).arg(int(atmo.transmittanceQuadrature))
+                    .arg(toString(atmo.quadratureScaleHeight))
+                    .arg(toString(atmo.allWavelengths[texIndex])).arg(atmo.profileTabulationPoints);
+    for(const auto& scatterer : atmo.scatterers)
+        key += "scatterer "+scatterer.name+": "+toString(scatterer.extinctionCrossSection_[texIndex])+"\n"+
+               scatterer.numberDensity+"\n";
+    for(const auto& absorber : atmo.absorbers)
+        key += "absorber "+absorber.name+": "+toString(absorber.absorptionCrossSection[texIndex])+"\n"+
+               absorber.numberDensity+"\n";
+    return key;
+}
+
+QString directGroundIrradianceKey(AtmosphereParameters const& atmo, const unsigned texIndex)
+{
+    return transmittanceKey(atmo, texIndex)+
+        QString("direct irradiance: texture %1x%2; solar irradiance %3; sun angular radius %4\n")
+            .arg(atmo.irradianceTexW).arg(atmo.irradianceTexH)
+            .arg(toString(atmo.solarIrradianceAtTOA[texIndex])).arg(toString(atmo.sunAngularRadius));
+}
+
+// The phase function is not applied to the single scattering texture, so it's not part of the key
+QString singleScatteringKey(AtmosphereParameters const& atmo, const unsigned texIndex,
+                            AtmosphereParameters::Scatterer const& scatterer)
+{
+    return transmittanceKey(atmo, texIndex)+
+        QString("single scattering by %1: texture %2; points %3, quadrature %4; cross section %5; "
+                "solar irradiance %6; sun angular radius %7\n")
+            .arg(scatterer.name).arg(toString(glm::vec4(atmo.scatteringTextureSize)))
+            .arg(atmo.radialIntegrationPoints).arg(int(atmo.radialQuadrature))
+            .arg(toString(scatterer.scatteringCrossSection_[texIndex]))
+            .arg(toString(atmo.solarIrradianceAtTOA[texIndex])).arg(toString(atmo.sunAngularRadius))+
+        scatterer.numberDensity+"\n";
+}
+
+std::set<QString> allStageKeys(AtmosphereParameters const& atmo)
+{
+    std::set<QString> keys;
+    for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
+    {
+        keys.insert(transmittanceKey(atmo, texIndex));
+        keys.insert(directGroundIrradianceKey(atmo, texIndex));
+        for(const auto& scatterer : atmo.scatterers)
+            keys.insert(singleScatteringKey(atmo, texIndex, scatterer));
+    }
+    return keys;
+}
+
+// The descriptions of all the jobs are parsed beforehand to find errors early and to know which stage results the jobs
+// share. The context describes where the line numbers of parsing errors come from.
+std::unique_ptr<AtmosphereParameters> parseJobDescription(Job const& job, std::string const& context)
+{
+    auto params=std::make_unique<AtmosphereParameters>();
+    try
+    {
+        params->parseText(job.descriptionText, job.descrFileName,
+                          AtmosphereParameters::ForceNoEDSTextures{opts.dbgNoEDSTextures});
+    }
+    catch(ParsingError const&)
+    {
+        std::cerr << "Failed to parse the atmosphere description of job \"" << job.name.toStdString()
+                  << "\", " << context << ":\n";
+        throw;
+    }
+    return params;
+}
+
+bool neededByLaterJobs(QString const& key)
+{
+    for(unsigned i=currentJob+1; i<jobs.size(); ++i)
+        if(jobs[i].stageKeys.count(key))
+            return true;
+    return false;
+}
+
+void parseOverride(QTextStream& stream, QString const& code, QString const& sweepFileName, int& lineNumber, Job& job)
+{
+    const auto keyValue=code.split(':');
+    if(keyValue.size()!=2)
+        throw ParsingError{sweepFileName,lineNumber,"error: not a key:value pair"};
+    const auto path=keyValue[0].split('/');
+    if(path.size()>2)
+        throw ParsingError{sweepFileName,lineNumber,"error: an entry may only be nested in one scatterer or absorber"};
+
+    Override ovr;
+    ovr.lineNumber=lineNumber;
+    ovr.key=path.back().simplified().toLower();
+    if(path.size()==2)
+    {
+        ovr.section=path[0].simplified().toLower();
+        if(!ovr.section.contains(sectionHeader))
+            throw ParsingError{sweepFileName,lineNumber,"error: expected scatterer \"name\" or absorber \"name\" before '/'"};
+    }
+    const QString indent=ovr.section.isEmpty() ? "" : "    ";
+    const auto value=keyValue[1].trimmed();
+    ovr.lines << indent+path.back().trimmed()+": "+value;
+    if(value.isEmpty())
+    {
+        // The value is a code block, which is copied verbatim
+        for(auto line=stream.readLine(); ; line=stream.readLine())
+        {
+            ++lineNumber;
+            if(line.isNull())
+                throw ParsingError{sweepFileName,lineNumber,"unterminated code block"};
+            const bool isMarker=line.contains(codeBlockMarker);
+            if(ovr.lines.size()==1 && !isMarker)
+                throw ParsingError{sweepFileName,lineNumber,"function body must start and end with triple backtick placed on a separate line."};
+            ovr.lines << line;
+            if(ovr.lines.size()>2 && isMarker)
+                break;
+        }
+    }
+    job.overrides.push_back(ovr);
+}
+
+}
+
+void loadSweep(QString const& sweepFileName, QString const& baseDescrFileName)
+{
+    baseOutputDir=atmo.textureOutputDir;
+
+    QFile file(sweepFileName);
+    if(!file.open(QFile::ReadOnly))
+    {
+        std::cerr << "Failed to open sweep file \"" << sweepFileName.toStdString() << "\": " << file.errorString().toStdString() << "\n";
+        throw MustQuit{};
+    }
+    QTextStream stream(&file);
+    const QRegularExpression jobHeader("^job \"([^\"/]+)\"$", QRegularExpression::CaseInsensitiveOption);
+    enum { BETWEEN_JOBS, JOB_HEADER_READ, IN_JOB } state=BETWEEN_JOBS;
+    int lineNumber=1;
+    for(auto line=stream.readLine(); !line.isNull(); line=stream.readLine(), ++lineNumber)
+    {
+        const auto code=line.split('#')[0].trimmed();
+        if(code.isEmpty())
+            continue;
+
+        switch(state)
+        {
+        case BETWEEN_JOBS:
+        {
+            const auto match=jobHeader.match(code.simplified());
+            if(!match.hasMatch())
+                throw ParsingError{sweepFileName,lineNumber,"expected job \"name\""};
+            const auto name=match.captured(1);
+            if(name=="." || name=="..")
+                throw ParsingError{sweepFileName,lineNumber,"job name must be usable as a directory name"};
+            for(const auto& job : jobs)
+                if(job.name==name)
+                    throw ParsingError{sweepFileName,lineNumber,QString("duplicate job \"%1\"").arg(name)};
+            jobs.push_back({name});
+            jobs.back().descrFileName=baseDescrFileName;
+            state=JOB_HEADER_READ;
+            break;
+        }
+        case JOB_HEADER_READ:
+            if(code!="{")
+                throw ParsingError{sweepFileName,lineNumber,"job description must begin with a '{'"};
+            state=IN_JOB;
+            break;
+        case IN_JOB:
+            if(code=="}")
+                state=BETWEEN_JOBS;
+            else
+                parseOverride(stream, code, sweepFileName, lineNumber, jobs.back());
+            break;
+        }
+    }
+    if(state!=BETWEEN_JOBS)
+        throw ParsingError{sweepFileName,lineNumber,"unterminated job description"};
+    if(jobs.empty())
+        throw ParsingError{sweepFileName,lineNumber,"sweep file contains no jobs"};
+
+    for(auto& job : jobs)
+    {
+        job.descriptionText=applyOverrides(atmo.descriptionFileText, job, sweepFileName);
+        const auto params=parseJobDescription(job, "line numbers are those of the base description with the overrides applied");
+        if(!sameTextureSizes(atmo, *params))
+        {
+            std::cerr << "Job \"" << job.name.toStdString() << "\" changes texture sizes, wavelengths or integration "
+                         "points that determine them. These must be the same for all the jobs of a sweep.\n";
+            throw MustQuit{};
+        }
+        job.stageKeys=allStageKeys(*params);
+    }
+    std::cerr << "Loaded " << jobs.size() << " sweep jobs\n";
+}
+
+void loadBatch(QStringList const& descrFileNames)
+{
+    baseOutputDir=atmo.textureOutputDir;
+    for(const auto& fileName : descrFileNames)
+    {
+        Job job;
+        job.name=QFileInfo(fileName).completeBaseName();
+        for(const auto& other : jobs)
+        {
+            if(other.name==job.name)
+            {
+                std::cerr << "Atmosphere descriptions \"" << other.descrFileName.toStdString() << "\" and \""
+                          << fileName.toStdString() << "\" would be saved to the same output directory\n";
+                throw MustQuit{};
+            }
+        }
+        job.descrFileName=fileName;
+        QFile file(fileName);
+        if(!file.open(QFile::ReadOnly))
+            throw DataLoadError{QString("Failed to open atmosphere description file: %1").arg(file.errorString())};
+        job.descriptionText=file.readAll();
+        job.stageKeys=allStageKeys(*parseJobDescription(job, "in file \""+fileName.toStdString()+"\""));
+        jobs.push_back(std::move(job));
+    }
+    std::cerr << "Loaded " << jobs.size() << " atmosphere descriptions for batch processing\n";
+    // OpenGL is initialized for the first job
+    setupSweepJob(0);
+}
+
+void loadBatchManifest(QString const& manifestFileName)
+{
+    QFile file(manifestFileName);
+    if(!file.open(QFile::ReadOnly))
+    {
+        std::cerr << "Failed to open batch manifest \"" << manifestFileName.toStdString() << "\": " << file.errorString().toStdString() << "\n";
+        throw MustQuit{};
+    }
+    const auto manifestDir=QFileInfo(manifestFileName).dir();
+    QStringList descrFileNames;
+    QTextStream stream(&file);
+    for(auto line=stream.readLine(); !line.isNull(); line=stream.readLine())
+    {
+        const auto fileName=line.split('#')[0].trimmed();
+        if(!fileName.isEmpty())
+            descrFileNames << manifestDir.filePath(fileName);
+    }
+    if(descrFileNames.isEmpty())
+    {
+        std::cerr << "Batch manifest \"" << manifestFileName.toStdString() << "\" lists no atmosphere descriptions\n";
+        throw MustQuit{};
+    }
+    loadBatch(descrFileNames);
+}
+
+unsigned sweepJobCount()
+{
+    return jobs.size();
+}
+
+QString sweepJobName(const unsigned jobIndex)
+{
+    return jobs[jobIndex].name;
+}
+
+void setupSweepJob(const unsigned jobIndex)
+{
+    currentJob=jobIndex;
+    // Results that no remaining job will reuse are only wasting memory now
+    for(auto it=sharedStageResults.begin(); it!=sharedStageResults.end();)
+    {
+        if(jobs[currentJob].stageKeys.count(it->first) || neededByLaterJobs(it->first))
+            ++it;
+        else
+            it=sharedStageResults.erase(it);
+    }
+
+    // The global parameters can't be assigned to, since scatterers and absorbers refer to their owner, so they are
+    // recreated in place
+    atmo.~AtmosphereParameters();
+    new(&atmo) AtmosphereParameters;
+    atmo.textureOutputDir=baseOutputDir+"/"+jobs[jobIndex].name.toStdString();
+    atmo.parseText(jobs[jobIndex].descriptionText, jobs[jobIndex].descrFileName,
+                   AtmosphereParameters::ForceNoEDSTextures{opts.dbgNoEDSTextures});
+}
+
+QString transmittanceStageKey(const unsigned texIndex)
+{
+    return transmittanceKey(atmo, texIndex);
+}
+
+QString directGroundIrradianceStageKey(const unsigned texIndex)
+{
+    return directGroundIrradianceKey(atmo, texIndex);
+}
+
+QString singleScatteringStageKey(const unsigned texIndex, AtmosphereParameters::Scatterer const& scatterer)
+{
+    return singleScatteringKey(atmo, texIndex, scatterer);
+}
+
+bool restoreSharedStageResult(std::string const& what, QString const& key, const GLenum target, std::vector<GLuint> const& textures)
+{
+    const auto it=sharedStageResults.find(key);
+    if(it==sharedStageResults.end())
+        return false;
+    const auto& result=it->second;
+    assert(result.target==target);
+
+    for(const auto texture : textures)
+    {
+        gl.glBindTexture(target, texture);
+        if(target==GL_TEXTURE_3D)
+            gl.glTexSubImage3D(target,0,0,0,0,result.size[0],result.size[1],result.size[2],GL_RGBA,GL_FLOAT,result.data.data());
+        else
+            gl.glTexSubImage2D(target,0,0,0,result.size[0],result.size[1],GL_RGBA,GL_FLOAT,result.data.data());
+    }
+    gl.glBindTexture(target, 0);
+
+    std::cerr << indentOutput() << "Reusing " << what << " computed for job \"" << result.jobName.toStdString() << "\"\n";
+    return true;
+}
+
+void keepSharedStageResult(QString const& key, const GLenum target, const GLuint texture, std::array<GLsizei,3> const& size)
+{
+    if(jobs.empty() || sharedStageResults.count(key) || !neededByLaterJobs(key))
+        return;
+    sharedStageResults[key]={target, size, readTexture(target, texture, size_t(size[0])*size[1]*size[2]),
+                             jobs[currentJob].name};
+}
@@ -0,0 +1,41 @@
+#ifndef INCLUDE_ONCE_87CF8F6F_65EF_4508_89AD_31058A946139
+#define INCLUDE_ONCE_87CF8F6F_65EF_4508_89AD_31058A946139
+
+#include <array>
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include <qopengl.h>
+#include "../common/AtmosphereParameters.hpp"
+
+// A sweep computes a family of models, each being the base atmosphere description with some entries overridden, in a
+// single process. The shader programs and the textures are reused between the jobs, and the results of the stages
+// that don't depend on the overridden entries are computed once and then copied to the later jobs.
+
+// Reads the list of jobs from the sweep file. The base description must have been parsed into atmo before this call.
+void loadSweep(QString const& sweepFileName, QString const& baseDescrFileName);
+// A batch of separate atmosphere descriptions is computed as a sweep whose jobs have no common base, and whose
+// textures may differ in size. Each job is named after the base name of its file. These functions leave atmo set up
+// for the first job.
+void loadBatch(QStringList const& descrFileNames);
+// The manifest lists the description files one per line, with paths relative to the manifest's directory
+void loadBatchManifest(QString const& manifestFileName);
+unsigned sweepJobCount();
+QString sweepJobName(unsigned jobIndex);
+// Replaces atmo with the description of the job and makes the output go to the job's subdirectory of the output
+// directory given on the command line. The textures must then be reallocated in case the sizes have changed.
+void setupSweepJob(unsigned jobIndex);
+
+// Keys of the shared stages consist of everything the results of the stage depend on. This is what makes up the
+// dependency graph of the stages: a key includes the keys of the stages whose results are inputs of this stage.
+QString transmittanceStageKey(unsigned texIndex);
+QString directGroundIrradianceStageKey(unsigned texIndex);
+QString singleScatteringStageKey(unsigned texIndex, AtmosphereParameters::Scatterer const& scatterer);
+
+// Fills the textures with the result kept for the key by an earlier job of the sweep. Returns false if there's no such
+// result, e.g. when no sweep is being computed.
+bool restoreSharedStageResult(std::string const& what, QString const& key, GLenum target, std::vector<GLuint> const& textures);
+// Keeps the contents of the texture of the given size for the later jobs of the sweep, if there are any
+void keepSharedStageResult(QString const& key, GLenum target, GLuint texture, std::array<GLsizei,3> const& size);
+
+#endif
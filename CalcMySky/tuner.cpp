@@ -0,0 +1,614 @@
+#include "tuner.hpp"
+
+#include <cmath>
+#include <memory>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <QRegularExpression>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QTextStream>
+#include <QFileInfo>
+#include <QFile>
+
+#include "data.hpp"
+#include "util.hpp"
+#include "glinit.hpp"
+#include "shaders.hpp"
+#include "profile-tables.hpp"
+#include "angular-integration.hpp"
+#include "../common/timing.hpp"
+#include "../common/error-statistics.hpp"
+
+namespace
+{
+
+// Each dimension of the 4D textures is probed at this fraction of its size, but not smaller than minProbeTextureSize
+constexpr int probeTextureSizeDivisor=4;
+constexpr int minProbeTextureSize=8;
+// The 4D textures are probed for the first wavelength set only. These are the shortest wavelengths, which scatter the
+// most, so the integrands there vary the fastest and multiple scattering matters the most.
+constexpr unsigned probedWavelengthSet=0;
+// Observed convergence orders are clamped to this, which is the order of the composite Gauss-Legendre rule
+constexpr double maxConvergenceOrder=8;
+// Texture sizes are tried from the ones in the description divided by this, up to the ones multiplied by this
+constexpr int textureSizeRange=8;
+
+// Results of a probe, one texture per item, e.g. per wavelength set or per scatterer
+using ProbeData=std::vector<std::vector<glm::vec4>>;
+
+struct PointsTuningResult
+{
+    int points;
+    double error;
+    bool targetReached;
+};
+
+struct TextureSizeTuningResult
+{
+    GLint width, height;
+    double error;
+    bool targetReached;
+};
+
+std::string formatSeconds(const double seconds)
+{
+    const std::chrono::steady_clock::time_point begin{};
+    return formatDeltaTime(begin, begin+std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                                    std::chrono::duration<double>(seconds)));
+}
+
+size_t scatteringTextureTexelCount()
+{
+    return size_t(atmo.scatTexWidth())*atmo.scatTexHeight()*atmo.scatTexDepth();
+}
+
+// 99th percentile of the relative differences of the tested data from the reference. The maximum would be dominated by
+// a few texels near the horizon, where the integrands are nearly discontinuous and practical numbers of points don't
+// converge.
+double relativeDifference(std::vector<glm::vec4> const& reference, std::vector<glm::vec4> const& tested)
+{
+    auto differences=relativeComponentErrors(reference, tested);
+    return computeErrorStatistics(differences).percentile99;
+}
+
+double relativeDifference(ProbeData const& reference, ProbeData const& tested)
+{
+    assert(reference.size()==tested.size());
+    double difference=0;
+    for(size_t i=0; i<reference.size(); ++i)
+        difference=std::max(difference, relativeDifference(reference[i], tested[i]));
+    return difference;
+}
+
+// Doubles the number of points starting from minPoints until the Richardson estimate of the error of the result
+// reaches the target. The order of convergence is estimated from the differences between three successive results,
+// so that the estimate works for any quadrature scheme, including the quasi-random angular one.
+PointsTuningResult findSufficientPoints(std::string const& what, const int minPoints, const int maxPoints,
+                                        std::function<ProbeData(int points)> const& compute)
+{
+    std::cerr << indentOutput() << "Probing " << what << ":\n";
+    OutputIndentIncrease incr;
+
+    auto previous=compute(minPoints);
+    double previousDifference=NAN;
+    double lastError=NAN; // NaN until the convergence is observed
+    for(int points=minPoints; 2*points<=maxPoints; points*=2)
+    {
+        auto current=compute(2*points);
+        const auto difference=relativeDifference(current, previous);
+        previous=std::move(current);
+        std::cerr << indentOutput() << points << " vs " << 2*points << " points: relative difference " << difference;
+        if(difference==0)
+        {
+            std::cerr << ", results are identical\n";
+            return {points, 0, true};
+        }
+        const auto order=std::log2(previousDifference/difference);
+        previousDifference=difference;
+        if(!(order>0))
+        {
+            // Either the first step, or the results are not converging yet
+            std::cerr << "\n";
+            continue;
+        }
+        // With the error proportional to h^p, where h is the spacing of the points, the error of the result computed
+        // with h is 2^p/(2^p-1) times its difference from the result computed with h/2
+        const auto errorGrowth=std::pow(2., std::min(order, maxConvergenceOrder));
+        const auto error=difference*errorGrowth/(errorGrowth-1);
+        lastError=error;
+        std::cerr << ", observed order of convergence " << order << ", estimated error " << error << "\n";
+        if(error<=opts.tuningTargetError)
+            return {points, error, true};
+    }
+    std::cerr << indentOutput() << "WARNING: target error not reached with " << maxPoints << " points\n";
+    // The last estimate is for fewer points than maxPoints, so it's an upper bound of the error with maxPoints
+    return {maxPoints, lastError, false};
+}
+
+// Bilinearly interpolates the coarse texture at the texel centers of the texture twice as large, the same way as
+// GL_LINEAR filtering with GL_CLAMP_TO_EDGE does
+std::vector<glm::vec4> interpolateToDoubleSize(std::vector<glm::vec4> const& coarse, const int width, const int height)
+{
+    std::vector<glm::vec4> fine;
+    fine.reserve(4*coarse.size());
+    for(int j=0; j<2*height; ++j)
+    {
+        const float y=std::clamp((j+0.5f)/2-0.5f, 0.f, height-1.f);
+        const int j0=int(y), j1=std::min(j0+1, height-1);
+        const float ty=y-j0;
+        for(int i=0; i<2*width; ++i)
+        {
+            const float x=std::clamp((i+0.5f)/2-0.5f, 0.f, width-1.f);
+            const int i0=int(x), i1=std::min(i0+1, width-1);
+            const float tx=x-i0;
+            const auto texel=[&](const int ii, const int jj) { return coarse[size_t(jj)*width+ii]; };
+            fine.push_back((1-ty)*((1-tx)*texel(i0,j0)+tx*texel(i1,j0)) +
+                              ty *((1-tx)*texel(i0,j1)+tx*texel(i1,j1)));
+        }
+    }
+    return fine;
+}
+
+// Finds the smallest texture size, doubling it from 1/textureSizeRange of the size in the description, that linear
+// interpolation between the texels reaches the target error with. The error is checked against a texture of twice the
+// size in each dimension, whose texels lie at quarters of the spacing of the tested one.
+TextureSizeTuningResult findSufficientTextureSize(std::string const& what, const GLint descrWidth, const GLint descrHeight,
+                                                  std::function<ProbeData(GLint width, GLint height)> const& compute)
+{
+    std::cerr << indentOutput() << "Probing " << what << ":\n";
+    OutputIndentIncrease incr;
+
+    GLint width=std::max(2, descrWidth/textureSizeRange), height=std::max(2, descrHeight/textureSizeRange);
+    auto coarse=compute(width, height);
+    double error=NAN;
+    for(; width<=descrWidth*textureSizeRange && height<=descrHeight*textureSizeRange; width*=2, height*=2)
+    {
+        auto fine=compute(2*width, 2*height);
+        ProbeData interpolated;
+        for(const auto& item : coarse)
+            interpolated.push_back(interpolateToDoubleSize(item, width, height));
+        // Interpolation error at quarters of texel spacing is 3/4 of that at the midpoints between texels
+        error=4./3*relativeDifference(fine, interpolated);
+        std::cerr << indentOutput() << width << "x" << height << ": estimated interpolation error " << error << "\n";
+        if(error<=opts.tuningTargetError)
+            return {width, height, error, true};
+        coarse=std::move(fine);
+    }
+    width/=2;
+    height/=2;
+    std::cerr << indentOutput() << "WARNING: target error not reached with size " << width << "x" << height << "\n";
+    return {width, height, error, false};
+}
+
+void setupWavelengthSet(const unsigned texIndex)
+{
+    initConstHeader(atmo.allWavelengths[texIndex]);
+    virtualSourceFiles[COMPUTE_TRANSMITTANCE_SHADER_FILENAME]=makeTransmittanceComputeFunctionsSrc(atmo.allWavelengths[texIndex]);
+    virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc();
+    virtualSourceFiles[TOTAL_SCATTERING_COEFFICIENT_SHADER_FILENAME]=makeTotalScatteringCoefSrc();
+    makeRadialQuadratureSrc(atmo.radialIntegrationPoints);
+}
+
+// Renders the program into all layers of the 3D texture attached to the current framebuffer, and returns the wall
+// time taken by the rendering
+double renderLayers(QOpenGLShaderProgram& program)
+{
+    const auto timeBegin=std::chrono::steady_clock::now();
+    for(GLsizei layer=0; layer<atmo.scatTexDepth(); ++layer)
+    {
+        program.setUniformValue("layer",layer);
+        renderQuad();
+    }
+    gl.glFinish();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-timeBegin).count();
+}
+
+double renderTransmittance()
+{
+    const auto program=compileShaderProgram("compute-transmittance.frag", "transmittance computation shader program");
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_TRANSMITTANCE]);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_TRANSMITTANCE],0);
+    checkFramebufferStatus("framebuffer for transmittance texture");
+
+    const auto timeBegin=std::chrono::steady_clock::now();
+    program->bind();
+    gl.glViewport(0, 0, atmo.transmittanceTexW, atmo.transmittanceTexH);
+    renderQuad();
+    gl.glFinish();
+    const auto timeEnd=std::chrono::steady_clock::now();
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
+    return std::chrono::duration<double>(timeEnd-timeBegin).count();
+}
+
+void renderDirectGroundIrradiance()
+{
+    const auto program=compileShaderProgram("compute-direct-irradiance.frag", "direct ground irradiance computation shader program");
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_IRRADIANCE]);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_DELTA_IRRADIANCE],0);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT1,textures[TEX_IRRADIANCE],0);
+    checkFramebufferStatus("framebuffer for irradiance texture");
+    setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1});
+
+    program->bind();
+    setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+    gl.glViewport(0, 0, atmo.irradianceTexW, atmo.irradianceTexH);
+    renderQuad();
+    gl.glFinish();
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
+}
+
+std::vector<glm::vec4> readTransmittance()
+{
+    return readTexture(GL_TEXTURE_2D, textures[TEX_TRANSMITTANCE], size_t(atmo.transmittanceTexW)*atmo.transmittanceTexH);
+}
+
+std::vector<glm::vec4> readDirectGroundIrradiance()
+{
+    return readTexture(GL_TEXTURE_2D, textures[TEX_DELTA_IRRADIANCE], size_t(atmo.irradianceTexW)*atmo.irradianceTexH);
+}
+
+GLuint make3DTexture()
+{
+    GLuint texture=0;
+    gl.glGenTextures(1, &texture);
+    gl.glBindTexture(GL_TEXTURE_3D,texture);
+    gl.glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    gl.glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    gl.glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_WRAP_R,GL_CLAMP_TO_EDGE);
+    setupTexture(texture, atmo.scatTexWidth(),atmo.scatTexHeight(),atmo.scatTexDepth());
+    return texture;
+}
+
+double computeSingleScattering(AtmosphereParameters::Scatterer const& scatterer, const GLuint targetTexture)
+{
+    virtualSourceFiles[DENSITIES_SHADER_FILENAME]=makeScattererDensityFunctionsSrc()+
+        "float scattererDensity(float alt) { return scattererNumberDensity_"+scatterer.name+"(alt); }\n"+
+        "vec4 scatteringCrossSection() { return "+
+            toString(scatterer.scatteringCrossSection(atmo.allWavelengths[probedWavelengthSet]))+"; }\n";
+    virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc()+
+        "vec4 currentPhaseFunction(float dotViewSun) { return phaseFunction_"+scatterer.name+"(dotViewSun); }\n";
+    const auto program=compileShaderProgram("compute-single-scattering.frag",
+                                            "single scattering computation shader program",
+                                            UseGeomShader{});
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_DELTA_SCATTERING]);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,targetTexture,0);
+    checkFramebufferStatus("framebuffer for single scattering");
+    gl.glViewport(0, 0, atmo.scatTexWidth(), atmo.scatTexHeight());
+
+    program->bind();
+    setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+    const auto seconds=renderLayers(*program);
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
+    return seconds;
+}
+
+std::unique_ptr<QOpenGLShaderProgram> compileScatteringDensityProgram(const unsigned scatteringOrder, const bool fromGroundOnly)
+{
+    virtualSourceFiles[COMPUTE_SCATTERING_DENSITY_FILENAME]=getShaderSrc(COMPUTE_SCATTERING_DENSITY_FILENAME,IgnoreCache{})
+                          .replace(QRegularExpression("\\bRADIATION_IS_FROM_GROUND_ONLY\\b"), fromGroundOnly ? "true" : "false")
+                          .replace(QRegularExpression("\\bSCATTERING_ORDER\\b"), QString::number(scatteringOrder));
+    return compileShaderProgram(COMPUTE_SCATTERING_DENSITY_FILENAME, "scattering density computation shader program",
+                                UseGeomShader{});
+}
+
+// Same as in the main computation: radiation from the ground, then the blended contributions of single scattering by
+// each scatterer
+double computeScatteringDensityOrder2(std::vector<GLuint> const& singleScatteringTextures)
+{
+    virtualSourceFiles[DENSITIES_SHADER_FILENAME]=makeScattererDensityFunctionsSrc();
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_MULTIPLE_SCATTERING]);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_DELTA_SCATTERING_DENSITY],0);
+    checkFramebufferStatus("framebuffer for scattering density");
+    gl.glViewport(0, 0, atmo.scatTexWidth(), atmo.scatTexHeight());
+
+    virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc()+
+        "vec4 currentPhaseFunction(float dotViewSun) { return vec4(3.4028235e38); }\n";
+    auto program=compileScatteringDensityProgram(2, true);
+    program->bind();
+    setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE   ,0,"transmittanceTexture");
+    setUniformTexture(*program,GL_TEXTURE_2D,TEX_DELTA_IRRADIANCE,1,"irradianceTexture");
+    double seconds=renderLayers(*program);
+
+    gl.glBlendFunc(GL_ONE, GL_ONE);
+    gl.glEnable(GL_BLEND);
+    for(unsigned scattererIndex=0; scattererIndex<atmo.scatterers.size(); ++scattererIndex)
+    {
+        virtualSourceFiles[PHASE_FUNCTIONS_SHADER_FILENAME]=makePhaseFunctionsSrc()+
+            "vec4 currentPhaseFunction(float dotViewSun) { return phaseFunction_"+atmo.scatterers[scattererIndex].name+"(dotViewSun); }\n";
+        program=compileScatteringDensityProgram(2, false);
+        program->bind();
+        setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+        setUniformTexture(*program,GL_TEXTURE_3D,singleScatteringTextures[scattererIndex],2,"firstScatteringTexture");
+        seconds+=renderLayers(*program);
+    }
+    gl.glDisable(GL_BLEND);
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
+    return seconds;
+}
+
+// Scattering density of orders 3 and higher from the delta scattering texture
+double computeScatteringDensity()
+{
+    virtualSourceFiles[DENSITIES_SHADER_FILENAME]=makeScattererDensityFunctionsSrc();
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_MULTIPLE_SCATTERING]);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_DELTA_SCATTERING_DENSITY],0);
+    checkFramebufferStatus("framebuffer for scattering density");
+    gl.glViewport(0, 0, atmo.scatTexWidth(), atmo.scatTexHeight());
+
+    const auto program=compileScatteringDensityProgram(3, false);
+    program->bind();
+    setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE   ,0,"transmittanceTexture");
+    setUniformTexture(*program,GL_TEXTURE_2D,TEX_DELTA_IRRADIANCE,1,"irradianceTexture");
+    setUniformTexture(*program,GL_TEXTURE_3D,TEX_DELTA_SCATTERING,2,"multipleScatteringTexture");
+    const auto seconds=renderLayers(*program);
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
+    return seconds;
+}
+
+double computeMultipleScatteringFromDensity()
+{
+    virtualSourceFiles[DENSITIES_SHADER_FILENAME]=makeScattererDensityFunctionsSrc();
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,fbos[FBO_MULTIPLE_SCATTERING]);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures[TEX_DELTA_SCATTERING],0);
+    checkFramebufferStatus("framebuffer for delta multiple scattering");
+    gl.glViewport(0, 0, atmo.scatTexWidth(), atmo.scatTexHeight());
+
+    const auto program=compileShaderProgram("compute-multiple-scattering.frag",
+                                            "multiple scattering computation shader program",
+                                            UseGeomShader{});
+    program->bind();
+    setUniformTexture(*program,GL_TEXTURE_2D,TEX_TRANSMITTANCE,0,"transmittanceTexture");
+    setUniformTexture(*program,GL_TEXTURE_3D,TEX_DELTA_SCATTERING_DENSITY,1,"scatteringDensityTexture");
+    const auto seconds=renderLayers(*program);
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,0);
+    return seconds;
+}
+
+// Copies the original description, replacing the values of the given keys, and appending the keys that were absent
+void writeTunedDescription(std::vector<std::pair<QString, int>> const& values)
+{
+    QString output;
+    std::vector<bool> written(values.size());
+    QString text=atmo.descriptionFileText;
+    QTextStream stream(&text, QIODevice::ReadOnly);
+    for(auto line=stream.readLine(); !line.isNull(); line=stream.readLine())
+    {
+        const auto keyValue=line.split('#')[0].split(':');
+        if(keyValue.size()==2)
+        {
+            const auto key=keyValue[0].simplified().toLower();
+            const auto it=std::find_if(values.begin(), values.end(), [&key](const auto& kv) { return kv.first==key; });
+            if(it!=values.end())
+            {
+                output += QString("%1: %2 # tuned, was %3\n").arg(keyValue[0].trimmed()).arg(it->second).arg(keyValue[1].trimmed());
+                written[it-values.begin()]=true;
+                continue;
+            }
+        }
+        output += line+"\n";
+    }
+    if(std::find(written.begin(), written.end(), false)!=written.end())
+    {
+        output += QString("\n# Tuned for relative error %1\n").arg(opts.tuningTargetError);
+        for(size_t i=0; i<values.size(); ++i)
+        {
+            if(!written[i])
+                output += QString("%1: %2\n").arg(values[i].first).arg(values[i].second);
+        }
+    }
+
+    std::cerr << "Writing tuned atmosphere description to \"" << opts.tunedAtmoPath << "\"...";
+    createDirs(QFileInfo(opts.tunedAtmoPath.c_str()).absolutePath().toStdString());
+    QFile file(opts.tunedAtmoPath.c_str());
+    if(!file.open(QFile::WriteOnly))
+    {
+        std::cerr << " FAILED to open: " << file.errorString() << "\n";
+        throw MustQuit{};
+    }
+    file.write(output.toUtf8());
+    file.close();
+    if(file.error())
+    {
+        std::cerr << " FAILED to write: " << file.errorString() << "\n";
+        throw MustQuit{};
+    }
+    std::cerr << " done\n";
+}
+
+void reportResult(std::string const& what, const int value, const double error, const bool targetReached)
+{
+    std::cerr << indentOutput() << what << ": " << value << " (";
+    if(std::isnan(error))
+        std::cerr << "error not estimated: no convergence observed";
+    else
+        std::cerr << "estimated error " << error;
+    std::cerr << (targetReached ? "" : ", target NOT reached") << ")\n";
+}
+
+}
+
+void tuneIntegrationParameters()
+{
+    const auto fullScatteringTextureSize=atmo.scatteringTextureSize;
+    const auto fullScatteringTexelCount=scatteringTextureTexelCount();
+    for(int i=0; i<4; ++i)
+    {
+        auto& size=atmo.scatteringTextureSize[i];
+        size=std::min(size, std::max(minProbeTextureSize, size/probeTextureSizeDivisor));
+    }
+    atmo.scatteringTextureSize[0] += atmo.scatteringTextureSize[0]%2; // shaders rely on this being even
+    const double texelCountRatio=double(fullScatteringTexelCount)/scatteringTextureTexelCount();
+
+    [[maybe_unused]] const auto glCtxAndSfc = initOpenGL();
+
+    const auto timeBegin=std::chrono::steady_clock::now();
+    std::cerr << "Tuning integration parameters for relative error " << opts.tuningTargetError << ":\n";
+    OutputIndentIncrease incr;
+
+    // The 2D textures are cheap, so they are probed at full size for all wavelength sets
+    const auto computeTransmittance=[]
+    {
+        ProbeData data;
+        for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
+        {
+            setupWavelengthSet(texIndex);
+            renderTransmittance();
+            data.push_back(readTransmittance());
+        }
+        return data;
+    };
+    const auto transmittancePoints=findSufficientPoints("transmittance integration points", 16, 8192,
+                                                        [&computeTransmittance](const int points)
+    {
+        atmo.numTransmittanceIntegrationPoints=points;
+        return computeTransmittance();
+    });
+    atmo.numTransmittanceIntegrationPoints=transmittancePoints.points;
+
+    const auto transmittanceSize=findSufficientTextureSize("transmittance texture size", atmo.transmittanceTexW, atmo.transmittanceTexH,
+                                                           [&computeTransmittance](const GLint width, const GLint height)
+    {
+        atmo.transmittanceTexW=width;
+        atmo.transmittanceTexH=height;
+        setupTexture(TEX_TRANSMITTANCE, width, height);
+        return computeTransmittance();
+    });
+    atmo.transmittanceTexW=transmittanceSize.width;
+    atmo.transmittanceTexH=transmittanceSize.height;
+    setupTexture(TEX_TRANSMITTANCE, atmo.transmittanceTexW, atmo.transmittanceTexH);
+
+    const auto irradianceSize=findSufficientTextureSize("irradiance texture size", atmo.irradianceTexW, atmo.irradianceTexH,
+                                                        [](const GLint width, const GLint height)
+    {
+        atmo.irradianceTexW=width;
+        atmo.irradianceTexH=height;
+        setupTexture(TEX_DELTA_IRRADIANCE, width, height);
+        setupTexture(TEX_IRRADIANCE, width, height);
+        ProbeData data;
+        for(unsigned texIndex=0; texIndex<atmo.allWavelengths.size(); ++texIndex)
+        {
+            setupWavelengthSet(texIndex);
+            renderTransmittance();
+            renderDirectGroundIrradiance();
+            data.push_back(readDirectGroundIrradiance());
+        }
+        return data;
+    });
+    atmo.irradianceTexW=irradianceSize.width;
+    atmo.irradianceTexH=irradianceSize.height;
+    setupTexture(TEX_DELTA_IRRADIANCE, atmo.irradianceTexW, atmo.irradianceTexH);
+    setupTexture(TEX_IRRADIANCE, atmo.irradianceTexW, atmo.irradianceTexH);
+
+    // The rest is probed for a single wavelength set with the reduced 4D textures
+    setupWavelengthSet(probedWavelengthSet);
+    const auto transmittanceSeconds=renderTransmittance();
+    renderDirectGroundIrradiance();
+    tabulateProfiles();
+    if(atmo.angularIntegrationScheme==AngularIntegrationScheme::Importance)
+        tabulateScatteringPhaseShape();
+
+    std::vector<GLuint> singleScatteringTextures;
+    for(unsigned i=0; i<atmo.scatterers.size(); ++i)
+        singleScatteringTextures.push_back(make3DTexture());
+    const auto computeAllSingleScattering=[&singleScatteringTextures]
+    {
+        double seconds=0;
+        for(unsigned i=0; i<atmo.scatterers.size(); ++i)
+            seconds+=computeSingleScattering(atmo.scatterers[i], singleScatteringTextures[i]);
+        return seconds;
+    };
+
+    const auto radialPoints=findSufficientPoints("radial integration points (single scattering)", 8, 2048,
+                                                 [&](const int points)
+    {
+        makeRadialQuadratureSrc(points);
+        computeAllSingleScattering();
+        ProbeData data;
+        for(const auto texture : singleScatteringTextures)
+            data.push_back(readTexture(GL_TEXTURE_3D, texture, scatteringTextureTexelCount()));
+        return data;
+    });
+    atmo.radialIntegrationPoints=radialPoints.points;
+    makeRadialQuadratureSrc(atmo.radialIntegrationPoints);
+    const auto singleScatteringSeconds=computeAllSingleScattering();
+
+    PointsTuningResult angularPoints{atmo.angularIntegrationPoints, 0, true};
+    double scatteringDensity2Seconds=0, scatteringDensitySeconds=0, multipleScatteringSeconds=0;
+    if(atmo.scatteringOrdersToCompute>=2)
+    {
+        angularPoints=findSufficientPoints("angular integration points (order 2 scattering density)", 16, 4096,
+                                           [&singleScatteringTextures](const int points)
+        {
+            makeScatteringDensityIntegrationSrc(atmo.angularIntegrationScheme, points);
+            computeScatteringDensityOrder2(singleScatteringTextures);
+            return ProbeData{readTexture(GL_TEXTURE_3D, textures[TEX_DELTA_SCATTERING_DENSITY], scatteringTextureTexelCount())};
+        });
+        atmo.angularIntegrationPoints=angularPoints.points;
+        makeScatteringDensityIntegrationSrc(atmo.angularIntegrationScheme, atmo.angularIntegrationPoints);
+        // Timed runs of the remaining stages with the recommended parameters
+        scatteringDensity2Seconds=computeScatteringDensityOrder2(singleScatteringTextures);
+        multipleScatteringSeconds=computeMultipleScatteringFromDensity();
+        if(atmo.scatteringOrdersToCompute>=3)
+            scatteringDensitySeconds=computeScatteringDensity();
+    }
+    gl.glDeleteTextures(GLsizei(singleScatteringTextures.size()), singleScatteringTextures.data());
+    atmo.scatteringTextureSize=fullScatteringTextureSize;
+
+    std::cerr << indentOutput() << "Recommended parameters:\n";
+    {
+        OutputIndentIncrease incr;
+        reportResult("transmittance integration points", transmittancePoints.points, transmittancePoints.error, transmittancePoints.targetReached);
+        reportResult("transmittance texture size for vza", transmittanceSize.width, transmittanceSize.error, transmittanceSize.targetReached);
+        reportResult("transmittance texture size for altitude", transmittanceSize.height, transmittanceSize.error, transmittanceSize.targetReached);
+        reportResult("irradiance texture size for sza", irradianceSize.width, irradianceSize.error, irradianceSize.targetReached);
+        reportResult("irradiance texture size for altitude", irradianceSize.height, irradianceSize.error, irradianceSize.targetReached);
+        reportResult("radial integration points", radialPoints.points, radialPoints.error, radialPoints.targetReached);
+        reportResult("angular integration points", angularPoints.points, angularPoints.error, angularPoints.targetReached);
+    }
+
+    // The probes of the 4D textures are extrapolated to full size assuming the time is proportional to the number of texels
+    const auto orders=atmo.scatteringOrdersToCompute;
+    const auto wavelengthSetCount=atmo.allWavelengths.size();
+    const auto singleScatteringTime=texelCountRatio*singleScatteringSeconds;
+    const auto scatteringDensityTime=texelCountRatio*(scatteringDensity2Seconds + (orders>2 ? (orders-2)*scatteringDensitySeconds : 0));
+    const auto multipleScatteringTime=texelCountRatio*(orders>1 ? (orders-1)*multipleScatteringSeconds : 0);
+    const auto totalTime=wavelengthSetCount*(transmittanceSeconds+singleScatteringTime+scatteringDensityTime+multipleScatteringTime);
+    std::cerr << indentOutput() << "Predicted computation time: " << formatSeconds(totalTime) << " for " << wavelengthSetCount
+              << " wavelength sets, per set:\n";
+    {
+        OutputIndentIncrease incr;
+        std::cerr << indentOutput() << "transmittance: " << formatSeconds(transmittanceSeconds) << "\n";
+        std::cerr << indentOutput() << "single scattering: " << formatSeconds(singleScatteringTime) << "\n";
+        std::cerr << indentOutput() << "scattering density: " << formatSeconds(scatteringDensityTime) << "\n";
+        std::cerr << indentOutput() << "multiple scattering: " << formatSeconds(multipleScatteringTime) << "\n";
+        std::cerr << indentOutput() << "(light pollution, eclipsed double scattering and saving of the textures are not included)\n";
+    }
+
+    writeTunedDescription({
+                           {"transmittance integration points", transmittancePoints.points},
+                           {"transmittance texture size for vza", transmittanceSize.width},
+                           {"transmittance texture size for altitude", transmittanceSize.height},
+                           {"irradiance texture size for sza", irradianceSize.width},
+                           {"irradiance texture size for altitude", irradianceSize.height},
+                           {"radial integration points", radialPoints.points},
+                           {"angular integration points", angularPoints.points},
+                          });
+
+    std::cerr << "Tuning finished in " << formatDeltaTime(timeBegin, std::chrono::steady_clock::now()) << "\n";
+}
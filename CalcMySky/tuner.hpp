@@ -0,0 +1,10 @@
+#ifndef INCLUDE_ONCE_C846CDA6_D62B_4D83_8722_CE588C77D817
+#define INCLUDE_ONCE_C846CDA6_D62B_4D83_8722_CE588C77D817
+
+// Looks for the smallest numbers of integration points and transmittance and irradiance texture sizes that reach the
+// relative error given in opts.tuningTargetError, and writes an atmosphere description with these values to
+// opts.tunedAtmoPath, printing the predicted computation time. The 4D textures are probed at reduced resolution, so
+// this function initializes OpenGL itself instead of letting the full-size textures be allocated.
+void tuneIntegrationParameters();
+
+#endif
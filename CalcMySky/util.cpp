@@ -2,11 +2,16 @@
 
 #include <memory>
 #include <cstring>
+#include <sstream>
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
 #include <QFile>
 
 #include "data.hpp"
+#include "stage-timing.hpp"
+#include "event-stream.hpp"
+#include "../common/kernels.hpp"
 
 void createDirs(std::string const& path)
 {
@@ -56,16 +61,26 @@ void qtMessageHandler(const QtMsgType type, QMessageLogContext const&, QString c
     }
 }
 
-std::vector<glm::vec4> saveTexture(const GLenum target, const GLuint texture, const std::string_view name,
-                                   const std::string_view path, std::vector<int> const& sizes,
-                                   const ReturnTextureData returnTexData)
+std::vector<glm::vec4> readTexture(const GLenum target, const GLuint texture, const size_t texelCount)
+{
+    std::vector<glm::vec4> data(texelCount);
+    gl.glBindTexture(target,texture);
+    gl.glGetTexImage(target,0,GL_RGBA,GL_FLOAT,data.data());
+    gl.glBindTexture(target,0);
+    return data;
+}
+
+void saveTexture(const GLenum target, const GLuint texture, const std::string_view name,
+                 const std::string_view path, std::vector<int> const& sizes,
+                 TextureSliceConsumer const& consumeSlice)
 {
     if(opts.dbgNoSaveTextures)
     {
         std::cerr << indentOutput() << "Would save " << name << ", but only shaders are to be saved.\n";
-        return {};
+        return;
     }
 
+    const StageTimer timer("saving");
     std::cerr << indentOutput() << "Saving " << name << " to \"" << path << "\"... ";
     if(const auto err=gl.glGetError(); err!=GL_NO_ERROR)
     {
@@ -103,44 +118,88 @@ std::vector<glm::vec4> saveTexture(const GLenum target, const GLuint texture, co
         }
     }
 
-    const auto subpixelCount = 4*pixelCount;
-    const std::unique_ptr<GLfloat[]> subpixels(new GLfloat[subpixelCount]);
-    gl.glGetTexImage(target, 0, GL_RGBA, GL_FLOAT, subpixels.get());
-    if(const auto err=gl.glGetError(); err!=GL_NO_ERROR)
+    QFile out(QByteArray::fromRawData(path.data(), path.size()));
+    if(!out.open(QFile::WriteOnly))
     {
-        std::cerr << "GL error in saveTexture() after glGetTexImage() call: " << openglErrorString(err) << "\n";
+        std::cerr << "failed to open file: " << out.errorString().toStdString() << "\n";
         throw MustQuit{};
     }
+    for(const uint16_t s : sizes)
+        out.write(reinterpret_cast<const char*>(&s), sizeof s);
 
-    unsigned nanCount = 0;
-    for(size_t i = 0; i < subpixelCount; ++i)
-    {
-        if(std::isnan(subpixels[i]))
-        {
-            ++nanCount;
-        }
-    }
-    std::vector<glm::vec4> dataToReturn;
-    if(returnTexData)
+    const bool needRounding = target==GL_TEXTURE_3D && opts.textureSavePrecision;
+    if(needRounding)
+        std::cerr << "mask: 0x" << std::hex << texDataRoundingMask(opts.textureSavePrecision) << std::dec << " ... ";
+
+    // 3D textures are read back one layer at a time, so that the whole texture never has
+    // to reside in host memory. Other textures are small enough to be read in one go.
+    const GLsizei sliceCount = d;
+    GLint origReadFBO=0;
+    if(target==GL_TEXTURE_3D)
     {
-        static_assert(std::is_trivially_copyable_v<glm::vec4>);
-        dataToReturn.assign(reinterpret_cast<const glm::vec4*>(subpixels.get()),
-                            reinterpret_cast<const glm::vec4*>(subpixels.get()+subpixelCount));
+        gl.glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &origReadFBO);
+        gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[FBO_FOR_TEXTURE_SAVING]);
+        gl.glReadBuffer(GL_COLOR_ATTACHMENT0);
     }
-    if(target==GL_TEXTURE_3D && opts.textureSavePrecision)
+
+    const auto subpixelCount = 4*size_t(w)*h*d;
+    const auto subpixelCountPerSlice = 4*size_t(w)*h;
+    const std::unique_ptr<GLfloat[]> subpixels(new GLfloat[subpixelCountPerSlice]);
+    size_t nanCount = 0;
+    for(GLsizei slice=0; slice<sliceCount; ++slice)
     {
-        roundTexData(subpixels.get(), subpixelCount, opts.textureSavePrecision);
+        std::ostringstream ss;
+        if(sliceCount>1)
+        {
+            ss << slice << " of " << sliceCount << " layers saved ";
+            std::cerr << ss.str();
+        }
+
+        if(target==GL_TEXTURE_3D)
+        {
+            gl.glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, slice);
+            if(const auto status=gl.glCheckFramebufferStatus(GL_READ_FRAMEBUFFER); status!=GL_FRAMEBUFFER_COMPLETE)
+            {
+                std::cerr << "framebuffer for texture saving is incomplete, status: 0x" << std::hex << status << std::dec << "\n";
+                throw MustQuit{};
+            }
+            gl.glReadPixels(0, 0, w, h, GL_RGBA, GL_FLOAT, subpixels.get());
+        }
+        else
+        {
+            gl.glGetTexImage(target, 0, GL_RGBA, GL_FLOAT, subpixels.get());
+        }
+        if(const auto err=gl.glGetError(); err!=GL_NO_ERROR)
+        {
+            std::cerr << "GL error in saveTexture() after reading back texture data: " << openglErrorString(err) << "\n";
+            throw MustQuit{};
+        }
+
+        nanCount += countNaNs(subpixels.get(), subpixelCountPerSlice);
+        // Once NaNs have appeared, the texture is saved only for diagnostics, so there's no point in further processing
+        if(consumeSlice && !nanCount)
+        {
+            static_assert(sizeof(glm::vec4) == 4*sizeof(GLfloat));
+            consumeSlice(reinterpret_cast<const glm::vec4*>(subpixels.get()), slice);
+        }
+        if(needRounding)
+            roundTexData(subpixels.get(), subpixelCountPerSlice, opts.textureSavePrecision);
+        out.write(reinterpret_cast<const char*>(subpixels.get()), subpixelCountPerSlice*sizeof subpixels[0]);
+        if(sliceCount>1)
+            reportProgress("Saving "+std::string(name), slice+1, sliceCount);
+
+        // Clear previous status and reset cursor position
+        const auto statusWidth=ss.tellp();
+        std::cerr << std::string(statusWidth, '\b') << std::string(statusWidth, ' ')
+                  << std::string(statusWidth, '\b');
     }
 
-    QFile out(QByteArray::fromRawData(path.data(), path.size()));
-    if(!out.open(QFile::WriteOnly))
+    if(target==GL_TEXTURE_3D)
     {
-        std::cerr << "failed to open file: " << out.errorString().toStdString() << "\n";
-        throw MustQuit{};
+        gl.glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+        gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, origReadFBO);
     }
-    for(const uint16_t s : sizes)
-        out.write(reinterpret_cast<const char*>(&s), sizeof s);
-    out.write(reinterpret_cast<const char*>(subpixels.get()), subpixelCount*sizeof subpixels[0]);
+
     out.close();
     if(out.error())
     {
@@ -154,8 +213,7 @@ std::vector<glm::vec4> saveTexture(const GLenum target, const GLuint texture, co
         throw MustQuit{};
     }
     std::cerr << "done\n";
-
-    return dataToReturn;
+    reportFileWritten(std::string(path));
 }
 
 void setupTexture(TextureId id, const GLsizei width, const GLsizei height)
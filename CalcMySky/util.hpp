@@ -3,6 +3,7 @@
 
 #include <string>
 #include <iostream>
+#include <functional>
 #include <string_view>
 #include <QVector4D>
 #include <QOpenGLFunctions_3_3_Core>
@@ -52,9 +53,12 @@ inline void setDrawBuffers(std::vector<GLenum> const& bufs)
 void renderQuad();
 inline void checkFramebufferStatus(const char*const fboDescription) { return checkFramebufferStatus(gl, fboDescription); }
 void qtMessageHandler(const QtMsgType type, QMessageLogContext const&, QString const& message);
-DEFINE_EXPLICIT_BOOL(ReturnTextureData);
-std::vector<glm::vec4> saveTexture(GLenum target, GLuint texture, std::string_view name, std::string_view path,
-                                   std::vector<int> const& sizes, ReturnTextureData=ReturnTextureData{false});
+// Receives unrounded texture data one slice at a time: a single depth layer for 3D textures, the whole texture otherwise.
+using TextureSliceConsumer = std::function<void(glm::vec4 const* sliceData, int sliceIndex)>;
+void saveTexture(GLenum target, GLuint texture, std::string_view name, std::string_view path,
+                 std::vector<int> const& sizes, TextureSliceConsumer const& consumeSlice={});
+// Reads the whole texture, which must be texelCount texels in size, to the CPU
+std::vector<glm::vec4> readTexture(GLenum target, GLuint texture, size_t texelCount);
 void createDirs(std::string const& path);
 
 class OutputIndentIncrease
@@ -4,6 +4,7 @@
 #include <cmath>
 #include <array>
 #include <vector>
+#include <algorithm>
 #include <cstring>
 #include <cassert>
 #include <iterator>
@@ -11,11 +12,15 @@
 #include <filesystem>
 #include <QFile>
 #include <QDebug>
+#include <QFileInfo>
+#include <QVector2D>
+#include <QCryptographicHash>
 #include <QRegularExpression>
 
 #include "util.hpp"
 #include "../common/const.hpp"
 #include "../common/util.hpp"
+#include "../common/kernels.hpp"
 #include "../common/EclipsedDoubleScatteringPrecomputer.hpp"
 #include "api/ShowMySky/Settings.hpp"
 
@@ -59,6 +64,54 @@ public:
     }
 };
 
+// Identifies view direction shaders, so that programs are only shared by renderers that use the same ones
+QString viewDirShadersKey(QByteArray const& vertShaderSrc, QByteArray const& fragShaderSrc,
+                          std::vector<std::pair<std::string,GLuint>> const& bindAttribLocations)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(vertShaderSrc);
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(fragShaderSrc);
+    for(const auto& [name, location] : bindAttribLocations)
+    {
+        hash.addData(QByteArray(1, '\0'));
+        hash.addData(QByteArray::fromStdString(name));
+        hash.addData(QByteArray::number(location));
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+// Draws each triangle of the surface into all the view layers. The vertex shader's position output is renamed to
+// viewDirVertexPosition, so that this shader can output position for the fragment shader.
+QByteArray viewLayersGeomShaderSrc(const unsigned layerCount)
+{
+    return QString(1+R"(
+#version 330
+layout(triangles) in;
+layout(triangle_strip, max_vertices=%1) out;
+
+in vec3 viewDirVertexPosition[];
+out vec3 position;
+flat out int viewLayer;
+
+void main()
+{
+    for(int layer=0; layer<%2; ++layer)
+    {
+        for(int i=0; i<3; ++i)
+        {
+            gl_Layer=layer;
+            viewLayer=layer;
+            position=viewDirVertexPosition[i];
+            gl_Position=gl_in[i].gl_Position;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
+)").arg(3*layerCount).arg(layerCount).toLatin1();
+}
+
 #ifndef NDEBUG
 # define OGL_TRACE() [[maybe_unused]] OGLTrace t(Q_FUNC_INFO);
 #else
@@ -164,7 +217,10 @@ void AtmosphereRenderer::loadEclipsedDoubleScatteringTexture(QString const& path
     log << "done";
 }
 
-void AtmosphereRenderer::loadTexture4D(QString const& path, const float altitudeCoord, Texture4DType texType)
+// If stackIndex is nonnegative, the slice is loaded as the stackIndex-th of the wavelength-set slabs stacked along depth
+// of the currently bound 3D texture; the texture is allocated for all the slabs when the first one is loaded.
+void AtmosphereRenderer::loadTexture4D(QString const& path, const float altitudeCoord, Texture4DType texType,
+                                       const int stackIndex)
 {
     auto log=qDebug().nospace();
 
@@ -208,8 +264,6 @@ void AtmosphereRenderer::loadTexture4D(QString const& path, const float altitude
     sizes[3]=2;
     const qint64 sizeToRead = pixelSize*uint64_t(sizes[0])*sizes[1]*sizes[2]*sizes[3];
 
-    const std::unique_ptr<char[]> data(new char[sizeToRead]);
-
     const qint64 absoluteOffset=file.pos()+readOffset;
     log << "skipping to offset " << absoluteOffset << "... ";
     if(!file.seek(absoluteOffset))
@@ -217,51 +271,68 @@ void AtmosphereRenderer::loadTexture4D(QString const& path, const float altitude
         throw DataLoadError{QObject::tr("Failed to seek to offset %1 in file \"%2\": %3")
                             .arg(absoluteOffset).arg(path).arg(file.errorString())};
     }
-    const auto actuallyRead=file.read(data.get(), sizeToRead);
-    if(actuallyRead != sizeToRead)
+    // The data are read into a buffer of the type of the texels, so that they can be accessed without breaking strict aliasing
+    const auto readData=[&](void*const buffer)
     {
-        const auto error = actuallyRead==-1 ? QObject::tr("Failed to read texture data from file \"%1\": %2").arg(path).arg(file.errorString())
-                                            : QObject::tr("Failed to read texture data from file \"%1\": requested %2 bytes, read %3").arg(path).arg(sizeToRead).arg(actuallyRead);
-        throw DataLoadError{error};
-    }
+        const auto actuallyRead=file.read(static_cast<char*>(buffer), sizeToRead);
+        if(actuallyRead != sizeToRead)
+        {
+            const auto error = actuallyRead==-1 ? QObject::tr("Failed to read texture data from file \"%1\": %2").arg(path).arg(file.errorString())
+                                                : QObject::tr("Failed to read texture data from file \"%1\": requested %2 bytes, read %3").arg(path).arg(sizeToRead).arg(actuallyRead);
+            throw DataLoadError{error};
+        }
+    };
+
+    const auto upload=[&](const GLenum internalFormat, const GLenum format, const GLenum type, const void*const pixels)
+    {
+        if(stackIndex<0)
+        {
+            gl.glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, sizes[0], sizes[1], sizes[2], 0, format, type, pixels);
+            return;
+        }
+        if(stackIndex==0)
+        {
+            gl.glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, sizes[0], sizes[1], sizes[2]*params_.allWavelengths.size(),
+                            0, format, type, nullptr);
+        }
+        gl.glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, stackIndex*sizes[2], sizes[0], sizes[1], sizes[2], format, type, pixels);
+    };
 
     const auto altSliceSize = size_t(sizes[0])*sizes[1]*sizes[2];
     if(texType == Texture4DType::InterpolationGuides)
     {
+        assert(sizeof(int16_t) == pixelSize);
+        const std::unique_ptr<int16_t[]> data(new int16_t[2*altSliceSize]);
+        readData(data.get());
         std::unique_ptr<int16_t[]> texData(new int16_t[altSliceSize]);
         for(size_t n = 0; n < altSliceSize; ++n)
         {
-            int16_t lower, upper;
-            assert(sizeof lower == pixelSize);
-            std::memcpy(&lower, data.get() + n * pixelSize, pixelSize);
-            std::memcpy(&upper, data.get() + (n+altSliceSize) * pixelSize, pixelSize);
+            const auto lower = data[n], upper = data[n+altSliceSize];
             texData[n] = lower + fractAltIndex*(upper-lower);
         }
-        gl.glTexImage3D(GL_TEXTURE_3D, 0, GL_R16_SNORM, sizes[0], sizes[1], sizes[2], 0, GL_RED, GL_SHORT, texData.get());
+        upload(GL_R16_SNORM, GL_RED, GL_SHORT, texData.get());
     }
     else
     {
+        assert(sizeof(glm::vec4) == pixelSize);
+        const std::unique_ptr<glm::vec4[]> data(new glm::vec4[2*altSliceSize]);
+        readData(data.get());
         std::unique_ptr<glm::vec4[]> texData(new glm::vec4[altSliceSize]);
-        for(size_t n = 0; n < altSliceSize; ++n)
-        {
-            glm::vec4 lower, upper;
-            assert(sizeof lower == pixelSize);
-            std::memcpy(&lower, data.get() + n * pixelSize, pixelSize);
-            std::memcpy(&upper, data.get() + (n+altSliceSize) * pixelSize, pixelSize);
-            texData[n] = lower + fractAltIndex*(upper-lower);
-        }
-        gl.glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA32F, sizes[0], sizes[1], sizes[2], 0, GL_RGBA, GL_FLOAT, texData.get());
+        // The lower altitude slice is followed by the upper one in the buffer
+        lerpVectors(data.get(), data.get() + altSliceSize, fractAltIndex, texData.get(), altSliceSize);
+        upload(GL_RGBA32F, GL_RGBA, GL_FLOAT, texData.get());
     }
     if(const auto err=gl.glGetError(); err!=GL_NO_ERROR)
     {
-        throw DataLoadError{QObject::tr("GL error in loadTexture4D(\"%1\") after glTexImage3D() call: %2")
-                            .arg(path).arg(openglErrorString(err).c_str())};
+        throw DataLoadError{QObject::tr("GL error in loadTexture4D(\"%1\") after %2() call: %3")
+                            .arg(path).arg(stackIndex<0 ? "glTexImage3D" : "glTexSubImage3D").arg(openglErrorString(err).c_str())};
     }
 
     log << "done";
 }
 
-glm::ivec2 AtmosphereRenderer::loadTexture2D(QString const& path)
+// If arrayLayer is nonnegative, the data are loaded into this layer of the currently bound 2D array texture
+glm::ivec2 AtmosphereRenderer::loadTexture2D(QString const& path, const int arrayLayer)
 {
     auto log=qDebug().nospace();
 
@@ -305,16 +376,204 @@ glm::ivec2 AtmosphereRenderer::loadTexture2D(QString const& path)
             throw DataLoadError{error};
         }
     }
-    gl.glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,sizes[0],sizes[1],0,GL_RGBA,GL_FLOAT,subpixels.get());
+    if(arrayLayer<0)
+        gl.glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,sizes[0],sizes[1],0,GL_RGBA,GL_FLOAT,subpixels.get());
+    else
+        gl.glTexSubImage3D(GL_TEXTURE_2D_ARRAY,0,0,0,arrayLayer,sizes[0],sizes[1],1,GL_RGBA,GL_FLOAT,subpixels.get());
     if(const auto err=gl.glGetError(); err!=GL_NO_ERROR)
     {
-        throw DataLoadError{QObject::tr("GL error in loadTexture2D(\"%1\") after glTexImage2D() call: %2")
-                            .arg(path).arg(openglErrorString(err).c_str())};
+        throw DataLoadError{QObject::tr("GL error in loadTexture2D(\"%1\") after %2() call: %3")
+                            .arg(path).arg(arrayLayer<0 ? "glTexImage2D" : "glTexSubImage3D").arg(openglErrorString(err).c_str())};
     }
     log << "done";
     return {sizes[0], sizes[1]};
 }
 
+auto AtmosphereRenderer::newTextureArray(const int width, const int height, const int layerCount) -> TexturePtr
+{
+    auto tex=newTex(QOpenGLTexture::Target2DArray);
+    tex->setMinificationFilter(QOpenGLTexture::Linear);
+    tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+    tex->bind();
+    gl.glTexImage3D(GL_TEXTURE_2D_ARRAY,0,GL_RGBA32F,width,height,layerCount,0,GL_RGBA,GL_FLOAT,nullptr);
+    if(const auto err=gl.glGetError(); err!=GL_NO_ERROR)
+    {
+        throw DataLoadError{QObject::tr("GL error while allocating %1×%2×%3 texture array: %4")
+                            .arg(width).arg(height).arg(layerCount).arg(openglErrorString(err).c_str())};
+    }
+    return tex;
+}
+
+// Returns the texture shared under key, or, if there's none, the one created by create(), to be loaded wavelength set
+// by wavelength set and shared when complete. Partially loaded textures aren't shared, so that other renderers never
+// render from missing layers.
+template<typename Create>
+auto AtmosphereRenderer::beginTextureArrayLoading(QString const& key, Create create) -> TexturePtr
+{
+    if(auto tex=resourcePool_->find<QOpenGLTexture>(key))
+    {
+        qDebug().nospace() << "Using shared texture " << key;
+        reusingSharedTextureArray_=true;
+        return tex;
+    }
+    reusingSharedTextureArray_=false;
+    return create();
+}
+
+// Data generated before texture arrays were supported have shaders that can only sample 2D textures of a single
+// wavelength set
+bool AtmosphereRenderer::dataSupportsTextureArrays() const
+{
+    const auto path=pathToData_+"/shaders/zero-order-scattering/0/texture-sampling-functions.frag";
+    if(!QFile::exists(path)) return false;
+    // The constants header, which gives the choice of the set at run time, is included in the file
+    const auto src=readFullFile(path);
+    return src.contains("WLSET_TEXTURE_ARRAYS") && src.contains("WLSET_UNIFORM_INDEX");
+}
+
+// Key of a resource loaded from path (which is inside pathToData_) in the shared resource pool
+QString AtmosphereRenderer::sharedKey(QString const& path) const
+{
+    assert(path.startsWith(pathToData_));
+    return canonicalPathToData_+path.mid(pathToData_.size());
+}
+
+// Key of the slice of a 4D texture at altitudeCoord. Textures at different altitudes have different contents, so the
+// coordinate is kept at full precision.
+QString AtmosphereRenderer::sharedSliceKey(QString const& path, const float altitudeCoord) const
+{
+    return QString("%1@%2").arg(sharedKey(path)).arg(double(altitudeCoord), 0, 'g', 9);
+}
+
+// Returns the texture shared under key by another renderer, or, if there's none, the texture created by load(),
+// which then becomes shared under this key
+template<typename Load>
+auto AtmosphereRenderer::sharedTexture(QString const& key, Load load) -> TexturePtr
+{
+    if(auto tex=resourcePool_->find<QOpenGLTexture>(key))
+    {
+        qDebug().nospace() << "Using shared texture " << key;
+        return tex;
+    }
+    TexturePtr tex=load();
+    resourcePool_->share(key, tex);
+    return tex;
+}
+
+// Compiles the shaders from viewDirVertShaderSrc_ and viewDirFragShaderSrc_, plus the geometry shader if several
+// view layers are rendered at once. The current shaders are only replaced if all the new ones compile.
+void AtmosphereRenderer::compileViewDirShaders()
+{
+    const bool layered = viewLayerCount_>1;
+    std::unique_ptr<QOpenGLShader> vertShader(new QOpenGLShader(QOpenGLShader::Vertex));
+    std::unique_ptr<QOpenGLShader> fragShader(new QOpenGLShader(QOpenGLShader::Fragment));
+    std::unique_ptr<QOpenGLShader> geomShader;
+    const auto vertShaderSrc = layered ? withDefinitionsInserted(viewDirVertShaderSrc_, "#define position viewDirVertexPosition\n")
+                                       : viewDirVertShaderSrc_;
+    if(!vertShader->compileSourceCode(vertShaderSrc))
+        throw DataLoadError{QObject::tr("Failed to compile view direction vertex shader:\n%2").arg(vertShader->log())};
+    if(!fragShader->compileSourceCode(viewDirFragShaderSrc_))
+        throw DataLoadError{QObject::tr("Failed to compile view direction fragment shader:\n%2").arg(fragShader->log())};
+    if(layered)
+    {
+        geomShader.reset(new QOpenGLShader(QOpenGLShader::Geometry));
+        if(!geomShader->compileSourceCode(viewLayersGeomShaderSrc(viewLayerCount_)))
+            throw DataLoadError{QObject::tr("Failed to compile view layers geometry shader:\n%2").arg(geomShader->log())};
+    }
+    viewDirVertShader_=std::move(vertShader);
+    viewDirFragShader_=std::move(fragShader);
+    viewLayersGeomShader_=std::move(geomShader);
+
+    viewDirShadersKey_=viewDirShadersKey(viewDirVertShaderSrc_, viewDirFragShaderSrc_, viewDirBindAttribLocations_);
+    if(layered)
+        viewDirShadersKey_ += QString("|layers:%1").arg(viewLayerCount_);
+}
+
+void AtmosphereRenderer::addViewDirShaders(QOpenGLShaderProgram& program) const
+{
+    program.addShader(viewDirFragShader_.get());
+    program.addShader(viewDirVertShader_.get());
+    if(viewLayersGeomShader_)
+        program.addShader(viewLayersGeomShader_.get());
+    for(const auto& b : viewDirBindAttribLocations_)
+        program.bindAttributeLocation(b.first.c_str(), b.second);
+}
+
+// The program for all the wavelength sets is built from the shaders of the first set, which then take the index of
+// the set from the wlSetIndex uniform instead of their constants
+QByteArray AtmosphereRenderer::programDefinitions(const AllWavelengthSets allWLSets) const
+{
+    return allWLSets ? shaderDefinitions_+"#define WLSET_UNIFORM_INDEX\n" : shaderDefinitions_;
+}
+
+QString AtmosphereRenderer::viewDirProgramKey(QString const& dir, const AllWavelengthSets allWLSets) const
+{
+    return QString("program:%1|%2|%3").arg(sharedKey(dir), QString::fromUtf8(programDefinitions(allWLSets)), viewDirShadersKey_);
+}
+
+// Returns the program consisting of the fragment shaders from dir and the view direction shaders. An identical
+// program built by another renderer is reused, except when reloading shaders, since the files might have changed.
+auto AtmosphereRenderer::loadViewDirProgram(QString const& dir, QString const& description,
+                                            const AllWavelengthSets allWLSets) -> ShaderProgPtr
+{
+    const auto key=viewDirProgramKey(dir, allWLSets);
+    if(!rebuildSharedPrograms_)
+    {
+        if(auto program=resourcePool_->find<ShaderProgram>(key))
+        {
+            qDebug().nospace() << "Using shared program for shaders from " << dir;
+            return program;
+        }
+    }
+
+    qDebug().nospace() << "Loading shaders from " << dir << "...";
+    const auto program=std::make_shared<ShaderProgram>();
+    program->sourceDir=dir;
+    program->allWavelengthSets=allWLSets;
+    const auto definitions=programDefinitions(allWLSets);
+    for(const auto& shaderFile : fs::directory_iterator(fs::u8path(dir.toStdString())))
+        addShaderFile(*program, QOpenGLShader::Fragment, shaderFile.path(), definitions);
+
+    addViewDirShaders(*program);
+
+    link(*program, description);
+
+    program->resolveUniforms(gl);
+    resourcePool_->share(key, program);
+    return program;
+}
+
+// Same as loadViewDirProgram(), but for the programs rendering into textures instead of the application's surface
+auto AtmosphereRenderer::loadPrecomputationProgram(QString const& dir, QString const& description,
+                                                   const AllWavelengthSets allWLSets) -> ShaderProgPtr
+{
+    const auto key=QString("program:%1|%2|precomputation").arg(sharedKey(dir), QString::fromUtf8(programDefinitions(allWLSets)));
+    if(!rebuildSharedPrograms_)
+    {
+        if(auto program=resourcePool_->find<ShaderProgram>(key))
+        {
+            qDebug().nospace() << "Using shared program for shaders from " << dir;
+            return program;
+        }
+    }
+
+    qDebug().nospace() << "Loading shaders from " << dir << "...";
+    const auto program=std::make_shared<ShaderProgram>();
+    program->sourceDir=dir;
+    program->allWavelengthSets=allWLSets;
+    const auto definitions=programDefinitions(allWLSets);
+    for(const auto& shaderFile : fs::directory_iterator(fs::u8path(dir.toStdString())))
+        addShaderFile(*program, QOpenGLShader::Fragment, shaderFile.path(), definitions);
+
+    program->addShader(precomputationProgramsVertShader_.get());
+
+    link(*program, description);
+
+    program->resolveUniforms(gl);
+    resourcePool_->share(key, program);
+    return program;
+}
+
 void AtmosphereRenderer::loadTextures(const CountStepsOnly countStepsOnly)
 {
     OGL_TRACE();
@@ -334,11 +593,38 @@ void AtmosphereRenderer::loadTextures(const CountStepsOnly countStepsOnly)
         if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
             continue;
 
-        auto& tex=*transmittanceTextures_.emplace_back(newTex(QOpenGLTexture::Target2D));
-        tex.setMinificationFilter(QOpenGLTexture::Linear);
-        tex.setWrapMode(QOpenGLTexture::ClampToEdge);
-        tex.bind();
-        loadTexture2D(QString("%1/transmittance-wlset%2.f32").arg(pathToData_).arg(wlSetIndex));
+        const auto path=QString("%1/transmittance-wlset%2.f32").arg(pathToData_).arg(wlSetIndex);
+        if(useTextureArrays_)
+        {
+            const auto key=sharedKey(pathToData_+"/transmittance-wlset*.f32");
+            if(wlSetIndex==0)
+            {
+                transmittanceTextures_.clear();
+                transmittanceTextures_.emplace_back(beginTextureArrayLoading(key, [&]
+                {
+                    return newTextureArray(params_.transmittanceTexW, params_.transmittanceTexH, params_.allWavelengths.size());
+                }));
+            }
+            if(!reusingSharedTextureArray_)
+            {
+                transmittanceTextures_.front()->bind();
+                loadTexture2D(path, wlSetIndex);
+                // Only share the array when all its layers are loaded
+                if(wlSetIndex+1==params_.allWavelengths.size())
+                    resourcePool_->share(key, transmittanceTextures_.front());
+            }
+            ++loadingStepsDone_; return;
+        }
+
+        transmittanceTextures_.emplace_back(sharedTexture(sharedKey(path), [&]
+        {
+            auto tex=newTex(QOpenGLTexture::Target2D);
+            tex->setMinificationFilter(QOpenGLTexture::Linear);
+            tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+            tex->bind();
+            loadTexture2D(path);
+            return tex;
+        }));
         ++loadingStepsDone_; return;
     }
 
@@ -352,11 +638,38 @@ void AtmosphereRenderer::loadTextures(const CountStepsOnly countStepsOnly)
         if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
             continue;
 
-        auto& tex=*irradianceTextures_.emplace_back(newTex(QOpenGLTexture::Target2D));
-        tex.setMinificationFilter(QOpenGLTexture::Linear);
-        tex.setWrapMode(QOpenGLTexture::ClampToEdge);
-        tex.bind();
-        loadTexture2D(QString("%1/irradiance-wlset%2.f32").arg(pathToData_).arg(wlSetIndex));
+        const auto path=QString("%1/irradiance-wlset%2.f32").arg(pathToData_).arg(wlSetIndex);
+        if(useTextureArrays_)
+        {
+            const auto key=sharedKey(pathToData_+"/irradiance-wlset*.f32");
+            if(wlSetIndex==0)
+            {
+                irradianceTextures_.clear();
+                irradianceTextures_.emplace_back(beginTextureArrayLoading(key, [&]
+                {
+                    return newTextureArray(params_.irradianceTexW, params_.irradianceTexH, params_.allWavelengths.size());
+                }));
+            }
+            if(!reusingSharedTextureArray_)
+            {
+                irradianceTextures_.front()->bind();
+                loadTexture2D(path, wlSetIndex);
+                // Only share the array when all its layers are loaded
+                if(wlSetIndex+1==params_.allWavelengths.size())
+                    resourcePool_->share(key, irradianceTextures_.front());
+            }
+            ++loadingStepsDone_; return;
+        }
+
+        irradianceTextures_.emplace_back(sharedTexture(sharedKey(path), [&]
+        {
+            auto tex=newTex(QOpenGLTexture::Target2D);
+            tex->setMinificationFilter(QOpenGLTexture::Linear);
+            tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+            tex->bind();
+            loadTexture2D(path);
+            return tex;
+        }));
         ++loadingStepsDone_; return;
     }
 
@@ -396,12 +709,16 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
         }
         else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
         {
-            auto& tex=*multipleScatteringTextures_.emplace_back(newTex(QOpenGLTexture::Target3D));
-            tex.setMinificationFilter(texFilter);
-            tex.setMagnificationFilter(texFilter);
-            tex.setWrapMode(QOpenGLTexture::ClampToEdge);
-            tex.bind();
-            loadTexture4D(filename, altCoord);
+            multipleScatteringTextures_.emplace_back(sharedTexture(sharedSliceKey(filename, altCoord), [&]
+            {
+                auto tex=newTex(QOpenGLTexture::Target3D);
+                tex->setMinificationFilter(texFilter);
+                tex->setMagnificationFilter(texFilter);
+                tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+                tex->bind();
+                loadTexture4D(filename, altCoord);
+                return tex;
+            }));
             ++loadingStepsDone_; return;
         }
     }
@@ -417,12 +734,17 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
             if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
                 continue;
 
-            auto& tex=*multipleScatteringTextures_.emplace_back(newTex(QOpenGLTexture::Target3D));
-            tex.setMinificationFilter(texFilter);
-            tex.setMagnificationFilter(texFilter);
-            tex.setWrapMode(QOpenGLTexture::ClampToEdge);
-            tex.bind();
-            loadTexture4D(QString("%1/multiple-scattering-wlset%2.f32").arg(pathToData_).arg(wlSetIndex), altCoord);
+            const auto path=QString("%1/multiple-scattering-wlset%2.f32").arg(pathToData_).arg(wlSetIndex);
+            multipleScatteringTextures_.emplace_back(sharedTexture(sharedSliceKey(path, altCoord), [&]
+            {
+                auto tex=newTex(QOpenGLTexture::Target3D);
+                tex->setMinificationFilter(texFilter);
+                tex->setMagnificationFilter(texFilter);
+                tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+                tex->bind();
+                loadTexture4D(path, altCoord);
+                return tex;
+            }));
             ++loadingStepsDone_; return;
         }
     }
@@ -455,6 +777,45 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
         {
         case PhaseFunctionType::General:
         {
+            // Paths of the files of all the wavelength sets, with %1 in place of the set index
+            const auto texturePattern=pathToData_+"/single-scattering/%1/"+scatterer.name+".f32";
+            const auto guides01Pattern=pathToData_+"/single-scattering/%1/"+scatterer.name+"-dims01.guides2d";
+            const auto guides02Pattern=pathToData_+"/single-scattering/%1/"+scatterer.name+"-dims02.guides2d";
+            // Loads the slice of one wavelength set into the 3D texture of all the sets, see useTextureArrays_
+            const auto loadStackedSlice=[&](std::vector<TexturePtr>& family, QString const& pattern, const unsigned wlSetIndex,
+                                            const QOpenGLTexture::Filter filter, const Texture4DType texType)
+            {
+                const auto key=sharedSliceKey(pattern.arg("*"), altCoord);
+                if(wlSetIndex==0)
+                {
+                    family.clear();
+                    family.emplace_back(beginTextureArrayLoading(key, [&]
+                    {
+                        auto tex=newTex(QOpenGLTexture::Target3D);
+                        tex->setMinificationFilter(filter);
+                        tex->setMagnificationFilter(filter);
+                        tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+                        return tex;
+                    }));
+                }
+                if(reusingSharedTextureArray_) return;
+                family.front()->bind();
+                loadTexture4D(pattern.arg(wlSetIndex), altCoord, texType, wlSetIndex);
+                // Only share the texture when all the sets are loaded
+                if(wlSetIndex+1==params_.allWavelengths.size())
+                    resourcePool_->share(key, family.front());
+            };
+            // Stacked guides are only usable if all the sets have them
+            const auto guidesExist=[&](QString const& pattern, const unsigned wlSetIndex)
+            {
+                if(!useTextureArrays_)
+                    return QFile::exists(pattern.arg(wlSetIndex));
+                for(unsigned i=0; i<params_.allWavelengths.size(); ++i)
+                    if(!QFile::exists(pattern.arg(i)))
+                        return false;
+                return true;
+            };
+
             for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
             {
                 if(countStepsOnly)
@@ -465,18 +826,27 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
                 if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
                     continue;
 
-                auto& texture=*texturesPerWLSet.emplace_back(newTex(QOpenGLTexture::Target3D));
-                texture.setMinificationFilter(texFilter);
-                texture.setMagnificationFilter(texFilter);
-                texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-                texture.bind();
-                loadTexture4D(QString("%1/single-scattering/%2/%3.f32").arg(pathToData_).arg(wlSetIndex).arg(scatterer.name), altCoord);
+                if(useTextureArrays_)
+                {
+                    loadStackedSlice(texturesPerWLSet, texturePattern, wlSetIndex, texFilter, Texture4DType::ScatteringTexture);
+                    ++loadingStepsDone_; return;
+                }
+                const auto path=texturePattern.arg(wlSetIndex);
+                texturesPerWLSet.emplace_back(sharedTexture(sharedSliceKey(path, altCoord), [&]
+                {
+                    auto texture=newTex(QOpenGLTexture::Target3D);
+                    texture->setMinificationFilter(texFilter);
+                    texture->setMagnificationFilter(texFilter);
+                    texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+                    texture->bind();
+                    loadTexture4D(path, altCoord);
+                    return texture;
+                }));
                 ++loadingStepsDone_; return;
             }
             for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
             {
-                const auto filename=QString("%1/single-scattering/%2/%3-dims01.guides2d").arg(pathToData_).arg(wlSetIndex).arg(scatterer.name);
-                if(QFile::exists(filename))
+                if(guidesExist(guides01Pattern, wlSetIndex))
                 {
                     if(countStepsOnly)
                     {
@@ -485,20 +855,30 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
                     else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
                     {
                         auto& guidesPerWLSet=singleScatteringInterpolationGuidesTextures01_[scatterer.name];
-                        auto& tex=*guidesPerWLSet.emplace_back(newTex(QOpenGLTexture::Target3D));
-                        tex.setMinificationFilter(QOpenGLTexture::Linear);
-                        tex.setMagnificationFilter(QOpenGLTexture::Linear);
-                        tex.setWrapMode(QOpenGLTexture::ClampToEdge);
-                        tex.bind();
-                        loadTexture4D(filename, altCoord, Texture4DType::InterpolationGuides);
+                        if(useTextureArrays_)
+                        {
+                            loadStackedSlice(guidesPerWLSet, guides01Pattern, wlSetIndex, QOpenGLTexture::Linear,
+                                             Texture4DType::InterpolationGuides);
+                            ++loadingStepsDone_; return;
+                        }
+                        const auto filename=guides01Pattern.arg(wlSetIndex);
+                        guidesPerWLSet.emplace_back(sharedTexture(sharedSliceKey(filename, altCoord), [&]
+                        {
+                            auto tex=newTex(QOpenGLTexture::Target3D);
+                            tex->setMinificationFilter(QOpenGLTexture::Linear);
+                            tex->setMagnificationFilter(QOpenGLTexture::Linear);
+                            tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+                            tex->bind();
+                            loadTexture4D(filename, altCoord, Texture4DType::InterpolationGuides);
+                            return tex;
+                        }));
                         ++loadingStepsDone_; return;
                     }
                 }
             }
             for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
             {
-                const auto filename=QString("%1/single-scattering/%2/%3-dims02.guides2d").arg(pathToData_).arg(wlSetIndex).arg(scatterer.name);
-                if(QFile::exists(filename))
+                if(guidesExist(guides02Pattern, wlSetIndex))
                 {
                     if(countStepsOnly)
                     {
@@ -507,12 +887,23 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
                     else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
                     {
                         auto& guidesPerWLSet=singleScatteringInterpolationGuidesTextures02_[scatterer.name];
-                        auto& tex=*guidesPerWLSet.emplace_back(newTex(QOpenGLTexture::Target3D));
-                        tex.setMinificationFilter(QOpenGLTexture::Linear);
-                        tex.setMagnificationFilter(QOpenGLTexture::Linear);
-                        tex.setWrapMode(QOpenGLTexture::ClampToEdge);
-                        tex.bind();
-                        loadTexture4D(filename, altCoord, Texture4DType::InterpolationGuides);
+                        if(useTextureArrays_)
+                        {
+                            loadStackedSlice(guidesPerWLSet, guides02Pattern, wlSetIndex, QOpenGLTexture::Linear,
+                                             Texture4DType::InterpolationGuides);
+                            ++loadingStepsDone_; return;
+                        }
+                        const auto filename=guides02Pattern.arg(wlSetIndex);
+                        guidesPerWLSet.emplace_back(sharedTexture(sharedSliceKey(filename, altCoord), [&]
+                        {
+                            auto tex=newTex(QOpenGLTexture::Target3D);
+                            tex->setMinificationFilter(QOpenGLTexture::Linear);
+                            tex->setMagnificationFilter(QOpenGLTexture::Linear);
+                            tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+                            tex->bind();
+                            loadTexture4D(filename, altCoord, Texture4DType::InterpolationGuides);
+                            return tex;
+                        }));
                         ++loadingStepsDone_; return;
                     }
                 }
@@ -544,12 +935,17 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
             }
             else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
             {
-                auto& texture=*texturesPerWLSet.emplace_back(newTex(QOpenGLTexture::Target3D));
-                texture.setMinificationFilter(texFilter);
-                texture.setMagnificationFilter(texFilter);
-                texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-                texture.bind();
-                loadTexture4D(QString("%1/single-scattering/%2-xyzw.f32").arg(pathToData_).arg(scatterer.name), altCoord);
+                const auto path=QString("%1/single-scattering/%2-xyzw.f32").arg(pathToData_).arg(scatterer.name);
+                texturesPerWLSet.emplace_back(sharedTexture(sharedSliceKey(path, altCoord), [&]
+                {
+                    auto texture=newTex(QOpenGLTexture::Target3D);
+                    texture->setMinificationFilter(texFilter);
+                    texture->setMagnificationFilter(texFilter);
+                    texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+                    texture->bind();
+                    loadTexture4D(path, altCoord);
+                    return texture;
+                }));
                 ++loadingStepsDone_; return;
             }
 
@@ -563,12 +959,16 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
                 else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
                 {
                     auto& guidesPerWLSet=singleScatteringInterpolationGuidesTextures01_[scatterer.name];
-                    auto& texture=*guidesPerWLSet.emplace_back(newTex(QOpenGLTexture::Target3D));
-                    texture.setMinificationFilter(QOpenGLTexture::Linear);
-                    texture.setMagnificationFilter(QOpenGLTexture::Linear);
-                    texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-                    texture.bind();
-                    loadTexture4D(guidesFilename01, altCoord, Texture4DType::InterpolationGuides);
+                    guidesPerWLSet.emplace_back(sharedTexture(sharedSliceKey(guidesFilename01, altCoord), [&]
+                    {
+                        auto texture=newTex(QOpenGLTexture::Target3D);
+                        texture->setMinificationFilter(QOpenGLTexture::Linear);
+                        texture->setMagnificationFilter(QOpenGLTexture::Linear);
+                        texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+                        texture->bind();
+                        loadTexture4D(guidesFilename01, altCoord, Texture4DType::InterpolationGuides);
+                        return texture;
+                    }));
                     ++loadingStepsDone_; return;
                 }
             }
@@ -582,12 +982,16 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
                 else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
                 {
                     auto& guidesPerWLSet=singleScatteringInterpolationGuidesTextures02_[scatterer.name];
-                    auto& texture=*guidesPerWLSet.emplace_back(newTex(QOpenGLTexture::Target3D));
-                    texture.setMinificationFilter(QOpenGLTexture::Linear);
-                    texture.setMagnificationFilter(QOpenGLTexture::Linear);
-                    texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-                    texture.bind();
-                    loadTexture4D(guidesFilename02, altCoord, Texture4DType::InterpolationGuides);
+                    guidesPerWLSet.emplace_back(sharedTexture(sharedSliceKey(guidesFilename02, altCoord), [&]
+                    {
+                        auto texture=newTex(QOpenGLTexture::Target3D);
+                        texture->setMinificationFilter(QOpenGLTexture::Linear);
+                        texture->setMagnificationFilter(QOpenGLTexture::Linear);
+                        texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+                        texture->bind();
+                        loadTexture4D(guidesFilename02, altCoord, Texture4DType::InterpolationGuides);
+                        return texture;
+                    }));
                     ++loadingStepsDone_; return;
                 }
             }
@@ -633,19 +1037,23 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
             }
             else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
             {
-                auto& texture=*eclipsedDoubleScatteringTextures_.emplace_back(newTex(QOpenGLTexture::Target3D));
-                texture.setMinificationFilter(texFilter);
-                texture.setMagnificationFilter(texFilter);
-                // relative azimuth
-                texture.setWrapMode(QOpenGLTexture::DirectionS, QOpenGLTexture::Repeat);
-                // VZA
-                texture.setWrapMode(QOpenGLTexture::DirectionT, QOpenGLTexture::ClampToEdge);
-                // SZA
-                texture.setWrapMode(QOpenGLTexture::DirectionR, QOpenGLTexture::ClampToEdge);
-
-                texture.bind();
-                loadEclipsedDoubleScatteringTexture(QString("%1/eclipsed-double-scattering-xyzw.f32")
-                                                     .arg(pathToData_), altCoord);
+                const auto path=QString("%1/eclipsed-double-scattering-xyzw.f32").arg(pathToData_);
+                eclipsedDoubleScatteringTextures_.emplace_back(sharedTexture(sharedSliceKey(path, altCoord), [&]
+                {
+                    auto texture=newTex(QOpenGLTexture::Target3D);
+                    texture->setMinificationFilter(texFilter);
+                    texture->setMagnificationFilter(texFilter);
+                    // relative azimuth
+                    texture->setWrapMode(QOpenGLTexture::DirectionS, QOpenGLTexture::Repeat);
+                    // VZA
+                    texture->setWrapMode(QOpenGLTexture::DirectionT, QOpenGLTexture::ClampToEdge);
+                    // SZA
+                    texture->setWrapMode(QOpenGLTexture::DirectionR, QOpenGLTexture::ClampToEdge);
+
+                    texture->bind();
+                    loadEclipsedDoubleScatteringTexture(path, altCoord);
+                    return texture;
+                }));
 
                 ++loadingStepsDone_; return;
             }
@@ -662,19 +1070,23 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
                 if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
                     continue;
 
-                auto& texture=*eclipsedDoubleScatteringTextures_.emplace_back(newTex(QOpenGLTexture::Target3D));
-                texture.setMinificationFilter(texFilter);
-                texture.setMagnificationFilter(texFilter);
-                // relative azimuth
-                texture.setWrapMode(QOpenGLTexture::DirectionS, QOpenGLTexture::Repeat);
-                // VZA
-                texture.setWrapMode(QOpenGLTexture::DirectionT, QOpenGLTexture::ClampToEdge);
-                // SZA
-                texture.setWrapMode(QOpenGLTexture::DirectionR, QOpenGLTexture::ClampToEdge);
-
-                texture.bind();
-                loadEclipsedDoubleScatteringTexture(QString("%1/eclipsed-double-scattering-wlset%2.f32")
-                                                     .arg(pathToData_).arg(wlSetIndex), altCoord);
+                const auto path=QString("%1/eclipsed-double-scattering-wlset%2.f32").arg(pathToData_).arg(wlSetIndex);
+                eclipsedDoubleScatteringTextures_.emplace_back(sharedTexture(sharedSliceKey(path, altCoord), [&]
+                {
+                    auto texture=newTex(QOpenGLTexture::Target3D);
+                    texture->setMinificationFilter(texFilter);
+                    texture->setMagnificationFilter(texFilter);
+                    // relative azimuth
+                    texture->setWrapMode(QOpenGLTexture::DirectionS, QOpenGLTexture::Repeat);
+                    // VZA
+                    texture->setWrapMode(QOpenGLTexture::DirectionT, QOpenGLTexture::ClampToEdge);
+                    // SZA
+                    texture->setWrapMode(QOpenGLTexture::DirectionR, QOpenGLTexture::ClampToEdge);
+
+                    texture->bind();
+                    loadEclipsedDoubleScatteringTexture(path, altCoord);
+                    return texture;
+                }));
 
                 ++loadingStepsDone_; return;
             }
@@ -726,12 +1138,29 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
         }
         else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
         {
-            auto& tex=*lightPollutionTextures_.emplace_back(newTex(QOpenGLTexture::Target2D));
-            tex.setMinificationFilter(texFilter);
-            tex.setMagnificationFilter(texFilter);
-            tex.setWrapMode(QOpenGLTexture::ClampToEdge);
-            tex.bind();
-            loadTexture2D(filename);
+            if(useTextureArrays_)
+            {
+                lightPollutionTextures_.emplace_back(sharedTexture(sharedKey(filename)+"[array]", [&]
+                {
+                    auto tex=newTextureArray(params_.lightPollutionTextureSize[0],
+                                             params_.lightPollutionTextureSize[1], 1);
+                    tex->setMagnificationFilter(texFilter);
+                    tex->setMinificationFilter(texFilter);
+                    loadTexture2D(filename, 0);
+                    return tex;
+                }));
+                ++loadingStepsDone_; return;
+            }
+            lightPollutionTextures_.emplace_back(sharedTexture(sharedKey(filename), [&]
+            {
+                auto tex=newTex(QOpenGLTexture::Target2D);
+                tex->setMinificationFilter(texFilter);
+                tex->setMagnificationFilter(texFilter);
+                tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+                tex->bind();
+                loadTexture2D(filename);
+                return tex;
+            }));
             ++loadingStepsDone_; return;
         }
     }
@@ -747,18 +1176,49 @@ void AtmosphereRenderer::reloadScatteringTextures(const CountStepsOnly countStep
             if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
                 continue;
 
-            auto& tex=*lightPollutionTextures_.emplace_back(newTex(QOpenGLTexture::Target2D));
-            tex.setMinificationFilter(texFilter);
-            tex.setMagnificationFilter(texFilter);
-            tex.setWrapMode(QOpenGLTexture::ClampToEdge);
-            tex.bind();
-            loadTexture2D(QString("%1/light-pollution-wlset%2.f32").arg(pathToData_).arg(wlSetIndex));
+            const auto path=QString("%1/light-pollution-wlset%2.f32").arg(pathToData_).arg(wlSetIndex);
+            if(useTextureArrays_)
+            {
+                const auto key=sharedKey(pathToData_+"/light-pollution-wlset*.f32");
+                if(wlSetIndex==0)
+                {
+                    lightPollutionTextures_.emplace_back(beginTextureArrayLoading(key, [&]
+                    {
+                        return newTextureArray(params_.lightPollutionTextureSize[0], params_.lightPollutionTextureSize[1],
+                                               params_.allWavelengths.size());
+                    }));
+                }
+                if(!reusingSharedTextureArray_)
+                {
+                    auto& tex=*lightPollutionTextures_.front();
+                    tex.setMinificationFilter(texFilter);
+                    tex.setMagnificationFilter(texFilter);
+                    tex.bind();
+                    loadTexture2D(path, wlSetIndex);
+                    // Only share the array when all its layers are loaded
+                    if(wlSetIndex+1==params_.allWavelengths.size())
+                        resourcePool_->share(key, lightPollutionTextures_.front());
+                }
+                ++loadingStepsDone_; return;
+            }
+
+            lightPollutionTextures_.emplace_back(sharedTexture(sharedKey(path), [&]
+            {
+                auto tex=newTex(QOpenGLTexture::Target2D);
+                tex->setMinificationFilter(texFilter);
+                tex->setMagnificationFilter(texFilter);
+                tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+                tex->bind();
+                loadTexture2D(path);
+                return tex;
+            }));
             ++loadingStepsDone_; return;
         }
     }
 }
 
-void AtmosphereRenderer::loadShaders(const CountStepsOnly countStepsOnly)
+// Programs needed regardless of whether eclipse shader is used, except the groups deferred by lazy loading
+void AtmosphereRenderer::loadCoreShaders(const CountStepsOnly countStepsOnly)
 {
     if(countStepsOnly)
     {
@@ -766,12 +1226,7 @@ void AtmosphereRenderer::loadShaders(const CountStepsOnly countStepsOnly)
     }
     else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
     {
-        viewDirVertShader_.reset(new QOpenGLShader(QOpenGLShader::Vertex));
-        viewDirFragShader_.reset(new QOpenGLShader(QOpenGLShader::Fragment));
-        if(!viewDirVertShader_->compileSourceCode(viewDirVertShaderSrc_))
-            throw DataLoadError{QObject::tr("Failed to compile view direction vertex shader:\n%2").arg(viewDirVertShader_->log())};
-        if(!viewDirFragShader_->compileSourceCode(viewDirFragShaderSrc_))
-            throw DataLoadError{QObject::tr("Failed to compile view direction fragment shader:\n%2").arg(viewDirFragShader_->log())};
+        compileViewDirShaders();
         ++loadingStepsDone_; return;
     }
 
@@ -794,79 +1249,316 @@ void AtmosphereRenderer::loadShaders(const CountStepsOnly countStepsOnly)
     }
     for(int renderMode=0; renderMode<SSRM_COUNT; ++renderMode)
     {
-        auto& programsPerScatterer=*singleScatteringPrograms_[renderMode];
+        if(pendingShaderGroups_ & singleScatteringShaderGroup(renderMode))
+            continue;
+        const auto stepsDoneBefore = loadingStepsDone_;
+        loadSingleScatteringShaders(countStepsOnly, renderMode);
+        if(loadingStepsDone_ != stepsDoneBefore)
+            return;
+    }
 
-        for(const auto& scatterer : params_.scatterers)
+    if(countStepsOnly)
+    {
+        ++totalLoadingStepsToDo_;
+    }
+    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+    {
+        multipleScatteringPrograms_.clear();
+        multipleScatteringMRTProgram_.reset();
+        ++loadingStepsDone_; return;
+    }
+    if(QFile::exists(pathToData_+"/shaders/multiple-scattering/0/"))
+    {
+        for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
         {
-            auto& programs=programsPerScatterer[scatterer.name];
-            if(scatterer.phaseFunctionType==PhaseFunctionType::General || renderMode==SSRM_ON_THE_FLY)
+            if(countStepsOnly)
             {
-                for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
-                {
-                    if(countStepsOnly)
-                    {
-                        ++totalLoadingStepsToDo_;
-                        continue;
-                    }
-                    if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
-                        continue;
-
-                    const auto scatDir=QString("%1/shaders/single-scattering/%2/%3/%4").arg(pathToData_)
-                                                                                       .arg(singleScatteringRenderModeNames[renderMode])
-                                                                                       .arg(wlSetIndex)
-                                                                                       .arg(scatterer.name);
-                    qDebug().nospace() << "Loading shaders from " << scatDir << "...";
-                    auto& program=*programs.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-
-                    for(const auto& shaderFile : fs::directory_iterator(fs::u8path(scatDir.toStdString())))
-                        addShaderFile(program,QOpenGLShader::Fragment,shaderFile.path());
+                ++totalLoadingStepsToDo_;
+                continue;
+            }
+            if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
+                continue;
 
-                    program.addShader(viewDirFragShader_.get());
-                    program.addShader(viewDirVertShader_.get());
-                    for(const auto& b : viewDirBindAttribLocations_)
-                        program.bindAttributeLocation(b.first.c_str(), b.second);
+            const auto wlDir=QString("%1/shaders/multiple-scattering/%2").arg(pathToData_).arg(wlSetIndex);
+            multipleScatteringPrograms_.emplace_back(loadViewDirProgram(wlDir, QObject::tr("multiple scattering shader program")));
+            ++loadingStepsDone_; return;
+        }
 
-                    link(program, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name));
-                    ++loadingStepsDone_; return;
-                }
+        if(QFile::exists(pathToData_+"/shaders/multiple-scattering-mrt/"))
+        {
+            if(countStepsOnly)
+            {
+                ++totalLoadingStepsToDo_;
             }
-            else
+            else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
             {
-                if(countStepsOnly)
-                {
-                    ++totalLoadingStepsToDo_;
-                    continue;
-                }
-                if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
-                    continue;
-
-                const auto scatDir=QString("%1/shaders/single-scattering/%2/%3").arg(pathToData_)
-                                                                                .arg(singleScatteringRenderModeNames[renderMode])
-                                                                                .arg(scatterer.name);
-                qDebug().nospace() << "Loading shaders from " << scatDir << "...";
-                auto& program=*programs.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-                for(const auto& shaderFile : fs::directory_iterator(fs::u8path(scatDir.toStdString())))
-                    addShaderFile(program,QOpenGLShader::Fragment,shaderFile.path());
-
-                program.addShader(viewDirFragShader_.get());
-                program.addShader(viewDirVertShader_.get());
-                for(const auto& b : viewDirBindAttribLocations_)
-                    program.bindAttributeLocation(b.first.c_str(), b.second);
-
-                link(program, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name));
+                multipleScatteringMRTProgram_=loadViewDirProgram(pathToData_+"/shaders/multiple-scattering-mrt/",
+                                                                 QObject::tr("multi-wavelength-set multiple scattering shader program"));
                 ++loadingStepsDone_; return;
             }
         }
     }
+    else
+    {
+        if(countStepsOnly)
+        {
+            ++totalLoadingStepsToDo_;
+        }
+        else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+        {
+            const auto wlDir=pathToData_+"/shaders/multiple-scattering/";
+            multipleScatteringPrograms_.emplace_back(loadViewDirProgram(wlDir, QObject::tr("multiple scattering shader program")));
+            ++loadingStepsDone_; return;
+        }
+    }
 
     if(countStepsOnly)
     {
         ++totalLoadingStepsToDo_;
-
-        // Dummy values so that the loop below doesn't index empty vector
-        eclipsedSingleScatteringPrograms_.clear();
-        for(int renderMode=SSRM_ON_THE_FLY; renderMode<SSRM_COUNT; ++renderMode)
-            eclipsedSingleScatteringPrograms_.emplace_back(std::make_unique<ScatteringProgramsMap>());
+    }
+    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+    {
+        zeroOrderScatteringPrograms_.clear();
+        ++loadingStepsDone_; return;
+    }
+    for(unsigned wlSetIndex=0; wlSetIndex<wlSetProgramCount(); ++wlSetIndex)
+    {
+        if(countStepsOnly)
+        {
+            ++totalLoadingStepsToDo_;
+            continue;
+        }
+        if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
+            continue;
+
+        const auto wlDir=QString("%1/shaders/zero-order-scattering/%2").arg(pathToData_).arg(wlSetIndex);
+        zeroOrderScatteringPrograms_.emplace_back(loadViewDirProgram(wlDir, QObject::tr("zero-order scattering shader program"),
+                                                                      AllWavelengthSets{useTextureArrays_}));
+        ++loadingStepsDone_; return;
+    }
+
+    if(countStepsOnly)
+    {
+        ++totalLoadingStepsToDo_;
+    }
+    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+    {
+        viewDirectionGetterProgram_=std::make_unique<ShaderProgram>();
+        auto& program=*viewDirectionGetterProgram_;
+        addViewDirShaders(program);
+        addShaderCode(program, QOpenGLShader::Fragment, QObject::tr("fragment shader for view direction getter"), 1+R"(
+#version 330
+
+in vec3 position;
+out vec3 viewDir;
+
+vec3 calcViewDir();
+void main()
+{
+    viewDir=calcViewDir();
+}
+)");
+        link(program, QObject::tr("view direction getter shader program"));
+        program.resolveUniforms(gl);
+        ++loadingStepsDone_; return;
+    }
+
+    if(countStepsOnly)
+    {
+        ++totalLoadingStepsToDo_;
+    }
+    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+    {
+        upsamplingProgram_=std::make_unique<ShaderProgram>();
+        auto& program=*upsamplingProgram_;
+        addViewDirShaders(program);
+        addShaderCode(program, QOpenGLShader::Fragment, QObject::tr("fragment shader for upsampling of reduced-resolution luminance"), 1+R"(
+#version 330
+
+uniform sampler2D reducedLuminance;
+uniform vec2 viewportSize;
+uniform float resolutionReduction;
+uniform vec3 sunDirection;
+uniform float sunAngularRadius;
+uniform vec3 moonDirection;
+uniform float moonAngularRadius;
+uniform float horizonElevation;
+uniform bool markingFullResolutionPixels;
+layout(location=0) out vec4 luminance;
+
+// Width, in reduced-resolution pixels, of the bands around the discs and the horizon that are rendered at full resolution
+const float MARGIN_PIXELS=2.;
+// Relative difference of neighboring reduced-resolution pixels above which the upsampling isn't trusted
+const float EDGE_THRESHOLD=0.25;
+
+vec3 calcViewDir();
+
+bool nearDisc(const vec3 viewDir, const vec3 discDir, const float discAngularRadius, const float margin)
+{
+    return dot(viewDir, discDir) > cos(discAngularRadius+margin);
+}
+
+void main()
+{
+    vec3 viewDir=calcViewDir();
+    // Derivatives must be computed in uniform control flow, i.e. before any discard
+    float margin=MARGIN_PIXELS*resolutionReduction*length(fwidth(viewDir));
+
+    ivec2 reducedSize=textureSize(reducedLuminance, 0);
+    vec2 pos=gl_FragCoord.xy/viewportSize*vec2(reducedSize)-0.5;
+    ivec2 base=ivec2(floor(pos));
+    vec2 frac=pos-vec2(base);
+    ivec2 maxCoord=reducedSize-1;
+    vec4 v00=texelFetch(reducedLuminance, clamp(base,            ivec2(0), maxCoord), 0);
+    vec4 v10=texelFetch(reducedLuminance, clamp(base+ivec2(1,0), ivec2(0), maxCoord), 0);
+    vec4 v01=texelFetch(reducedLuminance, clamp(base+ivec2(0,1), ivec2(0), maxCoord), 0);
+    vec4 v11=texelFetch(reducedLuminance, clamp(base+ivec2(1,1), ivec2(0), maxCoord), 0);
+    vec4 vMin=min(min(v00,v10),min(v01,v11));
+    vec4 vMax=max(max(v00,v10),max(v01,v11));
+
+    bool needFullResolution = any(greaterThan(vMax-vMin, EDGE_THRESHOLD*vMax)) ||
+                              nearDisc(viewDir, sunDirection, sunAngularRadius, margin) ||
+                              nearDisc(viewDir, moonDirection, moonAngularRadius, margin) ||
+                              abs(asin(clamp(viewDir.z,-1.,1.))-horizonElevation) < margin;
+    if(markingFullResolutionPixels)
+    {
+        if(!needFullResolution) discard;
+        luminance=vec4(0);
+        return;
+    }
+
+    // Luminance varies roughly exponentially across the sky, so interpolate its logarithm
+    const vec4 tiny=vec4(1e-30);
+    vec4 logV00=log(max(v00,tiny)), logV10=log(max(v10,tiny));
+    vec4 logV01=log(max(v01,tiny)), logV11=log(max(v11,tiny));
+    luminance=exp(mix(mix(logV00,logV10,frac.x), mix(logV01,logV11,frac.x), frac.y));
+}
+)");
+        link(program, QObject::tr("upsampling shader program"));
+        ++loadingStepsDone_; return;
+    }
+
+    if(!(pendingShaderGroups_ & SG_LIGHT_POLLUTION))
+        loadLightPollutionShaders(countStepsOnly);
+}
+
+// Programs of one single scattering render mode. In lazy mode, only the mode used by the settings is loaded with the
+// rest of the data, see neededShaderGroups().
+void AtmosphereRenderer::loadSingleScatteringShaders(const CountStepsOnly countStepsOnly, const int renderMode)
+{
+    auto& programsPerScatterer=*singleScatteringPrograms_[renderMode];
+    if(countStepsOnly)
+    {
+        ++totalLoadingStepsToDo_;
+    }
+    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+    {
+        programsPerScatterer.clear();
+        ++loadingStepsDone_; return;
+    }
+
+    for(const auto& scatterer : params_.scatterers)
+    {
+        auto& programs=programsPerScatterer[scatterer.name];
+        if(scatterer.phaseFunctionType==PhaseFunctionType::General || renderMode==SSRM_ON_THE_FLY)
+        {
+            for(unsigned wlSetIndex=0; wlSetIndex<wlSetProgramCount(); ++wlSetIndex)
+            {
+                if(countStepsOnly)
+                {
+                    ++totalLoadingStepsToDo_;
+                    continue;
+                }
+                if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
+                    continue;
+
+                const auto scatDir=QString("%1/shaders/single-scattering/%2/%3/%4").arg(pathToData_)
+                                                                                   .arg(singleScatteringRenderModeNames[renderMode])
+                                                                                   .arg(wlSetIndex)
+                                                                                   .arg(scatterer.name);
+                programs.emplace_back(loadViewDirProgram(scatDir, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name),
+                                                         AllWavelengthSets{useTextureArrays_}));
+                ++loadingStepsDone_; return;
+            }
+        }
+        else
+        {
+            if(countStepsOnly)
+            {
+                ++totalLoadingStepsToDo_;
+                continue;
+            }
+            if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
+                continue;
+
+            const auto scatDir=QString("%1/shaders/single-scattering/%2/%3").arg(pathToData_)
+                                                                            .arg(singleScatteringRenderModeNames[renderMode])
+                                                                            .arg(scatterer.name);
+            programs.emplace_back(loadViewDirProgram(scatDir, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name)));
+            ++loadingStepsDone_; return;
+        }
+    }
+}
+
+// Programs only needed when Settings::lightPollutionGroundLuminance() returns nonzero
+void AtmosphereRenderer::loadLightPollutionShaders(const CountStepsOnly countStepsOnly)
+{
+    const bool perWlSetPrograms = QFile::exists(pathToData_+"/shaders/light-pollution/0/");
+    if(countStepsOnly)
+    {
+        ++totalLoadingStepsToDo_;
+    }
+    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+    {
+        lightPollutionPrograms_.clear();
+        // Luminance data have a single program and texture, even with texture arrays
+        lightPollutionWlSetCount_ = perWlSetPrograms ? params_.allWavelengths.size() : 1;
+        ++loadingStepsDone_; return;
+    }
+    if(perWlSetPrograms)
+    {
+        for(unsigned wlSetIndex=0; wlSetIndex<wlSetProgramCount(); ++wlSetIndex)
+        {
+            if(countStepsOnly)
+            {
+                ++totalLoadingStepsToDo_;
+                continue;
+            }
+            if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
+                continue;
+
+            const auto wlDir=QString("%1/shaders/light-pollution/%2").arg(pathToData_).arg(wlSetIndex);
+            lightPollutionPrograms_.emplace_back(loadViewDirProgram(wlDir, QObject::tr("light pollution shader program"),
+                                                                    AllWavelengthSets{useTextureArrays_}));
+            ++loadingStepsDone_; return;
+        }
+    }
+    else
+    {
+        if(countStepsOnly)
+        {
+            ++totalLoadingStepsToDo_;
+        }
+        else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+        {
+            const auto wlDir=pathToData_+"/shaders/light-pollution/";
+            lightPollutionPrograms_.emplace_back(loadViewDirProgram(wlDir, QObject::tr("light pollution shader program")));
+            ++loadingStepsDone_; return;
+        }
+    }
+}
+
+// Programs only needed when Settings::usingEclipseShader() returns true
+void AtmosphereRenderer::loadEclipseShaders(const CountStepsOnly countStepsOnly)
+{
+    if(countStepsOnly)
+    {
+        ++totalLoadingStepsToDo_;
+
+        // Dummy values so that the loop below doesn't index empty vector
+        eclipsedSingleScatteringPrograms_.clear();
+        for(int renderMode=SSRM_ON_THE_FLY; renderMode<SSRM_COUNT; ++renderMode)
+            eclipsedSingleScatteringPrograms_.emplace_back(std::make_unique<ScatteringProgramsMap>());
     }
     else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
     {
@@ -885,7 +1577,7 @@ void AtmosphereRenderer::loadShaders(const CountStepsOnly countStepsOnly)
             auto& programs=programsPerScatterer[scatterer.name];
             if(scatterer.phaseFunctionType==PhaseFunctionType::General || renderMode==SSRM_ON_THE_FLY)
             {
-                for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
+                for(unsigned wlSetIndex=0; wlSetIndex<wlSetProgramCount(); ++wlSetIndex)
                 {
                     if(countStepsOnly)
                     {
@@ -899,18 +1591,8 @@ void AtmosphereRenderer::loadShaders(const CountStepsOnly countStepsOnly)
                                                                                                 .arg(singleScatteringRenderModeNames[renderMode])
                                                                                                 .arg(wlSetIndex)
                                                                                                 .arg(scatterer.name);
-                    qDebug().nospace() << "Loading shaders from " << scatDir << "...";
-                    auto& program=*programs.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-
-                    for(const auto& shaderFile : fs::directory_iterator(fs::u8path(scatDir.toStdString())))
-                        addShaderFile(program,QOpenGLShader::Fragment,shaderFile.path());
-
-                    program.addShader(viewDirFragShader_.get());
-                    program.addShader(viewDirVertShader_.get());
-                    for(const auto& b : viewDirBindAttribLocations_)
-                        program.bindAttributeLocation(b.first.c_str(), b.second);
-
-                    link(program, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name));
+                    programs.emplace_back(loadViewDirProgram(scatDir, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name),
+                                                             AllWavelengthSets{useTextureArrays_}));
                     ++loadingStepsDone_; return;
                 }
             }
@@ -927,18 +1609,7 @@ void AtmosphereRenderer::loadShaders(const CountStepsOnly countStepsOnly)
                 const auto scatDir=QString("%1/shaders/single-scattering-eclipsed/%2/%3").arg(pathToData_)
                                                                                             .arg(singleScatteringRenderModeNames[renderMode])
                                                                                             .arg(scatterer.name);
-                qDebug().nospace() << "Loading shaders from " << scatDir << "...";
-                auto& program=*programs.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-
-                for(const auto& shaderFile : fs::directory_iterator(fs::u8path(scatDir.toStdString())))
-                    addShaderFile(program,QOpenGLShader::Fragment,shaderFile.path());
-
-                program.addShader(viewDirFragShader_.get());
-                program.addShader(viewDirVertShader_.get());
-                for(const auto& b : viewDirBindAttribLocations_)
-                    program.bindAttributeLocation(b.first.c_str(), b.second);
-
-                link(program, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name));
+                programs.emplace_back(loadViewDirProgram(scatDir, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name)));
                 ++loadingStepsDone_; return;
             }
         }
@@ -982,7 +1653,7 @@ void main()
     for(const auto& scatterer : params_.scatterers)
     {
         auto& programs=(*eclipsedSingleScatteringPrecomputationPrograms_)[scatterer.name];
-        for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
+        for(unsigned wlSetIndex=0; wlSetIndex<wlSetProgramCount(); ++wlSetIndex)
         {
             if(countStepsOnly)
             {
@@ -995,15 +1666,8 @@ void main()
             const auto scatDir=QString("%1/shaders/single-scattering-eclipsed/precomputation/%3/%4").arg(pathToData_)
                                                                                                     .arg(wlSetIndex)
                                                                                                     .arg(scatterer.name);
-            qDebug().nospace() << "Loading shaders from " << scatDir << "...";
-            auto& program=*programs.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-
-            for(const auto& shaderFile : fs::directory_iterator(fs::u8path(scatDir.toStdString())))
-                addShaderFile(program,QOpenGLShader::Fragment,shaderFile.path());
-
-            program.addShader(precomputationProgramsVertShader_.get());
-
-            link(program, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name));
+            programs.emplace_back(loadPrecomputationProgram(scatDir, QObject::tr("shader program for scatterer \"%1\"").arg(scatterer.name),
+                                                         AllWavelengthSets{useTextureArrays_}));
             ++loadingStepsDone_; return;
         }
     }
@@ -1031,18 +1695,7 @@ void main()
                 continue;
 
             const auto scatDir=QString("%1/shaders/double-scattering-eclipsed/precomputed/%2").arg(pathToData_).arg(wlSetIndex);
-            qDebug().nospace() << "Loading shaders from " << scatDir << "...";
-            auto& program=*eclipsedDoubleScatteringPrecomputedPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-
-            for(const auto& shaderFile : fs::directory_iterator(fs::u8path(scatDir.toStdString())))
-                addShaderFile(program,QOpenGLShader::Fragment,shaderFile.path());
-
-            program.addShader(viewDirFragShader_.get());
-            program.addShader(viewDirVertShader_.get());
-            for(const auto& b : viewDirBindAttribLocations_)
-                program.bindAttributeLocation(b.first.c_str(), b.second);
-
-            link(program, QObject::tr("precomputed eclipsed double scattering shader program"));
+            eclipsedDoubleScatteringPrecomputedPrograms_.emplace_back(loadViewDirProgram(scatDir, QObject::tr("precomputed eclipsed double scattering shader program")));
             ++loadingStepsDone_; return;
         }
     }
@@ -1055,18 +1708,7 @@ void main()
         else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
         {
             const auto scatDir=QString("%1/shaders/double-scattering-eclipsed/precomputed").arg(pathToData_);
-            qDebug().nospace() << "Loading shaders from " << scatDir << "...";
-            auto& program=*eclipsedDoubleScatteringPrecomputedPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-
-            for(const auto& shaderFile : fs::directory_iterator(fs::u8path(scatDir.toStdString())))
-                addShaderFile(program,QOpenGLShader::Fragment,shaderFile.path());
-
-            program.addShader(viewDirFragShader_.get());
-            program.addShader(viewDirVertShader_.get());
-            for(const auto& b : viewDirBindAttribLocations_)
-                program.bindAttributeLocation(b.first.c_str(), b.second);
-
-            link(program, QObject::tr("precomputed eclipsed double scattering shader program"));
+            eclipsedDoubleScatteringPrecomputedPrograms_.emplace_back(loadViewDirProgram(scatDir, QObject::tr("precomputed eclipsed double scattering shader program")));
             ++loadingStepsDone_; return;
         }
     }
@@ -1092,103 +1734,7 @@ void main()
             continue;
 
         const auto scatDir=QString("%1/shaders/double-scattering-eclipsed/precomputation/%2").arg(pathToData_).arg(wlSetIndex);
-        qDebug().nospace() << "Loading shaders from " << scatDir << "...";
-        auto& program=*eclipsedDoubleScatteringPrecomputationPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-
-        for(const auto& shaderFile : fs::directory_iterator(fs::u8path(scatDir.toStdString())))
-            addShaderFile(program,QOpenGLShader::Fragment,shaderFile.path());
-
-        program.addShader(precomputationProgramsVertShader_.get());
-
-        link(program, QObject::tr("on-the-fly eclipsed double scattering shader program"));
-        ++loadingStepsDone_; return;
-    }
-
-    if(countStepsOnly)
-    {
-        ++totalLoadingStepsToDo_;
-    }
-    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
-    {
-        multipleScatteringPrograms_.clear();
-        ++loadingStepsDone_; return;
-    }
-    if(QFile::exists(pathToData_+"/shaders/multiple-scattering/0/"))
-    {
-        for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
-        {
-            if(countStepsOnly)
-            {
-                ++totalLoadingStepsToDo_;
-                continue;
-            }
-            if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
-                continue;
-
-            auto& program=*multipleScatteringPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-            const auto wlDir=QString("%1/shaders/multiple-scattering/%2").arg(pathToData_).arg(wlSetIndex);
-            qDebug().nospace() << "Loading shaders from " << wlDir << "...";
-            for(const auto& shaderFile : fs::directory_iterator(fs::u8path(wlDir.toStdString())))
-                addShaderFile(program, QOpenGLShader::Fragment, shaderFile.path());
-            program.addShader(viewDirFragShader_.get());
-            program.addShader(viewDirVertShader_.get());
-            for(const auto& b : viewDirBindAttribLocations_)
-                program.bindAttributeLocation(b.first.c_str(), b.second);
-            link(program, QObject::tr("multiple scattering shader program"));
-            ++loadingStepsDone_; return;
-        }
-    }
-    else
-    {
-        if(countStepsOnly)
-        {
-            ++totalLoadingStepsToDo_;
-        }
-        else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
-        {
-            auto& program=*multipleScatteringPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-            const auto wlDir=pathToData_+"/shaders/multiple-scattering/";
-            qDebug().nospace() << "Loading shaders from " << wlDir << "...";
-            for(const auto& shaderFile : fs::directory_iterator(fs::u8path(wlDir.toStdString())))
-                addShaderFile(program, QOpenGLShader::Fragment, shaderFile.path());
-            program.addShader(viewDirFragShader_.get());
-            program.addShader(viewDirVertShader_.get());
-            for(const auto& b : viewDirBindAttribLocations_)
-                program.bindAttributeLocation(b.first.c_str(), b.second);
-            link(program, QObject::tr("multiple scattering shader program"));
-            ++loadingStepsDone_; return;
-        }
-    }
-
-    if(countStepsOnly)
-    {
-        ++totalLoadingStepsToDo_;
-    }
-    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
-    {
-        zeroOrderScatteringPrograms_.clear();
-        ++loadingStepsDone_; return;
-    }
-    for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
-    {
-        if(countStepsOnly)
-        {
-            ++totalLoadingStepsToDo_;
-            continue;
-        }
-        if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
-            continue;
-
-        auto& program=*zeroOrderScatteringPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-        const auto wlDir=QString("%1/shaders/zero-order-scattering/%2").arg(pathToData_).arg(wlSetIndex);
-        qDebug().nospace() << "Loading shaders from " << wlDir << "...";
-        for(const auto& shaderFile : fs::directory_iterator(fs::u8path(wlDir.toStdString())))
-            addShaderFile(program, QOpenGLShader::Fragment, shaderFile.path());
-        program.addShader(viewDirFragShader_.get());
-        program.addShader(viewDirVertShader_.get());
-        for(const auto& b : viewDirBindAttribLocations_)
-            program.bindAttributeLocation(b.first.c_str(), b.second);
-        link(program, QObject::tr("zero-order scattering shader program"));
+        eclipsedDoubleScatteringPrecomputationPrograms_.emplace_back(loadPrecomputationProgram(scatDir, QObject::tr("on-the-fly eclipsed double scattering shader program")));
         ++loadingStepsDone_; return;
     }
 
@@ -1201,7 +1747,7 @@ void main()
         eclipsedZeroOrderScatteringPrograms_.clear();
         ++loadingStepsDone_; return;
     }
-    for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
+    for(unsigned wlSetIndex=0; wlSetIndex<wlSetProgramCount(); ++wlSetIndex)
     {
         if(countStepsOnly)
         {
@@ -1211,102 +1757,55 @@ void main()
         if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
             continue;
 
-        auto& program=*eclipsedZeroOrderScatteringPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
         const auto wlDir=QString("%1/shaders/eclipsed-zero-order-scattering/%2").arg(pathToData_).arg(wlSetIndex);
-        qDebug().nospace() << "Loading shaders from " << wlDir << "...";
-        for(const auto& shaderFile : fs::directory_iterator(fs::u8path(wlDir.toStdString())))
-            addShaderFile(program, QOpenGLShader::Fragment, shaderFile.path());
-        program.addShader(viewDirFragShader_.get());
-        program.addShader(viewDirVertShader_.get());
-        for(const auto& b : viewDirBindAttribLocations_)
-            program.bindAttributeLocation(b.first.c_str(), b.second);
-        link(program, QObject::tr("eclipsed zero-order scattering shader program"));
+        eclipsedZeroOrderScatteringPrograms_.emplace_back(loadViewDirProgram(wlDir, QObject::tr("eclipsed zero-order scattering shader program"),
+                                                                              AllWavelengthSets{useTextureArrays_}));
         ++loadingStepsDone_; return;
     }
+}
 
-    if(countStepsOnly)
-    {
-        ++totalLoadingStepsToDo_;
-    }
-    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
-    {
-        viewDirectionGetterProgram_=std::make_unique<QOpenGLShaderProgram>();
-        auto& program=*viewDirectionGetterProgram_;
-        program.addShader(viewDirFragShader_.get());
-        program.addShader(viewDirVertShader_.get());
-        for(const auto& b : viewDirBindAttribLocations_)
-            program.bindAttributeLocation(b.first.c_str(), b.second);
-        addShaderCode(program, QOpenGLShader::Fragment, QObject::tr("fragment shader for view direction getter"), 1+R"(
-#version 330
-
-in vec3 position;
-out vec3 viewDir;
-
-vec3 calcViewDir();
-void main()
+void AtmosphereRenderer::loadShaders(const CountStepsOnly countStepsOnly)
 {
-    viewDir=calcViewDir();
+    const auto stepsDoneBefore = loadingStepsDone_;
+    loadCoreShaders(countStepsOnly);
+    if(loadingStepsDone_ != stepsDoneBefore) // proceed only if previous function has nothing left to do
+        return;
+    // In lazy mode the deferred programs are loaded on demand or warmed up later, see stepDeferredShadersLoading()
+    if(!(pendingShaderGroups_ & SG_ECLIPSE))
+        loadEclipseShaders(countStepsOnly);
 }
-)");
-        link(program, QObject::tr("view direction getter shader program"));
-        ++loadingStepsDone_; return;
-    }
 
-    if(countStepsOnly)
+// Loads the programs of the groups in shaderGroupsInLoading_, which were deferred by lazy loading
+void AtmosphereRenderer::loadDeferredShaders(const CountStepsOnly countStepsOnly)
+{
+    const auto stepsDoneBefore = loadingStepsDone_;
+    for(int renderMode=0; renderMode<SSRM_COUNT; ++renderMode)
     {
-        ++totalLoadingStepsToDo_;
+        if(!(shaderGroupsInLoading_ & singleScatteringShaderGroup(renderMode)))
+            continue;
+        loadSingleScatteringShaders(countStepsOnly, renderMode);
+        if(loadingStepsDone_ != stepsDoneBefore)
+            return;
     }
-    else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
+    if(shaderGroupsInLoading_ & SG_LIGHT_POLLUTION)
     {
-        lightPollutionPrograms_.clear();
-        ++loadingStepsDone_; return;
+        loadLightPollutionShaders(countStepsOnly);
+        if(loadingStepsDone_ != stepsDoneBefore)
+            return;
     }
-    if(QFile::exists(pathToData_+"/shaders/light-pollution/0/"))
-    {
-        for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
-        {
-            if(countStepsOnly)
-            {
-                ++totalLoadingStepsToDo_;
-                continue;
-            }
-            if(++currentLoadingIterationStepCounter_ <= loadingStepsDone_)
-                continue;
+    if(shaderGroupsInLoading_ & SG_ECLIPSE)
+        loadEclipseShaders(countStepsOnly);
+}
 
-            auto& program=*lightPollutionPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-            const auto wlDir=QString("%1/shaders/light-pollution/%2").arg(pathToData_).arg(wlSetIndex);
-            qDebug().nospace() << "Loading shaders from " << wlDir << "...";
-            for(const auto& shaderFile : fs::directory_iterator(fs::u8path(wlDir.toStdString())))
-                addShaderFile(program, QOpenGLShader::Fragment, shaderFile.path());
-            program.addShader(viewDirFragShader_.get());
-            program.addShader(viewDirVertShader_.get());
-            for(const auto& b : viewDirBindAttribLocations_)
-                program.bindAttributeLocation(b.first.c_str(), b.second);
-            link(program, QObject::tr("light pollution shader program"));
-            ++loadingStepsDone_; return;
-        }
-    }
-    else
-    {
-        if(countStepsOnly)
-        {
-            ++totalLoadingStepsToDo_;
-        }
-        else if(++currentLoadingIterationStepCounter_ > loadingStepsDone_)
-        {
-            auto& program=*lightPollutionPrograms_.emplace_back(std::make_unique<QOpenGLShaderProgram>());
-            const auto wlDir=pathToData_+"/shaders/light-pollution/";
-            qDebug().nospace() << "Loading shaders from " << wlDir << "...";
-            for(const auto& shaderFile : fs::directory_iterator(fs::u8path(wlDir.toStdString())))
-                addShaderFile(program, QOpenGLShader::Fragment, shaderFile.path());
-            program.addShader(viewDirFragShader_.get());
-            program.addShader(viewDirVertShader_.get());
-            for(const auto& b : viewDirBindAttribLocations_)
-                program.bindAttributeLocation(b.first.c_str(), b.second);
-            link(program, QObject::tr("light pollution shader program"));
-            ++loadingStepsDone_; return;
-        }
-    }
+// Groups of programs that the current settings need for rendering
+unsigned AtmosphereRenderer::neededShaderGroups() const
+{
+    unsigned groups = singleScatteringShaderGroup(tools_->onTheFlySingleScatteringEnabled() ? SSRM_ON_THE_FLY : SSRM_PRECOMPUTED);
+    if(tools_->lightPollutionGroundLuminance())
+        groups |= SG_LIGHT_POLLUTION;
+    if(tools_->usingEclipseShader())
+        groups |= SG_ECLIPSE;
+    return groups;
 }
 
 void AtmosphereRenderer::setupBuffers()
@@ -1330,6 +1829,154 @@ void AtmosphereRenderer::setupBuffers()
     gl.glVertexAttribPointer(attribIndex, coordsPerVertex, GL_FLOAT, false, 0, 0);
     gl.glEnableVertexAttribArray(attribIndex);
     gl.glBindVertexArray(0);
+
+    gl.glGenBuffers(1, &perFrameUBO_);
+    gl.glBindBuffer(GL_UNIFORM_BUFFER, perFrameUBO_);
+    gl.glBufferData(GL_UNIFORM_BUFFER, sizeof(PerFrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    gl.glGenBuffers(1, &perWavelengthSetUBO_);
+    gl.glBindBuffer(GL_UNIFORM_BUFFER, perWavelengthSetUBO_);
+    gl.glBufferData(GL_UNIFORM_BUFFER, params_.allWavelengths.size()*sizeof(QVector4D), nullptr, GL_DYNAMIC_DRAW);
+    gl.glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    solarIrradianceFixupChanged_=true;
+}
+
+void AtmosphereRenderer::ShaderProgram::resolveUniforms(QOpenGLFunctions_3_3_Core& gl)
+{
+    sunAngularRadiusLoc                    = uniformLocation("sunAngularRadius");
+    useInterpolationGuidesLoc              = uniformLocation("useInterpolationGuides");
+    eclipsedDoubleScatteringTextureSizeLoc = uniformLocation("eclipsedDoubleScatteringTextureSize");
+    radianceToLuminancesLoc                = uniformLocation("radianceToLuminances");
+    firstWLSetIndexInPassLoc               = uniformLocation("firstWLSetIndexInPass");
+    wlSetsInPassLoc                        = uniformLocation("wlSetsInPass");
+    wlSetIndexLoc                          = uniformLocation("wlSetIndex");
+    cameraPositionLoc                      = uniformLocation("cameraPosition");
+    sunDirectionLoc                        = uniformLocation("sunDirection");
+    moonPositionLoc                        = uniformLocation("moonPosition");
+    lightPollutionGroundLuminanceLoc       = uniformLocation("lightPollutionGroundLuminance");
+    pseudoMirrorSkyBelowHorizonLoc         = uniformLocation("pseudoMirrorSkyBelowHorizon");
+    solarIrradianceFixupLoc                = uniformLocation("solarIrradianceFixup");
+
+    const auto perFrameBlockIndex = gl.glGetUniformBlockIndex(programId(), "PerFrameUniforms");
+    if(perFrameBlockIndex != GL_INVALID_INDEX)
+        gl.glUniformBlockBinding(programId(), perFrameBlockIndex, PER_FRAME_UNIFORMS_BINDING);
+    const auto perWLSetBlockIndex = gl.glGetUniformBlockIndex(programId(), "PerWavelengthSetUniforms");
+    if(perWLSetBlockIndex != GL_INVALID_INDEX)
+        gl.glUniformBlockBinding(programId(), perWLSetBlockIndex, PER_WAVELENGTH_SET_UNIFORMS_BINDING);
+    usesUniformBlocks = perFrameBlockIndex != GL_INVALID_INDEX;
+
+    // Each sampler always uses the same texture unit, so there's no need to set them on each draw
+    static constexpr std::pair<const char*, GLint> samplerUnits[] =
+    {
+        {"transmittanceTexture", 0},
+        {"irradianceTexture", 1},
+        {"scatteringTexture", 0},
+        {"scatteringTextureInterpolationGuides01", 1},
+        {"scatteringTextureInterpolationGuides02", 2},
+        {"eclipsedScatteringTexture", 0},
+        {"eclipsedDoubleScatteringTexture", 0},
+        {"lightPollutionScatteringTexture", 0},
+    };
+    bind();
+    for(const auto& [name, unit] : samplerUnits)
+    {
+        if(const auto location = uniformLocation(name); location >= 0)
+            setUniformValue(location, unit);
+    }
+    if(const auto location = uniformLocation("scatteringTextures"); location >= 0)
+    {
+        std::array<GLint, maxWLSetsPerPass> units;
+        for(unsigned i = 0; i < units.size(); ++i)
+            units[i] = i;
+        setUniformValueArray(location, units.data(), units.size());
+    }
+    release();
+}
+
+// Collects the inputs of draw() that may change without the renderer being notified
+std::vector<double> AtmosphereRenderer::frameState(const double brightness) const
+{
+    std::vector<double> state
+    {
+        brightness,
+        tools_->altitude(),
+        tools_->sunAzimuth(),
+        tools_->sunZenithAngle(),
+        tools_->sunAngularRadius(),
+        tools_->moonAzimuth(),
+        tools_->moonZenithAngle(),
+        tools_->earthMoonDistance(),
+        tools_->lightPollutionGroundLuminance(),
+        double(tools_->zeroOrderScatteringEnabled()),
+        double(tools_->singleScatteringEnabled()),
+        double(tools_->multipleScatteringEnabled()),
+        double(tools_->onTheFlySingleScatteringEnabled()),
+        double(tools_->onTheFlyPrecompDoubleScatteringEnabled()),
+        double(tools_->textureFilteringEnabled()),
+        double(tools_->usingEclipseShader()),
+        double(tools_->pseudoMirrorEnabled()),
+        double(viewportSize_.width()),
+        double(viewportSize_.height()),
+    };
+    for(const auto& [name, enabled] : scatterersEnabledStates_)
+        state.push_back(enabled);
+    for(const auto& fixup : solarIrradianceFixup_)
+        for(int i=0; i<4; ++i)
+            state.push_back(fixup[i]);
+    return state;
+}
+
+void AtmosphereRenderer::updateUniformBuffers()
+{
+    auto& u = perFrameUniforms_;
+    const auto camPos = cameraPosition(), sunDir = sunDirection(), moonPos = moonPosition();
+    for(int i = 0; i < 3; ++i)
+    {
+        u.cameraPosition[i] = camPos[i];
+        u.sunDirection[i] = sunDir[i];
+        u.moonPosition[i] = moonPos[i];
+    }
+    u.lightPollutionGroundLuminance = tools_->lightPollutionGroundLuminance();
+    u.pseudoMirrorSkyBelowHorizon = tools_->pseudoMirrorEnabled();
+
+    gl.glBindBuffer(GL_UNIFORM_BUFFER, perFrameUBO_);
+    gl.glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof u, &u);
+    if(solarIrradianceFixupChanged_)
+    {
+        static_assert(sizeof(QVector4D) == 4*sizeof(GLfloat)); // std140 stride of vec4 array
+        std::vector<QVector4D> fixups(params_.allWavelengths.size(), QVector4D(1,1,1,1));
+        std::copy_n(solarIrradianceFixup_.begin(), std::min(fixups.size(), solarIrradianceFixup_.size()), fixups.begin());
+        gl.glBindBuffer(GL_UNIFORM_BUFFER, perWavelengthSetUBO_);
+        gl.glBufferSubData(GL_UNIFORM_BUFFER, 0, fixups.size()*sizeof fixups[0], fixups.data());
+        solarIrradianceFixupChanged_ = false;
+    }
+    gl.glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    gl.glBindBufferBase(GL_UNIFORM_BUFFER, PER_FRAME_UNIFORMS_BINDING, perFrameUBO_);
+    gl.glBindBufferBase(GL_UNIFORM_BUFFER, PER_WAVELENGTH_SET_UNIFORMS_BINDING, perWavelengthSetUBO_);
+}
+
+void AtmosphereRenderer::setPerDrawUniforms(ShaderProgram& prog, const unsigned wlSetIndex)
+{
+    prog.setUniformValue(prog.sunAngularRadiusLoc, float(tools_->sunAngularRadius()));
+    gl.glUniform1i(prog.wlSetIndexLoc, wlSetIndex);
+    if(prog.usesUniformBlocks) return;
+
+    // Shaders generated before the uniform blocks were introduced take all the values as plain uniforms
+    const auto& u = perFrameUniforms_;
+    gl.glUniform3fv(prog.cameraPositionLoc, 1, u.cameraPosition);
+    gl.glUniform3fv(prog.sunDirectionLoc, 1, u.sunDirection);
+    gl.glUniform3fv(prog.moonPositionLoc, 1, u.moonPosition);
+    gl.glUniform1f(prog.lightPollutionGroundLuminanceLoc, u.lightPollutionGroundLuminance);
+    gl.glUniform1i(prog.pseudoMirrorSkyBelowHorizonLoc, u.pseudoMirrorSkyBelowHorizon);
+    prog.setUniformValue(prog.solarIrradianceFixupLoc, solarIrradianceFixup(wlSetIndex));
+}
+
+// Programs may be shared with renderers that have another solar spectrum, so the fixup is set even if it's identity
+QVector4D AtmosphereRenderer::solarIrradianceFixup(const unsigned wlSetIndex) const
+{
+    if(solarIrradianceFixup_.empty())
+        return QVector4D(1,1,1,1);
+    return solarIrradianceFixup_[wlSetIndex];
 }
 
 glm::dvec3 AtmosphereRenderer::cameraPosition() const
@@ -1385,7 +2032,7 @@ QVector4D AtmosphereRenderer::getPixelLuminance(QPoint const& pixelPos)
 
 auto AtmosphereRenderer::getPixelSpectralRadiance(QPoint const& pixelPos) -> SpectralRadiance
 {
-    if(radianceRenderBuffers_.empty()) return {};
+    if(!renderingRadiance()) return {};
     if(pixelPos.x()<0 || pixelPos.y()<0 || pixelPos.x()>=viewportSize_.width() || pixelPos.y()>=viewportSize_.height())
         return {};
 
@@ -1395,10 +2042,12 @@ auto AtmosphereRenderer::getPixelSpectralRadiance(QPoint const& pixelPos) -> Spe
         for(unsigned i=0; i<wavelengthsPerPixel; ++i)
             output.wavelengths.emplace_back(wlSet[i]);
     gl.glBindFramebuffer(GL_FRAMEBUFFER, luminanceRadianceFBO_);
-    gl.glReadBuffer(GL_COLOR_ATTACHMENT1);
     for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
     {
-        gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
+        const auto group = wlSetIndex / radianceBuffersPerPass_;
+        if(int(group) != attachedRadianceGroup_)
+            attachRadianceBufferGroup(group);
+        gl.glReadBuffer(GL_COLOR_ATTACHMENT1 + wlSetIndex % radianceBuffersPerPass_);
         GLfloat data[wavelengthsPerPixel]={NAN,NAN,NAN,NAN};
         gl.glReadPixels(pixelPos.x(), viewportSize_.height()-pixelPos.y()-1, 1,1, GL_RGBA, GL_FLOAT, data);
         for(unsigned i=0; i<wavelengthsPerPixel; ++i)
@@ -1413,6 +2062,84 @@ auto AtmosphereRenderer::getPixelSpectralRadiance(QPoint const& pixelPos) -> Spe
     return output;
 }
 
+auto AtmosphereRenderer::startRadianceReadback(QRect const& region) -> std::unique_ptr<RadianceReadback>
+{
+    const QRect fullRect(QPoint(0,0), viewportSize_);
+    const auto rect = region.isNull() ? fullRect : region.intersected(fullRect);
+    if(rect.isEmpty()) return nullptr;
+
+    std::vector<QPoint> pixels;
+    pixels.reserve(size_t(rect.width())*rect.height());
+    for(int y=rect.top(); y<=rect.bottom(); ++y)
+        for(int x=rect.left(); x<=rect.right(); ++x)
+            pixels.emplace_back(x,y);
+    return issueRadianceReadback(pixels, rect);
+}
+
+auto AtmosphereRenderer::startRadianceReadback(std::vector<QPoint> const& pixels) -> std::unique_ptr<RadianceReadback>
+{
+    const QRect fullRect(QPoint(0,0), viewportSize_);
+    std::vector<QPoint> validPixels;
+    std::copy_if(pixels.begin(), pixels.end(), std::back_inserter(validPixels),
+                 [&fullRect](QPoint const& p){ return fullRect.contains(p); });
+    if(validPixels.empty()) return nullptr;
+    return issueRadianceReadback(validPixels, {});
+}
+
+// Schedules reading of all radiance buffers and of view directions into a pixel pack buffer. If rect is not null,
+// it's read with a single call per plane, otherwise each pixel is read separately.
+auto AtmosphereRenderer::issueRadianceReadback(std::vector<QPoint> const& pixels, QRect const& rect) -> std::unique_ptr<RadianceReadback>
+{
+    OGL_TRACE();
+
+    if(!renderingRadiance()) return nullptr;
+
+    GLint origDrawFBO=-1, origReadFBO=-1;
+    gl.glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &origDrawFBO);
+    gl.glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &origReadFBO);
+
+    auto readback=std::make_unique<PBORadianceReadback>(gl, getWavelengths(), pixels, rect.isNull() ? 0 : rect.width());
+    const auto readPlane=[&](const unsigned plane)
+    {
+        if(!rect.isNull())
+        {
+            gl.glReadPixels(rect.left(), viewportSize_.height()-rect.bottom()-1, rect.width(), rect.height(),
+                            GL_RGBA, GL_FLOAT, readback->offset(plane));
+            return;
+        }
+        for(unsigned i=0; i<pixels.size(); ++i)
+            gl.glReadPixels(pixels[i].x(), viewportSize_.height()-pixels[i].y()-1, 1,1, GL_RGBA, GL_FLOAT, readback->offset(plane, i));
+    };
+
+    // Render view directions first, so that all the reads are issued together
+    viewDirectionGetterProgram_->bind();
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, viewDirectionFBO_);
+    drawSurface(*viewDirectionGetterProgram_);
+
+    readback->beginReads();
+    const unsigned wlSetCount=params_.allWavelengths.size();
+    readPlane(wlSetCount);
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, luminanceRadianceFBO_);
+    for(unsigned wlSetIndex=0; wlSetIndex<wlSetCount; ++wlSetIndex)
+    {
+        const auto group = wlSetIndex / radianceBuffersPerPass_;
+        if(int(group) != attachedRadianceGroup_)
+            attachRadianceBufferGroup(group);
+        gl.glReadBuffer(GL_COLOR_ATTACHMENT1 + wlSetIndex % radianceBuffersPerPass_);
+        readPlane(wlSetIndex);
+    }
+    readback->endReads();
+
+    gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, origDrawFBO);
+    gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, origReadFBO);
+
+    if(const auto err=gl.glGetError(); err!=GL_NO_ERROR)
+        throw OpenGLError{QObject::tr("GL error while starting radiance readback: %1").arg(openglErrorString(err).c_str())};
+
+    return readback;
+}
+
 std::vector<float> AtmosphereRenderer::getWavelengths()
 {
     constexpr unsigned wavelengthsPerPixel=4;
@@ -1433,16 +2160,21 @@ void AtmosphereRenderer::setSolarSpectrum(std::vector<float> const& solarIrradia
         const auto origIrrad = toQVector(params_.solarIrradianceAtTOA[n]);
         solarIrradianceFixup_.emplace_back(newIrrad/origIrrad);
     }
+    solarIrradianceFixupChanged_=true;
 }
 
 void AtmosphereRenderer::resetSolarSpectrum()
 {
     // Simple clear() won't work because we want to reset the uniform in the programs where it's been already altered
     std::fill(solarIrradianceFixup_.begin(), solarIrradianceFixup_.end(), QVector4D(1,1,1,1));
+    solarIrradianceFixupChanged_=true;
 }
 
 auto AtmosphereRenderer::getViewDirection(QPoint const& pixelPos) -> Direction
 {
+    // The view direction buffer has a single layer
+    if(viewLayerCount_>1) return Direction{NAN, NAN};
+
     viewDirectionGetterProgram_->bind();
     gl.glBindFramebuffer(GL_FRAMEBUFFER, viewDirectionFBO_);
     drawSurface(*viewDirectionGetterProgram_);
@@ -1457,18 +2189,54 @@ auto AtmosphereRenderer::getViewDirection(QPoint const& pixelPos) -> Direction
 
 void AtmosphereRenderer::prepareRadianceFrames(const bool clear)
 {
-    if(radianceRenderBuffers_.empty()) return;
+    if(!renderingRadiance()) return;
 
-    for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
+    const unsigned groupCount = (radianceRenderBuffers_.size() + radianceBuffersPerPass_ - 1) / radianceBuffersPerPass_;
+    for(unsigned group=0; group<groupCount; ++group)
     {
-        gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
-        gl.glDrawBuffers(2, std::array<GLenum,2>{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1}.data());
-        if(clear)
-            gl.glClearBufferfv(GL_COLOR, 1, std::array<GLfloat,4>{0,0,0,0}.data());
+        const auto buffersAttached = attachRadianceBufferGroup(group);
+        if(!clear) continue;
+        for(unsigned i=0; i<buffersAttached; ++i)
+            gl.glClearBufferfv(GL_COLOR, 1+i, std::array<GLfloat,4>{0,0,0,0}.data());
     }
 }
 
+// Attaches radiance render buffers of wavelength sets [group*N, (group+1)*N) to color attachments 1..N,
+// so that switching between them doesn't need reattachment. Returns the number of buffers attached.
+unsigned AtmosphereRenderer::attachRadianceBufferGroup(const unsigned group)
+{
+    const auto firstWLSet = group*radianceBuffersPerPass_;
+    assert(firstWLSet < radianceRenderBuffers_.size());
+    const auto count = std::min<unsigned>(radianceBuffersPerPass_, radianceRenderBuffers_.size()-firstWLSet);
+    std::vector<GLenum> drawBuffers{GL_COLOR_ATTACHMENT0};
+    for(unsigned i=0; i<count; ++i)
+    {
+        gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1+i, GL_RENDERBUFFER, radianceRenderBuffers_[firstWLSet+i]);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT1+i);
+    }
+    gl.glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+    attachedRadianceGroup_ = group;
+    return count;
+}
+
+// Directs radianceOutput (location 1) of single-wavelength-set shaders to the radiance buffer of wlSetIndex
+void AtmosphereRenderer::selectRadianceRenderTarget(const unsigned wlSetIndex)
+{
+    if(!renderingRadiance()) return;
+
+    const auto group = wlSetIndex / radianceBuffersPerPass_;
+    if(int(group) != attachedRadianceGroup_)
+        attachRadianceBufferGroup(group);
+    gl.glDrawBuffers(2, std::array<GLenum,2>{GL_COLOR_ATTACHMENT0,
+                                             GLenum(GL_COLOR_ATTACHMENT1 + wlSetIndex % radianceBuffersPerPass_)}.data());
+}
+
 bool AtmosphereRenderer::canGrabRadiance() const
+{
+    return dataSupportsRadiance() && viewLayerCount_==1 && resolutionReduction_==1;
+}
+
+bool AtmosphereRenderer::dataSupportsRadiance() const
 {
     const bool haveNoLuminanceOnlySingleScatteringTextures =
         std::find_if(params_.scatterers.begin(), params_.scatterers.end(), [=](auto const& scatterer)
@@ -1478,7 +2246,7 @@ bool AtmosphereRenderer::canGrabRadiance() const
 
 bool AtmosphereRenderer::canSetSolarSpectrum() const
 {
-    return canGrabRadiance(); // condition is the same as for radiance grabbing
+    return dataSupportsRadiance(); // condition is the same as for radiance grabbing
 }
 
 bool AtmosphereRenderer::canRenderPrecomputedEclipsedDoubleScattering() const
@@ -1489,41 +2257,34 @@ bool AtmosphereRenderer::canRenderPrecomputedEclipsedDoubleScattering() const
 void AtmosphereRenderer::renderZeroOrderScattering()
 {
     OGL_TRACE();
+    if(useTextureArrays_)
+    {
+        // Texture arrays are shared by all wavelength sets, so they only need to be bound once
+        transmittanceTextures_.front()->bind(0);
+        irradianceTextures_.front()->bind(1);
+    }
     for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
     {
-        if(!radianceRenderBuffers_.empty())
-            gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
+        selectRadianceRenderTarget(wlSetIndex);
         if(tools_->usingEclipseShader())
         {
-            auto& prog=*eclipsedZeroOrderScatteringPrograms_[wlSetIndex];
+            auto& prog=wlSetProgram(eclipsedZeroOrderScatteringPrograms_, wlSetIndex);
             prog.bind();
-            prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-            prog.setUniformValue("moonPosition", toQVector(moonPosition()));
-            prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-            prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
-            transmittanceTextures_[wlSetIndex]->bind(0);
-            prog.setUniformValue("transmittanceTexture", 0);
-            prog.setUniformValue("lightPollutionGroundLuminance", float(tools_->lightPollutionGroundLuminance()));
-            prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-            if(!solarIrradianceFixup_.empty())
-                prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+            setPerDrawUniforms(prog, wlSetIndex);
+            if(!useTextureArrays_)
+                transmittanceTextures_[wlSetIndex]->bind(0);
             drawSurface(prog);
         }
         else
         {
-            auto& prog=*zeroOrderScatteringPrograms_[wlSetIndex];
+            auto& prog=wlSetProgram(zeroOrderScatteringPrograms_, wlSetIndex);
             prog.bind();
-            prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-            prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-            prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
-            transmittanceTextures_[wlSetIndex]->bind(0);
-            prog.setUniformValue("transmittanceTexture", 0);
-            irradianceTextures_[wlSetIndex]->bind(1);
-            prog.setUniformValue("irradianceTexture",1);
-            prog.setUniformValue("lightPollutionGroundLuminance", float(tools_->lightPollutionGroundLuminance()));
-            prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-            if(!solarIrradianceFixup_.empty())
-                prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+            setPerDrawUniforms(prog, wlSetIndex);
+            if(!useTextureArrays_)
+            {
+                transmittanceTextures_[wlSetIndex]->bind(0);
+                irradianceTextures_[wlSetIndex]->bind(1);
+            }
             drawSurface(prog);
         }
     }
@@ -1534,6 +2295,12 @@ void AtmosphereRenderer::precomputeEclipsedSingleScattering()
 {
     OGL_TRACE();
 
+    // The precomputation shaders address the texture via gl_FragCoord, so the viewport must cover all of it, even
+    // when the scattering passes are rendered at reduced resolution
+    GLint origViewport[4];
+    gl.glGetIntegerv(GL_VIEWPORT, origViewport);
+    gl.glViewport(0, 0, params_.eclipsedSingleScatteringTextureSize[0], params_.eclipsedSingleScatteringTextureSize[1]);
+
     gl.glBindVertexArray(vao_);
     // TODO: avoid redoing it if Sun elevation and Moon elevation and relative azimuth haven't changed
     for(const auto& scatterer : params_.scatterers)
@@ -1544,20 +2311,30 @@ void AtmosphereRenderer::precomputeEclipsedSingleScattering()
         const bool needBlending = scatterer.phaseFunctionType==PhaseFunctionType::Achromatic || scatterer.phaseFunctionType==PhaseFunctionType::Smooth;
         for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
         {
-            auto& prog=*programs[wlSetIndex];
+            auto& prog=wlSetProgram(programs, wlSetIndex);
             prog.bind();
+            prog.setUniformValue(prog.wlSetIndexLoc, int(wlSetIndex));
             prog.setUniformValue("altitude", float(tools_->altitude()));
             prog.setUniformValue("moonPositionRelativeToSunAzimuth", toQVector(moonPositionRelativeToSunAzimuth()));
             prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
             prog.setUniformValue("sunZenithAngle", float(tools_->sunZenithAngle()));
-            transmittanceTextures_[wlSetIndex]->bind(0);
+            wlSetTexture(transmittanceTextures_, wlSetIndex).bind(0);
             prog.setUniformValue("transmittanceTexture", 0);
-            if(!solarIrradianceFixup_.empty())
-                prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+            prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup(wlSetIndex));
 
-            auto& tex = needBlending ? *textures.front() : *textures[wlSetIndex];
             gl.glBindFramebuffer(GL_FRAMEBUFFER, eclipseSingleScatteringPrecomputationFBO_);
-            gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,tex.textureId(),0);
+            if(needBlending)
+            {
+                gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures.front()->textureId(),0);
+            }
+            else
+            {
+                auto& tex=wlSetTexture(textures, wlSetIndex);
+                if(useTextureArrays_)
+                    gl.glFramebufferTextureLayer(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,tex.textureId(),0,wlSetIndex);
+                else
+                    gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,tex.textureId(),0);
+            }
             checkFramebufferStatus(gl, "Eclipsed single scattering precomputation FBO");
             gl.glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
@@ -1566,7 +2343,8 @@ void AtmosphereRenderer::precomputeEclipsedSingleScattering()
         }
     }
     gl.glBindVertexArray(0);
-    gl.glBindFramebuffer(GL_FRAMEBUFFER,luminanceRadianceFBO_);
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,scatteringPassesFBO_);
+    gl.glViewport(origViewport[0], origViewport[1], origViewport[2], origViewport[3]);
     gl.glEnablei(GL_BLEND, 0);
 }
 
@@ -1574,8 +2352,11 @@ void AtmosphereRenderer::renderSingleScattering()
 {
     OGL_TRACE();
 
-    if(tools_->usingEclipseShader())
+    if(tools_->usingEclipseShader() && !reuseEclipsePrecomputations_)
+    {
+        GPUProfiler::Scope scope(gpuProfiler_, "Eclipsed single scattering precomputation");
         precomputeEclipsedSingleScattering();
+    }
 
     const auto texFilter = tools_->textureFilteringEnabled() ? QOpenGLTexture::Linear : QOpenGLTexture::Nearest;
     const auto renderMode = tools_->onTheFlySingleScatteringEnabled() ? SSRM_ON_THE_FLY : SSRM_PRECOMPUTED;
@@ -1584,26 +2365,19 @@ void AtmosphereRenderer::renderSingleScattering()
         if(!scatterersEnabledStates_.at(scatterer.name))
             continue;
 
+        GPUProfiler::Scope scope(gpuProfiler_, scatterer.name);
         if(renderMode==SSRM_ON_THE_FLY)
         {
             if(tools_->usingEclipseShader())
             {
                 for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
                 {
-                    if(!radianceRenderBuffers_.empty())
-                        gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
+                    selectRadianceRenderTarget(wlSetIndex);
 
-                    auto& prog=*eclipsedSingleScatteringPrograms_[renderMode]->at(scatterer.name)[wlSetIndex];
+                    auto& prog=wlSetProgram(eclipsedSingleScatteringPrograms_[renderMode]->at(scatterer.name), wlSetIndex);
                     prog.bind();
-                    prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-                    prog.setUniformValue("moonPosition", toQVector(moonPosition()));
-                    prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-                    prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
-                    transmittanceTextures_[wlSetIndex]->bind(0);
-                    prog.setUniformValue("transmittanceTexture", 0);
-                    prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-                    if(!solarIrradianceFixup_.empty())
-                        prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+                    setPerDrawUniforms(prog, wlSetIndex);
+                    wlSetTexture(transmittanceTextures_, wlSetIndex).bind(0);
 
                     drawSurface(prog);
                 }
@@ -1612,19 +2386,12 @@ void AtmosphereRenderer::renderSingleScattering()
             {
                 for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
                 {
-                    if(!radianceRenderBuffers_.empty())
-                        gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
+                    selectRadianceRenderTarget(wlSetIndex);
 
-                    auto& prog=*singleScatteringPrograms_[renderMode]->at(scatterer.name)[wlSetIndex];
+                    auto& prog=wlSetProgram(singleScatteringPrograms_[renderMode]->at(scatterer.name), wlSetIndex);
                     prog.bind();
-                    prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-                    prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-                    prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
-                    transmittanceTextures_[wlSetIndex]->bind(0);
-                    prog.setUniformValue("transmittanceTexture", 0);
-                    prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-                    if(!solarIrradianceFixup_.empty())
-                        prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+                    setPerDrawUniforms(prog, wlSetIndex);
+                    wlSetTexture(transmittanceTextures_, wlSetIndex).bind(0);
 
                     drawSurface(prog);
                 }
@@ -1636,24 +2403,17 @@ void AtmosphereRenderer::renderSingleScattering()
             {
                 for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
                 {
-                    if(!radianceRenderBuffers_.empty())
-                        gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
+                    selectRadianceRenderTarget(wlSetIndex);
 
-                    auto& prog=*eclipsedSingleScatteringPrograms_[renderMode]->at(scatterer.name)[wlSetIndex];
+                    auto& prog=wlSetProgram(eclipsedSingleScatteringPrograms_[renderMode]->at(scatterer.name), wlSetIndex);
                     prog.bind();
-                    prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-                    prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-                    prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
+                    setPerDrawUniforms(prog, wlSetIndex);
                     {
-                        auto& tex=*eclipsedSingleScatteringPrecomputationTextures_.at(scatterer.name)[wlSetIndex];
+                        auto& tex=wlSetTexture(eclipsedSingleScatteringPrecomputationTextures_.at(scatterer.name), wlSetIndex);
                         tex.setMinificationFilter(texFilter);
                         tex.setMagnificationFilter(texFilter);
                         tex.bind(0);
-                        prog.setUniformValue("eclipsedScatteringTexture", 0);
                     }
-                    prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-                    if(!solarIrradianceFixup_.empty())
-                        prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
 
                     drawSurface(prog);
                 }
@@ -1662,20 +2422,16 @@ void AtmosphereRenderer::renderSingleScattering()
             {
                 for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
                 {
-                    if(!radianceRenderBuffers_.empty())
-                        gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
+                    selectRadianceRenderTarget(wlSetIndex);
 
-                    auto& prog=*singleScatteringPrograms_[renderMode]->at(scatterer.name)[wlSetIndex];
+                    auto& prog=wlSetProgram(singleScatteringPrograms_[renderMode]->at(scatterer.name), wlSetIndex);
                     prog.bind();
-                    prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-                    prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-                    prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
+                    setPerDrawUniforms(prog, wlSetIndex);
                     {
-                        auto& tex=*singleScatteringTextures_.at(scatterer.name)[wlSetIndex];
+                        auto& tex=wlSetTexture(singleScatteringTextures_.at(scatterer.name), wlSetIndex);
                         tex.setMinificationFilter(texFilter);
                         tex.setMagnificationFilter(texFilter);
                         tex.bind(0);
-                        prog.setUniformValue("scatteringTexture", 0);
                     }
 
                     bool guides01Loaded = false, guides02Loaded = false;
@@ -1683,9 +2439,7 @@ void AtmosphereRenderer::renderSingleScattering()
                         const auto guidesPerWLSetIt = singleScatteringInterpolationGuidesTextures01_.find(scatterer.name);
                         if(guidesPerWLSetIt != singleScatteringInterpolationGuidesTextures01_.end())
                         {
-                            auto& tex=guidesPerWLSetIt->second[wlSetIndex];
-                            tex->bind(1);
-                            prog.setUniformValue("scatteringTextureInterpolationGuides01", 1);
+                            wlSetTexture(guidesPerWLSetIt->second, wlSetIndex).bind(1);
                             guides01Loaded = true;
                         }
                     }
@@ -1693,17 +2447,11 @@ void AtmosphereRenderer::renderSingleScattering()
                         const auto guidesPerWLSetIt = singleScatteringInterpolationGuidesTextures02_.find(scatterer.name);
                         if(guidesPerWLSetIt != singleScatteringInterpolationGuidesTextures02_.end())
                         {
-                            auto& tex=guidesPerWLSetIt->second[wlSetIndex];
-                            tex->bind(2);
-                            prog.setUniformValue("scatteringTextureInterpolationGuides02", 2);
+                            wlSetTexture(guidesPerWLSetIt->second, wlSetIndex).bind(2);
                             guides02Loaded = true;
                         }
                     }
-                    prog.setUniformValue("useInterpolationGuides", guides01Loaded && guides02Loaded);
-
-                    prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-                    if(!solarIrradianceFixup_.empty())
-                        prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+                    prog.setUniformValue(prog.useInterpolationGuidesLoc, guides01Loaded && guides02Loaded);
 
                     drawSurface(prog);
                 }
@@ -1713,17 +2461,13 @@ void AtmosphereRenderer::renderSingleScattering()
         {
             auto& prog=*singleScatteringPrograms_[renderMode]->at(scatterer.name).front();
             prog.bind();
-            prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-            prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-            prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
+            setPerDrawUniforms(prog, 0);
             {
                 auto& tex=*singleScatteringTextures_.at(scatterer.name).front();
                 tex.setMinificationFilter(texFilter);
                 tex.setMagnificationFilter(texFilter);
                 tex.bind(0);
             }
-            prog.setUniformValue("scatteringTexture", 0);
-            prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
 
             bool guides01Loaded = false, guides02Loaded = false;
             {
@@ -1732,7 +2476,6 @@ void AtmosphereRenderer::renderSingleScattering()
                 {
                     auto& tex=guidesPerWLSetIt->second.front();
                     tex->bind(1);
-                    prog.setUniformValue("scatteringTextureInterpolationGuides01", 1);
                     guides01Loaded = true;
                 }
             }
@@ -1742,11 +2485,10 @@ void AtmosphereRenderer::renderSingleScattering()
                 {
                     auto& tex=guidesPerWLSetIt->second.front();
                     tex->bind(2);
-                    prog.setUniformValue("scatteringTextureInterpolationGuides02", 2);
                     guides02Loaded = true;
                 }
             }
-            prog.setUniformValue("useInterpolationGuides", guides01Loaded && guides02Loaded);
+            prog.setUniformValue(prog.useInterpolationGuidesLoc, guides01Loaded && guides02Loaded);
 
             drawSurface(prog);
         }
@@ -1754,17 +2496,13 @@ void AtmosphereRenderer::renderSingleScattering()
         {
             auto& prog=*eclipsedSingleScatteringPrograms_[renderMode]->at(scatterer.name).front();
             prog.bind();
-            prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-            prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-            prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
+            setPerDrawUniforms(prog, 0);
             {
                 auto& tex=*eclipsedSingleScatteringPrecomputationTextures_.at(scatterer.name).front();
                 tex.setMinificationFilter(texFilter);
                 tex.setMagnificationFilter(texFilter);
                 tex.bind(0);
-                prog.setUniformValue("eclipsedScatteringTexture", 0);
             }
-            prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
 
             drawSurface(prog);
         }
@@ -1778,17 +2516,16 @@ void AtmosphereRenderer::precomputeEclipsedDoubleScattering()
     gl.glBindFramebuffer(GL_FRAMEBUFFER, eclipseDoubleScatteringPrecomputationFBO_);
     gl.glDisablei(GL_BLEND, 0);
     gl.glBindVertexArray(vao_);
-    const bool renderingNeedsLuminance = !canGrabRadiance();
+    const bool renderingNeedsLuminance = !dataSupportsRadiance();
     std::unique_ptr<EclipsedDoubleScatteringPrecomputer> precompAccumulator;
     for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
     {
         auto& prog=*eclipsedDoubleScatteringPrecomputationPrograms_[wlSetIndex];
         prog.bind();
         int unusedTextureUnitNum=0;
-        transmittanceTextures_[wlSetIndex]->bind(unusedTextureUnitNum);
+        wlSetTexture(transmittanceTextures_, wlSetIndex).bind(unusedTextureUnitNum);
         prog.setUniformValue("transmittanceTexture", unusedTextureUnitNum++);
-        if(!solarIrradianceFixup_.empty())
-            prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+        prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup(wlSetIndex));
         prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
 
         auto precomputer = std::make_unique<EclipsedDoubleScatteringPrecomputer>(gl,
@@ -1824,7 +2561,7 @@ void AtmosphereRenderer::precomputeEclipsedDoubleScattering()
         }
     }
     gl.glBindVertexArray(0);
-    gl.glBindFramebuffer(GL_FRAMEBUFFER,luminanceRadianceFBO_);
+    gl.glBindFramebuffer(GL_FRAMEBUFFER,scatteringPassesFBO_);
     gl.glEnablei(GL_BLEND, 0);
 }
 
@@ -1835,21 +2572,18 @@ void AtmosphereRenderer::renderMultipleScattering()
     const auto texFilter = tools_->textureFilteringEnabled() ? QOpenGLTexture::Linear : QOpenGLTexture::Nearest;
     if(tools_->usingEclipseShader())
     {
-        if(tools_->onTheFlyPrecompDoubleScatteringEnabled())
+        if(tools_->onTheFlyPrecompDoubleScatteringEnabled() && !reuseEclipsePrecomputations_)
+        {
+            GPUProfiler::Scope scope(gpuProfiler_, "Eclipsed double scattering precomputation");
             precomputeEclipsedDoubleScattering();
+        }
         for(unsigned wlSetIndex=0; wlSetIndex < eclipsedDoubleScatteringPrecomputedPrograms_.size(); ++wlSetIndex)
         {
-            if(!radianceRenderBuffers_.empty())
-                gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
+            selectRadianceRenderTarget(wlSetIndex);
 
             auto& prog=*eclipsedDoubleScatteringPrecomputedPrograms_[wlSetIndex];
             prog.bind();
-            prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-            prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-            prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
-            prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-            if(!solarIrradianceFixup_.empty())
-                prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+            setPerDrawUniforms(prog, wlSetIndex);
 
             if(tools_->onTheFlyPrecompDoubleScatteringEnabled())
             {
@@ -1858,9 +2592,9 @@ void AtmosphereRenderer::renderMultipleScattering()
                 tex.setMinificationFilter(texFilter);
                 tex.setMagnificationFilter(texFilter);
                 tex.bind(0);
-                prog.setUniformValue("eclipsedDoubleScatteringTexture", 0);
-                prog.setUniformValue("eclipsedDoubleScatteringTextureSize", QVector3D(params_.eclipsedDoubleScatteringTextureSize[0],
-                                                                                      params_.eclipsedDoubleScatteringTextureSize[1], 1));
+                prog.setUniformValue(prog.eclipsedDoubleScatteringTextureSizeLoc,
+                                     QVector3D(params_.eclipsedDoubleScatteringTextureSize[0],
+                                               params_.eclipsedDoubleScatteringTextureSize[1], 1));
             }
             else
             {
@@ -1870,10 +2604,33 @@ void AtmosphereRenderer::renderMultipleScattering()
                 texture.setMinificationFilter(texFilter);
                 texture.setMagnificationFilter(texFilter);
                 texture.bind(0);
-                prog.setUniformValue("eclipsedDoubleScatteringTexture", 0);
 
-                prog.setUniformValue("eclipsedDoubleScatteringTextureSize", toQVector(glm::vec3(params_.eclipsedDoubleScatteringTextureSize)));
+                prog.setUniformValue(prog.eclipsedDoubleScatteringTextureSizeLoc, toQVector(glm::vec3(params_.eclipsedDoubleScatteringTextureSize)));
+            }
+            drawSurface(prog);
+        }
+    }
+    else if(multipleScatteringMRTProgram_ && renderingRadiance())
+    {
+        auto& prog=*multipleScatteringMRTProgram_;
+        prog.bind();
+        setPerDrawUniforms(prog, 0);
+        const unsigned groupCount = (multipleScatteringTextures_.size() + radianceBuffersPerPass_ - 1) / radianceBuffersPerPass_;
+        for(unsigned group = 0; group < groupCount; ++group)
+        {
+            const auto wlSetsInPass = attachRadianceBufferGroup(group);
+            const auto firstWLSetIndex = group*radianceBuffersPerPass_;
+            for(unsigned i = 0; i < wlSetsInPass; ++i)
+            {
+                auto& tex=*multipleScatteringTextures_[firstWLSetIndex+i];
+                tex.setMinificationFilter(texFilter);
+                tex.setMagnificationFilter(texFilter);
+                tex.bind(i);
             }
+            gl.glUniformMatrix4fv(prog.radianceToLuminancesLoc, wlSetsInPass, false,
+                                  &radianceToLuminances_[firstWLSetIndex][0][0]);
+            gl.glUniform1i(prog.firstWLSetIndexInPassLoc, firstWLSetIndex);
+            gl.glUniform1i(prog.wlSetsInPassLoc, wlSetsInPass);
             drawSurface(prog);
         }
     }
@@ -1881,23 +2638,16 @@ void AtmosphereRenderer::renderMultipleScattering()
     {
         for(unsigned wlSetIndex = 0; wlSetIndex < multipleScatteringTextures_.size(); ++wlSetIndex)
         {
-            if(!radianceRenderBuffers_.empty())
-                gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
+            selectRadianceRenderTarget(wlSetIndex);
 
             auto& prog=*multipleScatteringPrograms_[wlSetIndex];
             prog.bind();
-            prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-            prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-            prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
-            prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-            if(!solarIrradianceFixup_.empty())
-                prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
+            setPerDrawUniforms(prog, wlSetIndex);
 
             auto& tex=*multipleScatteringTextures_[wlSetIndex];
             tex.setMinificationFilter(texFilter);
             tex.setMagnificationFilter(texFilter);
             tex.bind(0);
-            prog.setUniformValue("scatteringTexture", 0);
             drawSurface(prog);
         }
     }
@@ -1909,26 +2659,28 @@ void AtmosphereRenderer::renderLightPollution()
 
     const auto texFilter = tools_->textureFilteringEnabled() ? QOpenGLTexture::Linear : QOpenGLTexture::Nearest;
 
-    for(unsigned wlSetIndex = 0; wlSetIndex < lightPollutionPrograms_.size(); ++wlSetIndex)
+    if(useTextureArrays_)
     {
-        if(!radianceRenderBuffers_.empty())
-            gl.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, radianceRenderBuffers_[wlSetIndex]);
-
-        auto& prog=*lightPollutionPrograms_[wlSetIndex];
-        prog.bind();
-        prog.setUniformValue("cameraPosition", toQVector(cameraPosition()));
-        prog.setUniformValue("sunDirection", toQVector(sunDirection()));
-        prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
-        prog.setUniformValue("pseudoMirrorSkyBelowHorizon", tools_->pseudoMirrorEnabled());
-        if(!solarIrradianceFixup_.empty())
-            prog.setUniformValue("solarIrradianceFixup", solarIrradianceFixup_[wlSetIndex]);
-
-        auto& tex=*lightPollutionTextures_[wlSetIndex];
+        auto& tex=*lightPollutionTextures_.front();
         tex.setMinificationFilter(texFilter);
         tex.setMagnificationFilter(texFilter);
         tex.bind(0);
-        prog.setUniformValue("lightPollutionScatteringTexture", 0);
-        prog.setUniformValue("lightPollutionGroundLuminance", float(tools_->lightPollutionGroundLuminance()));
+    }
+    for(unsigned wlSetIndex = 0; wlSetIndex < lightPollutionWlSetCount_; ++wlSetIndex)
+    {
+        selectRadianceRenderTarget(wlSetIndex);
+
+        auto& prog=wlSetProgram(lightPollutionPrograms_, wlSetIndex);
+        prog.bind();
+        setPerDrawUniforms(prog, wlSetIndex);
+
+        if(!useTextureArrays_)
+        {
+            auto& tex=*lightPollutionTextures_[wlSetIndex];
+            tex.setMinificationFilter(texFilter);
+            tex.setMagnificationFilter(texFilter);
+            tex.bind(0);
+        }
         drawSurface(prog);
     }
 }
@@ -1939,8 +2691,19 @@ int AtmosphereRenderer::initPreparationToDraw()
 
     if(state_ == State::ReloadingTextures)
         return totalLoadingStepsToDo_;
+    if(state_ == State::LoadingDeferredShaders)
+        return deferredShadersStepsToDo_;
     if(state_ != State::ReadyToRender) return -1;
 
+    if(const auto groups = neededShaderGroups() & pendingShaderGroups_)
+    {
+        [[maybe_unused]] OGLTrace t("loading deferred shaders");
+
+        state_ = State::LoadingDeferredShaders;
+        currentActivity_=QObject::tr("Loading shaders...");
+        return stepDeferredShadersLoading(CountStepsOnly{true}, groups).stepsToDo;
+    }
+
     const auto altCoord=altitudeUnitRangeTexCoord();
     if(altCoord != altCoordToLoad_)
     {
@@ -1961,6 +2724,18 @@ auto AtmosphereRenderer::stepPreparationToDraw() -> LoadingStatus
 {
     OGL_TRACE();
 
+    if(state_ == State::LoadingDeferredShaders)
+    {
+        const auto status = stepDeferredShadersLoading(CountStepsOnly{false}, pendingShaderGroups_);
+        if(status.stepsDone < status.stepsToDo)
+            return status;
+        finalizeLoading();
+        // Altitude or other settings might have changed while we were loading, so there may be more to load
+        if(const int stepsToDo = initPreparationToDraw(); stepsToDo > 0)
+            return {0, stepsToDo};
+        return status;
+    }
+
     if(state_ != State::ReloadingTextures)
         return {0, -1};
 
@@ -1994,8 +2769,22 @@ void AtmosphereRenderer::draw(const double brightness, const bool clear)
             status = stepPreparationToDraw();
     }
 
+    lastDrawReusedFrame_=false;
     if(state_ != State::ReadyToRender) return;
 
+    if(frameCachingEnabled_)
+    {
+        auto state=frameState(brightness);
+        if(clear && frameValid_ && state==lastFrameState_)
+        {
+            lastDrawReusedFrame_=true;
+            return;
+        }
+        // An accumulated frame doesn't correspond to a single state
+        frameValid_=clear;
+        lastFrameState_=std::move(state);
+    }
+
     oglDebugMessageInsert("AtmosphereRenderer::draw() begins drawing");
 
     GLint targetFBO=-1;
@@ -2006,7 +2795,8 @@ void AtmosphereRenderer::draw(const double brightness, const bool clear)
         if(canGrabRadiance())
         {
             prepareRadianceFrames(clear);
-            gl.glEnablei(GL_BLEND, 1);
+            for(unsigned i=0; i<radianceBuffersPerPass_; ++i)
+                gl.glEnablei(GL_BLEND, 1+i);
         }
         if(clear)
         {
@@ -2014,22 +2804,119 @@ void AtmosphereRenderer::draw(const double brightness, const bool clear)
             gl.glClear(GL_COLOR_BUFFER_BIT);
         }
         gl.glEnablei(GL_BLEND, 0);
+        updateUniformBuffers();
+        gpuProfiler_.beginFrame();
+        scatteringPassesFBO_=luminanceRadianceFBO_;
+        if(reducedResolutionActive())
+            renderAtReducedResolution(brightness, clear);
+        else
+            renderScatteringPasses(brightness);
+        gpuProfiler_.endFrame();
+        gl.glDisablei(GL_BLEND, 0);
+
+        gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER,targetFBO);
+    }
+}
+
+void AtmosphereRenderer::renderScatteringPasses(const double brightness)
+{
+    gl.glBlendFunc(GL_CONSTANT_COLOR, GL_ONE);
+    gl.glBlendColor(brightness, brightness, brightness, brightness);
+    if(tools_->zeroOrderScatteringEnabled())
+    {
+        GPUProfiler::Scope scope(gpuProfiler_, "Zero-order scattering");
+        renderZeroOrderScattering();
+    }
+    if(tools_->singleScatteringEnabled())
+    {
+        GPUProfiler::Scope scope(gpuProfiler_, "Single scattering");
+        renderSingleScattering();
+    }
+    if(tools_->multipleScatteringEnabled())
+    {
+        GPUProfiler::Scope scope(gpuProfiler_, "Multiple scattering");
+        renderMultipleScattering();
+    }
+    if(tools_->lightPollutionGroundLuminance())
+    {
+        GPUProfiler::Scope scope(gpuProfiler_, "Light pollution");
+        renderLightPollution();
+    }
+}
+
+// Renders the scattering passes into the reduced-resolution target, upsamples the result into the luminance target,
+// and then repeats the passes at full resolution for the pixels the upsampling can't reproduce well. The surface is
+// drawn in the same normalized device coordinates at both resolutions, so a full-resolution pixel at window position p
+// corresponds to p*reducedSize/fullSize in the reduced-resolution target.
+void AtmosphereRenderer::renderAtReducedResolution(const double brightness, const bool clear)
+{
+    OGL_TRACE();
+
+    GLint viewport[4];
+    gl.glGetIntegerv(GL_VIEWPORT, viewport);
+    {
+        GPUProfiler::Scope scope(gpuProfiler_, "Reduced resolution passes");
+        scatteringPassesFBO_=reducedResolutionFBO_;
+        gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reducedResolutionFBO_);
+        if(clear)
         {
-            gl.glBlendFunc(GL_CONSTANT_COLOR, GL_ONE);
-            gl.glBlendColor(brightness, brightness, brightness, brightness);
-            if(tools_->zeroOrderScatteringEnabled())
-                renderZeroOrderScattering();
-            if(tools_->singleScatteringEnabled())
-                renderSingleScattering();
-            if(tools_->multipleScatteringEnabled())
-                renderMultipleScattering();
-            if(tools_->lightPollutionGroundLuminance())
-                renderLightPollution();
+            gl.glClearColor(0,0,0,0);
+            gl.glClear(GL_COLOR_BUFFER_BIT);
         }
+        gl.glViewport(0, 0, reducedResolutionSize_.width(), reducedResolutionSize_.height());
+        renderScatteringPasses(brightness);
+        gl.glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        scatteringPassesFBO_=luminanceRadianceFBO_;
+    }
+
+    gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, luminanceRadianceFBO_);
+    // Radiance render buffers may remain attached from full-resolution draws, but aren't rendered to
+    gl.glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    gl.glEnable(GL_STENCIL_TEST);
+    {
+        GPUProfiler::Scope scope(gpuProfiler_, "Upsampling");
         gl.glDisablei(GL_BLEND, 0);
+        gl.glClearStencil(0);
+        gl.glClear(GL_STENCIL_BUFFER_BIT);
 
-        gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER,targetFBO);
+        auto& prog=*upsamplingProgram_;
+        prog.bind();
+        reducedResolutionLuminanceTexture_->bind(0);
+        prog.setUniformValue("reducedLuminance", 0);
+        prog.setUniformValue("viewportSize", QVector2D(viewportSize_.width(), viewportSize_.height()));
+        prog.setUniformValue("resolutionReduction", float(resolutionReduction_));
+        prog.setUniformValue("sunDirection", toQVector(sunDirection()));
+        prog.setUniformValue("sunAngularRadius", float(tools_->sunAngularRadius()));
+        prog.setUniformValue("moonDirection", toQVector(glm::normalize(moonPosition()-cameraPosition())));
+        prog.setUniformValue("moonAngularRadius", float(std::asin(moonRadius/cameraMoonDistance())));
+        // Negative altitude would make the acos NaN. Below the ground the horizon is taken as seen from the ground.
+        const auto altitude = std::max(0., tools_->altitude());
+        const auto horizonElevation = -std::acos(params_.earthRadius/(params_.earthRadius+altitude));
+        prog.setUniformValue("horizonElevation", float(horizonElevation));
+
+        // First mark the pixels that need full resolution...
+        gl.glStencilFunc(GL_ALWAYS, 1, 0xff);
+        gl.glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        gl.glColorMask(false, false, false, false);
+        prog.setUniformValue("markingFullResolutionPixels", true);
+        drawSurface(prog);
+        gl.glColorMask(true, true, true, true);
+
+        // ...then upsample into the rest
+        gl.glStencilFunc(GL_EQUAL, 0, 0xff);
+        gl.glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        prog.setUniformValue("markingFullResolutionPixels", false);
+        drawSurface(prog);
+        gl.glEnablei(GL_BLEND, 0);
+    }
+    {
+        GPUProfiler::Scope scope(gpuProfiler_, "Full resolution passes");
+        gl.glStencilFunc(GL_EQUAL, 1, 0xff);
+        reuseEclipsePrecomputations_=true;
+        renderScatteringPasses(brightness);
+        reuseEclipsePrecomputations_=false;
     }
+    gl.glDisable(GL_STENCIL_TEST);
 }
 
 void AtmosphereRenderer::setupRenderTarget()
@@ -2044,12 +2931,22 @@ void AtmosphereRenderer::setupRenderTarget()
     luminanceRenderTargetTexture_.setMagnificationFilter(QOpenGLTexture::Nearest);
     luminanceRenderTargetTexture_.setWrapMode(QOpenGLTexture::ClampToEdge);
 
-    if(canGrabRadiance())
+    if(dataSupportsRadiance())
     {
         assert(radianceRenderBuffers_.empty());
         radianceRenderBuffers_.resize(params_.allWavelengths.size());
         gl.glGenRenderbuffers(radianceRenderBuffers_.size(), radianceRenderBuffers_.data());
 
+        // Attachment 0 is taken by luminance, the rest can hold radiance of several wavelength sets at once
+        GLint maxDrawBuffers=0, maxColorAttachments=0;
+        gl.glGetIntegerv(GL_MAX_DRAW_BUFFERS, &maxDrawBuffers);
+        gl.glGetIntegerv(GL_MAX_COLOR_ATTACHMENTS, &maxColorAttachments);
+        radianceBuffersPerPass_ = std::clamp(std::min(maxDrawBuffers, maxColorAttachments)-1, 1, int(maxWLSetsPerPass));
+        attachedRadianceGroup_ = -1;
+        radianceToLuminances_.clear();
+        for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
+            radianceToLuminances_.emplace_back(radianceToLuminance(wlSetIndex, params_.allWavelengths));
+
         gl.glGenFramebuffers(1, &viewDirectionFBO_);
         gl.glGenRenderbuffers(1, &viewDirectionRenderBuffer_);
         gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, viewDirectionFBO_);
@@ -2065,9 +2962,11 @@ void AtmosphereRenderer::setupRenderTarget()
     for(const auto& scatterer : params_.scatterers)
     {
         auto& textures=eclipsedSingleScatteringPrecomputationTextures_[scatterer.name];
+        // Radiance of all the wavelength sets goes into layers of one texture, see useTextureArrays_
+        const bool layered = useTextureArrays_ && scatterer.phaseFunctionType==PhaseFunctionType::General;
         for(unsigned wlSetIndex=0; wlSetIndex<params_.allWavelengths.size(); ++wlSetIndex)
         {
-            auto& tex=*textures.emplace_back(newTex(QOpenGLTexture::Target2D));
+            auto& tex=*textures.emplace_back(newTex(layered ? QOpenGLTexture::Target2DArray : QOpenGLTexture::Target2D));
             tex.setMinificationFilter(QOpenGLTexture::Linear);
             tex.setMagnificationFilter(QOpenGLTexture::Linear);
             // relative azimuth
@@ -2077,9 +2976,17 @@ void AtmosphereRenderer::setupRenderTarget()
             tex.bind();
             const auto width=params_.eclipsedSingleScatteringTextureSize[0];
             const auto height=params_.eclipsedSingleScatteringTextureSize[1];
-            gl.glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+            if(layered)
+            {
+                gl.glTexImage3D(GL_TEXTURE_2D_ARRAY,0,GL_RGBA32F,width,height,params_.allWavelengths.size(),
+                                0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+            }
+            else
+            {
+                gl.glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+            }
 
-            if(scatterer.phaseFunctionType!=PhaseFunctionType::General)
+            if(layered || scatterer.phaseFunctionType!=PhaseFunctionType::General)
                 break;
         }
     }
@@ -2109,6 +3016,7 @@ AtmosphereRenderer::AtmosphereRenderer(QOpenGLFunctions_3_3_Core& gl, QString co
     , drawSurfaceCallback(drawSurface)
     , pathToData_(pathToData)
     , luminanceRenderTargetTexture_(QOpenGLTexture::Target2D)
+    , gpuProfiler_(gl)
 {
     params_.parse(pathToData + "/params.atmo", AtmosphereParameters::ForceNoEDSTextures{false}, AtmosphereParameters::SkipSpectra{true});
 }
@@ -2116,6 +3024,7 @@ AtmosphereRenderer::AtmosphereRenderer(QOpenGLFunctions_3_3_Core& gl, QString co
 void AtmosphereRenderer::setDrawSurfaceCallback(std::function<void(QOpenGLShaderProgram& shprog)> const& drawSurface)
 {
     drawSurfaceCallback=drawSurface;
+    frameValid_=false;
 }
 
 int AtmosphereRenderer::initDataLoading(QByteArray viewDirVertShaderSrc, QByteArray viewDirFragShaderSrc,
@@ -2125,11 +3034,27 @@ int AtmosphereRenderer::initDataLoading(QByteArray viewDirVertShaderSrc, QByteAr
     {
         state_ = State::LoadingData;
         currentActivity_=QObject::tr("Loading textures and shaders...");
+        frameValid_=false;
         loadingStepsDone_=0;
         totalLoadingStepsToDo_=0;
 
         clearResources();
 
+        resourcePool_ = SharedResourcePool::forContext(QOpenGLContext::currentContext());
+        canonicalPathToData_ = QFileInfo(pathToData_).canonicalFilePath();
+        if(canonicalPathToData_.isEmpty())
+            canonicalPathToData_ = pathToData_;
+        // Normally read from the headers of 4D textures, but these aren't read when the textures are shared
+        numAltIntervalsIn4DTexture_ = params_.scatteringTextureSize[3]-1;
+
+        useTextureArrays_ = tools_->wavelengthSetTextureArraysEnabled() && dataSupportsTextureArrays();
+        lazyShaderLoading_ = tools_->lazyShaderLoadingEnabled();
+        pendingShaderGroups_ = lazyShaderLoading_ ? SG_ALL & ~neededShaderGroups() : 0;
+        shaderGroupsInLoading_ = 0;
+        deferredShadersStepsToDo_ = -1;
+        deferredShadersStepsDone_ = 0;
+        shaderDefinitions_ = useTextureArrays_ ? "#define WLSET_TEXTURE_ARRAYS\n" : "";
+
         viewDirVertShaderSrc_=std::move(viewDirVertShaderSrc);
         viewDirFragShaderSrc_=std::move(viewDirFragShaderSrc);
         viewDirBindAttribLocations_=std::move(viewDirBindAttribLocations);
@@ -2152,54 +3077,74 @@ void AtmosphereRenderer::setViewDirShaders(QByteArray viewDirVertShaderSrc, QByt
 {
     viewDirVertShaderSrc_ = viewDirVertShaderSrc;
     viewDirFragShaderSrc_ = viewDirFragShaderSrc;
+    viewDirBindAttribLocations_ = std::move(viewDirBindAttribLocations);
+    frameValid_ = false;
 
-    std::unique_ptr<QOpenGLShader> newVertShader(new QOpenGLShader(QOpenGLShader::Vertex));
-    std::unique_ptr<QOpenGLShader> newFragShader(new QOpenGLShader(QOpenGLShader::Fragment));
-
-    if(!newVertShader->compileSourceCode(viewDirVertShaderSrc_))
-        throw DataLoadError{QObject::tr("Failed to compile view direction vertex shader:\n%2").arg(viewDirVertShader_->log())};
-    if(!newFragShader->compileSourceCode(viewDirFragShaderSrc_))
-        throw DataLoadError{QObject::tr("Failed to compile view direction fragment shader:\n%2").arg(viewDirFragShader_->log())};
+    std::unique_ptr<QOpenGLShader> oldVertShader = std::move(viewDirVertShader_);
+    std::unique_ptr<QOpenGLShader> oldFragShader = std::move(viewDirFragShader_);
+    std::unique_ptr<QOpenGLShader> oldGeomShader = std::move(viewLayersGeomShader_);
+    try
+    {
+        compileViewDirShaders();
+    }
+    catch(...)
+    {
+        viewDirVertShader_ = std::move(oldVertShader);
+        viewDirFragShader_ = std::move(oldFragShader);
+        viewLayersGeomShader_ = std::move(oldGeomShader);
+        throw;
+    }
 
-    const auto replaceShaders = [oldVert=viewDirVertShader_.get(),
-                                 oldFrag=viewDirFragShader_.get(),
-                                 newVert=newVertShader.get(),
-                                 newFrag=newFragShader.get()](QOpenGLShaderProgram& prog, QString const& name)
+    const auto replaceShaders = [this,
+                                 oldVert=oldVertShader.get(),
+                                 oldFrag=oldFragShader.get(),
+                                 oldGeom=oldGeomShader.get()](ShaderProgPtr& prog, QString const& name)
                                 {
-                                    prog.removeShader(oldVert);
-                                    prog.removeShader(oldFrag);
-                                    prog.addShader(newVert);
-                                    prog.addShader(newFrag);
-                                    link(prog, name);
+                                    // A program used by other renderers, or built by another renderer with its own
+                                    // shader objects, can't be relinked in place, so build a new one from the files
+                                    if(prog.use_count() > 1 || !prog->shaders().contains(oldVert))
+                                    {
+                                        prog = loadViewDirProgram(prog->sourceDir, name, AllWavelengthSets{prog->allWavelengthSets});
+                                        return;
+                                    }
+                                    resourcePool_->withdraw(prog);
+                                    prog->removeShader(oldVert);
+                                    prog->removeShader(oldFrag);
+                                    if(oldGeom)
+                                        prog->removeShader(oldGeom);
+                                    addViewDirShaders(*prog);
+                                    link(*prog, name);
+                                    prog->resolveUniforms(gl);
+                                    if(!prog->sourceDir.isEmpty())
+                                        resourcePool_->share(viewDirProgramKey(prog->sourceDir, AllWavelengthSets{prog->allWavelengthSets}), prog);
                                 };
 
     for(const auto& map : singleScatteringPrograms_)
         for(auto& item : *map)
             for(auto& prog : item.second)
-                replaceShaders(*prog, QObject::tr("single scattering shader program"));
+                replaceShaders(prog, QObject::tr("single scattering shader program"));
 
     for(const auto& map : eclipsedSingleScatteringPrograms_)
         for(auto& item : *map)
             for(auto& prog : item.second)
-                replaceShaders(*prog, QObject::tr("eclipsed single scattering shader program"));
-
-    for(const auto& prog : eclipsedDoubleScatteringPrecomputedPrograms_)
-        replaceShaders(*prog, QObject::tr("eclipsed double scattering shader program"));
-    for(const auto& prog : lightPollutionPrograms_)
-        replaceShaders(*prog, QObject::tr("light pollution shader program"));
-    for(const auto& prog : zeroOrderScatteringPrograms_)
-        replaceShaders(*prog, QObject::tr("zero-order scattering shader program"));
-    for(const auto& prog : eclipsedZeroOrderScatteringPrograms_)
-        replaceShaders(*prog, QObject::tr("eclipsed zero-order scattering shader program"));
-    for(const auto& prog : multipleScatteringPrograms_)
-        replaceShaders(*prog, QObject::tr("multiple scattering shader program"));
-
-    replaceShaders(*viewDirectionGetterProgram_, QObject::tr("view direction getter shader program"));
-
-    viewDirVertShader_ = std::move(newVertShader);
-    viewDirFragShader_ = std::move(newFragShader);
-    viewDirBindAttribLocations_ = std::move(viewDirBindAttribLocations);
-
+                replaceShaders(prog, QObject::tr("eclipsed single scattering shader program"));
+
+    for(auto& prog : eclipsedDoubleScatteringPrecomputedPrograms_)
+        replaceShaders(prog, QObject::tr("eclipsed double scattering shader program"));
+    for(auto& prog : lightPollutionPrograms_)
+        replaceShaders(prog, QObject::tr("light pollution shader program"));
+    for(auto& prog : zeroOrderScatteringPrograms_)
+        replaceShaders(prog, QObject::tr("zero-order scattering shader program"));
+    for(auto& prog : eclipsedZeroOrderScatteringPrograms_)
+        replaceShaders(prog, QObject::tr("eclipsed zero-order scattering shader program"));
+    for(auto& prog : multipleScatteringPrograms_)
+        replaceShaders(prog, QObject::tr("multiple scattering shader program"));
+    if(multipleScatteringMRTProgram_)
+        replaceShaders(multipleScatteringMRTProgram_, QObject::tr("multi-wavelength-set multiple scattering shader program"));
+
+    replaceShaders(viewDirectionGetterProgram_, QObject::tr("view direction getter shader program"));
+    if(upsamplingProgram_)
+        replaceShaders(upsamplingProgram_, QObject::tr("upsampling shader program"));
 }
 
 auto AtmosphereRenderer::stepDataLoading() -> LoadingStatus
@@ -2242,6 +3187,9 @@ auto AtmosphereRenderer::stepDataLoading() -> LoadingStatus
 
 void AtmosphereRenderer::finalizeLoading()
 {
+    // Programs deferred in lazy mode must be rebuilt too when they get loaded
+    if(!pendingShaderGroups_)
+        rebuildSharedPrograms_ = false;
     currentActivity_.clear();
     totalLoadingStepsToDo_=0;
     loadingStepsDone_=0;
@@ -2275,8 +3223,31 @@ void AtmosphereRenderer::clearResources()
         gl.glDeleteFramebuffers(1, &eclipseSingleScatteringPrecomputationFBO_);
         eclipseSingleScatteringPrecomputationFBO_=0;
     }
+    if(perFrameUBO_)
+    {
+        gl.glDeleteBuffers(1, &perFrameUBO_);
+        perFrameUBO_=0;
+    }
+    if(perWavelengthSetUBO_)
+    {
+        gl.glDeleteBuffers(1, &perWavelengthSetUBO_);
+        perWavelengthSetUBO_=0;
+    }
     if(!radianceRenderBuffers_.empty())
         gl.glDeleteRenderbuffers(radianceRenderBuffers_.size(), radianceRenderBuffers_.data());
+    layeredLuminanceRenderTargetTexture_.reset();
+    if(reducedResolutionFBO_)
+    {
+        gl.glDeleteFramebuffers(1, &reducedResolutionFBO_);
+        reducedResolutionFBO_=0;
+    }
+    if(fullResolutionMaskRenderBuffer_)
+    {
+        gl.glDeleteRenderbuffers(1, &fullResolutionMaskRenderBuffer_);
+        fullResolutionMaskRenderBuffer_=0;
+    }
+    reducedResolutionLuminanceTexture_.reset();
+    gpuProfiler_.clear();
 }
 
 void AtmosphereRenderer::drawSurface(QOpenGLShaderProgram& prog)
@@ -2297,22 +3268,101 @@ void AtmosphereRenderer::resizeEvent(int width, int height)
     }
 
     viewportSize_=QSize(width,height);
+    frameValid_=false;
     if(!luminanceRadianceFBO_) return;
 
     GLint origFBO=-1;
     gl.glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &origFBO);
     gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER,luminanceRadianceFBO_);
 
-    GLint origTex=-1;
-    gl.glGetIntegerv(GL_TEXTURE_BINDING_2D, &origTex);
-    luminanceRenderTargetTexture_.bind();
+    if(viewLayerCount_>1)
+    {
+        // All the attachments of a layered framebuffer must be layered, so the radiance render buffers can't stay
+        for(unsigned i=0; i<radianceBuffersPerPass_ && !radianceRenderBuffers_.empty(); ++i)
+            gl.glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1+i, GL_RENDERBUFFER, 0);
+        attachedRadianceGroup_ = -1;
+        gl.glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        gl.glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, 0);
+
+        const auto target = cubeMapViewLayers_ ? QOpenGLTexture::TargetCubeMap : QOpenGLTexture::Target2DArray;
+        if(!layeredLuminanceRenderTargetTexture_ || layeredLuminanceRenderTargetTexture_->target()!=target)
+        {
+            layeredLuminanceRenderTargetTexture_=newTex(target);
+            layeredLuminanceRenderTargetTexture_->setMinificationFilter(QOpenGLTexture::Nearest);
+            layeredLuminanceRenderTargetTexture_->setMagnificationFilter(QOpenGLTexture::Nearest);
+            layeredLuminanceRenderTargetTexture_->setWrapMode(QOpenGLTexture::ClampToEdge);
+            layeredLuminanceRenderTargetTexture_->create();
+        }
+
+        GLint origTex=-1;
+        gl.glGetIntegerv(cubeMapViewLayers_ ? GL_TEXTURE_BINDING_CUBE_MAP : GL_TEXTURE_BINDING_2D_ARRAY, &origTex);
+        layeredLuminanceRenderTargetTexture_->bind();
+        if(cubeMapViewLayers_)
+        {
+            if(width!=height)
+                qWarning().nospace() << "AtmosphereRenderer::resizeEvent(" << width << ", " << height << "): cube map faces must be square, using width as their size";
+            for(unsigned face=0; face<6; ++face)
+                gl.glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+face,0,GL_RGBA32F,width,width,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+        }
+        else
+        {
+            gl.glTexImage3D(GL_TEXTURE_2D_ARRAY,0,GL_RGBA32F,width,height,viewLayerCount_,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+        }
+        gl.glFramebufferTexture(GL_DRAW_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,layeredLuminanceRenderTargetTexture_->textureId(),0);
+        checkFramebufferStatus(gl, "Atmosphere renderer layered FBO");
+        gl.glBindTexture(cubeMapViewLayers_ ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D_ARRAY, origTex);
+    }
+    else
+    {
+        layeredLuminanceRenderTargetTexture_.reset();
+
+        GLint origTex=-1;
+        gl.glGetIntegerv(GL_TEXTURE_BINDING_2D, &origTex);
+        luminanceRenderTargetTexture_.bind();
+
+        gl.glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+        gl.glFramebufferTexture(GL_DRAW_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,luminanceRenderTargetTexture_.textureId(),0);
+
+        if(resolutionReduction_>1)
+        {
+            if(!fullResolutionMaskRenderBuffer_)
+                gl.glGenRenderbuffers(1, &fullResolutionMaskRenderBuffer_);
+            gl.glBindRenderbuffer(GL_RENDERBUFFER, fullResolutionMaskRenderBuffer_);
+            gl.glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+            gl.glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            gl.glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, fullResolutionMaskRenderBuffer_);
+        }
+        else
+        {
+            gl.glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, 0);
+        }
+        checkFramebufferStatus(gl, "Atmosphere renderer FBO");
 
-    gl.glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
-    gl.glFramebufferTexture(GL_DRAW_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,luminanceRenderTargetTexture_.textureId(),0);
-    checkFramebufferStatus(gl, "Atmosphere renderer FBO");
+        if(resolutionReduction_>1)
+        {
+            const int reducedWidth =(width +resolutionReduction_-1)/resolutionReduction_;
+            const int reducedHeight=(height+resolutionReduction_-1)/resolutionReduction_;
+            if(!reducedResolutionLuminanceTexture_)
+            {
+                reducedResolutionLuminanceTexture_=newTex(QOpenGLTexture::Target2D);
+                reducedResolutionLuminanceTexture_->setMinificationFilter(QOpenGLTexture::Nearest);
+                reducedResolutionLuminanceTexture_->setMagnificationFilter(QOpenGLTexture::Nearest);
+                reducedResolutionLuminanceTexture_->setWrapMode(QOpenGLTexture::ClampToEdge);
+                reducedResolutionLuminanceTexture_->create();
+            }
+            reducedResolutionLuminanceTexture_->bind();
+            reducedResolutionSize_=QSize(reducedWidth, reducedHeight);
+            gl.glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,reducedWidth,reducedHeight,0,GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+            if(!reducedResolutionFBO_)
+                gl.glGenFramebuffers(1, &reducedResolutionFBO_);
+            gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reducedResolutionFBO_);
+            gl.glFramebufferTexture(GL_DRAW_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,reducedResolutionLuminanceTexture_->textureId(),0);
+            checkFramebufferStatus(gl, "Reduced resolution FBO");
+        }
+        gl.glBindTexture(GL_TEXTURE_2D, origTex);
+    }
 
     gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, origFBO);
-    gl.glBindTexture(GL_TEXTURE_2D, origTex);
 
     if(!radianceRenderBuffers_.empty())
     {
@@ -2326,6 +3376,64 @@ void AtmosphereRenderer::resizeEvent(int width, int height)
     }
 }
 
+void AtmosphereRenderer::setViewLayers(const unsigned layerCount, const bool cubeMap)
+{
+    OGL_TRACE();
+
+    if(layerCount==0 || (cubeMap && layerCount!=6))
+    {
+        qWarning().nospace() << "AtmosphereRenderer::setViewLayers(" << layerCount << ", " << cubeMap << "): invalid number of layers";
+        return;
+    }
+    if(layerCount==viewLayerCount_ && cubeMap==cubeMapViewLayers_)
+        return;
+
+    if(layerCount>1)
+    {
+        // Each layer gets a copy of the triangle with gl_Position, position, viewLayer and gl_Layer
+        constexpr GLint componentsPerVertex=4+3+1+1;
+        GLint maxLayers=0, maxVertices=0, maxComponents=0;
+        gl.glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        gl.glGetIntegerv(GL_MAX_GEOMETRY_OUTPUT_VERTICES, &maxVertices);
+        gl.glGetIntegerv(GL_MAX_GEOMETRY_TOTAL_OUTPUT_COMPONENTS, &maxComponents);
+        const auto maxLayerCount = std::min({maxLayers, maxVertices/3, maxComponents/(3*componentsPerVertex)});
+        if(GLint(layerCount) > maxLayerCount)
+        {
+            throw OpenGLError{QObject::tr("Can't render %1 view layers at once: the OpenGL implementation supports at most %2")
+                                .arg(layerCount).arg(maxLayerCount)};
+        }
+    }
+
+    viewLayerCount_ = layerCount;
+    cubeMapViewLayers_ = cubeMap;
+
+    // Nothing to relink if the shaders haven't been loaded yet: they'll be compiled for the new layer count
+    if(viewDirVertShader_)
+        setViewDirShaders(viewDirVertShaderSrc_, viewDirFragShaderSrc_, viewDirBindAttribLocations_);
+
+    // Radiance render buffers detached in layered mode are reattached by draw() as needed
+    if(luminanceRadianceFBO_)
+        resizeEvent(viewportSize_.width(), viewportSize_.height());
+}
+
+void AtmosphereRenderer::setResolutionReduction(const unsigned factor)
+{
+    OGL_TRACE();
+
+    if(factor==0)
+    {
+        qWarning() << "AtmosphereRenderer::setResolutionReduction(0): factor must be positive";
+        return;
+    }
+    if(factor==resolutionReduction_)
+        return;
+
+    resolutionReduction_ = factor;
+    // Radiance render buffers, no longer rendered to in this mode, are reattached by draw() as needed
+    if(luminanceRadianceFBO_)
+        resizeEvent(viewportSize_.width(), viewportSize_.height());
+}
+
 void AtmosphereRenderer::setScattererEnabled(QString const& name, const bool enable)
 {
     scatterersEnabledStates_[name]=enable;
@@ -2340,6 +3448,13 @@ int AtmosphereRenderer::initShaderReloading()
 
     state_ = State::ReloadingShaders;
     currentActivity_=QObject::tr("Reloading shaders...");
+    frameValid_=false;
+    rebuildSharedPrograms_ = true;
+    // Programs not needed by the current settings will be reloaded when needed
+    pendingShaderGroups_ = lazyShaderLoading_ ? SG_ALL & ~neededShaderGroups() : 0;
+    shaderGroupsInLoading_ = 0;
+    deferredShadersStepsToDo_ = -1;
+    deferredShadersStepsDone_ = 0;
     loadingStepsDone_=0;
     totalLoadingStepsToDo_=0;
     loadShaders(CountStepsOnly{true});
@@ -2362,3 +3477,63 @@ auto AtmosphereRenderer::stepShaderReloading() -> LoadingStatus
 
     return {loadingStepsDone_, totalLoadingStepsToDo_};
 }
+
+// Loads (or, if countStepsOnly, only counts the steps for) programs deferred in lazy mode. A run of the loading
+// covers the pending groups among the given ones, chosen when the run starts; a run already in progress is continued
+// regardless of groups. The step machine of loadDeferredShaders() is driven by the dedicated counters, so the regular
+// ones stay intact.
+auto AtmosphereRenderer::stepDeferredShadersLoading(const CountStepsOnly countStepsOnly, const unsigned groups) -> LoadingStatus
+{
+    if(deferredShadersStepsToDo_ < 0 && !(groups & pendingShaderGroups_))
+        return {0, 0};
+
+    const auto swapCounters = [this]
+    {
+        std::swap(loadingStepsDone_, deferredShadersStepsDone_);
+        std::swap(totalLoadingStepsToDo_, deferredShadersStepsToDo_);
+    };
+    swapCounters();
+    try
+    {
+        if(totalLoadingStepsToDo_ < 0)
+        {
+            shaderGroupsInLoading_ = groups & pendingShaderGroups_;
+            totalLoadingStepsToDo_=0;
+            loadingStepsDone_=0;
+            loadDeferredShaders(CountStepsOnly{true});
+        }
+        if(!countStepsOnly)
+        {
+            currentLoadingIterationStepCounter_=0;
+            loadDeferredShaders(CountStepsOnly{false});
+        }
+    }
+    catch(std::exception const& ex)
+    {
+        swapCounters();
+        throw DataLoadError(ex.what());
+    }
+    swapCounters();
+
+    const LoadingStatus status{deferredShadersStepsDone_, deferredShadersStepsToDo_};
+    if(deferredShadersStepsDone_ == deferredShadersStepsToDo_)
+    {
+        pendingShaderGroups_ &= ~shaderGroupsInLoading_;
+        shaderGroupsInLoading_ = 0;
+        deferredShadersStepsToDo_ = -1;
+        deferredShadersStepsDone_ = 0;
+        if(!pendingShaderGroups_)
+            rebuildSharedPrograms_ = false;
+    }
+    return status;
+}
+
+auto AtmosphereRenderer::stepShaderWarmup() -> LoadingStatus
+{
+    OGL_TRACE();
+
+    if(state_ != State::ReadyToRender)
+        return {0, -1};
+
+    return stepDeferredShadersLoading(CountStepsOnly{false}, pendingShaderGroups_);
+}
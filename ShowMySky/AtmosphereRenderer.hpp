@@ -13,11 +13,44 @@
 #include "../common/types.hpp"
 #include "../common/AtmosphereParameters.hpp"
 #include "api/ShowMySky/AtmosphereRenderer.hpp"
+#include "GPUProfiler.hpp"
+#include "PBORadianceReadback.hpp"
+#include "SharedResourcePool.hpp"
 
 class AtmosphereRenderer : public ShowMySky::AtmosphereRenderer
 {
-    using ShaderProgPtr=std::unique_ptr<QOpenGLShaderProgram>;
-    using TexturePtr=std::unique_ptr<QOpenGLTexture>;
+    //! Shader program that remembers locations of the uniforms the renderer sets on each draw
+    class ShaderProgram : public QOpenGLShaderProgram
+    {
+    public:
+        GLint sunAngularRadiusLoc=-1;
+        GLint useInterpolationGuidesLoc=-1;
+        GLint eclipsedDoubleScatteringTextureSizeLoc=-1;
+        // These are only present in the program that renders several wavelength sets per pass
+        GLint radianceToLuminancesLoc=-1;
+        GLint firstWLSetIndexInPassLoc=-1;
+        GLint wlSetsInPassLoc=-1;
+        //! Only present in the programs that render all the wavelength sets, see #allWavelengthSets
+        GLint wlSetIndexLoc=-1;
+        // These are only used by the shaders generated before the uniform blocks were introduced
+        GLint cameraPositionLoc=-1;
+        GLint sunDirectionLoc=-1;
+        GLint moonPositionLoc=-1;
+        GLint lightPollutionGroundLuminanceLoc=-1;
+        GLint pseudoMirrorSkyBelowHorizonLoc=-1;
+        GLint solarIrradianceFixupLoc=-1;
+        bool usesUniformBlocks=false;
+        //! Directory with the fragment shaders of the model, empty for the programs not loaded from the data
+        QString sourceDir;
+        //! Whether the program was built to render any wavelength set, selected by \c wlSetIndex uniform
+        bool allWavelengthSets=false;
+
+        //! Must be called after each (re)linking
+        void resolveUniforms(QOpenGLFunctions_3_3_Core& gl);
+    };
+    // Read-only textures and programs may be shared with other renderers via SharedResourcePool
+    using ShaderProgPtr=std::shared_ptr<ShaderProgram>;
+    using TexturePtr=std::shared_ptr<QOpenGLTexture>;
     using ScattererName=QString;
     QOpenGLFunctions_3_3_Core& gl;
 public:
@@ -59,12 +92,21 @@ public:
     bool canGrabRadiance() const override;
     bool canSetSolarSpectrum() const override;
     bool canRenderPrecomputedEclipsedDoubleScattering() const override;
-    GLuint getLuminanceTexture() override { return luminanceRenderTargetTexture_.textureId(); };
+    GLuint getLuminanceTexture() override
+    { return layeredLuminanceRenderTargetTexture_ ? layeredLuminanceRenderTargetTexture_->textureId()
+                                                  : luminanceRenderTargetTexture_.textureId(); };
 
     void draw(double brightness, bool clear) override;
     void resizeEvent(int width, int height) override;
+    void setViewLayers(unsigned layerCount, bool cubeMap) override;
+    void setResolutionReduction(unsigned factor) override;
+    void setFrameCachingEnabled(bool enable) override { frameCachingEnabled_=enable; frameValid_=false; }
+    void invalidateFrame() override { frameValid_=false; }
+    bool lastDrawReusedFrame() const override { return lastDrawReusedFrame_; }
     QVector4D getPixelLuminance(QPoint const& pixelPos) override;
     SpectralRadiance getPixelSpectralRadiance(QPoint const& pixelPos) override;
+    std::unique_ptr<RadianceReadback> startRadianceReadback(QRect const& region) override;
+    std::unique_ptr<RadianceReadback> startRadianceReadback(std::vector<QPoint> const& pixels) override;
     std::vector<float> getWavelengths() override;
     void setSolarSpectrum(std::vector<float> const& solarIrradianceAtTOA) override;
     void resetSolarSpectrum() override;
@@ -73,6 +115,9 @@ public:
     void setScattererEnabled(QString const& name, bool enable) override;
     int initShaderReloading() override;
     LoadingStatus stepShaderReloading() override;
+    LoadingStatus stepShaderWarmup() override;
+    void setGPUProfilingEnabled(bool enable) override { gpuProfiler_.setEnabled(enable); }
+    std::vector<GPUTimingEntry> getGPUTimings() const override { return gpuProfiler_.lastResults(); }
     AtmosphereParameters const& atmosphereParameters() const { return params_; }
 
 private: // variables
@@ -80,13 +125,31 @@ private: // variables
     std::function<void(QOpenGLShaderProgram&)> drawSurfaceCallback;
     AtmosphereParameters params_;
     QString pathToData_;
+    //! Replaces #pathToData_ in the keys of shared resources, so that different paths to the same data match
+    QString canonicalPathToData_;
     int totalLoadingStepsToDo_=-1, loadingStepsDone_=0, currentLoadingIterationStepCounter_=0;
+    //! If true, the programs not needed by the settings aren't loaded with the rest of the data, see Settings::lazyShaderLoadingEnabled()
+    bool lazyShaderLoading_=false;
+    //! Groups of programs, as ShaderGroup flags, skipped by lazy loading and not loaded since
+    unsigned pendingShaderGroups_=0;
+    //! Groups loaded by the current run of #stepDeferredShadersLoading
+    unsigned shaderGroupsInLoading_=0;
+    //! Set by #initShaderReloading to ignore shared programs until all the programs have been rebuilt from files
+    bool rebuildSharedPrograms_=false;
+    // Counters for the deferred loading of programs, separate from the ones above so that it can run while the
+    // renderer is ready to render. Negative number of steps to do means that no run is in progress.
+    int deferredShadersStepsToDo_=-1, deferredShadersStepsDone_=0;
     QString currentActivity_;
 
     QByteArray viewDirVertShaderSrc_, viewDirFragShaderSrc_;
     std::vector<std::pair<std::string,GLuint>> viewDirBindAttribLocations_;
+    //! Identifies the view direction shaders in the keys of shared programs
+    QString viewDirShadersKey_;
+    std::shared_ptr<SharedResourcePool> resourcePool_;
 
     GLuint vao_=0, vbo_=0, luminanceRadianceFBO_=0, viewDirectionFBO_=0;
+    //! The FBO that the scattering passes draw into, restored after they use other FBOs for precomputations
+    GLuint scatteringPassesFBO_=0;
     GLuint eclipseSingleScatteringPrecomputationFBO_=0;
     GLuint eclipseDoubleScatteringPrecomputationFBO_=0;
     // Lower and upper altitude slices from the 4D texture
@@ -95,24 +158,68 @@ private: // variables
     std::vector<TexturePtr> transmittanceTextures_;
     std::vector<TexturePtr> irradianceTextures_;
     std::vector<TexturePtr> lightPollutionTextures_;
+    /**
+     * If true, each of transmittance, irradiance and light pollution families, as well as the eclipsed single
+     * scattering precomputation textures of each scatterer with general phase function, is a single 2D array texture
+     * indexed by wavelength set, while the single scattering textures of each scatterer (and their interpolation
+     * guides) are stacked along depth of a single 3D texture. The programs rendering these families are then loaded
+     * once for all the wavelength sets, see ShaderProgram::allWavelengthSets.
+     */
+    bool useTextureArrays_=false;
+    //! If true, the texture array being loaded layer by layer was found in the shared pool, so its layers are skipped
+    bool reusingSharedTextureArray_=false;
+    //! Prepended to each loaded fragment shader (after the \c \#version directive)
+    QByteArray shaderDefinitions_;
     std::vector<GLuint> radianceRenderBuffers_;
+    // XXX: keep in sync with MAX_WL_SETS_PER_PASS in render.frag
+    static constexpr unsigned maxWLSetsPerPass=7;
+    //! Number of radiance render buffers attached to the FBO simultaneously (color attachments 1..N)
+    unsigned radianceBuffersPerPass_=1;
+    //! Index of the group of radiance render buffers currently attached to the FBO, -1 if none
+    int attachedRadianceGroup_=-1;
+    std::vector<glm::mat4> radianceToLuminances_;
     std::map<ScattererName,std::vector<TexturePtr>> singleScatteringInterpolationGuidesTextures01_; // VZA-dotViewSun dimensions
     std::map<ScattererName,std::vector<TexturePtr>> singleScatteringInterpolationGuidesTextures02_; // VZA-SZA dimensions
     GLuint viewDirectionRenderBuffer_=0;
-    // Indexed as singleScatteringTextures_[scattererName][wavelengthSetIndex]
+    // Indexed as singleScatteringTextures_[scattererName][wavelengthSetIndex], see also wlSetTexture()
     std::map<ScattererName,std::vector<TexturePtr>> singleScatteringTextures_;
     std::map<ScattererName,std::vector<TexturePtr>> eclipsedSingleScatteringPrecomputationTextures_;
     TexturePtr eclipsedDoubleScatteringPrecomputationScratchTexture_;
     std::vector<TexturePtr> eclipsedDoubleScatteringPrecomputationTargetTextures_;
     QOpenGLTexture luminanceRenderTargetTexture_;
+    //! Replaces #luminanceRenderTargetTexture_ as the render target when several view layers are rendered at once
+    TexturePtr layeredLuminanceRenderTargetTexture_;
+    //! Number of views rendered by each draw call, see #setViewLayers
+    unsigned viewLayerCount_=1;
+    bool cubeMapViewLayers_=false;
+    //! Ratio of full resolution to that of the scattering passes, see #setResolutionReduction
+    unsigned resolutionReduction_=1;
+    GLuint reducedResolutionFBO_=0;
+    TexturePtr reducedResolutionLuminanceTexture_;
+    QSize reducedResolutionSize_;
+    //! Stencil of #luminanceRadianceFBO_, marks the pixels that are rendered at full resolution
+    GLuint fullResolutionMaskRenderBuffer_=0;
+    //! Set while the scattering passes are repeated in the same frame, so that eclipse precomputations can be skipped
+    bool reuseEclipsePrecomputations_=false;
+
+    bool frameCachingEnabled_=false;
+    //! Whether the render targets hold a complete frame rendered for #lastFrameState_
+    bool frameValid_=false;
+    bool lastDrawReusedFrame_=false;
+    //! Everything that affects the frame besides the state changes that explicitly invalidate it, see #frameState
+    std::vector<double> lastFrameState_;
     QSize viewportSize_;
     double altCoordToLoad_=0; //!< Used to load textures for a single altitude slice, even if input altitude changes during the load
 
     std::vector<ShaderProgPtr> lightPollutionPrograms_;
+    //! Number of passes of renderLightPollution(): one per wavelength set for radiance data, one for luminance data
+    unsigned lightPollutionWlSetCount_=0;
     std::vector<ShaderProgPtr> zeroOrderScatteringPrograms_;
     std::vector<ShaderProgPtr> eclipsedZeroOrderScatteringPrograms_;
     std::vector<ShaderProgPtr> multipleScatteringPrograms_;
-    // Indexed as singleScatteringPrograms_[renderMode][scattererName][wavelengthSetIndex]
+    //! Renders multiple scattering for up to #maxWLSetsPerPass wavelength sets in one pass
+    ShaderProgPtr multipleScatteringMRTProgram_;
+    // Indexed as singleScatteringPrograms_[renderMode][scattererName][wavelengthSetIndex], see also wlSetProgram()
     using ScatteringProgramsMap=std::map<ScattererName,std::vector<ShaderProgPtr>>;
     std::vector<std::unique_ptr<ScatteringProgramsMap>> singleScatteringPrograms_;
     std::vector<std::unique_ptr<ScatteringProgramsMap>> eclipsedSingleScatteringPrograms_;
@@ -122,32 +229,81 @@ private: // variables
     std::unique_ptr<ScatteringProgramsMap> eclipsedSingleScatteringPrecomputationPrograms_;
     std::unique_ptr<QOpenGLShader> precomputationProgramsVertShader_;
     std::unique_ptr<QOpenGLShader> viewDirVertShader_, viewDirFragShader_;
+    //! Replicates the surface to all the view layers, null if there's only one layer
+    std::unique_ptr<QOpenGLShader> viewLayersGeomShader_;
     ShaderProgPtr viewDirectionGetterProgram_;
+    ShaderProgPtr upsamplingProgram_;
     std::map<ScattererName,bool> scatterersEnabledStates_;
 
     std::vector<QVector4D> solarIrradianceFixup_;
+    bool solarIrradianceFixupChanged_=true;
+
+    // XXX: keep in sync with PerFrameUniforms block in render.frag, which uses std140 layout
+    struct PerFrameUniforms
+    {
+        GLfloat cameraPosition[3];
+        GLfloat padding0;
+        GLfloat sunDirection[3];
+        GLfloat padding1;
+        GLfloat moonPosition[3];
+        GLfloat lightPollutionGroundLuminance;
+        GLint pseudoMirrorSkyBelowHorizon;
+        GLint padding2[3];
+    } perFrameUniforms_={};
+    static_assert(sizeof(PerFrameUniforms)==64);
+    enum UniformBlockBinding : GLuint
+    {
+        PER_FRAME_UNIFORMS_BINDING,
+        PER_WAVELENGTH_SET_UNIFORMS_BINDING,
+    };
+    GLuint perFrameUBO_=0, perWavelengthSetUBO_=0;
 
     int numAltIntervalsIn4DTexture_;
 
+    GPUProfiler gpuProfiler_;
+
+    //! Groups of programs that lazy loading can defer, combined as bit flags
+    enum ShaderGroup : unsigned
+    {
+        SG_ON_THE_FLY_SINGLE_SCATTERING  = 1u<<SSRM_ON_THE_FLY,  //!< See singleScatteringShaderGroup()
+        SG_PRECOMPUTED_SINGLE_SCATTERING = 1u<<SSRM_PRECOMPUTED,
+        SG_LIGHT_POLLUTION               = 1u<<SSRM_COUNT,
+        SG_ECLIPSE                       = 1u<<(SSRM_COUNT+1),
+        SG_ALL = SG_ON_THE_FLY_SINGLE_SCATTERING|SG_PRECOMPUTED_SINGLE_SCATTERING|SG_LIGHT_POLLUTION|SG_ECLIPSE
+    };
+
     enum class State
     {
         NotReady,           //!< Just constructed or failed to load data
         LoadingData,        //!< After initDataLoading() and until loading completes
         ReloadingShaders,   //!< After initShaderReloading() and until shaders reloading completes
         ReloadingTextures,  //!< After initPreparationToDraw() and until textures reloading completes
+        LoadingDeferredShaders, //!< After initPreparationToDraw() found lazily skipped programs needed, until they are loaded
         ReadyToRender,
     } state_ = State::NotReady;
 
 private: // methods
     DEFINE_EXPLICIT_BOOL(CountStepsOnly);
+    DEFINE_EXPLICIT_BOOL(AllWavelengthSets);
     void loadTextures(CountStepsOnly countStepsOnly);
     void reloadScatteringTextures(CountStepsOnly countStepsOnly);
     void setupRenderTarget();
     void loadShaders(CountStepsOnly countStepsOnly);
+    void loadCoreShaders(CountStepsOnly countStepsOnly);
+    void loadSingleScatteringShaders(CountStepsOnly countStepsOnly, int renderMode);
+    void loadLightPollutionShaders(CountStepsOnly countStepsOnly);
+    void loadEclipseShaders(CountStepsOnly countStepsOnly);
+    void loadDeferredShaders(CountStepsOnly countStepsOnly);
+    unsigned neededShaderGroups() const;
+    static unsigned singleScatteringShaderGroup(int renderMode) { return 1u<<renderMode; }
+    LoadingStatus stepDeferredShadersLoading(CountStepsOnly countStepsOnly, unsigned groups);
     void setupBuffers();
     void clearResources();
     void finalizeLoading();
     void drawSurface(QOpenGLShaderProgram& prog);
+    void updateUniformBuffers();
+    std::vector<double> frameState(double brightness) const;
+    void setPerDrawUniforms(ShaderProgram& prog, unsigned wlSetIndex);
 
     double altitudeUnitRangeTexCoord() const;
     double cameraMoonDistance() const;
@@ -155,13 +311,40 @@ private: // methods
     glm::dvec3 moonPosition() const;
     glm::dvec3 moonPositionRelativeToSunAzimuth() const;
     glm::dvec3 cameraPosition() const;
-    glm::ivec2 loadTexture2D(QString const& path);
+    template<typename Load>
+    TexturePtr sharedTexture(QString const& key, Load load);
+    QString sharedKey(QString const& path) const;
+    QString sharedSliceKey(QString const& path, float altitudeCoord) const;
+    QByteArray programDefinitions(AllWavelengthSets allWLSets) const;
+    QString viewDirProgramKey(QString const& dir, AllWavelengthSets allWLSets) const;
+    void compileViewDirShaders();
+    void addViewDirShaders(QOpenGLShaderProgram& program) const;
+    ShaderProgPtr loadViewDirProgram(QString const& dir, QString const& description,
+                                     AllWavelengthSets allWLSets=AllWavelengthSets{false});
+    ShaderProgPtr loadPrecomputationProgram(QString const& dir, QString const& description,
+                                            AllWavelengthSets allWLSets=AllWavelengthSets{false});
+    QVector4D solarIrradianceFixup(unsigned wlSetIndex) const;
+    glm::ivec2 loadTexture2D(QString const& path, int arrayLayer=-1);
+    TexturePtr newTextureArray(int width, int height, int layerCount);
+    template<typename Create>
+    TexturePtr beginTextureArrayLoading(QString const& key, Create create);
+    bool dataSupportsTextureArrays() const;
+    bool dataSupportsRadiance() const;
+    //! Whether radiance render buffers are attached to the FBO while drawing
+    bool renderingRadiance() const { return !radianceRenderBuffers_.empty() && viewLayerCount_==1 && resolutionReduction_==1; }
+    QOpenGLTexture& wlSetTexture(std::vector<TexturePtr> const& family, unsigned wlSetIndex) const
+    { return *family[useTextureArrays_ ? 0 : wlSetIndex]; }
+    ShaderProgram& wlSetProgram(std::vector<ShaderProgPtr> const& family, unsigned wlSetIndex) const
+    { return *family[useTextureArrays_ ? 0 : wlSetIndex]; }
+    //! Number of programs loaded for each family that has per-wavelength-set programs
+    unsigned wlSetProgramCount() const { return useTextureArrays_ ? 1 : params_.allWavelengths.size(); }
     enum class Texture4DType
     {
         ScatteringTexture,
         InterpolationGuides,
     };
-    void loadTexture4D(QString const& path, float altitudeCoord, Texture4DType texType = Texture4DType::ScatteringTexture);
+    void loadTexture4D(QString const& path, float altitudeCoord, Texture4DType texType = Texture4DType::ScatteringTexture,
+                       int stackIndex=-1);
     void loadEclipsedDoubleScatteringTexture(QString const& path, float altitudeCoord);
 
     void precomputeEclipsedSingleScattering();
@@ -170,7 +353,13 @@ private: // methods
     void renderSingleScattering();
     void renderMultipleScattering();
     void renderLightPollution();
+    void renderScatteringPasses(double brightness);
+    void renderAtReducedResolution(double brightness, bool clear);
+    bool reducedResolutionActive() const { return resolutionReduction_>1 && viewLayerCount_==1; }
     void prepareRadianceFrames(bool clear);
+    unsigned attachRadianceBufferGroup(unsigned group);
+    void selectRadianceRenderTarget(unsigned wlSetIndex);
+    std::unique_ptr<RadianceReadback> issueRadianceReadback(std::vector<QPoint> const& pixels, QRect const& rect);
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include "GLWidget.hpp"
-#include <chrono>
+#include <cmath>
+#include <algorithm>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QFileDialog>
@@ -13,6 +14,7 @@
 #include "ToolsWidget.hpp"
 #include "AtmosphereRenderer.hpp"
 #include "GLSLCosineQualityChecker.hpp"
+#include "ViewDirShaders.hpp"
 #include "BlueNoiseTriangleRemapped.hpp"
 
 static QPoint position(QMouseEvent* event)
@@ -41,6 +43,7 @@ GLWidget::~GLWidget()
     // We also want to do our own cleanup.
     makeCurrent();
 
+    gpuProfiler_.reset();
     if(vbo_)
     {
         glDeleteBuffers(1, &vbo_);
@@ -51,16 +54,7 @@ GLWidget::~GLWidget()
         glDeleteVertexArrays(1, &vao_);
         vao_=0;
     }
-    if(glareTextures_[0])
-    {
-        glDeleteTextures(std::size(glareTextures_), glareTextures_);
-        std::fill_n(glareTextures_, std::size(glareTextures_), 0);
-    }
-    if(glareFBOs_[0])
-    {
-        glDeleteFramebuffers(std::size(glareFBOs_), glareFBOs_);
-        std::fill_n(glareFBOs_, std::size(glareFBOs_), 0);
-    }
+    glareFilter_.reset();
 }
 
 void GLWidget::makeDitherPatternTexture()
@@ -106,27 +100,9 @@ void GLWidget::makeDitherPatternTexture()
 
 void GLWidget::makeGlareRenderTarget()
 {
-    if(!glareTextures_[0])
-        glGenTextures(std::size(glareTextures_), glareTextures_);
-    for(unsigned n=0; n<std::size(glareTextures_); ++n)
-    {
-        glBindTexture(GL_TEXTURE_2D, glareTextures_[n]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width(), height(), 0, GL_RGBA, GL_FLOAT, nullptr);
-        // This is needed to avoid aliasing when sampling along skewed lines
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // We want our convolution filter to sample zeros outside the texture, so clamp to _border_
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    }
-    if(!glareFBOs_[0])
-        glGenFramebuffers(std::size(glareFBOs_), glareFBOs_);
-    for(unsigned n=0; n<std::size(glareFBOs_); ++n)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, glareFBOs_[n]);
-        glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,glareTextures_[n],0);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    }
+    glareValid_ = false;
+    if(glareFilter_)
+        glareFilter_->resize(width(), height());
 }
 
 QVector3D GLWidget::rgbMaxValue() const
@@ -190,6 +166,11 @@ void GLWidget::initializeGL()
             glBindVertexArray(0);
         };
         renderer.reset(ShowMySky_AtmosphereRenderer_create(this,&pathToData,tools,&drawSurface));
+        renderer->setGPUProfilingEnabled(true);
+        // Repaints that only change exposure or other display settings needn't redraw the sky
+        renderer->setFrameCachingEnabled(true);
+        gpuProfiler_=std::make_unique<GPUProfiler>(*this);
+        gpuProfiler_->setEnabled(true);
         tools->updateParameters(static_cast<AtmosphereRenderer*>(renderer.get())->atmosphereParameters());
         connect(tools, &ToolsWidget::settingChanged, this, qOverload<>(&GLWidget::update));
         connect(tools, &ToolsWidget::projectionChanged, this, [this](const Projection newProjection)
@@ -198,6 +179,16 @@ void GLWidget::initializeGL()
                 { currentColorMode_ = newColorMode; update(); });
         connect(tools, &ToolsWidget::ditheringMethodChanged, this, [this]
                 { makeDitherPatternTexture(); update(); });
+        connect(tools, &ToolsWidget::glareMethodChanged, this, [this]
+                { glareValid_ = false; update(); });
+        connect(tools, &ToolsWidget::resolutionReductionChanged, this, [this](const unsigned factor)
+                {
+                    makeCurrent();
+                    renderer->setResolutionReduction(factor);
+                    if(renderer->isReadyToRender())
+                        tools->setCanGrabRadiance(renderer->canGrabRadiance());
+                    update();
+                });
         connect(tools, &ToolsWidget::setScattererEnabled, this, [this,renderer=renderer.get()](QString const& name, const bool enable)
                 { renderer->setScattererEnabled(name, enable); update(); });
         connect(tools, &ToolsWidget::reloadShadersClicked, this, &GLWidget::reloadShaders);
@@ -206,7 +197,6 @@ void GLWidget::initializeGL()
         connect(tools, &ToolsWidget::setBlackBodySolarSpectrum, this, &GLWidget::setBlackBodySolarSpectrum);
 
         makeDitherPatternTexture();
-        makeGlareRenderTarget();
         setupBuffers();
 
         GLSLCosineQualityChecker cosineChecker(*this);
@@ -365,131 +355,10 @@ void main()
 )");
         link(*luminanceToScreenRGB_, tr("luminanceToScreenRGB shader program"));
 
-        glareProgram_=std::make_unique<QOpenGLShaderProgram>();
-        addShaderCode(*glareProgram_, QOpenGLShader::Fragment, tr("glare fragment shader"), 1+R"(
-#version 330
-uniform sampler2D luminanceXYZW;
-uniform vec2 stepDir;
-out vec4 XYZW;
-
-float weight(const float x)
-{
-    const float a=0.955491103831962;
-    const float b=0.0111272240420095;
-    return abs(x)<0.5 ? a : b/(x*x);
-}
-
-void main()
-{
-    vec2 size = textureSize(luminanceXYZW, 0);
-    vec2 pos = gl_FragCoord.st-vec2(0.5);
-    if(stepDir.x*stepDir.y >= 0)
-    {
-        vec2 dir = stepDir.x<0 || stepDir.y<0 ? -stepDir : stepDir;
-        float stepCountBottomLeft = 1+ceil(min(pos.x/dir.x, pos.y/dir.y));
-        float stepCountTopRight = 1+ceil(min((size.x-pos.x-1)/dir.x, (size.y-pos.y-1)/dir.y));
-
-        XYZW = weight(0) * texture(luminanceXYZW, gl_FragCoord.st/size);
-        for(float dist=1; dist<stepCountBottomLeft; ++dist)
-            XYZW += weight(dist) * texture(luminanceXYZW, (gl_FragCoord.st-dir*dist)/size);
-        for(float dist=1; dist<stepCountTopRight; ++dist)
-            XYZW += weight(dist) * texture(luminanceXYZW, (gl_FragCoord.st+dir*dist)/size);
-    }
-    else
-    {
-        vec2 dir = stepDir.x<0 ? -stepDir : stepDir;
-        float stepCountTopLeft = 1+ceil(min(pos.x/dir.x, (size.y-pos.y-1)/-dir.y));
-        float stepCountBottomRight = 1+ceil(min((size.x-pos.x-1)/dir.x, pos.y/-dir.y));
-
-        XYZW = weight(0) * texture(luminanceXYZW, gl_FragCoord.st/size);
-        for(float dist=1; dist<stepCountTopLeft; ++dist)
-            XYZW += weight(dist) * texture(luminanceXYZW, (gl_FragCoord.st-dir*dist)/size);
-        for(float dist=1; dist<stepCountBottomRight; ++dist)
-            XYZW += weight(dist) * texture(luminanceXYZW, (gl_FragCoord.st+dir*dist)/size);
-    }
-}
-)");
-        addShaderCode(*glareProgram_, QOpenGLShader::Vertex, tr("glare vertex shader"), 1+R"(
-#version 330
-in vec3 vertex;
-void main()
-{
-    gl_Position=vec4(vertex,1);
-}
-)");
-        link(*glareProgram_, tr("glare shader program"));
-
-        static constexpr const char* viewDirVertShaderSrc=1+R"(
-#version 330
-in vec3 vertex;
-out vec3 position;
-void main()
-{
-    position=vertex;
-    gl_Position=vec4(position,1);
-}
-)";
-        QByteArray viewDirFragShaderSrc=1+R"(
-#version 330
-in vec3 position;
-uniform float zoomFactor;
-uniform mat3 cameraRotation;
-uniform float viewportAspectRatio;
-
-uniform int projection;
-// These values must match the entries in the Projection enum
-#define PROJ_EQUIRECTANGULAR 0
-#define PROJ_PERSPECTIVE 1
-#define PROJ_FISHEYE 2
-
-const float PI=3.1415926535897932;
-
-#if COSINE_IS_BROKEN
-// Define Chebyshoff approximations for sin and cos
-float sin(float x)
-{
-    x = mod(x+PI, 2*PI)-PI;
-    return x*(0.999999599920672 + x*x*(-0.166665526354071 + x*x*(0.00833240298869917 + x*x*(-0.0001980863334175 + x*x*(2.69971463693744e-6 - 2.03622449118901e-8*x*x)))));
-}
-float cos(float x)
-{
-    x = mod(x+PI, 2*PI)-PI;
-    return 0.999999210782322 + x*x*(-0.499994213384716 + x*x*(0.0416597778065509 + x*x*(-0.00138587899196014 + x*x*(0.0000242029413673591 - 2.19729638194131e-7*x*x))));
-}
-#endif
-
-vec3 calcViewDir()
-{
-    vec2 pos=position.xy/zoomFactor;
-    if(projection==PROJ_EQUIRECTANGULAR)
-    {
-        return cameraRotation*vec3(cos(pos.x*PI)*cos(pos.y*(PI/2)),
-                                   sin(pos.x*PI)*cos(pos.y*(PI/2)),
-                                   sin(pos.y*(PI/2)));
-    }
-    else if(projection==PROJ_PERSPECTIVE)
-    {
-        const float horizViewAngle = 120*PI/180;
-        const float camDistToScreen = 0.5 * tan(horizViewAngle);
-        pos.y /= viewportAspectRatio;
-        return cameraRotation * normalize(vec3(-camDistToScreen, pos));
-    }
-    else if(projection==PROJ_FISHEYE)
-    {
-        const float thetaMax=PI;
-        float r=length(pos.xy);
-        float theta=r*thetaMax;
-        if(theta > thetaMax)
-            return vec3(0);
-        float phi = PI - atan(pos.x,pos.y);
-        return cameraRotation*vec3(cos(phi)*sin(theta),
-                                   sin(phi)*sin(theta),
-                                            cos(theta));
-    }
+        glareFilter_=std::make_unique<GlareFilter>(*this);
+        makeGlareRenderTarget();
 
-    return vec3(0);
-}
-)";
+        QByteArray viewDirFragShaderSrc=::viewDirFragShaderSrc;
         viewDirFragShaderSrc.replace("COSINE_IS_BROKEN", cosineIsOK ? "0" : "1");
         renderer->initDataLoading(viewDirVertShaderSrc, viewDirFragShaderSrc);
         stepDataLoading();
@@ -517,6 +386,7 @@ void GLWidget::stepDataLoading()
             tools->setCanGrabRadiance(renderer->canGrabRadiance());
             tools->setCanSetSolarSpectrum(renderer->canSetSolarSpectrum());
             update();
+            QTimer::singleShot(0, this, &GLWidget::stepShaderWarmup);
         }
         else if(status.stepsDone < status.stepsToDo)
         {
@@ -546,9 +416,15 @@ void GLWidget::stepPreparationToDraw(const bool emitProgressStatus)
             emit loadProgress(renderer->currentActivity(), status.stepsDone, status.stepsToDo);
 
         if(status.stepsDone < status.stepsToDo)
+        {
             QTimer::singleShot(0, this, [this]{stepPreparationToDraw(true);});
+        }
         else
+        {
             QTimer::singleShot(0, this, qOverload<>(&GLWidget::update));
+            // The warm-up stops while the renderer is preparing, so resume it
+            QTimer::singleShot(0, this, &GLWidget::stepShaderWarmup);
+        }
     }
     catch(ShowMySky::Error const& ex)
     {
@@ -572,66 +448,89 @@ void GLWidget::paintGL()
 
     if(!renderer->isReadyToRender()) return;
 
-    glFinish();
-    const auto t0=std::chrono::steady_clock::now();
-    renderer->draw(1, true);
+    const std::array<float,4> viewState{tools->zoomFactor(), tools->cameraYaw(), tools->cameraPitch(),
+                                        float(static_cast<int>(currentProjection()))};
+    if(viewState != lastViewState_)
+    {
+        renderer->invalidateFrame();
+        lastViewState_ = viewState;
+    }
+
+    gpuProfiler_->beginFrame();
+    gpuProfiler_->beginScope(tr("Frame"));
+    {
+        GPUProfiler::Scope scope(*gpuProfiler_, tr("Atmosphere"));
+        renderer->draw(1, true);
+    }
+    const bool luminanceChanged = !renderer->lastDrawReusedFrame();
 
     glBindVertexArray(vao_);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, renderer->getLuminanceTexture());
-    if(tools->glareEnabled())
+    if(!tools->glareEnabled())
+    {
+        glareValid_ = false;
+    }
+    else if(glareValid_ && !luminanceChanged)
+    {
+        // The result of the previous frame's glare is still valid
+        glBindTexture(GL_TEXTURE_2D, glareResult_);
+    }
+    else
     {
-        // We want our convolution filter to sample zeros outside the texture, so clamp to _border_
-        // Subsequent code doesn't depend on this
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        GPUProfiler::Scope scope(*gpuProfiler_, tr("Glare"));
+        glareResult_ = glareFilter_->apply(renderer->getLuminanceTexture(), tools->glareMethod(), vao_);
+        glBindTexture(GL_TEXTURE_2D, glareResult_);
+        glBindVertexArray(vao_);
+        glareValid_ = true;
+    }
+    {
+        GPUProfiler::Scope scope(*gpuProfiler_, tr("Tone mapping"));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        luminanceToScreenRGB_->bind();
+        luminanceToScreenRGB_->setUniformValue("luminanceXYZW", 0);
+        ditherPatternTexture_.bind(1);
+        luminanceToScreenRGB_->setUniformValue("ditherPattern", 1);
+        luminanceToScreenRGB_->setUniformValue("rgbMaxValue", rgbMaxValue());
+        luminanceToScreenRGB_->setUniformValue("ditheringMethod", static_cast<int>(tools->ditheringMethod()));
+        luminanceToScreenRGB_->setUniformValue("gradualClipping", tools->gradualClippingEnabled());
+        luminanceToScreenRGB_->setUniformValue("exposure", tools->exposure());
+        luminanceToScreenRGB_->setUniformValue("colorMode", static_cast<int>(currentColorMode()));
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+    glBindVertexArray(0);
+    gpuProfiler_->endScope();
+    gpuProfiler_->endFrame();
+    reportGPUTimings();
 
-        GLint targetFBO=-1;
-        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFBO);
+    if(lastRadianceCapturePosition.x()>=0 && lastRadianceCapturePosition.y()>=0)
+        updateSpectralRadiance(lastRadianceCapturePosition);
+}
 
-        constexpr double degree=M_PI/180;
-        constexpr double angleMin=5*degree;
-        constexpr int numAngleSteps=3;
-        constexpr double angleStep=360*degree/numAngleSteps;
+void GLWidget::reportGPUTimings()
+{
+    const auto& ownTimings=gpuProfiler_->lastResults();
+    if(ownTimings.empty()) return;
 
-        glareProgram_->bind();
-        glareProgram_->setUniformValue("luminanceXYZW", 0);
-        for(int angleStepNum=0; angleStepNum<numAngleSteps; ++angleStepNum)
+    // Nest the renderer's own scopes into our "Atmosphere" scope
+    const auto rendererTimings=renderer->getGPUTimings();
+    std::vector<ShowMySky::AtmosphereRenderer::GPUTimingEntry> timings;
+    for(const auto& entry : ownTimings)
+    {
+        timings.push_back(entry);
+        if(entry.name==tr("Atmosphere"))
         {
-            // This is needed to avoid aliasing when sampling along skewed lines
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            const auto angle = angleMin + angleStep*angleStepNum;
-            glareProgram_->setUniformValue("stepDir", QVector2D(std::cos(angle),std::sin(angle)));
-            glBindFramebuffer(GL_FRAMEBUFFER, glareFBOs_[angleStepNum%2]);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            // Now use the result of this stage to feed the next stage
-            glBindTexture(GL_TEXTURE_2D, glareTextures_[angleStepNum%2]);
+            for(auto rendererEntry : rendererTimings)
+            {
+                rendererEntry.depth += entry.depth+1;
+                timings.push_back(rendererEntry);
+            }
         }
-
-        glBindFramebuffer(GL_FRAMEBUFFER,targetFBO);
-    }
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    luminanceToScreenRGB_->bind();
-    luminanceToScreenRGB_->setUniformValue("luminanceXYZW", 0);
-    ditherPatternTexture_.bind(1);
-    luminanceToScreenRGB_->setUniformValue("ditherPattern", 1);
-    luminanceToScreenRGB_->setUniformValue("rgbMaxValue", rgbMaxValue());
-    luminanceToScreenRGB_->setUniformValue("ditheringMethod", static_cast<int>(tools->ditheringMethod()));
-    luminanceToScreenRGB_->setUniformValue("gradualClipping", tools->gradualClippingEnabled());
-    luminanceToScreenRGB_->setUniformValue("exposure", tools->exposure());
-    luminanceToScreenRGB_->setUniformValue("colorMode", static_cast<int>(currentColorMode()));
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-
-    glFinish();
-    const auto t1=std::chrono::steady_clock::now();
-    emit frameFinished(std::chrono::duration_cast<std::chrono::microseconds>(t1-t0).count());
-
-    if(lastRadianceCapturePosition.x()>=0 && lastRadianceCapturePosition.y()>=0)
-        updateSpectralRadiance(lastRadianceCapturePosition);
+    }
+    tools->showGPUTimings(timings);
+    // The outermost scope is the whole frame
+    emit frameFinished(std::max(1LL, std::llround(1000*ownTimings.front().timeInMS)));
 }
 
 void GLWidget::resizeGL(int w, int h)
@@ -873,9 +772,14 @@ void GLWidget::stepShaderReloading()
 
         emit loadProgress(renderer->currentActivity(), status.stepsDone, status.stepsToDo);
         if(renderer->isReadyToRender())
+        {
             update();
+            QTimer::singleShot(0, this, &GLWidget::stepShaderWarmup);
+        }
         else if(status.stepsDone < status.stepsToDo)
+        {
             QTimer::singleShot(0, this, &GLWidget::stepShaderReloading);
+        }
     }
     catch(ShowMySky::Error const& ex)
     {
@@ -888,6 +792,28 @@ void GLWidget::stepShaderReloading()
     }
 }
 
+// Loads the shaders skipped by lazy loading one by one while the event loop is idle
+void GLWidget::stepShaderWarmup()
+{
+    if(!renderer) return;
+    try
+    {
+        makeCurrent();
+        const auto status = renderer->stepShaderWarmup();
+        if(status.stepsDone < status.stepsToDo)
+            QTimer::singleShot(0, this, &GLWidget::stepShaderWarmup);
+    }
+    catch(ShowMySky::Error const& ex)
+    {
+        QTimer::singleShot(0,
+            [this,errorType=ex.errorType(),what=ex.what()]
+            {
+                emit loadProgress(tr("Shader warm-up failed"), 0, 0);
+                QMessageBox::critical(this, errorType, what);
+            });
+    }
+}
+
 bool GLWidget::eventFilter(QObject* object, QEvent* event)
 {
     if(event->type() == QEvent::FocusIn || event->type() == QEvent::FocusOut)
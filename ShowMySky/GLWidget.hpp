@@ -1,11 +1,14 @@
 #ifndef INCLUDE_ONCE_71D92E37_E297_472C_8495_1BF8EA61DC99
 #define INCLUDE_ONCE_71D92E37_E297_472C_8495_1BF8EA61DC99
 
+#include <array>
 #include <memory>
 #include <QOpenGLWidget>
 #include <QOpenGLTexture>
 #include <QOpenGLFunctions_3_3_Core>
 #include "AtmosphereRenderer.hpp"
+#include "GPUProfiler.hpp"
+#include "GlareFilter.hpp"
 #include "../common/AtmosphereParameters.hpp"
 
 class ToolsWidget;
@@ -32,11 +35,17 @@ public:
 
 private:
     std::unique_ptr<ShowMySky::AtmosphereRenderer> renderer;
+    //! Times glare and tone mapping passes, and the frame as a whole
+    std::unique_ptr<GPUProfiler> gpuProfiler_;
     std::unique_ptr<QOpenGLShaderProgram> luminanceToScreenRGB_;
-    std::unique_ptr<QOpenGLShaderProgram> glareProgram_;
+    std::unique_ptr<GlareFilter> glareFilter_;
     QOpenGLTexture ditherPatternTexture_;
-    GLuint glareTextures_[2] = {};
-    GLuint glareFBOs_[2] = {};
+    //! Texture with the last result of the glare filter
+    GLuint glareResult_ = 0;
+    //! Whether #glareResult_ holds the result for the current luminance frame and glare method
+    bool glareValid_ = false;
+    //! Values of the uniforms set by the surface drawing callback at the last paint, to detect the need to redraw the sky
+    std::array<float,4> lastViewState_ = {};
     QString pathToData;
     ToolsWidget* tools;
     GLuint vao_=0, vbo_=0;
@@ -87,11 +96,13 @@ private:
     void reloadShaders();
     void stepDataLoading();
     void stepShaderReloading();
+    void stepShaderWarmup();
     void stepPreparationToDraw(bool emitProgressStatus);
     QVector3D rgbMaxValue() const;
     void makeGlareRenderTarget();
     void makeDitherPatternTexture();
     void updateSpectralRadiance(QPoint const& pixelPos);
+    void reportGPUTimings();
     void setDragMode(DragMode mode, int x=0, int y=0) { dragMode_=mode; prevMouseX_=x; prevMouseY_=y; }
     void setFlatSolarSpectrum();
     void resetSolarSpectrum();
@@ -0,0 +1,124 @@
+#include "GPUProfiler.hpp"
+
+GPUProfiler::~GPUProfiler()
+{
+    clear();
+}
+
+void GPUProfiler::clear()
+{
+    for(const auto& frame : pendingFrames_)
+        recycle(frame);
+    pendingFrames_.clear();
+    openScopes_.clear();
+    recordingFrame_=false;
+    if(!freeQueries_.empty())
+    {
+        gl.glDeleteQueries(freeQueries_.size(), freeQueries_.data());
+        freeQueries_.clear();
+    }
+}
+
+void GPUProfiler::setEnabled(const bool enabled)
+{
+    if(enabled==enabled_) return;
+    enabled_=enabled;
+    if(!enabled)
+    {
+        clear();
+        lastResults_.clear();
+    }
+}
+
+GLuint GPUProfiler::newQuery()
+{
+    if(freeQueries_.empty())
+    {
+        GLuint query=0;
+        gl.glGenQueries(1, &query);
+        return query;
+    }
+    const auto query=freeQueries_.back();
+    freeQueries_.pop_back();
+    return query;
+}
+
+void GPUProfiler::recycle(Frame const& frame)
+{
+    for(const auto& scope : frame.scopes)
+    {
+        freeQueries_.push_back(scope.beginQuery);
+        if(scope.endQuery)
+            freeQueries_.push_back(scope.endQuery);
+    }
+}
+
+void GPUProfiler::collectResults()
+{
+    while(!pendingFrames_.empty())
+    {
+        const auto& frame=pendingFrames_.front();
+        // Queries complete in the order they were issued, so the frame is done when its last query is
+        GLint available=GL_FALSE;
+        gl.glGetQueryObjectiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) break;
+
+        lastResults_.clear();
+        for(const auto& scope : frame.scopes)
+        {
+            GLuint64 begin=0, end=0;
+            gl.glGetQueryObjectui64v(scope.beginQuery, GL_QUERY_RESULT, &begin);
+            gl.glGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &end);
+            lastResults_.push_back({scope.name, scope.depth, end>begin ? (end-begin)*1e-6 : 0.});
+        }
+        recycle(frame);
+        pendingFrames_.pop_front();
+    }
+}
+
+void GPUProfiler::beginFrame()
+{
+    if(!enabled_) return;
+
+    collectResults();
+    openScopes_.clear();
+    // If the GPU is this far behind, skip profiling the frame instead of waiting for old results
+    recordingFrame_ = pendingFrames_.size() < maxFramesInFlight;
+    if(recordingFrame_)
+        pendingFrames_.emplace_back();
+}
+
+void GPUProfiler::endFrame()
+{
+    if(!recordingFrame_) return;
+
+    while(!openScopes_.empty())
+        endScope();
+    recordingFrame_=false;
+    if(pendingFrames_.back().scopes.empty())
+        pendingFrames_.pop_back();
+}
+
+void GPUProfiler::beginScope(QString const& name)
+{
+    if(!recordingFrame_) return;
+
+    auto& frame=pendingFrames_.back();
+    const auto query=newQuery();
+    gl.glQueryCounter(query, GL_TIMESTAMP);
+    frame.lastQuery=query;
+    openScopes_.push_back(frame.scopes.size());
+    frame.scopes.push_back({name, unsigned(openScopes_.size()-1), query});
+}
+
+void GPUProfiler::endScope()
+{
+    if(!recordingFrame_ || openScopes_.empty()) return;
+
+    auto& frame=pendingFrames_.back();
+    auto& scope=frame.scopes[openScopes_.back()];
+    openScopes_.pop_back();
+    scope.endQuery=newQuery();
+    gl.glQueryCounter(scope.endQuery, GL_TIMESTAMP);
+    frame.lastQuery=scope.endQuery;
+}
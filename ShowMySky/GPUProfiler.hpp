@@ -0,0 +1,82 @@
+#ifndef INCLUDE_ONCE_EE574A03_EFEE_4EA5_983D_A30C53BDF7CA
+#define INCLUDE_ONCE_EE574A03_EFEE_4EA5_983D_A30C53BDF7CA
+
+#include <deque>
+#include <vector>
+#include <QString>
+#include <QOpenGLFunctions_3_3_Core>
+#include "api/ShowMySky/AtmosphereRenderer.hpp"
+
+/**
+ * \brief Measures GPU time of named parts of a frame without stalling the pipeline.
+ *
+ * Each scope is delimited by a pair of \c GL_TIMESTAMP queries, so that scopes can be nested (unlike \c GL_TIME_ELAPSED
+ * queries, which can't overlap). Queries of a frame are kept in a ring of up to #maxFramesInFlight frames and are only
+ * read back when the GL reports them as available, so the results lag one or two frames behind. If the GPU falls so far
+ * behind that the ring is full, the new frame is simply not profiled.
+ *
+ * All the methods must be called with the OpenGL context current.
+ */
+class GPUProfiler
+{
+public:
+    using Entry=ShowMySky::AtmosphereRenderer::GPUTimingEntry;
+
+    explicit GPUProfiler(QOpenGLFunctions_3_3_Core& gl) : gl(gl) {}
+    GPUProfiler(GPUProfiler const&)=delete;
+    ~GPUProfiler();
+
+    void setEnabled(bool enabled);
+    bool enabled() const { return enabled_; }
+    //! Collects results of the completed frames and starts recording a new one
+    void beginFrame();
+    void endFrame();
+    void beginScope(QString const& name);
+    void endScope();
+    //! Results of the latest frame whose queries have completed, in the order of scope beginnings
+    std::vector<Entry> const& lastResults() const { return lastResults_; }
+    //! Deletes all query objects and forgets pending frames
+    void clear();
+
+    //! Brackets the lifetime of the object with #beginScope and #endScope
+    class Scope
+    {
+        GPUProfiler& profiler;
+    public:
+        Scope(GPUProfiler& profiler, QString const& name) : profiler(profiler) { profiler.beginScope(name); }
+        Scope(Scope const&)=delete;
+        ~Scope() { profiler.endScope(); }
+    };
+
+private:
+    struct PendingScope
+    {
+        QString name;
+        unsigned depth;
+        GLuint beginQuery;
+        GLuint endQuery=0;
+    };
+    struct Frame
+    {
+        std::vector<PendingScope> scopes;
+        GLuint lastQuery=0; //!< The query issued last in this frame
+    };
+
+    static constexpr unsigned maxFramesInFlight=4;
+
+    QOpenGLFunctions_3_3_Core& gl;
+    bool enabled_=false;
+    //! Whether the frame being recorded (the last one in #pendingFrames_) is actually profiled
+    bool recordingFrame_=false;
+    std::deque<Frame> pendingFrames_;
+    //! Indices (in the scopes of the current frame) of the scopes that have begun but not ended yet
+    std::vector<unsigned> openScopes_;
+    std::vector<GLuint> freeQueries_;
+    std::vector<Entry> lastResults_;
+
+    GLuint newQuery();
+    void recycle(Frame const& frame);
+    void collectResults();
+};
+
+#endif
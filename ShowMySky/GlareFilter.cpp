@@ -0,0 +1,231 @@
+#include "GlareFilter.hpp"
+
+#include <cmath>
+#include <iterator>
+#include <QVector2D>
+#include "util.hpp"
+
+namespace
+{
+
+constexpr char glareWeightSrc[]=1+R"(
+const float a=0.955491103831962;
+const float b=0.0111272240420095;
+float weight(const float x)
+{
+    return abs(x)<0.5 ? a : b/(x*x);
+}
+)";
+
+constexpr char glareVertShaderSrc[]=1+R"(
+#version 330
+in vec3 vertex;
+void main()
+{
+    gl_Position=vec4(vertex,1);
+}
+)";
+
+}
+
+GlareFilter::GlareFilter(QOpenGLFunctions_3_3_Core& gl)
+    : gl(gl)
+{
+    lineConvolutionProgram_=std::make_unique<QOpenGLShaderProgram>();
+    addShaderCode(*lineConvolutionProgram_, QOpenGLShader::Fragment, QObject::tr("line convolution glare fragment shader"),
+                  std::string(1+R"(
+#version 330
+uniform sampler2D luminanceXYZW;
+uniform vec2 stepDir;
+out vec4 XYZW;
+)")+glareWeightSrc+R"(
+void main()
+{
+    vec2 size = textureSize(luminanceXYZW, 0);
+    vec2 pos = gl_FragCoord.st-vec2(0.5);
+    if(stepDir.x*stepDir.y >= 0)
+    {
+        vec2 dir = stepDir.x<0 || stepDir.y<0 ? -stepDir : stepDir;
+        float stepCountBottomLeft = 1+ceil(min(pos.x/dir.x, pos.y/dir.y));
+        float stepCountTopRight = 1+ceil(min((size.x-pos.x-1)/dir.x, (size.y-pos.y-1)/dir.y));
+
+        XYZW = weight(0) * texture(luminanceXYZW, gl_FragCoord.st/size);
+        for(float dist=1; dist<stepCountBottomLeft; ++dist)
+            XYZW += weight(dist) * texture(luminanceXYZW, (gl_FragCoord.st-dir*dist)/size);
+        for(float dist=1; dist<stepCountTopRight; ++dist)
+            XYZW += weight(dist) * texture(luminanceXYZW, (gl_FragCoord.st+dir*dist)/size);
+    }
+    else
+    {
+        vec2 dir = stepDir.x<0 ? -stepDir : stepDir;
+        float stepCountTopLeft = 1+ceil(min(pos.x/dir.x, (size.y-pos.y-1)/-dir.y));
+        float stepCountBottomRight = 1+ceil(min((size.x-pos.x-1)/dir.x, pos.y/-dir.y));
+
+        XYZW = weight(0) * texture(luminanceXYZW, gl_FragCoord.st/size);
+        for(float dist=1; dist<stepCountTopLeft; ++dist)
+            XYZW += weight(dist) * texture(luminanceXYZW, (gl_FragCoord.st-dir*dist)/size);
+        for(float dist=1; dist<stepCountBottomRight; ++dist)
+            XYZW += weight(dist) * texture(luminanceXYZW, (gl_FragCoord.st+dir*dist)/size);
+    }
+}
+)").c_str());
+    addShaderCode(*lineConvolutionProgram_, QOpenGLShader::Vertex, QObject::tr("glare vertex shader"), glareVertShaderSrc);
+    lineConvolutionProgram_->bindAttributeLocation("vertex", 0);
+    link(*lineConvolutionProgram_, QObject::tr("line convolution glare shader program"));
+
+    mipPyramidProgram_=std::make_unique<QOpenGLShaderProgram>();
+    addShaderCode(*mipPyramidProgram_, QOpenGLShader::Fragment, QObject::tr("mip pyramid glare fragment shader"),
+                  std::string(1+R"(
+#version 330
+uniform sampler2D luminanceXYZW;
+uniform vec2 stepDir;
+out vec4 XYZW;
+)")+glareWeightSrc+R"(
+// Distances smaller than this are summed texel by texel, like in the line convolution
+const int NEAR_RANGE=8;
+// Each octave of larger distances is split into this many intervals, each one sampled once from
+// the mip level whose texel size equals the interval length
+const int SAMPLES_PER_OCTAVE=4;
+
+// Sum of weight(dist) for integer dist in [from, to), approximated by the integral of the kernel
+float intervalWeight(const float from, const float to)
+{
+    return b*(1/(from-0.5)-1/(to-0.5));
+}
+
+vec4 sampleBothSides(const float dist, const float lod)
+{
+    vec2 size = textureSize(luminanceXYZW, 0);
+    return textureLod(luminanceXYZW, (gl_FragCoord.st-stepDir*dist)/size, lod) +
+           textureLod(luminanceXYZW, (gl_FragCoord.st+stepDir*dist)/size, lod);
+}
+
+void main()
+{
+    vec2 size = textureSize(luminanceXYZW, 0);
+    XYZW = weight(0) * textureLod(luminanceXYZW, gl_FragCoord.st/size, 0);
+    for(int dist=1; dist<NEAR_RANGE; ++dist)
+        XYZW += weight(dist) * sampleBothSides(dist, 0);
+
+    // Samples beyond the edges return zeros, so we don't need the exact step counts
+    float maxDist = length(size);
+    for(float octaveStart=NEAR_RANGE; octaveStart<maxDist; octaveStart*=2)
+    {
+        float interval = octaveStart/SAMPLES_PER_OCTAVE;
+        float lod = log2(interval);
+        for(int n=0; n<SAMPLES_PER_OCTAVE; ++n)
+        {
+            float from = octaveStart+n*interval;
+            XYZW += intervalWeight(from, from+interval) * sampleBothSides(from+(interval-1)/2, lod);
+        }
+    }
+}
+)").c_str());
+    addShaderCode(*mipPyramidProgram_, QOpenGLShader::Vertex, QObject::tr("glare vertex shader"), glareVertShaderSrc);
+    mipPyramidProgram_->bindAttributeLocation("vertex", 0);
+    link(*mipPyramidProgram_, QObject::tr("mip pyramid glare shader program"));
+}
+
+GlareFilter::~GlareFilter()
+{
+    if(textures_[0])
+        gl.glDeleteTextures(std::size(textures_), textures_);
+    if(fbos_[0])
+        gl.glDeleteFramebuffers(std::size(fbos_), fbos_);
+    if(sourceFBO_)
+        gl.glDeleteFramebuffers(1, &sourceFBO_);
+}
+
+void GlareFilter::resize(const int width, const int height)
+{
+    width_=width;
+    height_=height;
+
+    if(!textures_[0])
+        gl.glGenTextures(std::size(textures_), textures_);
+    for(unsigned n=0; n<std::size(textures_); ++n)
+    {
+        gl.glBindTexture(GL_TEXTURE_2D, textures_[n]);
+        gl.glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        // This is needed to avoid aliasing when sampling along skewed lines
+        gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // We want our convolution filter to sample zeros outside the texture, so clamp to _border_
+        gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    }
+    gl.glBindTexture(GL_TEXTURE_2D, 0);
+
+    if(!fbos_[0])
+        gl.glGenFramebuffers(std::size(fbos_), fbos_);
+    if(!sourceFBO_)
+        gl.glGenFramebuffers(1, &sourceFBO_);
+    GLint origFBO=0;
+    gl.glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &origFBO);
+    for(unsigned n=0; n<std::size(fbos_); ++n)
+    {
+        gl.glBindFramebuffer(GL_FRAMEBUFFER, fbos_[n]);
+        gl.glFramebufferTexture(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,textures_[n],0);
+    }
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, origFBO);
+}
+
+GLuint GlareFilter::apply(const GLuint luminanceTexture, const Method method, const GLuint vao)
+{
+    GLint origDrawFBO=-1, origReadFBO=-1;
+    gl.glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &origDrawFBO);
+    gl.glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &origReadFBO);
+
+    gl.glActiveTexture(GL_TEXTURE0);
+    const bool usingMipmaps = method==Method::MipPyramid;
+    if(usingMipmaps)
+    {
+        // The renderer's texture has no mipmaps, so take a copy that will have them. The first pass writes
+        // into textures_[0], so the copy goes to the other one.
+        gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFBO_);
+        gl.glFramebufferTexture(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, luminanceTexture, 0);
+        gl.glReadBuffer(GL_COLOR_ATTACHMENT0);
+        gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos_[1]);
+        gl.glBlitFramebuffer(0,0,width_,height_, 0,0,width_,height_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, origReadFBO);
+        gl.glBindTexture(GL_TEXTURE_2D, textures_[1]);
+        gl.glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    else
+    {
+        gl.glBindTexture(GL_TEXTURE_2D, luminanceTexture);
+        // We want our convolution filter to sample zeros outside the texture, so clamp to _border_
+        // Subsequent code doesn't depend on this
+        gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    }
+
+    constexpr double degree=M_PI/180;
+    constexpr double angleMin=5*degree;
+    constexpr double angleStep=360*degree/numAngleSteps;
+
+    auto& program = usingMipmaps ? *mipPyramidProgram_ : *lineConvolutionProgram_;
+    program.bind();
+    program.setUniformValue("luminanceXYZW", 0);
+    gl.glBindVertexArray(vao);
+    for(int angleStepNum=0; angleStepNum<numAngleSteps; ++angleStepNum)
+    {
+        // This is needed to avoid aliasing when sampling along skewed lines
+        gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, usingMipmaps ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
+        gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        const auto angle = angleMin + angleStep*angleStepNum;
+        program.setUniformValue("stepDir", QVector2D(std::cos(angle),std::sin(angle)));
+        gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos_[angleStepNum%2]);
+        gl.glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        // Now use the result of this stage to feed the next stage
+        gl.glBindTexture(GL_TEXTURE_2D, textures_[angleStepNum%2]);
+        if(usingMipmaps && angleStepNum+1<numAngleSteps)
+            gl.glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    gl.glBindVertexArray(0);
+    program.release();
+
+    gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, origDrawFBO);
+    return textures_[(numAngleSteps-1)%2];
+}
@@ -0,0 +1,49 @@
+#ifndef INCLUDE_ONCE_938EEC91_BF02_4870_843A_5A2E91CD0E9B
+#define INCLUDE_ONCE_938EEC91_BF02_4870_843A_5A2E91CD0E9B
+
+#include <memory>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLFunctions_3_3_Core>
+
+/**
+ * \brief Applies the visual glare effect to a luminance image.
+ *
+ * The point spread function is a star made by successive convolution of the image along lines in three directions. The
+ * kernel of each line convolution has a narrow core and wings decaying as the inverse square of the distance, reaching
+ * to the edges of the image.
+ */
+class GlareFilter
+{
+public:
+    enum class Method
+    {
+        LineConvolution, //!< Reference method: sums the kernel texel by texel, the cost grows linearly with image size
+        MipPyramid,      //!< Sums the wings of the kernel octave by octave from mipmaps, the cost grows logarithmically with image size
+    };
+    static constexpr int numAngleSteps=3;
+
+    explicit GlareFilter(QOpenGLFunctions_3_3_Core& gl);
+    ~GlareFilter();
+    //! Allocates the intermediate textures; must be called before the first #apply and on each change of image size
+    void resize(int width, int height);
+    /**
+     * \brief Filters \p luminanceTexture, which must have the size passed to #resize.
+     *
+     * Each pass draws a full-screen quad with \p vao, using the current viewport.
+     *
+     * \returns the texture with the result. It remains valid until the next call of #apply or #resize.
+     */
+    GLuint apply(GLuint luminanceTexture, Method method, GLuint vao);
+
+private:
+    QOpenGLFunctions_3_3_Core& gl;
+    std::unique_ptr<QOpenGLShaderProgram> lineConvolutionProgram_;
+    std::unique_ptr<QOpenGLShaderProgram> mipPyramidProgram_;
+    GLuint textures_[2] = {};
+    GLuint fbos_[2] = {};
+    //! Lets the mip pyramid method copy the input luminance into a texture with mipmaps
+    GLuint sourceFBO_=0;
+    int width_=0, height_=0;
+};
+
+#endif
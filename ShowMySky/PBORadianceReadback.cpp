@@ -0,0 +1,112 @@
+#include "PBORadianceReadback.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include "../common/util.hpp"
+
+PBORadianceReadback::PBORadianceReadback(QOpenGLFunctions_3_3_Core& gl, std::vector<float> const& wavelengths,
+                                         std::vector<QPoint> const& pixels, const unsigned rectWidth)
+    : gl(gl)
+    , pixelCount_(pixels.size())
+    , planeCount_(wavelengths.size()/4+1)
+    , rectWidth_(rectWidth)
+{
+    assert(!rectWidth || pixelCount_ % rectWidth == 0);
+    result_.wavelengths=wavelengths;
+    result_.pixels=pixels;
+
+    gl.glGenBuffers(1, &pbo_);
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo_);
+    gl.glBufferData(GL_PIXEL_PACK_BUFFER, 4*sizeof(GLfloat)*planeCount_*pixelCount_, nullptr, GL_STREAM_READ);
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+PBORadianceReadback::~PBORadianceReadback()
+{
+    releaseGLObjects();
+}
+
+void PBORadianceReadback::releaseGLObjects()
+{
+    if(fence_)
+    {
+        gl.glDeleteSync(fence_);
+        fence_=nullptr;
+    }
+    if(pbo_)
+    {
+        gl.glDeleteBuffers(1, &pbo_);
+        pbo_=0;
+    }
+}
+
+void PBORadianceReadback::beginReads()
+{
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo_);
+}
+
+void PBORadianceReadback::endReads()
+{
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fence_=gl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool PBORadianceReadback::isReady()
+{
+    if(unpacked_) return true;
+    const auto status=gl.glClientWaitSync(fence_, 0, 0);
+    return status==GL_ALREADY_SIGNALED || status==GL_CONDITION_SATISFIED;
+}
+
+auto PBORadianceReadback::get() -> ShowMySky::AtmosphereRenderer::SpectralRadianceBlock const&
+{
+    if(unpacked_) return result_;
+
+    constexpr GLuint64 timeoutNS=1'000'000'000;
+    GLenum status;
+    while((status=gl.glClientWaitSync(fence_, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNS))==GL_TIMEOUT_EXPIRED);
+    if(status==GL_WAIT_FAILED)
+    {
+        releaseGLObjects();
+        throw OpenGLError{QObject::tr("Failed to wait for radiance readback")};
+    }
+
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo_);
+    const auto data=static_cast<const GLfloat*>(gl.glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                                                    4*sizeof(GLfloat)*planeCount_*pixelCount_,
+                                                                    GL_MAP_READ_BIT));
+    if(!data)
+    {
+        gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        releaseGLObjects();
+        throw OpenGLError{QObject::tr("Failed to map radiance readback buffer")};
+    }
+
+    const auto wlSetCount=planeCount_-1;
+    const auto wavelengthCount=result_.wavelengths.size();
+    result_.radiances.resize(pixelCount_*wavelengthCount);
+    result_.directions.resize(pixelCount_);
+    const auto rectHeight = rectWidth_ ? pixelCount_/rectWidth_ : 0;
+    for(size_t p=0; p<pixelCount_; ++p)
+    {
+        // GL rows go from bottom to top, while our pixels are enumerated from the top
+        const auto bufIndex = rectWidth_ ? (rectHeight-1-p/rectWidth_)*rectWidth_ + p%rectWidth_ : p;
+        for(unsigned wlSet=0; wlSet<wlSetCount; ++wlSet)
+        {
+            const auto src=data+4*(wlSet*pixelCount_+bufIndex);
+            std::copy_n(src, 4, &result_.radiances[p*wavelengthCount+4*wlSet]);
+        }
+
+        const auto viewDir=data+4*(wlSetCount*pixelCount_+bufIndex);
+        auto& dir=result_.directions[p];
+        dir.azimuth = 180/M_PI * (viewDir[0]!=0 || viewDir[1]!=0 ? std::atan2(viewDir[1], viewDir[0]) : 0);
+        dir.elevation = 180/M_PI * std::asin(viewDir[2]);
+    }
+
+    gl.glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    releaseGLObjects();
+    unpacked_=true;
+    return result_;
+}
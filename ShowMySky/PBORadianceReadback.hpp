@@ -0,0 +1,52 @@
+#ifndef INCLUDE_ONCE_623115B8_44FA_4FA0_AA04_39C51BD0719B
+#define INCLUDE_ONCE_623115B8_44FA_4FA0_AA04_39C51BD0719B
+
+#include <QOpenGLFunctions_3_3_Core>
+#include "api/ShowMySky/AtmosphereRenderer.hpp"
+
+/**
+ * \brief Radiance readback into a pixel pack buffer, completed by a fence.
+ *
+ * The buffer consists of \c planeCount planes of \c pixelCount RGBA float pixels each: one plane per wavelength set,
+ * followed by a plane of view direction vectors. The renderer fills the planes with \c glReadPixels calls between
+ * #beginReads and #endReads, and the data are unpacked into a SpectralRadianceBlock on the first call to #get.
+ */
+class PBORadianceReadback : public ShowMySky::AtmosphereRenderer::RadianceReadback
+{
+public:
+    /**
+     * \param pixels pixel positions in window coordinates, in the order of the result;
+     * \param rectWidth if nonzero, the planes are read as rectangles of this width, with rows in GL order (bottom
+     *                  to top), and \p pixels enumerate the rectangle from the top-left pixel row by row; if zero,
+     *                  each plane stores the pixels in the order of \p pixels.
+     */
+    PBORadianceReadback(QOpenGLFunctions_3_3_Core& gl, std::vector<float> const& wavelengths,
+                        std::vector<QPoint> const& pixels, unsigned rectWidth);
+    PBORadianceReadback(PBORadianceReadback const&)=delete;
+    ~PBORadianceReadback();
+
+    //! Binds the buffer to \c GL_PIXEL_PACK_BUFFER
+    void beginReads();
+    //! Offset to pass to \c glReadPixels as the data pointer to read into \p pixel of \p plane
+    void* offset(unsigned plane, unsigned pixel=0) const
+    { return reinterpret_cast<void*>(4*sizeof(GLfloat)*(size_t(plane)*pixelCount_+pixel)); }
+    //! Unbinds the buffer and inserts the fence
+    void endReads();
+
+    bool isReady() override;
+    ShowMySky::AtmosphereRenderer::SpectralRadianceBlock const& get() override;
+
+private:
+    QOpenGLFunctions_3_3_Core& gl;
+    GLuint pbo_=0;
+    GLsync fence_=nullptr;
+    size_t pixelCount_;
+    unsigned planeCount_;
+    unsigned rectWidth_;
+    bool unpacked_=false;
+    ShowMySky::AtmosphereRenderer::SpectralRadianceBlock result_;
+
+    void releaseGLObjects();
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "SharedResourcePool.hpp"
+
+#include <QOpenGLContext>
+
+std::shared_ptr<SharedResourcePool> SharedResourcePool::forContext(QOpenGLContext*const context)
+{
+    static std::mutex poolsMutex;
+    static std::map<const void*, std::weak_ptr<SharedResourcePool>> pools;
+
+    // Without a context there's nothing to share with
+    if(!context) return std::make_shared<SharedResourcePool>();
+
+    const std::lock_guard lock(poolsMutex);
+    // Forget the pools of share groups that no longer have renderers
+    for(auto it=pools.begin(); it!=pools.end();)
+    {
+        if(it->second.expired())
+            it=pools.erase(it);
+        else
+            ++it;
+    }
+
+    auto& entry=pools[context->shareGroup()];
+    auto pool=entry.lock();
+    if(!pool)
+    {
+        pool=std::make_shared<SharedResourcePool>();
+        entry=pool;
+    }
+    return pool;
+}
+
+std::shared_ptr<void> SharedResourcePool::findImpl(QString const& key)
+{
+    const std::lock_guard lock(mutex_);
+    const auto it=resources_.find(key);
+    if(it==resources_.end()) return nullptr;
+    auto resource=it->second.lock();
+    if(!resource)
+        resources_.erase(it);
+    return resource;
+}
+
+void SharedResourcePool::shareImpl(QString const& key, std::shared_ptr<void> const& resource)
+{
+    const std::lock_guard lock(mutex_);
+    resources_[key]=resource;
+}
+
+void SharedResourcePool::withdraw(std::shared_ptr<void> const& resource)
+{
+    const std::lock_guard lock(mutex_);
+    for(auto it=resources_.begin(); it!=resources_.end();)
+    {
+        const auto shared=it->second.lock();
+        if(!shared || shared==resource)
+            it=resources_.erase(it);
+        else
+            ++it;
+    }
+}
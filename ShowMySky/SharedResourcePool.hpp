@@ -0,0 +1,50 @@
+#ifndef INCLUDE_ONCE_3F0B6C1E_8D27_4A95_B1E4_6C2D90A7F853
+#define INCLUDE_ONCE_3F0B6C1E_8D27_4A95_B1E4_6C2D90A7F853
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <QString>
+
+class QOpenGLContext;
+
+/**
+ * \brief Lets renderers whose OpenGL contexts share objects use the same read-only textures and shader programs.
+ *
+ * There's one pool per share group of OpenGL contexts, obtained via #forContext. The pool only keeps weak references to
+ * the resources, so each resource is destroyed when the last renderer using it releases it, and the pool itself lives
+ * as long as any renderer holds it. Users of the pool should choose the keys so that equal keys imply identical
+ * resources, e.g. include the canonical path of the data file and the altitude slice loaded from it.
+ *
+ * The pool may be accessed from threads of different contexts of the share group.
+ */
+class SharedResourcePool
+{
+public:
+    //! Returns the pool of the share group of \p context, creating it if none exists yet
+    static std::shared_ptr<SharedResourcePool> forContext(QOpenGLContext* context);
+
+    //! Returns the resource shared under \p key, or \c nullptr if there's none or it has already been destroyed
+    template<typename T>
+    std::shared_ptr<T> find(QString const& key)
+    {
+        return std::static_pointer_cast<T>(findImpl(key));
+    }
+    //! Makes \p resource available under \p key, replacing the resource previously shared under it, if any
+    template<typename T>
+    void share(QString const& key, std::shared_ptr<T> const& resource)
+    {
+        shareImpl(key, std::static_pointer_cast<void>(resource));
+    }
+    //! Stops sharing \p resource, e.g. before modifying it so that it no longer matches its key
+    void withdraw(std::shared_ptr<void> const& resource);
+
+private:
+    std::mutex mutex_;
+    std::map<QString, std::weak_ptr<void>> resources_;
+
+    std::shared_ptr<void> findImpl(QString const& key);
+    void shareImpl(QString const& key, std::shared_ptr<void> const& resource);
+};
+
+#endif
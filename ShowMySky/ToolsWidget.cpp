@@ -1,6 +1,7 @@
 #include "ToolsWidget.hpp"
 #include <QFrame>
 #include <QLabel>
+#include <QFontDatabase>
 #include <QPushButton>
 #include <cmath>
 #include "RadiancePlot.hpp"
@@ -147,8 +148,49 @@ ToolsWidget::ToolsWidget(QWidget*const parent)
         colorMode_->setSizePolicy(QSizePolicy::Expanding,QSizePolicy::Fixed);
         layout->addLayout(hbox);
     }
+    {
+        resolutionReduction_->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+        resolutionReduction_->addItem(tr("Full"), 1u);
+        resolutionReduction_->addItem(tr("1/2, upsampled"), 2u);
+        resolutionReduction_->addItem(tr("1/4, upsampled"), 4u);
+        resolutionReduction_->setToolTip(tr("Render smooth parts of the sky at reduced resolution.\n"
+                                            "Spectral radiance is only available at full resolution."));
+        connect(resolutionReduction_, qOverload<int>(&QComboBox::currentIndexChanged), this, [this](const int index)
+                { emit resolutionReductionChanged(resolutionReduction_->itemData(index).toUInt()); });
+        const auto hbox=new QHBoxLayout;
+        const auto label=new QLabel(tr("Sky resolution"));
+        label->setBuddy(resolutionReduction_);
+        hbox->addWidget(label);
+        hbox->addWidget(resolutionReduction_);
+        resolutionReduction_->setSizePolicy(QSizePolicy::Expanding,QSizePolicy::Fixed);
+        layout->addLayout(hbox);
+    }
     gradualClippingEnabled_ = addCheckBox(layout, this, tr("&Gradual color clipping"), true);
     glareEnabled_ = addCheckBox(layout, this, tr("Glare (visual only)"), false);
+    {
+        glareMethod_->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+        glareMethod_->addItem(tr("Exact line convolution"));
+        glareMethod_->addItem(tr("Fast mip pyramid approximation"));
+        glareMethod_->setCurrentIndex(static_cast<int>(GlareFilter::Method::LineConvolution));
+        glareMethod_->setToolTip(tr("The cost of the exact filter grows linearly with window size, "
+                                    "that of the approximation only logarithmically."));
+        connect(glareMethod_, qOverload<int>(&QComboBox::currentIndexChanged), this, &ToolsWidget::glareMethodChanged);
+        const auto hbox=new QHBoxLayout;
+        const auto label=new QLabel(tr("Glare filter"));
+        label->setBuddy(glareMethod_);
+        hbox->addWidget(label);
+        hbox->addWidget(glareMethod_);
+        glareMethod_->setSizePolicy(QSizePolicy::Expanding,QSizePolicy::Fixed);
+        const auto frame=new QFrame;
+        frame->setLayout(hbox);
+        frame->setEnabled(glareEnabled_->isChecked());
+        auto margins=frame->contentsMargins();
+        margins.setLeft(glareEnabled_->style()->pixelMetric(QStyle::PM_IndicatorWidth));
+        frame->setContentsMargins(margins);
+        layout->addWidget(frame);
+        connect(glareEnabled_, &QCheckBox::stateChanged, frame, [frame](const int state)
+                { frame->setEnabled(state==Qt::Checked); });
+    }
     zeroOrderScatteringEnabled_ = addCheckBox(layout, this, tr("Draw zer&o-order scattering layer"), true);
     singleScatteringEnabled_    = addCheckBox(layout, this, tr("Draw &single scattering layers"), true);
     {
@@ -220,10 +262,28 @@ ToolsWidget::ToolsWidget(QWidget*const parent)
         connect(windowDecorationEnabled_, &QCheckBox::stateChanged, this,
                 [this](const bool enabled){ emit windowDecorationToggled(enabled); });
     }
+    {
+        gpuTimings_=new QLabel;
+        gpuTimings_->setTextFormat(Qt::PlainText);
+        gpuTimings_->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+        gpuTimings_->setTextInteractionFlags(Qt::TextSelectableByMouse);
+        layout->addWidget(gpuTimings_);
+    }
 
     layout->addStretch();
 }
 
+void ToolsWidget::showGPUTimings(std::vector<ShowMySky::AtmosphereRenderer::GPUTimingEntry> const& timings)
+{
+    QString text=tr("GPU time per frame:");
+    for(const auto& entry : timings)
+    {
+        text += '\n' + QString(2*(entry.depth+1), ' ') +
+                tr("%1: %2 ms").arg(entry.name).arg(entry.timeInMS, 0, 'f', 3);
+    }
+    gpuTimings_->setText(text);
+}
+
 void ToolsWidget::showRadiancePlot()
 {
     if(!radiancePlotWindow_)
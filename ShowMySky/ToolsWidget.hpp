@@ -11,6 +11,7 @@
 #include "GLWidget.hpp"
 #include "api/ShowMySky/Settings.hpp"
 
+class QLabel;
 class QCheckBox;
 
 class ToolsWidget : public QDockWidget, public ShowMySky::Settings
@@ -25,6 +26,8 @@ class ToolsWidget : public QDockWidget, public ShowMySky::Settings
     QComboBox* solarSpectrumMode_=new QComboBox;
     QComboBox* projection_=new QComboBox;
     QComboBox* colorMode_=new QComboBox;
+    QComboBox* resolutionReduction_=new QComboBox;
+    QComboBox* glareMethod_=new QComboBox;
     QDoubleSpinBox* solarSpectrumTemperature_=new QDoubleSpinBox;
     Manipulator* altitude_=nullptr;
     Manipulator* exposure_=nullptr;
@@ -52,6 +55,7 @@ class ToolsWidget : public QDockWidget, public ShowMySky::Settings
     std::unique_ptr<QWidget> radiancePlotWindow_;
     RadiancePlot* radiancePlot_=nullptr;
     QCheckBox* windowDecorationEnabled_=nullptr;
+    QLabel* gpuTimings_=nullptr;
     QVector<QCheckBox*> scatterers;
 public:
     ToolsWidget(QWidget* parent=nullptr);
@@ -75,13 +79,16 @@ public:
     bool textureFilteringEnabled() override { return textureFilteringEnabled_->isChecked(); }
     bool usingEclipseShader() override { return usingEclipseShader_->isChecked(); }
     bool pseudoMirrorEnabled() override { return pseudoMirrorEnabled_->isChecked(); }
+    bool lazyShaderLoadingEnabled() override { return true; } // GLWidget warms up the rest in the background
     bool gradualClippingEnabled() const { return gradualClippingEnabled_->isChecked(); }
     bool glareEnabled() const { return glareEnabled_->isChecked(); }
+    GlareFilter::Method glareMethod() const { return static_cast<GlareFilter::Method>(glareMethod_->currentIndex()); }
     float exposure() const { return std::pow(10., exposure_->value()); }
     GLWidget::DitheringMode ditheringMode() const { return static_cast<GLWidget::DitheringMode>(ditheringMode_->currentIndex()); }
     GLWidget::DitheringMethod ditheringMethod() const { return static_cast<GLWidget::DitheringMethod>(ditheringMethod_->currentIndex()); }
 
     bool handleSpectralRadiance(ShowMySky::AtmosphereRenderer::SpectralRadiance const& spectrum);
+    void showGPUTimings(std::vector<ShowMySky::AtmosphereRenderer::GPUTimingEntry> const& timings);
     void setCanGrabRadiance(bool can);
     void setCanSetSolarSpectrum(bool can);
     void setZoomFactor(double zoom);
@@ -107,6 +114,8 @@ signals:
     void windowDecorationToggled(bool enabled);
     void projectionChanged(GLWidget::Projection);
     void colorModeChanged(GLWidget::ColorMode);
+    void resolutionReductionChanged(unsigned factor);
+    void glareMethodChanged();
 };
 
 #endif
@@ -0,0 +1,82 @@
+#ifndef INCLUDE_ONCE_BAF775CC_0529_46FD_B4C5_8C8A49C1B77F
+#define INCLUDE_ONCE_BAF775CC_0529_46FD_B4C5_8C8A49C1B77F
+
+// View direction shaders shared by the interactive viewer and the batch renderer. The fragment shader
+// implements calcViewDir() for the projections listed in GLWidget::Projection, controlled by the uniforms
+// zoomFactor, cameraRotation, viewportAspectRatio and projection. Before use, COSINE_IS_BROKEN must be
+// replaced with 1 or 0 depending on the result of GLSLCosineQualityChecker.
+
+inline constexpr const char* viewDirVertShaderSrc=1+R"(
+#version 330
+in vec3 vertex;
+out vec3 position;
+void main()
+{
+    position=vertex;
+    gl_Position=vec4(position,1);
+}
+)";
+
+inline constexpr const char* viewDirFragShaderSrc=1+R"(
+#version 330
+in vec3 position;
+uniform float zoomFactor;
+uniform mat3 cameraRotation;
+uniform float viewportAspectRatio;
+
+uniform int projection;
+// These values must match the entries in the Projection enum
+#define PROJ_EQUIRECTANGULAR 0
+#define PROJ_PERSPECTIVE 1
+#define PROJ_FISHEYE 2
+
+const float PI=3.1415926535897932;
+
+#if COSINE_IS_BROKEN
+// Define Chebyshoff approximations for sin and cos
+float sin(float x)
+{
+    x = mod(x+PI, 2*PI)-PI;
+    return x*(0.999999599920672 + x*x*(-0.166665526354071 + x*x*(0.00833240298869917 + x*x*(-0.0001980863334175 + x*x*(2.69971463693744e-6 - 2.03622449118901e-8*x*x)))));
+}
+float cos(float x)
+{
+    x = mod(x+PI, 2*PI)-PI;
+    return 0.999999210782322 + x*x*(-0.499994213384716 + x*x*(0.0416597778065509 + x*x*(-0.00138587899196014 + x*x*(0.0000242029413673591 - 2.19729638194131e-7*x*x))));
+}
+#endif
+
+vec3 calcViewDir()
+{
+    vec2 pos=position.xy/zoomFactor;
+    if(projection==PROJ_EQUIRECTANGULAR)
+    {
+        return cameraRotation*vec3(cos(pos.x*PI)*cos(pos.y*(PI/2)),
+                                   sin(pos.x*PI)*cos(pos.y*(PI/2)),
+                                   sin(pos.y*(PI/2)));
+    }
+    else if(projection==PROJ_PERSPECTIVE)
+    {
+        const float horizViewAngle = 120*PI/180;
+        const float camDistToScreen = 0.5 * tan(horizViewAngle);
+        pos.y /= viewportAspectRatio;
+        return cameraRotation * normalize(vec3(-camDistToScreen, pos));
+    }
+    else if(projection==PROJ_FISHEYE)
+    {
+        const float thetaMax=PI;
+        float r=length(pos.xy);
+        float theta=r*thetaMax;
+        if(theta > thetaMax)
+            return vec3(0);
+        float phi = PI - atan(pos.x,pos.y);
+        return cameraRotation*vec3(cos(phi)*sin(theta),
+                                   sin(phi)*sin(theta),
+                                            cos(theta));
+    }
+
+    return vec3(0);
+}
+)";
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <QObject>
 #include <QVector4D>
+#include <QRect>
 #include <qopengl.h>
 
 #include "Settings.hpp"
@@ -69,6 +70,57 @@ public:
         int stepsToDo; //!< Total number of steps to do. Negative in case of error (e.g. when a step function was called at inappropriate moment).
     };
 
+    /**
+     * \brief Spectral radiances and view directions of a set of pixels.
+     */
+    struct SpectralRadianceBlock
+    {
+        std::vector<float> wavelengths;   //!< Wavelengths in nanometers, common to all the pixels
+        /**
+         * Spectral radiances of all the pixels, in \f$\mathrm{\frac{W}{m^2\,sr\,nm}}\f$. The spectrum of each pixel is stored contiguously: radiance of pixel \c p at \c wavelengths[w] is \c radiances[p*wavelengths.size()+w].
+         */
+        std::vector<float> radiances;
+        std::vector<QPoint> pixels;       //!< Positions of the pixels in window coordinates, in the order their spectra are stored
+        std::vector<Direction> directions; //!< View directions of the pixels, in the same order
+
+        //! Number of pixels in the block.
+        unsigned pixelCount() const { return pixels.size(); }
+        //! Pointer to the first of \c wavelengths.size() radiance values of the pixel number \p pixel.
+        float const* spectrum(unsigned pixel) const { return radiances.data()+size_t(pixel)*wavelengths.size(); }
+    };
+
+    /**
+     * \brief Handle to an asynchronous readback of spectral radiance started by #startRadianceReadback.
+     *
+     * The handle refers to OpenGL objects of the renderer, so it must be destroyed while the OpenGL context of the renderer is current, and before the renderer itself.
+     */
+    class RadianceReadback
+    {
+    public:
+        /**
+         * \brief Check whether the data have arrived, without waiting.
+         * \returns \c true if #get won't block.
+         */
+        virtual bool isReady() = 0;
+        /**
+         * \brief Get the data, waiting for the GPU if necessary.
+         *
+         * The first call unpacks the data; subsequent calls return the same object.
+         */
+        virtual SpectralRadianceBlock const& get() = 0;
+        virtual ~RadianceReadback() = default;
+    };
+
+    /**
+     * \brief GPU time spent in a named part of a frame.
+     */
+    struct GPUTimingEntry
+    {
+        QString name;    //!< Name of the part of the frame, e.g. "Multiple scattering"
+        unsigned depth;  //!< Nesting level: 0 for the top-level parts, 1 for the parts inside them, etc.
+        double timeInMS; //!< GPU time spent in this part, in milliseconds
+    };
+
 public:
     /**
      * \brief Set the callback that will draw the screen surface.
@@ -89,6 +141,8 @@ public:
      *
      * The fragment shader \p viewDirFragShaderSrc passed here implements `vec3 calcViewDir(void)` function that is used as an application-agnostic way of determining view direction of the ray associated with a given fragment of the surface being rendered.
      *
+     * Renderers whose OpenGL contexts are in the same share group (including several renderers in the same context) share the textures loaded from the same data at the same altitude, as well as the shader programs built with identical view direction shaders. Such resources are only loaded by the first renderer that needs them, while the loading steps of the others complete almost immediately. The current OpenGL context at the time of this call determines the share group.
+     *
      * \param viewDirVertShaderSrc a vertex shader that will be used by all the shader programs that implement the atmosphere model;
      * \param viewDirFragShaderSrc a fragment shader that implements \c calcViewDir function;
      * \param viewDirBindAttribLocations locations of vertex attributes necessary to render the screen surface. Each \c pair consists of an attribute name and its location.
@@ -174,6 +228,8 @@ public:
      *
      * This method returns the OpenGL name suitable for use with \c glBindTexture for the render target containing photopic and scotopic luminance values packed into \c vec4 pixels (see #getPixelLuminance for details). This is the main output of #draw that can be used to finally render the data to screen in the desired color space.
      *
+     * If several view layers have been requested via #setViewLayers, the render target is a \c GL_TEXTURE_2D_ARRAY or a \c GL_TEXTURE_CUBE_MAP texture instead of a \c GL_TEXTURE_2D one.
+     *
      * \return OpenGL name of the luminance render target.
      */
     virtual GLuint getLuminanceTexture() = 0;
@@ -195,6 +251,53 @@ public:
      * \param height height of the rener target.
      */
     virtual void resizeEvent(int width, int height) = 0;
+    /**
+     * \brief Render several views in a single #draw call.
+     *
+     * This method makes #draw render \p layerCount views at once into the layers of the luminance render target, which becomes a 2D array texture or, if \p cubeMap is \c true, a cube map texture. Each scattering pass then binds its program, uniforms and textures once for all the views, and the surface drawn by the callback set via #setDrawSurfaceCallback is replicated to all the layers by a geometry shader. This is useful e.g. for generation of environment maps or rendering for a rig of several cameras.
+     *
+     * In this mode the view direction shaders have to follow some additional rules. The vertex shader must pass the surface coordinates to the fragment stage only via its `vec3 position` output, and must not use the name `position` for anything else. The fragment shader may declare `flat in int viewLayer;` to get the index of the layer being rendered and compute the view direction accordingly, e.g. using an array of camera rotations. For a cube map, the layers are the faces in the order of \c GL_TEXTURE_CUBE_MAP_POSITIVE_X + \c viewLayer, and the faces are square, having the width passed to #resizeEvent as their size.
+     *
+     * Spectral radiance can't be grabbed in this mode, so #canGrabRadiance returns \c false and #getViewDirection returns NaNs. #getPixelLuminance reads the first layer.
+     *
+     * The change causes relinking of all the shader programs in use, like #setViewDirShaders does.
+     *
+     * \param layerCount number of views to render, 1 to return to rendering of a single view into a 2D texture;
+     * \param cubeMap whether to render into a cube map, in which case \p layerCount must be 6.
+     */
+    virtual void setViewLayers(unsigned layerCount, bool cubeMap) = 0;
+    /**
+     * \brief Render the smooth parts of the sky at reduced resolution.
+     *
+     * This method makes #draw render the scattering passes at \p factor times lower resolution in each dimension, and then upsample the result to the full-resolution luminance render target. The upsampling interpolates logarithm of luminance, since it varies roughly exponentially across the sky. The pixels where this would lose detail, namely those near the discs of the Sun and the Moon, near the horizon, and those whose neighborhood in the reduced-resolution image has high contrast, are instead rendered by the scattering passes again, at full resolution.
+     *
+     * Spectral radiance can't be grabbed in this mode, so #canGrabRadiance returns \c false. When accumulating several draws with \c clear set to \c false, the scene should stay the same between them, otherwise the set of full-resolution pixels may differ. The mode has no effect when several view layers are rendered, see #setViewLayers.
+     *
+     * \param factor ratio of full resolution to the reduced one, 1 to render everything at full resolution. Useful values are 2 to 4.
+     */
+    virtual void setResolutionReduction(unsigned factor) = 0;
+    /**
+     * \brief Let #draw reuse the previous frame if nothing has changed since it was rendered.
+     *
+     * When frame caching is enabled, #draw with \p clear set to \c true returns without rendering if the brightness, all the values returned by the ShowMySky::Settings, the solar spectrum, the enabled states of the scatterers and the size of the render target are the same as for the previous such call. The luminance and radiance render targets then keep the previous frame. Drawing with \p clear set to \c false always renders, and the next draw too.
+     *
+     * The renderer can't see the uniforms set by the callback passed to #setDrawSurfaceCallback, e.g. camera orientation or zoom, so the application must call #invalidateFrame whenever they change.
+     *
+     * Caching is disabled by default.
+     */
+    virtual void setFrameCachingEnabled(bool enable) = 0;
+    /**
+     * \brief Make the next call to #draw render, even if frame caching would let it reuse the previous frame.
+     *
+     * See #setFrameCachingEnabled.
+     */
+    virtual void invalidateFrame() = 0;
+    /**
+     * \brief Tell whether the last call to #draw reused the previous frame instead of rendering.
+     *
+     * The application can use this to skip its own processing of the luminance render target, e.g. glare, when its input hasn't changed.
+     */
+    virtual bool lastDrawReusedFrame() const = 0;
     /**
      * \brief Get luminance of a pixel.
      *
@@ -216,6 +319,24 @@ public:
      * \return Spectral radiance of the pixel specified.
      */
     virtual SpectralRadiance getPixelSpectralRadiance(QPoint const& pixelPos) = 0;
+    /**
+     * \brief Start reading back spectral radiance of a rectangular region.
+     *
+     * This method schedules copying of the radiance render targets of all the wavelength sets, as well as the view directions, from the region specified into a buffer, without waiting for the GPU. The result can be fetched later via the handle returned. The data correspond to the last #draw call preceding this one.
+     *
+     * \param region region in window coordinates, (0,0) corresponding to the top-left point; a null rectangle means the whole render target. The region is clipped to the render target.
+     * \return A handle to the pending readback, with the pixels ordered row by row starting from the top-left one; \c nullptr if #canGrabRadiance returns \c false or the region is empty.
+     */
+    virtual std::unique_ptr<RadianceReadback> startRadianceReadback(QRect const& region = {}) = 0;
+    /**
+     * \brief Start reading back spectral radiance of a list of pixels.
+     *
+     * This is an overload of #startRadianceReadback(QRect const&) for a set of pixels that don't form a rectangle, e.g. samples for region statistics. Pixels outside of the render target are skipped.
+     *
+     * \param pixels positions of the pixels in window coordinates, (0,0) corresponding to the top-left point.
+     * \return A handle to the pending readback, with the pixels in the order given; \c nullptr if #canGrabRadiance returns \c false or no pixel is inside the render target.
+     */
+    virtual std::unique_ptr<RadianceReadback> startRadianceReadback(std::vector<QPoint> const& pixels) = 0;
     /**
      * \brief Get the wavelengths used in computations.
      * \returns All the wavelengths used in computations, in nanometers.
@@ -263,6 +384,30 @@ public:
      * This is a debug method. It performs a single step of the process of reloading of shaders initialized by #initShaderReloading.
      */
     virtual LoadingStatus stepShaderReloading() = 0;
+    /**
+     * \brief Perform a single step of loading of the shaders deferred by lazy loading.
+     *
+     * If Settings::lazyShaderLoadingEnabled returned \c true when #initDataLoading was called, the shader programs not needed by the current settings (e.g. eclipse programs while Settings::usingEclipseShader returns \c false) are not loaded with the rest of the data. They are loaded on demand by #initPreparationToDraw and #stepPreparationToDraw as soon as the settings require them. To avoid a delay at that moment, the application can instead call this method repeatedly while idle, until its return value indicates completion. The renderer remains ready to render during this process.
+     *
+     * \returns Status of the warm-up. If there's nothing to do, \c stepsToDo is zero. If the renderer isn't ready to render, e.g. while it's reloading textures after a change of altitude, \c stepsToDo is negative and nothing is done: the warm-up should then be resumed when the renderer is ready again.
+     */
+    virtual LoadingStatus stepShaderWarmup() = 0;
+    /**
+     * \brief Enable or disable measurement of GPU time spent by #draw.
+     *
+     * This is a debug method. When profiling is enabled, #draw wraps its parts (zero-order scattering, single scattering of each scatterer, multiple scattering, light pollution, eclipse precomputations) in GPU timer queries. The queries are read back asynchronously, so profiling doesn't stall the pipeline.
+     *
+     * Must be called with the OpenGL context of the renderer current.
+     */
+    virtual void setGPUProfilingEnabled(bool enable) = 0;
+    /**
+     * \brief Get GPU timings of the parts of a recent frame.
+     *
+     * The results come from the latest frame whose timer queries have completed, which is typically one or two frames behind the last call to #draw. The entries are listed in the order the parts began, with nested parts following their enclosing one.
+     *
+     * \returns GPU timings of the last completed frame, or an empty vector if profiling is disabled or no frame has completed yet.
+     */
+    virtual std::vector<GPUTimingEntry> getGPUTimings() const = 0;
     /**
      * \brief Enable or disable a single-scattering layer.
      *
@@ -299,7 +444,7 @@ SHOWMYSKY_DLL_PUBLIC ShowMySky::AtmosphereRenderer*
  *
  * If the value of the symbol doesn't match the value of this constant, the library loaded is incompatible with the header against which the binary was compiled. Mixing incompatible header and library leads to undefined behavior.
  */
-#define ShowMySky_ABI_version 15
+#define ShowMySky_ABI_version 21
 
 /**
  * \brief Name of library to be dlopen()-ed
@@ -131,6 +131,28 @@ public:
      */
     virtual bool pseudoMirrorEnabled() = 0;
 
+    /**
+     * \brief Whether to keep per-wavelength-set textures in texture arrays and render them with one program per family.
+     *
+     * If \c true, transmittance, irradiance and light pollution textures of all wavelength sets are loaded as layers of a single array texture per family, and single scattering textures of each scatterer are stacked along depth of a single 3D texture. The shader programs that used to be built for each wavelength set are then built once and select the set with a uniform, which reduces the number of texture objects, texture binds and programs to compile. This requires the model data generated by a version of CalcMySky whose shaders support texture arrays; for older data the setting is ignored.
+     *
+     * This setting is only queried when data loading is initiated (see AtmosphereRenderer::initDataLoading).
+     *
+     * \returns Whether to use texture arrays for per-wavelength-set textures.
+     */
+    virtual bool wavelengthSetTextureArraysEnabled() { return false; }
+
+    /**
+     * \brief Whether to defer loading of the shaders not needed by the current settings.
+     *
+     * If \c true, data loading skips the shader programs not needed by the current settings: those only used to render an eclipsed atmosphere while #usingEclipseShader returns \c false, those of the single scattering mode not selected by #onTheFlySingleScatteringEnabled, and those of light pollution while #lightPollutionGroundLuminance returns zero. This shortens the time to first frame. The skipped programs are then loaded on demand when the settings start requiring them, or in the background via AtmosphereRenderer::stepShaderWarmup.
+     *
+     * This setting is only queried when data loading is initiated (see AtmosphereRenderer::initDataLoading).
+     *
+     * \returns Whether to load shaders lazily.
+     */
+    virtual bool lazyShaderLoadingEnabled() { return false; }
+
     virtual ~Settings() = default;
 };
 
@@ -0,0 +1,102 @@
+#include "AsyncImageWriter.hpp"
+
+#include <algorithm>
+#include <QFile>
+#include "../../common/util.hpp"
+
+AsyncImageWriter::AsyncImageWriter(QOpenGLFunctions_3_3_Core& gl, const unsigned ringSize)
+    : gl(gl)
+    , slots_(std::max(1u, ringSize))
+{
+    for(auto& slot : slots_)
+        gl.glGenBuffers(1, &slot.pbo);
+    gl.glGenFramebuffers(1, &readFBO_);
+}
+
+AsyncImageWriter::~AsyncImageWriter()
+{
+    for(auto& slot : slots_)
+    {
+        if(slot.fence)
+            gl.glDeleteSync(slot.fence);
+        gl.glDeleteBuffers(1, &slot.pbo);
+    }
+    gl.glDeleteFramebuffers(1, &readFBO_);
+}
+
+void AsyncImageWriter::enqueue(const GLuint texture, const int width, const int height, QString const& path)
+{
+    auto& slot=slots_[nextSlot_];
+    nextSlot_=(nextSlot_+1)%slots_.size();
+    if(slot.fence)
+        finish(slot);
+
+    GLint origReadFBO=0;
+    gl.glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &origReadFBO);
+    gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO_);
+    gl.glFramebufferTexture(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    gl.glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const GLsizeiptr size = 4*sizeof(GLfloat)*GLsizeiptr(width)*height;
+    if(size > slot.capacity)
+    {
+        gl.glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity=size;
+    }
+    gl.glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, nullptr);
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, origReadFBO);
+    if(const auto err=gl.glGetError(); err!=GL_NO_ERROR)
+        throw OpenGLError{QObject::tr("GL error on attempt to read back image for \"%1\": %2").arg(path).arg(openglErrorString(err).c_str())};
+
+    slot.fence=gl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width=width;
+    slot.height=height;
+    slot.path=path;
+}
+
+void AsyncImageWriter::finish(Slot& slot)
+{
+    // Only blocks if the GPU is still busy with the frame, which is the point where we must wait anyway
+    constexpr GLuint64 timeoutNS=1'000'000'000;
+    GLenum status;
+    while((status=gl.glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNS))==GL_TIMEOUT_EXPIRED);
+    gl.glDeleteSync(slot.fence);
+    slot.fence=nullptr;
+    if(status==GL_WAIT_FAILED)
+        throw OpenGLError{QObject::tr("Failed to wait for readback of image for \"%1\"").arg(slot.path)};
+
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const auto size = 4*sizeof(GLfloat)*size_t(slot.width)*slot.height;
+    const auto data=gl.glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if(!data)
+    {
+        gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        throw OpenGLError{QObject::tr("Failed to map pixel buffer for \"%1\"").arg(slot.path)};
+    }
+
+    QFile out(slot.path);
+    const bool opened=out.open(QFile::WriteOnly);
+    if(opened)
+    {
+        for(const uint16_t s : {slot.width, slot.height})
+            out.write(reinterpret_cast<const char*>(&s), sizeof s);
+        out.write(static_cast<const char*>(data), size);
+    }
+    gl.glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if(!opened || out.error()!=QFile::NoError)
+        throw DataLoadError{QObject::tr("Failed to write \"%1\": %2").arg(slot.path).arg(out.errorString())};
+}
+
+void AsyncImageWriter::flush()
+{
+    // Finish in the order of submission
+    for(unsigned i=0; i<slots_.size(); ++i)
+    {
+        auto& slot=slots_[(nextSlot_+i)%slots_.size()];
+        if(slot.fence)
+            finish(slot);
+    }
+}
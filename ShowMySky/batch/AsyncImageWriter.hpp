@@ -0,0 +1,48 @@
+#ifndef INCLUDE_ONCE_198B751F_5F3C_4B2F_9C58_9D707935DE66
+#define INCLUDE_ONCE_198B751F_5F3C_4B2F_9C58_9D707935DE66
+
+#include <vector>
+#include <QString>
+#include <QOpenGLFunctions_3_3_Core>
+
+/**
+ * \brief Saves rendered images to files without waiting for the GPU after each frame.
+ *
+ * Each image is read back into one of a ring of pixel pack buffers, with a fence inserted after the read. The buffer
+ * is only mapped when the ring wraps around to it, by which time the GPU has normally finished that frame, so that
+ * rendering of the following frames overlaps with the transfer and with writing of the files.
+ *
+ * The files have the same layout as the textures saved by CalcMySky: width and height as \c uint16_t, followed by
+ * RGBA pixels as 32-bit floats, bottom row first.
+ */
+class AsyncImageWriter
+{
+public:
+    AsyncImageWriter(QOpenGLFunctions_3_3_Core& gl, unsigned ringSize);
+    AsyncImageWriter(AsyncImageWriter const&)=delete;
+    ~AsyncImageWriter();
+
+    //! Schedules readback of a \c GL_RGBA32F 2D texture and writing of its data to \p path
+    void enqueue(GLuint texture, int width, int height, QString const& path);
+    //! Waits for all the scheduled readbacks and writes the files
+    void flush();
+
+private:
+    struct Slot
+    {
+        GLuint pbo=0;
+        GLsync fence=nullptr;
+        GLsizeiptr capacity=0;
+        int width=0, height=0;
+        QString path;
+    };
+
+    QOpenGLFunctions_3_3_Core& gl;
+    std::vector<Slot> slots_;
+    unsigned nextSlot_=0;
+    GLuint readFBO_=0;
+
+    void finish(Slot& slot);
+};
+
+#endif
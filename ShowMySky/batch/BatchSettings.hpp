@@ -0,0 +1,41 @@
+#ifndef INCLUDE_ONCE_251DC8E3_454D_41D0_9843_8622E609AF54
+#define INCLUDE_ONCE_251DC8E3_454D_41D0_9843_8622E609AF54
+
+#include <cmath>
+#include <ShowMySky/Settings.hpp>
+#include "FrameSpec.hpp"
+
+//! Feeds the parameters of the current frame of a batch to AtmosphereRenderer
+class BatchSettings : public ShowMySky::Settings
+{
+    static constexpr double degree=M_PI/180;
+
+    FrameSpec frame_;
+    bool textureArrays_=false;
+
+public:
+    void setFrame(FrameSpec const& frame) { frame_=frame; }
+    FrameSpec const& frame() const { return frame_; }
+    void setTextureArraysEnabled(bool enabled) { textureArrays_=enabled; }
+
+    double altitude() override { return frame_.altitude; }
+    double sunAzimuth() override { return degree*frame_.sunAzimuth; }
+    double sunZenithAngle() override { return degree*(90-frame_.sunElevation); }
+    double sunAngularRadius() override { return degree*frame_.sunAngularRadius; }
+    double moonAzimuth() override { return degree*frame_.moonAzimuth; }
+    double moonZenithAngle() override { return degree*(90-frame_.moonElevation); }
+    double earthMoonDistance() override { return 1000*frame_.earthMoonDistance; }
+    double lightPollutionGroundLuminance() override { return frame_.lightPollutionLuminance; }
+    bool zeroOrderScatteringEnabled() override { return true; }
+    bool singleScatteringEnabled() override { return true; }
+    bool multipleScatteringEnabled() override { return true; }
+    bool onTheFlySingleScatteringEnabled() override { return false; }
+    bool onTheFlyPrecompDoubleScatteringEnabled() override { return true; }
+    bool usingEclipseShader() override { return frame_.eclipse; }
+    bool pseudoMirrorEnabled() override { return false; }
+    bool wavelengthSetTextureArraysEnabled() override { return textureArrays_; }
+    // Eclipse programs are only loaded if some frame of the batch needs them
+    bool lazyShaderLoadingEnabled() override { return true; }
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "FrameSpec.hpp"
+
+#include <map>
+#include <limits>
+#include <cstdint>
+#include <functional>
+#include <QFile>
+#include <QRegularExpression>
+#include "../../common/util.hpp"
+
+std::vector<FrameSpec> parseBatchFile(QString const& path)
+{
+    QFile file(path);
+    if(!file.open(QFile::ReadOnly))
+        throw DataLoadError{QObject::tr("Failed to open batch file \"%1\": %2").arg(path).arg(file.errorString())};
+
+    std::vector<FrameSpec> frames;
+    FrameSpec frame;
+    int lineNumber=0;
+
+    const auto toDouble=[&](QString const& key, QString const& value)
+    {
+        bool ok=false;
+        const auto x=value.toDouble(&ok);
+        if(!ok)
+            throw ParsingError{path, lineNumber, QObject::tr("failed to parse value of \"%1\": \"%2\"").arg(key).arg(value)};
+        return x;
+    };
+    using Setter=std::function<void(QString const& key, QString const& value)>;
+    const std::map<QString, Setter> setters={
+        {"output", [&](auto&, auto& value){ frame.output=value; }},
+        {"size", [&](auto& key, auto& value)
+            {
+                const QRegularExpression pattern("^([0-9]+)x([0-9]+)$");
+                const auto match=pattern.match(value);
+                if(!match.hasMatch() || match.captured(1).toInt()<=0 || match.captured(2).toInt()<=0)
+                    throw ParsingError{path, lineNumber, QObject::tr("bad value of \"%1\", expected WIDTHxHEIGHT: \"%2\"").arg(key).arg(value)};
+                frame.width=match.captured(1).toInt();
+                frame.height=match.captured(2).toInt();
+                // The header of the output file stores the dimensions as 16-bit numbers
+                constexpr int maxSize=std::numeric_limits<uint16_t>::max();
+                if(frame.width>maxSize || frame.height>maxSize)
+                {
+                    throw ParsingError{path, lineNumber, QObject::tr("bad value of \"%1\", width and height mustn't exceed %2: \"%3\"")
+                                                            .arg(key).arg(maxSize).arg(value)};
+                }
+            }},
+        {"altitude", [&](auto& key, auto& value){ frame.altitude=toDouble(key, value); }},
+        {"sun-azimuth", [&](auto& key, auto& value){ frame.sunAzimuth=toDouble(key, value); }},
+        {"sun-elevation", [&](auto& key, auto& value){ frame.sunElevation=toDouble(key, value); }},
+        {"sun-angular-radius", [&](auto& key, auto& value){ frame.sunAngularRadius=toDouble(key, value); }},
+        {"moon-azimuth", [&](auto& key, auto& value){ frame.moonAzimuth=toDouble(key, value); }},
+        {"moon-elevation", [&](auto& key, auto& value){ frame.moonElevation=toDouble(key, value); }},
+        {"earth-moon-distance", [&](auto& key, auto& value){ frame.earthMoonDistance=toDouble(key, value); }},
+        {"eclipse", [&](auto& key, auto& value)
+            {
+                if(value=="true" || value=="1")
+                    frame.eclipse=true;
+                else if(value=="false" || value=="0")
+                    frame.eclipse=false;
+                else
+                    throw ParsingError{path, lineNumber, QObject::tr("bad value of \"%1\", expected true or false: \"%2\"").arg(key).arg(value)};
+            }},
+        {"light-pollution", [&](auto& key, auto& value){ frame.lightPollutionLuminance=toDouble(key, value); }},
+        {"projection", [&](auto& key, auto& value)
+            {
+                if(value=="equirectangular")
+                    frame.projection=FrameSpec::Equirectangular;
+                else if(value=="perspective")
+                    frame.projection=FrameSpec::Perspective;
+                else if(value=="fisheye")
+                    frame.projection=FrameSpec::Fisheye;
+                else
+                    throw ParsingError{path, lineNumber, QObject::tr("unknown value of \"%1\": \"%2\"").arg(key).arg(value)};
+            }},
+        {"yaw", [&](auto& key, auto& value){ frame.cameraYaw=toDouble(key, value); }},
+        {"pitch", [&](auto& key, auto& value){ frame.cameraPitch=toDouble(key, value); }},
+        {"zoom", [&](auto& key, auto& value){ frame.zoomFactor=toDouble(key, value); }},
+    };
+
+    while(!file.atEnd())
+    {
+        ++lineNumber;
+        const auto line=QString::fromUtf8(file.readLine()).trimmed();
+        if(line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        frame.output.clear();
+        for(const auto& item : line.split(QRegularExpression("\\s+")))
+        {
+            const auto eqPos=item.indexOf('=');
+            if(eqPos<=0)
+                throw ParsingError{path, lineNumber, QObject::tr("expected key=value, got \"%1\"").arg(item)};
+            const auto key=item.left(eqPos);
+            const auto setter=setters.find(key);
+            if(setter==setters.end())
+                throw ParsingError{path, lineNumber, QObject::tr("unknown key \"%1\"").arg(key)};
+            setter->second(key, item.mid(eqPos+1));
+        }
+        if(frame.output.isEmpty())
+            throw ParsingError{path, lineNumber, QObject::tr("output path not specified")};
+        frames.push_back(frame);
+    }
+    return frames;
+}
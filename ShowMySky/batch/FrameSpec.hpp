@@ -0,0 +1,48 @@
+#ifndef INCLUDE_ONCE_2EBD0819_EE7C_4FA6_A920_01FB3105DD67
+#define INCLUDE_ONCE_2EBD0819_EE7C_4FA6_A920_01FB3105DD67
+
+#include <vector>
+#include <QString>
+
+//! Parameters of a single frame of a batch, in the units the interactive viewer shows them
+struct FrameSpec
+{
+    // These values must match the entries in the GLWidget::Projection enum
+    enum Projection
+    {
+        Equirectangular,
+        Perspective,
+        Fisheye,
+    };
+
+    QString output;                     //!< Path to the output files, without extension
+    int width=1024, height=512;         //!< Image size, in pixels
+    double altitude=50;                 //!< Camera altitude, in m
+    double sunAzimuth=0;                //!< In degrees
+    double sunElevation=45;             //!< In degrees
+    double sunAngularRadius=0.25;       //!< In degrees
+    double moonAzimuth=0;               //!< In degrees
+    double moonElevation=41;            //!< In degrees
+    double earthMoonDistance=371925;    //!< In km
+    bool eclipse=false;                 //!< Whether to use eclipse shaders
+    double lightPollutionLuminance=0;   //!< Ground luminance for light pollution, in cd/m²
+    Projection projection=Equirectangular;
+    double cameraYaw=0;                 //!< In degrees
+    double cameraPitch=0;               //!< In degrees
+    double zoomFactor=1;
+};
+
+/**
+ * Parses a batch file. Each non-empty line that doesn't start with \c # describes a frame as a set of
+ * whitespace-separated \c key=value pairs, e.g.
+ *
+ *     output=frames/dawn-000 size=512x512 projection=fisheye sun-elevation=-3 sun-azimuth=90
+ *
+ * Parameters not specified on a line are inherited from the previous frame, so a sequence can be described by
+ * changing only what varies. The \c output key must be given on each line.
+ *
+ * Throws ParsingError on malformed input.
+ */
+std::vector<FrameSpec> parseBatchFile(QString const& path);
+
+#endif
@@ -0,0 +1,81 @@
+#include "PhaseFunctionTable.hpp"
+
+#include <algorithm>
+#include <QOpenGLShaderProgram>
+#include "../../common/types.hpp"
+#include "../../common/util.hpp"
+#include "../util.hpp"
+
+std::vector<glm::vec4> tabulatePhaseFunction(QOpenGLFunctions_3_3_Core& gl, const GLuint vao, QString const& pathToData,
+                                             QString const& scattererName, const unsigned wlSetIndex)
+{
+    // Shaders for on-the-fly single scattering are saved for all scatterers and wavelength sets, whatever
+    // the phase function type, and their phase function file is self-contained.
+    const auto phaseFunctionPath=QString("%1/shaders/single-scattering/%2/%3/%4/phase-functions.frag")
+                                    .arg(pathToData).arg(singleScatteringRenderModeNames[SSRM_ON_THE_FLY])
+                                    .arg(wlSetIndex).arg(scattererName);
+
+    QOpenGLShaderProgram program;
+    addShaderCode(program, QOpenGLShader::Vertex, QObject::tr("phase function tabulation vertex shader"), 1+R"(
+#version 330
+in vec4 vertex;
+void main() { gl_Position=vertex; }
+)");
+    addShaderCode(program, QOpenGLShader::Fragment, QObject::tr("phase function tabulation fragment shader"), 1+R"(
+#version 330
+vec4 currentPhaseFunction(float dotViewSun);
+uniform float sampleCount;
+out vec4 value;
+void main()
+{
+    const float PI=3.14159265358979324;
+    value=currentPhaseFunction(cos(PI*(gl_FragCoord.x-0.5)/(sampleCount-1)));
+}
+)");
+    addShaderFile(program, QOpenGLShader::Fragment, phaseFunctionPath);
+    program.bindAttributeLocation("vertex", 0);
+    link(program, QObject::tr("phase function tabulation program for scatterer \"%1\"").arg(scattererName));
+
+    GLint maxTextureSize=0;
+    gl.glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    const int sampleCount=std::min(4096, maxTextureSize);
+
+    GLint origViewport[4], origFBO=0;
+    gl.glGetIntegerv(GL_VIEWPORT, origViewport);
+    gl.glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &origFBO);
+
+    GLuint texture=0, fbo=0;
+    gl.glGenTextures(1, &texture);
+    gl.glBindTexture(GL_TEXTURE_2D, texture);
+    gl.glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, sampleCount, 1, 0, GL_RGBA, GL_FLOAT, nullptr);
+    gl.glBindTexture(GL_TEXTURE_2D, 0);
+    gl.glGenFramebuffers(1, &fbo);
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    gl.glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    gl.glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    gl.glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    gl.glViewport(0, 0, sampleCount, 1);
+    program.bind();
+    program.setUniformValue("sampleCount", float(sampleCount));
+    gl.glBindVertexArray(vao);
+    gl.glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    gl.glBindVertexArray(0);
+    program.release();
+
+    std::vector<glm::vec4> values(sampleCount);
+    gl.glReadPixels(0, 0, sampleCount, 1, GL_RGBA, GL_FLOAT, values.data());
+    const auto err=gl.glGetError();
+
+    gl.glBindFramebuffer(GL_FRAMEBUFFER, origFBO);
+    gl.glViewport(origViewport[0], origViewport[1], origViewport[2], origViewport[3]);
+    gl.glDeleteFramebuffers(1, &fbo);
+    gl.glDeleteTextures(1, &texture);
+
+    if(err!=GL_NO_ERROR)
+    {
+        throw OpenGLError{QObject::tr("GL error while tabulating phase function of scatterer \"%1\": %2")
+                          .arg(scattererName).arg(openglErrorString(err).c_str())};
+    }
+    return values;
+}
@@ -0,0 +1,19 @@
+#ifndef INCLUDE_ONCE_0D6E43B2_9A51_4C7F_8E2B_51F3A7C90E64
+#define INCLUDE_ONCE_0D6E43B2_9A51_4C7F_8E2B_51F3A7C90E64
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <QString>
+#include <QOpenGLFunctions_3_3_Core>
+
+/**
+ * \brief Tabulates the phase function of a scatterer by running its GLSL code saved in the data directory.
+ *
+ * The values are sampled uniformly in scattering angle from 0 to π, as expected by
+ * SkyRadianceQuery::setPhaseFunctionTable. \p vao must contain a full-screen quad with 2D vertex coordinates in
+ * attribute 0, drawn as a triangle strip.
+ */
+std::vector<glm::vec4> tabulatePhaseFunction(QOpenGLFunctions_3_3_Core& gl, GLuint vao, QString const& pathToData,
+                                             QString const& scattererName, unsigned wlSetIndex);
+
+#endif
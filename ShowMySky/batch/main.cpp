@@ -0,0 +1,542 @@
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <iostream>
+
+#include <QDir>
+#include <QFile>
+#include <QGuiApplication>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QCommandLineParser>
+#include <QOpenGLFunctions_3_3_Core>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+#include <ShowMySky/AtmosphereRenderer.hpp>
+#include "config.h"
+#include "../../common/util.hpp"
+#include "../../common/OffscreenGL.hpp"
+#include "../../common/error-statistics.hpp"
+#include "../GLSLCosineQualityChecker.hpp"
+#include "../ViewDirShaders.hpp"
+#include "../GlareFilter.hpp"
+#include "../cpu/SkyRadianceQuery.hpp"
+#include "AsyncImageWriter.hpp"
+#include "BatchSettings.hpp"
+#include "FrameSpec.hpp"
+#include "PhaseFunctionTable.hpp"
+
+namespace
+{
+
+QString pathToData;
+QString batchFilePath;
+unsigned pipelineDepth=3;
+bool textureArrays=false;
+bool saveRadiance=false;
+bool cpuCheck=false;
+double cpuCheckTolerance=-1; // negative means no limit
+QString luminanceReferenceDir;
+double luminanceReferenceTolerance=-1; // negative means no limit
+unsigned resolutionReduction=1;
+bool upsamplingErrorCheck=false;
+bool glareErrorCheck=false;
+
+void handleCmdLine()
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render a batch of sky frames with ShowMySky and save their luminance as float images.\n\n"
+                                     "Each line of the batch file describes a frame as key=value pairs; keys not given are inherited "
+                                     "from the previous line. Available keys: output, size (WIDTHxHEIGHT), altitude (m), sun-azimuth, "
+                                     "sun-elevation, sun-angular-radius, moon-azimuth, moon-elevation (degrees), earth-moon-distance (km), "
+                                     "eclipse (true/false), light-pollution (cd/m^2), projection (equirectangular/perspective/fisheye), "
+                                     "yaw, pitch (degrees), zoom.\n\n"
+                                     "Luminance is saved to OUTPUT-luminance.f32: width and height as uint16, then XYZW float pixels, "
+                                     "bottom row first. Radiance is saved to OUTPUT-radiance.f32: number of wavelengths, width and height "
+                                     "as uint16, then the wavelengths in nm and the spectra of the pixels as floats, top row first.");
+    parser.addPositionalArgument("path to data", "Path to atmosphere textures");
+    parser.addPositionalArgument("batch file", "File with descriptions of the frames to render");
+    parser.addVersionOption();
+    parser.addHelpOption();
+    QCommandLineOption pipelineDepthOpt("pipeline-depth", "Number of frames whose readback may be in flight simultaneously (default: 3)", "N");
+    parser.addOption(pipelineDepthOpt);
+    QCommandLineOption textureArraysOpt("texture-arrays", "Keep per-wavelength-set textures in texture arrays");
+    parser.addOption(textureArraysOpt);
+    QCommandLineOption radianceOpt("radiance", "Also save spectral radiance (requires data computed with calcmysky --radiance)");
+    parser.addOption(radianceOpt);
+    QCommandLineOption cpuCheckOpt("cpu-check", "Compare the saved radiance with that computed by the CPU sky radiance query for the same directions "
+                                                "and report the relative error (implies --radiance; eclipsed frames are skipped)");
+    parser.addOption(cpuCheckOpt);
+    QCommandLineOption cpuCheckToleranceOpt("cpu-check-tolerance", "Exit with status 2 if the 99th percentile of the relative error found by "
+                                                                   "the CPU check exceeds X in any frame (implies --cpu-check)", "X");
+    parser.addOption(cpuCheckToleranceOpt);
+    QCommandLineOption luminanceReferenceOpt("luminance-reference", "Compare the saved luminance of each frame with that saved in DIR by an "
+                                                                    "earlier run of the same batch file and report the relative error", "DIR");
+    parser.addOption(luminanceReferenceOpt);
+    QCommandLineOption luminanceReferenceToleranceOpt("luminance-reference-tolerance", "Exit with status 2 if the 99th percentile of the "
+                                                      "relative error of luminance with respect to the reference exceeds X in any frame "
+                                                      "(requires --luminance-reference)", "X");
+    parser.addOption(luminanceReferenceToleranceOpt);
+    QCommandLineOption resolutionReductionOpt("reduced-resolution", "Render the smooth parts of the sky at 1/N of the resolution and upsample them "
+                                                                    "(default: 1, i.e. full resolution; incompatible with --radiance)", "N");
+    parser.addOption(resolutionReductionOpt);
+    QCommandLineOption upsamplingErrorOpt("upsampling-error", "Also render each frame at full resolution and report the relative error of the "
+                                                              "luminance rendered at reduced resolution");
+    parser.addOption(upsamplingErrorOpt);
+    QCommandLineOption glareErrorOpt("glare-error", "Apply the exact and the fast glare filters to each frame and report the relative error "
+                                                    "of the fast one and the run times of both (the saved images don't include glare)");
+    parser.addOption(glareErrorOpt);
+    // Applied in selectOffscreenGLBackend() before the application is created
+    QCommandLineOption glBackendOpt(GL_BACKEND_OPTION_NAME, GL_BACKEND_OPTION_DESCRIPTION, "backend");
+    parser.addOption(glBackendOpt);
+
+    parser.process(*qApp);
+
+    const auto posArgs=parser.positionalArguments();
+    if(posArgs.size()>2)
+        throw BadCommandLine{QObject::tr("Too many arguments")};
+    if(posArgs.size()<2)
+        throw BadCommandLine{QObject::tr("Path to data and batch file must be specified")};
+    pathToData=posArgs[0];
+    batchFilePath=posArgs[1];
+
+    if(parser.isSet(pipelineDepthOpt))
+    {
+        bool ok=false;
+        pipelineDepth=parser.value(pipelineDepthOpt).toUInt(&ok);
+        if(!ok || pipelineDepth==0)
+            throw BadCommandLine{QObject::tr("Bad pipeline depth \"%1\"").arg(parser.value(pipelineDepthOpt))};
+    }
+    textureArrays=parser.isSet(textureArraysOpt);
+    cpuCheck=parser.isSet(cpuCheckOpt) || parser.isSet(cpuCheckToleranceOpt);
+    if(parser.isSet(cpuCheckToleranceOpt))
+    {
+        bool ok=false;
+        cpuCheckTolerance=parser.value(cpuCheckToleranceOpt).toDouble(&ok);
+        if(!ok || !(cpuCheckTolerance>=0))
+            throw BadCommandLine{QObject::tr("Bad CPU check tolerance \"%1\"").arg(parser.value(cpuCheckToleranceOpt))};
+    }
+    saveRadiance=parser.isSet(radianceOpt) || cpuCheck;
+    luminanceReferenceDir=parser.value(luminanceReferenceOpt);
+    if(parser.isSet(luminanceReferenceToleranceOpt))
+    {
+        if(luminanceReferenceDir.isEmpty())
+            throw BadCommandLine{QObject::tr("Luminance reference tolerance requires a luminance reference")};
+        bool ok=false;
+        luminanceReferenceTolerance=parser.value(luminanceReferenceToleranceOpt).toDouble(&ok);
+        if(!ok || !(luminanceReferenceTolerance>=0))
+            throw BadCommandLine{QObject::tr("Bad luminance reference tolerance \"%1\"").arg(parser.value(luminanceReferenceToleranceOpt))};
+    }
+    if(parser.isSet(resolutionReductionOpt))
+    {
+        bool ok=false;
+        resolutionReduction=parser.value(resolutionReductionOpt).toUInt(&ok);
+        if(!ok || resolutionReduction==0)
+            throw BadCommandLine{QObject::tr("Bad resolution reduction factor \"%1\"").arg(parser.value(resolutionReductionOpt))};
+    }
+    upsamplingErrorCheck=parser.isSet(upsamplingErrorOpt);
+    glareErrorCheck=parser.isSet(glareErrorOpt);
+    if(saveRadiance && resolutionReduction>1)
+        throw BadCommandLine{QObject::tr("Radiance can't be saved when rendering at reduced resolution")};
+    if(upsamplingErrorCheck && resolutionReduction==1)
+        throw BadCommandLine{QObject::tr("Upsampling error can only be checked when rendering at reduced resolution")};
+
+    if(pathToData.endsWith('/')
+#ifdef Q_OS_WIN
+       || pathToData.endsWith('\\')
+#endif
+      )
+    {
+        pathToData.chop(1);
+#ifdef Q_OS_WIN
+        pathToData.replace('\\','/');
+#endif
+    }
+}
+
+void writeRadiance(QString const& path, ShowMySky::AtmosphereRenderer::SpectralRadianceBlock const& block,
+                   const int width, const int height)
+{
+    QFile out(path);
+    if(!out.open(QFile::WriteOnly))
+        throw DataLoadError{QObject::tr("Failed to open \"%1\" for writing: %2").arg(path).arg(out.errorString())};
+    for(const uint16_t s : {int(block.wavelengths.size()), width, height})
+        out.write(reinterpret_cast<const char*>(&s), sizeof s);
+    out.write(reinterpret_cast<const char*>(block.wavelengths.data()), block.wavelengths.size()*sizeof block.wavelengths[0]);
+    out.write(reinterpret_cast<const char*>(block.radiances.data()), block.radiances.size()*sizeof block.radiances[0]);
+    if(out.error()!=QFile::NoError)
+        throw DataLoadError{QObject::tr("Failed to write \"%1\": %2").arg(path).arg(out.errorString())};
+}
+
+// Returns the 99th percentile of the relative error, or 0 if no pixel was compared
+double checkAgainstCPU(SkyRadianceQuery& query, FrameSpec const& frame,
+                     ShowMySky::AtmosphereRenderer::SpectralRadianceBlock const& block)
+{
+    constexpr double degree=M_PI/180;
+    std::vector<glm::vec3> viewDirs;
+    viewDirs.reserve(block.pixelCount());
+    for(const auto& dir : block.directions)
+    {
+        const auto az=degree*dir.azimuth, el=degree*dir.elevation;
+        viewDirs.emplace_back(std::cos(el)*std::cos(az), std::cos(el)*std::sin(az), std::sin(el));
+    }
+
+    SkyRadianceQuery::Scene scene;
+    scene.altitude=frame.altitude;
+    scene.sunAzimuth=degree*frame.sunAzimuth;
+    scene.sunZenithAngle=degree*(90-frame.sunElevation);
+    scene.sunAngularRadius=degree*frame.sunAngularRadius;
+    scene.lightPollutionGroundLuminance=frame.lightPollutionLuminance;
+    const auto cpuRadiances=query.radiance(scene, viewDirs);
+
+    const auto wavelengthCount=block.wavelengths.size();
+    std::vector<double> errors;
+    for(unsigned p=0; p<block.pixelCount(); ++p)
+    {
+        double gpuNormSqr=0, diffNormSqr=0;
+        for(unsigned w=0; w<wavelengthCount; ++w)
+        {
+            const double gpu=block.spectrum(p)[w], cpu=cpuRadiances[p*wavelengthCount+w];
+            gpuNormSqr += sqr(gpu);
+            diffNormSqr += sqr(cpu-gpu);
+        }
+        // Zero radiance marks pixels discarded by the renderer, e.g. those outside of the fisheye circle
+        if(gpuNormSqr==0) continue;
+        errors.push_back(std::sqrt(diffNormSqr/gpuNormSqr));
+    }
+    if(errors.empty()) return 0;
+
+    const auto stats=computeErrorStatistics(errors);
+    std::cerr << "\n" << frame.output << ": relative difference of CPU and GPU radiance: " << stats
+              << " (" << stats.count << " pixels)\n";
+    return stats.percentile99;
+}
+
+std::vector<glm::vec4> readLuminance(QOpenGLFunctions_3_3_Core& gl, const GLuint texture, const int width, const int height)
+{
+    std::vector<glm::vec4> pixels(size_t(width)*height);
+    GLint origTex=0;
+    gl.glGetIntegerv(GL_TEXTURE_BINDING_2D, &origTex);
+    gl.glBindTexture(GL_TEXTURE_2D, texture);
+    gl.glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, pixels.data());
+    gl.glBindTexture(GL_TEXTURE_2D, origTex);
+    return pixels;
+}
+
+// Reads luminance saved by AsyncImageWriter
+std::vector<glm::vec4> readLuminanceFile(QString const& path, const int width, const int height)
+{
+    QFile in(path);
+    if(!in.open(QFile::ReadOnly))
+        throw DataLoadError{QObject::tr("Failed to open \"%1\": %2").arg(path).arg(in.errorString())};
+    uint16_t sizes[2];
+    if(in.read(reinterpret_cast<char*>(sizes), sizeof sizes) != sizeof sizes)
+        throw DataLoadError{QObject::tr("Failed to read header from \"%1\": %2").arg(path).arg(in.errorString())};
+    if(sizes[0]!=width || sizes[1]!=height)
+    {
+        throw DataLoadError{QObject::tr("Size of image in \"%1\" is %2×%3, but the frame is %4×%5")
+                            .arg(path).arg(sizes[0]).arg(sizes[1]).arg(width).arg(height)};
+    }
+    std::vector<glm::vec4> pixels(size_t(width)*height);
+    const qint64 sizeToRead=pixels.size()*sizeof pixels[0];
+    if(in.read(reinterpret_cast<char*>(pixels.data()), sizeToRead) != sizeToRead)
+        throw DataLoadError{QObject::tr("Failed to read image data from \"%1\": %2").arg(path).arg(in.errorString())};
+    return pixels;
+}
+
+// Prints statistics of relative error of photopic luminance of \p tested with respect to \p reference.
+// Returns the 99th percentile of the error, or 0 if no pixel was compared.
+double reportLuminanceErrors(FrameSpec const& frame, std::string const& description,
+                           std::vector<glm::vec4> const& reference, std::vector<glm::vec4> const& tested)
+{
+    std::vector<double> errors;
+    errors.reserve(reference.size());
+    for(size_t i=0; i<reference.size(); ++i)
+    {
+        // Zero luminance marks pixels discarded by the renderer, e.g. those outside of the fisheye circle
+        const double ref=reference[i].y;
+        if(ref<=0) continue;
+        errors.push_back(std::abs(tested[i].y-ref)/ref);
+    }
+    if(errors.empty()) return 0;
+
+    const auto stats=computeErrorStatistics(errors);
+    std::cerr << "\n" << frame.output << ": relative error of " << description << ": " << stats
+              << " (" << stats.count << " pixels)\n";
+    return stats.percentile99;
+}
+
+// Renders the current frame at full resolution and compares its photopic luminance with that of the frame
+// rendered at reduced resolution
+void checkUpsampling(QOpenGLFunctions_3_3_Core& gl, ShowMySky::AtmosphereRenderer& renderer,
+                     FrameSpec const& frame, const int width, const int height)
+{
+    renderer.setResolutionReduction(1);
+    renderer.draw(1, true);
+    const auto reference=readLuminance(gl, renderer.getLuminanceTexture(), width, height);
+    renderer.setResolutionReduction(resolutionReduction);
+    renderer.draw(1, true);
+    const auto upsampled=readLuminance(gl, renderer.getLuminanceTexture(), width, height);
+
+    reportLuminanceErrors(frame, "luminance upsampled from 1/"+std::to_string(resolutionReduction)+" resolution",
+                          reference, upsampled);
+}
+
+// Applies the exact and the fast glare filters to the rendered luminance, compares the results and reports their run times
+void checkGlare(QOpenGLFunctions_3_3_Core& gl, GlareFilter& glare, const GLuint luminanceTexture, const GLuint vao,
+                FrameSpec const& frame, const int width, const int height)
+{
+    const auto applyGlare=[&](const GlareFilter::Method method, double& seconds)
+    {
+        gl.glFinish();
+        const auto start=std::chrono::steady_clock::now();
+        const auto texture=glare.apply(luminanceTexture, method, vao);
+        gl.glFinish();
+        seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        return readLuminance(gl, texture, width, height);
+    };
+    double exactTime=0, fastTime=0;
+    const auto reference=applyGlare(GlareFilter::Method::LineConvolution, exactTime);
+    const auto approximation=applyGlare(GlareFilter::Method::MipPyramid, fastTime);
+
+    reportLuminanceErrors(frame, "mip pyramid glare", reference, approximation);
+    std::cerr << frame.output << ": glare filter time: exact " << exactTime << " s, mip pyramid " << fastTime << " s\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    [[maybe_unused]] UTF8Console utf8console;
+
+    try
+    {
+        selectOffscreenGLBackend(argc, argv);
+    }
+    catch(ShowMySky::Error const& ex)
+    {
+        std::cerr << ex.errorType() << ": " << ex.what() << "\n";
+        return 1;
+    }
+    QGuiApplication app(argc, argv);
+    app.setApplicationName("ShowMySky batch renderer");
+    app.setApplicationVersion(PROJECT_VERSION);
+
+    try
+    {
+        handleCmdLine();
+
+        const auto frames=parseBatchFile(batchFilePath);
+        if(frames.empty())
+        {
+            std::cerr << "Batch file contains no frames\n";
+            return 0;
+        }
+
+        [[maybe_unused]] const auto glSurfaceAndContext=createOffscreenGLContext();
+
+        QOpenGLFunctions_3_3_Core gl;
+        if(!gl.initializeOpenGLFunctions())
+            throw InitializationError{QObject::tr("Failed to initialize OpenGL 3.3 functions")};
+
+        GLuint vao=0, vbo=0;
+        gl.glGenVertexArrays(1, &vao);
+        gl.glBindVertexArray(vao);
+        gl.glGenBuffers(1, &vbo);
+        gl.glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        static constexpr GLfloat vertices[]=
+        {
+            -1, -1,
+             1, -1,
+            -1,  1,
+             1,  1,
+        };
+        gl.glBufferData(GL_ARRAY_BUFFER, sizeof vertices, vertices, GL_STATIC_DRAW);
+        constexpr GLuint attribIndex=0;
+        constexpr int coordsPerVertex=2;
+        gl.glVertexAttribPointer(attribIndex, coordsPerVertex, GL_FLOAT, false, 0, 0);
+        gl.glEnableVertexAttribArray(attribIndex);
+        gl.glBindVertexArray(0);
+
+        BatchSettings settings;
+        settings.setTextureArraysEnabled(textureArrays);
+        settings.setFrame(frames.front());
+
+        const std::function drawSurface=[&gl,&settings,vao](QOpenGLShaderProgram& program)
+        {
+            constexpr float degree=M_PI/180;
+            const auto& frame=settings.frame();
+            program.setUniformValue("zoomFactor", float(frame.zoomFactor));
+            const auto camYaw=glm::rotate(float(degree*frame.cameraYaw), glm::vec3(0,0,1));
+            const auto camPitch=glm::rotate(float(degree*frame.cameraPitch), glm::vec3(0,-1,0));
+            program.setUniformValue("cameraRotation", toQMatrix(camYaw*camPitch));
+            program.setUniformValue("viewportAspectRatio", float(frame.width)/float(frame.height));
+            program.setUniformValue("projection", static_cast<int>(frame.projection));
+            gl.glBindVertexArray(vao);
+            gl.glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            gl.glBindVertexArray(0);
+        };
+
+        const std::unique_ptr<ShowMySky::AtmosphereRenderer>
+            renderer(ShowMySky_AtmosphereRenderer_create(&gl, &pathToData, &settings, &drawSurface));
+        renderer->setResolutionReduction(resolutionReduction);
+
+        const bool cosineIsOK = GLSLCosineQualityChecker(gl).isGood();
+        QByteArray fragShaderSrc=viewDirFragShaderSrc;
+        fragShaderSrc.replace("COSINE_IS_BROKEN", cosineIsOK ? "0" : "1");
+
+        // The renderer takes the initial size of its render target from the viewport
+        int currentWidth=frames.front().width, currentHeight=frames.front().height;
+        gl.glViewport(0, 0, currentWidth, currentHeight);
+
+        std::cerr << "Loading data...\n";
+        const auto loadStart=std::chrono::steady_clock::now();
+        renderer->initDataLoading(viewDirVertShaderSrc, fragShaderSrc);
+        for(auto status=renderer->stepDataLoading(); status.stepsDone<status.stepsToDo; status=renderer->stepDataLoading());
+        if(!renderer->isReadyToRender())
+            throw DataLoadError{QObject::tr("Failed to load atmosphere model data")};
+        const auto loadEnd=std::chrono::steady_clock::now();
+        std::cerr << "Data loaded in " << std::chrono::duration<double>(loadEnd-loadStart).count() << " s\n";
+
+        if(saveRadiance && !renderer->canGrabRadiance())
+            throw DataLoadError{QObject::tr("Radiance output requested, but the model data only contain luminance")};
+
+        std::unique_ptr<SkyRadianceQuery> cpuQuery;
+        if(cpuCheck)
+        {
+            cpuQuery=std::make_unique<SkyRadianceQuery>(pathToData);
+            const auto& params=cpuQuery->atmosphereParameters();
+            for(const auto& scatterer : params.scatterers)
+                for(unsigned wlSetIndex=0; wlSetIndex<params.allWavelengths.size(); ++wlSetIndex)
+                    cpuQuery->setPhaseFunctionTable(scatterer.name, wlSetIndex,
+                                                    tabulatePhaseFunction(gl, vao, pathToData, scatterer.name, wlSetIndex));
+        }
+
+        std::unique_ptr<GlareFilter> glare;
+        if(glareErrorCheck)
+        {
+            glare=std::make_unique<GlareFilter>(gl);
+            glare->resize(currentWidth, currentHeight);
+        }
+
+        AsyncImageWriter writer(gl, pipelineDepth);
+        struct PendingRadiance
+        {
+            std::unique_ptr<ShowMySky::AtmosphereRenderer::RadianceReadback> readback;
+            QString path;
+            int width, height;
+            FrameSpec frame;
+        };
+        std::deque<PendingRadiance> pendingRadiance;
+        std::vector<QString> framesOutOfTolerance;
+        const auto writeOldestRadiance=[&pendingRadiance,&cpuQuery,&framesOutOfTolerance]
+        {
+            auto& pending=pendingRadiance.front();
+            writeRadiance(pending.path, pending.readback->get(), pending.width, pending.height);
+            if(cpuQuery && !pending.frame.eclipse)
+            {
+                const auto error=checkAgainstCPU(*cpuQuery, pending.frame, pending.readback->get());
+                if(cpuCheckTolerance>=0 && !(error<=cpuCheckTolerance))
+                    framesOutOfTolerance.push_back(pending.frame.output);
+            }
+            pendingRadiance.pop_front();
+        };
+        for(unsigned frameIndex=0; frameIndex<frames.size(); ++frameIndex)
+        {
+            const auto& frame=frames[frameIndex];
+            settings.setFrame(frame);
+            if(frame.width!=currentWidth || frame.height!=currentHeight)
+            {
+                currentWidth=frame.width;
+                currentHeight=frame.height;
+                // Wait for the pending readbacks, they refer to the textures that are to be reallocated
+                writer.flush();
+                gl.glViewport(0, 0, currentWidth, currentHeight);
+                renderer->resizeEvent(currentWidth, currentHeight);
+                if(glare)
+                    glare->resize(currentWidth, currentHeight);
+            }
+
+            // Altitude changes and enabling of eclipse mode may require loading textures or shaders
+            if(renderer->initPreparationToDraw() > 0)
+                for(auto status=renderer->stepPreparationToDraw(); status.stepsDone<status.stepsToDo; status=renderer->stepPreparationToDraw());
+
+            if(upsamplingErrorCheck)
+                checkUpsampling(gl, *renderer, frame, currentWidth, currentHeight);
+            else
+                renderer->draw(1, true);
+            if(glare)
+                checkGlare(gl, *glare, renderer->getLuminanceTexture(), vao, frame, currentWidth, currentHeight);
+            writer.enqueue(renderer->getLuminanceTexture(), currentWidth, currentHeight, frame.output+"-luminance.f32");
+            if(saveRadiance)
+            {
+                if(pendingRadiance.size() >= pipelineDepth)
+                    writeOldestRadiance();
+                pendingRadiance.push_back({renderer->startRadianceReadback(), frame.output+"-radiance.f32",
+                                           currentWidth, currentHeight, frame});
+            }
+            std::cerr << "\rFrame " << frameIndex+1 << " of " << frames.size() << std::flush;
+        }
+        writer.flush();
+        while(!pendingRadiance.empty())
+            writeOldestRadiance();
+        std::vector<QString> framesOutOfLuminanceTolerance;
+        if(!luminanceReferenceDir.isEmpty())
+        {
+            for(const auto& frame : frames)
+            {
+                const auto path=frame.output+"-luminance.f32";
+                const auto reference=readLuminanceFile(QDir(luminanceReferenceDir).filePath(path), frame.width, frame.height);
+                const auto tested=readLuminanceFile(path, frame.width, frame.height);
+                const auto error=reportLuminanceErrors(frame, "luminance with respect to the reference", reference, tested);
+                if(luminanceReferenceTolerance>=0 && !(error<=luminanceReferenceTolerance))
+                    framesOutOfLuminanceTolerance.push_back(frame.output);
+            }
+        }
+        const auto renderEnd=std::chrono::steady_clock::now();
+        const auto renderTime=std::chrono::duration<double>(renderEnd-loadEnd).count();
+        std::cerr << "\n" << frames.size() << " frames rendered in " << renderTime << " s ("
+                  << frames.size()/renderTime << " frames/s)\n";
+
+        glare.reset();
+        gl.glDeleteBuffers(1, &vbo);
+        gl.glDeleteVertexArrays(1, &vao);
+        const auto reportFramesOutOfTolerance=[](std::string const& what, const double tolerance,
+                                                 std::vector<QString> const& outputs)
+        {
+            if(outputs.empty()) return;
+            std::cerr << what << " exceeds " << tolerance << " in " << outputs.size() << " frames:";
+            for(const auto& output : outputs)
+                std::cerr << " " << output;
+            std::cerr << "\n";
+        };
+        reportFramesOutOfTolerance("Relative difference of CPU and GPU radiance", cpuCheckTolerance, framesOutOfTolerance);
+        reportFramesOutOfTolerance("Relative error of luminance with respect to the reference", luminanceReferenceTolerance,
+                                   framesOutOfLuminanceTolerance);
+        if(!framesOutOfTolerance.empty() || !framesOutOfLuminanceTolerance.empty())
+            return 2;
+        return 0;
+    }
+    catch(ShowMySky::Error const& ex)
+    {
+        std::cerr << ex.errorType() << ": " << ex.what() << "\n";
+        return 1;
+    }
+    catch(MustQuit& ex)
+    {
+        return ex.exitCode;
+    }
+    catch(std::exception const& ex)
+    {
+#if defined Q_OS_WIN && !defined __GNUC__
+        // MSVCRT-generated exceptions can contain localized messages
+        // in OEM codepage, so restore CP before printing them.
+        utf8console.restore();
+#endif
+        std::cerr << "Fatal error: " << ex.what() << '\n';
+        return 111;
+    }
+}
@@ -0,0 +1,116 @@
+#include "CPUTexture.hpp"
+
+#include <cstring>
+#include <cstdint>
+#include <QFile>
+#include "../../common/util.hpp"
+
+namespace
+{
+
+template<size_t N>
+void readHeader(QFile& file, QString const& path, uint16_t (&sizes)[N])
+{
+    const qint64 sizeToRead=sizeof sizes;
+    if(file.read(reinterpret_cast<char*>(sizes), sizeToRead) != sizeToRead)
+    {
+        throw DataLoadError{QObject::tr("Failed to read header from file \"%1\": %2")
+                            .arg(path).arg(file.errorString())};
+    }
+}
+
+void readData(QFile& file, QString const& path, char* data, const qint64 sizeToRead)
+{
+    const auto actuallyRead=file.read(data, sizeToRead);
+    if(actuallyRead != sizeToRead)
+    {
+        const auto error = actuallyRead==-1 ? QObject::tr("Failed to read texture data from file \"%1\": %2").arg(path).arg(file.errorString())
+                                            : QObject::tr("Failed to read texture data from file \"%1\": requested %2 bytes, read %3").arg(path).arg(sizeToRead).arg(actuallyRead);
+        throw DataLoadError{error};
+    }
+}
+
+// Reads the two altitude slices surrounding altitudeCoord and blends them with the given function
+template<typename Texel, typename StoredTexel, typename Blend>
+CPUTexture3D<Texel> load4DSlice(QString const& path, const float altitudeCoord, Blend blend)
+{
+    QFile file(path);
+    if(!file.open(QFile::ReadOnly))
+        throw DataLoadError{QObject::tr("Failed to open file \"%1\": %2").arg(path).arg(file.errorString())};
+
+    uint16_t sizes[4];
+    readHeader(file, path, sizes);
+
+    constexpr size_t pixelSize = sizeof(StoredTexel);
+    const qint64 expectedFileSize = file.pos() + pixelSize*uint64_t(sizes[0])*sizes[1]*sizes[2]*sizes[3];
+    if(expectedFileSize != file.size())
+    {
+        throw DataLoadError{QObject::tr("Size of file \"%1\" (%2 bytes) doesn't match image dimensions %3×%4×%5×%6 from file header.\nThe expected size is %7 bytes.")
+                            .arg(path).arg(file.size()).arg(sizes[0]).arg(sizes[1]).arg(sizes[2]).arg(sizes[3]).arg(expectedFileSize)};
+    }
+
+    // XXX: keep in sync with AtmosphereRenderer::loadTexture4D(), so that both pick the same slices
+    const auto numAltIntervals = sizes[3]-1;
+    const auto altTexIndex = altitudeCoord==1 ? numAltIntervals-1 : altitudeCoord*numAltIntervals;
+    const auto floorAltIndex = std::floor(altTexIndex);
+    const auto fractAltIndex = altTexIndex-floorAltIndex;
+
+    const auto altSliceSize = size_t(sizes[0])*sizes[1]*sizes[2];
+    const qint64 absoluteOffset = file.pos() + pixelSize*altSliceSize*uint64_t(floorAltIndex);
+    if(!file.seek(absoluteOffset))
+    {
+        throw DataLoadError{QObject::tr("Failed to seek to offset %1 in file \"%2\": %3")
+                            .arg(absoluteOffset).arg(path).arg(file.errorString())};
+    }
+    std::vector<StoredTexel> data(2*altSliceSize);
+    readData(file, path, reinterpret_cast<char*>(data.data()), pixelSize*data.size());
+
+    std::vector<Texel> texels(altSliceSize);
+    for(size_t n = 0; n < altSliceSize; ++n)
+        texels[n] = blend(data[n], data[n+altSliceSize], fractAltIndex);
+    return {sizes[0], sizes[1], sizes[2], std::move(texels)};
+}
+
+}
+
+CPUTexture2D<glm::vec4> loadCPUTexture2D(QString const& path)
+{
+    QFile file(path);
+    if(!file.open(QFile::ReadOnly))
+        throw DataLoadError{QObject::tr("Failed to open file \"%1\": %2").arg(path).arg(file.errorString())};
+
+    uint16_t sizes[2];
+    readHeader(file, path, sizes);
+
+    const auto texelCount = uint64_t(sizes[0])*sizes[1];
+    if(const qint64 expectedFileSize = texelCount*sizeof(glm::vec4)+file.pos();
+       expectedFileSize != file.size())
+    {
+        throw DataLoadError{QObject::tr("Size of file \"%1\" (%2 bytes) doesn't match image dimensions %3×%4 from file header.\nThe expected size is %5 bytes.")
+                            .arg(path).arg(file.size()).arg(sizes[0]).arg(sizes[1]).arg(expectedFileSize)};
+    }
+
+    std::vector<glm::vec4> texels(texelCount);
+    static_assert(sizeof texels[0] == 4*sizeof(float));
+    readData(file, path, reinterpret_cast<char*>(texels.data()), texelCount*sizeof texels[0]);
+    return {sizes[0], sizes[1], std::move(texels)};
+}
+
+CPUTexture3D<glm::vec4> loadCPUTexture4DSlice(QString const& path, const float altitudeCoord)
+{
+    return load4DSlice<glm::vec4, glm::vec4>(path, altitudeCoord,
+                                             [](glm::vec4 const& lower, glm::vec4 const& upper, const float alpha)
+                                             { return lower + alpha*(upper-lower); });
+}
+
+CPUTexture3D<float> loadCPUGuides4DSlice(QString const& path, const float altitudeCoord)
+{
+    return load4DSlice<float, int16_t>(path, altitudeCoord,
+                                       [](const int16_t lower, const int16_t upper, const float alpha)
+                                       {
+                                           // The renderer truncates the blended value to an integer before uploading it
+                                           const int16_t value = lower + alpha*(upper-lower);
+                                           // Conversion of signed normalized integers as specified by OpenGL
+                                           return std::max(value/32767.f, -1.f);
+                                       });
+}
@@ -0,0 +1,101 @@
+#ifndef INCLUDE_ONCE_5E0B6A41_8C27_4F3D_9B1E_2D7A6C94F0B3
+#define INCLUDE_ONCE_5E0B6A41_8C27_4F3D_9B1E_2D7A6C94F0B3
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <QString>
+
+/*
+ * Textures kept in main memory and sampled the way OpenGL samples textures with GL_LINEAR filtering and
+ * GL_CLAMP_TO_EDGE wrapping, which is what AtmosphereRenderer sets up for all the textures it renders from.
+ */
+
+namespace cpu_texture_detail
+{
+// Finds the two texels a linear filter blends along one dimension, and the weight of the second one
+inline void linearTexelPair(float texCoord, const int size, int& i0, int& i1, float& alpha)
+{
+    // Clamping first keeps the float-to-int conversion defined for any input, including NaN
+    const float x = std::max(-1.f, std::min(texCoord*size-0.5f, float(size)));
+    const float xFloor = std::floor(x);
+    alpha = x-xFloor;
+    i0 = std::clamp(int(xFloor),   0, size-1);
+    i1 = std::clamp(int(xFloor)+1, 0, size-1);
+}
+}
+
+template<typename Texel>
+class CPUTexture2D
+{
+    int width_=0, height_=0;
+    std::vector<Texel> texels_;
+public:
+    CPUTexture2D()=default;
+    CPUTexture2D(const int width, const int height, std::vector<Texel>&& texels)
+        : width_(width), height_(height), texels_(std::move(texels))
+    {}
+    bool empty() const { return texels_.empty(); }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    Texel const& texel(const int x, const int y) const { return texels_[size_t(y)*width_+x]; }
+
+    Texel sample(glm::vec2 const& texCoords) const
+    {
+        using namespace cpu_texture_detail;
+        int x0, x1, y0, y1;
+        float ax, ay;
+        linearTexelPair(texCoords[0], width_,  x0, x1, ax);
+        linearTexelPair(texCoords[1], height_, y0, y1, ay);
+        const Texel lower = texel(x0,y0) + (texel(x1,y0)-texel(x0,y0))*ax;
+        const Texel upper = texel(x0,y1) + (texel(x1,y1)-texel(x0,y1))*ax;
+        return lower + (upper-lower)*ay;
+    }
+};
+
+template<typename Texel>
+class CPUTexture3D
+{
+    int width_=0, height_=0, depth_=0;
+    std::vector<Texel> texels_;
+public:
+    CPUTexture3D()=default;
+    CPUTexture3D(const int width, const int height, const int depth, std::vector<Texel>&& texels)
+        : width_(width), height_(height), depth_(depth), texels_(std::move(texels))
+    {}
+    bool empty() const { return texels_.empty(); }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int depth() const { return depth_; }
+    Texel const& texel(const int x, const int y, const int z) const
+    { return texels_[(size_t(z)*height_+y)*width_+x]; }
+
+    Texel sample(glm::vec3 const& texCoords) const
+    {
+        using namespace cpu_texture_detail;
+        int x0, x1, y0, y1, z0, z1;
+        float ax, ay, az;
+        linearTexelPair(texCoords[0], width_,  x0, x1, ax);
+        linearTexelPair(texCoords[1], height_, y0, y1, ay);
+        linearTexelPair(texCoords[2], depth_,  z0, z1, az);
+        const auto bilinear=[&](const int z)
+        {
+            const Texel lower = texel(x0,y0,z) + (texel(x1,y0,z)-texel(x0,y0,z))*ax;
+            const Texel upper = texel(x0,y1,z) + (texel(x1,y1,z)-texel(x0,y1,z))*ax;
+            return lower + (upper-lower)*ay;
+        };
+        const Texel front=bilinear(z0), back=bilinear(z1);
+        return front + (back-front)*az;
+    }
+};
+
+// These loaders read the same files and produce the same texel values as AtmosphereRenderer::loadTexture2D() and
+// AtmosphereRenderer::loadTexture4D(), throwing DataLoadError on failure.
+CPUTexture2D<glm::vec4> loadCPUTexture2D(QString const& path);
+//! Loads the 3D slice of a 4D texture at \p altitudeCoord, interpolating between the nearest stored slices
+CPUTexture3D<glm::vec4> loadCPUTexture4DSlice(QString const& path, float altitudeCoord);
+//! Like #loadCPUTexture4DSlice, but for interpolation guides, converted to floats as for a \c GL_R16_SNORM texture
+CPUTexture3D<float> loadCPUGuides4DSlice(QString const& path, float altitudeCoord);
+
+#endif
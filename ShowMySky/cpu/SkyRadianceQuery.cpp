@@ -0,0 +1,652 @@
+#include "SkyRadianceQuery.hpp"
+
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <QFile>
+#include <QDebug>
+#include "../../common/util.hpp"
+
+/*
+ * The functions below mirror their namesakes in the GLSL sources (texture-coordinates.frag, texture-sampling-functions.frag,
+ * common-functions.frag and render.frag), and are kept as close to them as possible, including the use of single
+ * precision, so that the results match those of the GPU. When changing either, keep them in sync.
+ */
+
+namespace
+{
+
+constexpr float PI=M_PI;
+constexpr float epsilon = 1e-37; // Prevents passing zero to log
+
+float safeSqrt(const float x) { return std::sqrt(std::max(x,0.f)); }
+
+float unitRangeToTexCoord(const float u, const float texSize)
+{
+    return (0.5f+(texSize-1)*u)/texSize;
+}
+float texCoordToIndex(const float texCoord, const float texSize)
+{
+    return texSize*texCoord-0.5f;
+}
+float indexToTexCoord(const float index, const float texSize)
+{
+    return (index+0.5f)/texSize;
+}
+
+}
+
+// Structure-of-arrays storage of the view geometry of a group of directions. Computation of the geometry uses selects
+// instead of branches on the data, so that the compiler can vectorize it.
+struct SkyRadianceQuery::DirectionBlock
+{
+    static constexpr unsigned capacity=64;
+    unsigned size=0;
+    glm::vec3 viewDir[capacity];
+    glm::vec3 zenith[capacity];
+    float altitude[capacity];
+    float cosViewZenithAngle[capacity];
+    float cosSunZenithAngle[capacity];
+    float dotViewSun[capacity];
+    bool viewRayIntersectsGround[capacity];
+    bool lookingIntoAtmosphere[capacity];
+    // Zero view direction marks pixels that the renderer discards
+    bool valid[capacity];
+};
+
+SkyRadianceQuery::SkyRadianceQuery(QString const& pathToData)
+    : pathToData_(pathToData)
+{
+    const auto atmoDescrFileName=pathToData+"/params.atmo";
+    // Like the renderer, we skip the spectra, because the files they may refer to aren't copied into the data
+    // directory. But we need the spectra that the renderer gets from the precomputed shaders, so try to get them
+    // from the full description too.
+    try
+    {
+        AtmosphereParameters fullParams;
+        fullParams.parse(atmoDescrFileName);
+        groundAlbedo_=fullParams.groundAlbedo;
+        lightPollutionRelativeRadiance_=fullParams.lightPollutionRelativeRadiance;
+    }
+    catch(ShowMySky::Error const& ex)
+    {
+        qWarning().noquote() << "Ground albedo and light pollution spectra are unavailable, zero-order scattering "
+                                "will require them to be set explicitly. The error was:" << ex.what();
+    }
+    params_.parse(atmoDescrFileName, AtmosphereParameters::ForceNoEDSTextures{false}, AtmosphereParameters::SkipSpectra{true});
+
+    if(!params_.allTexturesAreRadiance)
+    {
+        throw DataLoadError{QObject::tr("Data in \"%1\" contain luminance, while radiance is required for CPU queries. "
+                                        "Recompute them with the --radiance option of calcmysky.").arg(pathToData)};
+    }
+
+    const auto wlSetCount=params_.allWavelengths.size();
+    wlSetTextures_.resize(wlSetCount);
+    for(unsigned wlSetIndex=0; wlSetIndex<wlSetCount; ++wlSetIndex)
+    {
+        auto& textures=wlSetTextures_[wlSetIndex];
+        textures.transmittance=loadCPUTexture2D(QString("%1/transmittance-wlset%2.f32").arg(pathToData_).arg(wlSetIndex));
+        textures.irradiance=loadCPUTexture2D(QString("%1/irradiance-wlset%2.f32").arg(pathToData_).arg(wlSetIndex));
+        if(const auto path=QString("%1/light-pollution-wlset%2.f32").arg(pathToData_).arg(wlSetIndex); QFile::exists(path))
+            textures.lightPollution=loadCPUTexture2D(path);
+    }
+    for(const auto& scatterer : params_.scatterers)
+        phaseFunctions_[scatterer.name].resize(wlSetCount);
+}
+
+std::vector<float> SkyRadianceQuery::wavelengths() const
+{
+    std::vector<float> wavelengths;
+    for(const auto& wlSet : params_.allWavelengths)
+        for(int i=0; i<wlSet.length(); ++i)
+            wavelengths.push_back(wlSet[i]);
+    return wavelengths;
+}
+
+void SkyRadianceQuery::setPhaseFunction(QString const& scattererName, const unsigned wlSetIndex, PhaseFunction const& function)
+{
+    const auto it=phaseFunctions_.find(scattererName);
+    if(it==phaseFunctions_.end())
+        throw DataLoadError{QObject::tr("Atmosphere description has no scatterer named \"%1\"").arg(scattererName)};
+    if(wlSetIndex>=it->second.size())
+        throw DataLoadError{QObject::tr("Wavelength set index %1 is out of range").arg(wlSetIndex)};
+    it->second[wlSetIndex]=function;
+}
+
+void SkyRadianceQuery::setPhaseFunctionTable(QString const& scattererName, const unsigned wlSetIndex,
+                                             std::vector<glm::vec4> const& values)
+{
+    if(values.size()<2)
+        throw DataLoadError{QObject::tr("Phase function table must contain at least two values")};
+    setPhaseFunction(scattererName, wlSetIndex, [values](const float dotViewSun)
+                     {
+                         const auto maxIndex=values.size()-1;
+                         const float pos = std::acos(clampCosine(dotViewSun))/PI*maxIndex;
+                         const auto i=std::min(size_t(pos), maxIndex-1);
+                         return values[i] + (values[i+1]-values[i])*(pos-i);
+                     });
+}
+
+void SkyRadianceQuery::setGroundSpectra(std::vector<glm::vec4> const& groundAlbedo,
+                                        std::vector<glm::vec4> const& lightPollutionRelativeRadiance)
+{
+    if(groundAlbedo.size()!=params_.allWavelengths.size() ||
+       lightPollutionRelativeRadiance.size()!=params_.allWavelengths.size())
+    {
+        throw DataLoadError{QObject::tr("Ground spectra must have one item per wavelength set")};
+    }
+    groundAlbedo_=groundAlbedo;
+    lightPollutionRelativeRadiance_=lightPollutionRelativeRadiance;
+}
+
+void SkyRadianceQuery::loadScatteringTextures(const float altitudeCoord)
+{
+    loadedAltitudeCoord_=NAN;
+    for(unsigned wlSetIndex=0; wlSetIndex<wlSetTextures_.size(); ++wlSetIndex)
+    {
+        auto& texture=wlSetTextures_[wlSetIndex].multipleScattering;
+        if(const auto path=QString("%1/multiple-scattering-wlset%2.f32").arg(pathToData_).arg(wlSetIndex); QFile::exists(path))
+            texture=loadCPUTexture4DSlice(path, altitudeCoord);
+        else
+            texture={};
+    }
+
+    singleScatteringTextures_.clear();
+    for(const auto& scatterer : params_.scatterers)
+    {
+        auto& texturesPerWLSet=singleScatteringTextures_[scatterer.name];
+        for(unsigned wlSetIndex=0; wlSetIndex<wlSetTextures_.size(); ++wlSetIndex)
+        {
+            const auto pathBase=QString("%1/single-scattering/%2/%3").arg(pathToData_).arg(wlSetIndex).arg(scatterer.name);
+            auto& textures=texturesPerWLSet.emplace_back();
+            textures.scattering=loadCPUTexture4DSlice(pathBase+".f32", altitudeCoord);
+            // As in the renderer, the guides are only used when both of their textures are available
+            const auto guides01Path=pathBase+"-dims01.guides2d", guides02Path=pathBase+"-dims02.guides2d";
+            if(QFile::exists(guides01Path) && QFile::exists(guides02Path))
+            {
+                textures.guides01=loadCPUGuides4DSlice(guides01Path, altitudeCoord);
+                textures.guides02=loadCPUGuides4DSlice(guides02Path, altitudeCoord);
+            }
+        }
+    }
+    loadedAltitudeCoord_=altitudeCoord;
+}
+
+float SkyRadianceQuery::cosSZAToUnitRangeTexCoord(const float cosSunZenithAngle) const
+{
+    const float earthRadius=params_.earthRadius, atmosphereHeight=params_.atmosphereHeight;
+    const float distFromGroundToTopAtmoBorder=distanceToAtmosphereBorder(cosSunZenithAngle, 0.f);
+    const float distMin=atmosphereHeight;
+    const float distMax=params_.lengthOfHorizRayFromGroundToBorderOfAtmo;
+    const float a=(distFromGroundToTopAtmoBorder-distMin)/(distMax-distMin);
+    const float A=2*earthRadius/(distMax-distMin);
+    return std::max(0.f,1-a/A)/(a+1);
+}
+
+glm::vec2 SkyRadianceQuery::transmittanceTexVarsToTexCoord(const float cosVZA, float altitude) const
+{
+    if(altitude<0)
+        altitude=0;
+
+    const float earthRadius=params_.earthRadius, atmosphereHeight=params_.atmosphereHeight;
+    const float lengthOfHorizRay=params_.lengthOfHorizRayFromGroundToBorderOfAtmo;
+    const float distToHorizon=std::sqrt(sqr(altitude)+2*altitude*earthRadius);
+    const float t=unitRangeToTexCoord(distToHorizon / lengthOfHorizRay, params_.transmittanceTexH);
+    const float dMin=atmosphereHeight-altitude; // distance to zenith
+    const float dMax=lengthOfHorizRay+distToHorizon;
+    const float d=distanceToAtmosphereBorder(cosVZA,altitude);
+    const float s=unitRangeToTexCoord((d-dMin)/(dMax-dMin), params_.transmittanceTexW);
+    return {s,t};
+}
+
+glm::vec2 SkyRadianceQuery::irradianceTexVarsToTexCoord(const float cosSunZenithAngle, const float altitude) const
+{
+    const float s=unitRangeToTexCoord((cosSunZenithAngle+1)/2, params_.irradianceTexW);
+    const float t=unitRangeToTexCoord(altitude/params_.atmosphereHeight, params_.irradianceTexH);
+    return {s,t};
+}
+
+// A combination of scatteringTexVarsTo4DCoords() and scattering4DCoordsToTex3DCoords()
+glm::vec3 SkyRadianceQuery::scatteringTexVarsToTex3DCoords(const float cosSunZenithAngle, const float cosViewZenithAngle,
+                                                           const float dotViewSun, const float altitude,
+                                                           const bool viewRayIntersectsGround) const
+{
+    const float earthRadius=params_.earthRadius, atmosphereHeight=params_.atmosphereHeight;
+    const float lengthOfHorizRay=params_.lengthOfHorizRayFromGroundToBorderOfAtmo;
+    const glm::vec4 texSize(params_.scatteringTextureSize);
+    const float r=earthRadius+altitude;
+    const float distToHorizon=std::sqrt(sqr(altitude)+2*altitude*earthRadius);
+
+    float cosVZACoord;
+    const float rCvza=r*cosViewZenithAngle;
+    const float discriminant=sqr(rCvza)-sqr(r)+sqr(earthRadius);
+    if(viewRayIntersectsGround)
+    {
+        const float distToGround = -rCvza-safeSqrt(discriminant);
+        const float distMin = altitude;
+        const float distMax = distToHorizon;
+        cosVZACoord = distMax==distMin ? 0.f : (distToGround-distMin)/(distMax-distMin);
+    }
+    else
+    {
+        const float distToTopAtmoBorder = -rCvza+safeSqrt(discriminant+sqr(lengthOfHorizRay));
+        const float distMin = atmosphereHeight-altitude;
+        const float distMax = distToHorizon+lengthOfHorizRay;
+        cosVZACoord = distMax==distMin ? 0.f : (distToTopAtmoBorder-distMin)/(distMax-distMin);
+    }
+    const float dotVSCoord=(dotViewSun+1)/2;
+    const float cosSZACoord=cosSZAToUnitRangeTexCoord(cosSunZenithAngle);
+
+    const float cosVZAtc = viewRayIntersectsGround ?
+                            0.5f-0.5f*unitRangeToTexCoord(cosVZACoord, texSize[0]/2) :
+                            0.5f+0.5f*unitRangeToTexCoord(cosVZACoord, texSize[0]/2);
+    const float dotVStc = unitRangeToTexCoord(dotVSCoord, texSize[1]);
+    const float cosSZAtc = unitRangeToTexCoord(cosSZACoord, texSize[2]);
+    return {cosVZAtc, dotVStc, cosSZAtc};
+}
+
+// A combination of lightPollutionTexVarsTo2DCoords() and lightPollutionTexVarsToTexCoords()
+glm::vec2 SkyRadianceQuery::lightPollutionTexVarsToTexCoords(const float altitude, const float cosViewZenithAngle,
+                                                             const bool viewRayIntersectsGround) const
+{
+    const float earthRadius=params_.earthRadius, atmosphereHeight=params_.atmosphereHeight;
+    const float lengthOfHorizRay=params_.lengthOfHorizRayFromGroundToBorderOfAtmo;
+    const glm::vec2 texSize(params_.lightPollutionTextureSize);
+    const float r=earthRadius+altitude;
+    const float distToHorizon=std::sqrt(sqr(altitude)+2*altitude*earthRadius);
+
+    float cosVZACoord;
+    const float rCvza=r*cosViewZenithAngle;
+    const float discriminant=sqr(rCvza)-sqr(r)+sqr(earthRadius);
+    if(viewRayIntersectsGround)
+    {
+        const float distToGround = -rCvza-safeSqrt(discriminant);
+        const float distMin = altitude;
+        const float distMax = distToHorizon;
+        cosVZACoord = distMax==distMin ? 0.f : (distToGround-distMin)/(distMax-distMin);
+    }
+    else
+    {
+        const float distToTopAtmoBorder = -rCvza+safeSqrt(discriminant+sqr(lengthOfHorizRay));
+        const float distMin = atmosphereHeight-altitude;
+        const float distMax = distToHorizon+lengthOfHorizRay;
+        cosVZACoord = distMax==distMin ? 0.f : (distToTopAtmoBorder-distMin)/(distMax-distMin);
+    }
+    const float altCoord = distToHorizon / lengthOfHorizRay;
+
+    const float cosVZAtc = viewRayIntersectsGround ?
+                            0.5f-0.5f*unitRangeToTexCoord(cosVZACoord, texSize[0]/2) :
+                            0.5f+0.5f*unitRangeToTexCoord(cosVZACoord, texSize[0]/2);
+    const float altitudeTC = unitRangeToTexCoord(altCoord, texSize[1]);
+    return {cosVZAtc, altitudeTC};
+}
+
+float SkyRadianceQuery::findGuide01Angle(CPUTexture3D<float> const& guides, glm::vec3 const& indices) const
+{
+    // Row is the line along VZA coordinate.
+    // Position between rows means the position along dotViewSun coordinate.
+    const glm::vec4 texSize(params_.scatteringTextureSize);
+    const float texCoordVerbatim = indexToTexCoord(indices[2], texSize[2]);
+    const float rowLen = texSize[0];
+    const float numRows = texSize[1];
+    const float posOfRow = indices[1];
+    const float posInRow = indices[0];
+    const float currRow = std::floor(posOfRow);
+    const float posBetweenRows = posOfRow - currRow;
+    const auto guideAngle=[&](const float pos)
+    {
+        return PI/2*guides.sample({indexToTexCoord(pos, rowLen),
+                                   indexToTexCoord(currRow, numRows-1),
+                                   texCoordVerbatim});
+    };
+
+    // A & B are the endpoints of binary search inside the row
+    float posInRow_A = 0;
+    float posInRow_B = rowLen-1;
+    if(posInRow_A + (posBetweenRows-0.5f) * std::tan(guideAngle(posInRow_A)) > posInRow)
+        std::swap(posInRow_A, posInRow_B);
+    for(int n=0; n<8; ++n)
+    {
+        const float currPosInRow = (posInRow_A + posInRow_B)/2;
+        if(currPosInRow + (posBetweenRows-0.5f) * std::tan(guideAngle(currPosInRow)) < posInRow)
+            posInRow_A = currPosInRow;
+        else
+            posInRow_B = currPosInRow;
+    }
+    return guideAngle((posInRow_A + posInRow_B)/2);
+}
+
+float SkyRadianceQuery::findGuide02Angle(CPUTexture3D<float> const& guides, glm::vec3 const& indices) const
+{
+    // Row is the line along VZA coordinate.
+    // Position between rows means the position along SZA coordinate.
+    const glm::vec4 texSize(params_.scatteringTextureSize);
+    const float texCoordVerbatim = indexToTexCoord(indices[1], texSize[1]);
+    const float rowLen = texSize[0];
+    const float numRows = texSize[2];
+    const float posOfRow = indices[2];
+    const float posInRow = indices[0];
+    const float currRow = std::floor(posOfRow);
+    const float posBetweenRows = posOfRow - currRow;
+    const auto guideAngle=[&](const float pos)
+    {
+        return PI/2*guides.sample({indexToTexCoord(pos, rowLen),
+                                   texCoordVerbatim,
+                                   indexToTexCoord(currRow, numRows-1)});
+    };
+
+    float posInRow_A = 0;
+    float posInRow_B = rowLen-1;
+    if(posInRow_A + (posBetweenRows-0.5f) * std::tan(guideAngle(posInRow_A)) > posInRow)
+        std::swap(posInRow_A, posInRow_B);
+    for(int n=0; n<8; ++n)
+    {
+        const float currPosInRow = (posInRow_A + posInRow_B)/2;
+        if(currPosInRow + (posBetweenRows-0.5f) * std::tan(guideAngle(currPosInRow)) < posInRow)
+            posInRow_A = currPosInRow;
+        else
+            posInRow_B = currPosInRow;
+    }
+    return guideAngle((posInRow_A + posInRow_B)/2);
+}
+
+glm::vec4 SkyRadianceQuery::sample3DTextureGuided01_log(SingleScatteringTextures const& textures, glm::vec3 const& indices) const
+{
+    const glm::vec3 texSize(glm::vec4(params_.scatteringTextureSize));
+    const float interpAngle = findGuide01Angle(textures.guides01, indices);
+
+    const float cosVZAIndex = indices[0];
+    const float dotVSIndex = indices[1];
+    const float currRow = std::floor(dotVSIndex);
+    const float posBetweenRows = dotVSIndex - currRow;
+    const float cvzaPosInCurrRow = cosVZAIndex - posBetweenRows*std::tan(interpAngle);
+    const float cvzaPosInNextRow = cosVZAIndex + (1-posBetweenRows)*std::tan(interpAngle);
+
+    glm::vec3 indicesCurrRow = indices, indicesNextRow = indices;
+    indicesCurrRow[0] = std::clamp(cvzaPosInCurrRow, 0.f, texSize[0]-1);
+    indicesNextRow[0] = std::clamp(cvzaPosInNextRow, 0.f, texSize[0]-1);
+    indicesCurrRow[1] = currRow;
+    indicesNextRow[1] = std::min(currRow+1, texSize[1]-1);
+
+    const auto toTexCoords=[&](glm::vec3 const& i)
+    {
+        return glm::vec3(indexToTexCoord(i[0], texSize[0]), indexToTexCoord(i[1], texSize[1]), indexToTexCoord(i[2], texSize[2]));
+    };
+    const glm::vec4 valueCurrRow = textures.scattering.sample(toTexCoords(indicesCurrRow));
+    const glm::vec4 valueNextRow = textures.scattering.sample(toTexCoords(indicesNextRow));
+    const glm::vec4 logValNextRow = glm::log(glm::max(valueNextRow, glm::vec4(epsilon)));
+    const glm::vec4 logValCurrRow = glm::log(glm::max(valueCurrRow, glm::vec4(epsilon)));
+    return (logValNextRow-logValCurrRow) * posBetweenRows + logValCurrRow;
+}
+
+glm::vec4 SkyRadianceQuery::sample3DTextureGuided(SingleScatteringTextures const& textures, glm::vec3 const& texCoords) const
+{
+    const glm::vec3 texSize(glm::vec4(params_.scatteringTextureSize));
+    const glm::vec3 indices(texCoordToIndex(texCoords[0], texSize[0]),
+                            texCoordToIndex(texCoords[1], texSize[1]),
+                            texCoordToIndex(texCoords[2], texSize[2]));
+    // Handle the external interpolation guides: the guides between a pair of VZA-dotViewSun 2D "pictures".
+    const float interpAngle = findGuide02Angle(textures.guides02, indices);
+
+    const float cvzaIndex = indices[0];
+    const float cszaIndex = indices[2];
+    const float currRow = std::floor(cszaIndex);
+    const float posBetweenRows = cszaIndex - currRow;
+    const float cvzaPosInCurrRow = cvzaIndex - posBetweenRows*std::tan(interpAngle);
+    const float cvzaPosInNextRow = cvzaIndex + (1-posBetweenRows)*std::tan(interpAngle);
+
+    glm::vec3 indicesCurrRow = indices, indicesNextRow = indices;
+    indicesCurrRow[0] = std::clamp(cvzaPosInCurrRow, 0.f, texSize[0]-1);
+    indicesNextRow[0] = std::clamp(cvzaPosInNextRow, 0.f, texSize[0]-1);
+    indicesCurrRow[2] = currRow;
+    indicesNextRow[2] = std::min(currRow+1, texSize[2]-1);
+
+    // The internal interpolation guides are the ones between rows in each 2D "picture".
+    const glm::vec4 logValCurrRow = sample3DTextureGuided01_log(textures, indicesCurrRow);
+    const glm::vec4 logValNextRow = sample3DTextureGuided01_log(textures, indicesNextRow);
+    return glm::exp((logValNextRow-logValCurrRow) * posBetweenRows + logValCurrRow);
+}
+
+glm::vec4 SkyRadianceQuery::opticalDepthToAtmosphereBorder(WavelengthSetTextures const& textures,
+                                                           const float cosViewZenithAngle, const float altitude) const
+{
+    return textures.transmittance.sample(transmittanceTexVarsToTexCoord(cosViewZenithAngle, altitude));
+}
+
+// Assumes that the endpoint of view ray doesn't intentionally exit atmosphere.
+glm::vec4 SkyRadianceQuery::transmittance(WavelengthSetTextures const& textures, const float cosViewZenithAngle,
+                                          const float altitude, const float dist, const bool viewRayIntersectsGround) const
+{
+    const float earthRadius=params_.earthRadius;
+    const float r=earthRadius+altitude;
+    const float altAtDist=std::clamp(std::sqrt(sqr(dist)+sqr(r)+2*r*dist*cosViewZenithAngle)-earthRadius,
+                                     0.f, float(params_.atmosphereHeight));
+    const float cosViewZenithAngleAtDist=clampCosine((r*cosViewZenithAngle+dist)/(earthRadius+altAtDist));
+
+    glm::vec4 depth;
+    if(viewRayIntersectsGround)
+    {
+        depth=opticalDepthToAtmosphereBorder(textures, -cosViewZenithAngleAtDist, altAtDist) -
+              opticalDepthToAtmosphereBorder(textures, -cosViewZenithAngle, altitude);
+    }
+    else
+    {
+        depth=opticalDepthToAtmosphereBorder(textures, cosViewZenithAngle, altitude) -
+              opticalDepthToAtmosphereBorder(textures, cosViewZenithAngleAtDist, altAtDist);
+    }
+    return glm::exp(-depth);
+}
+
+float SkyRadianceQuery::distanceToAtmosphereBorder(const float cosZenithAngle, const float observerAltitude) const
+{
+    const float Robs=params_.earthRadius+observerAltitude;
+    const float Ratm=params_.earthRadius+params_.atmosphereHeight;
+    const float discriminant=sqr(Ratm)-sqr(Robs)*(1-sqr(cosZenithAngle));
+    return std::max(safeSqrt(discriminant)-Robs*cosZenithAngle, 0.f);
+}
+
+float SkyRadianceQuery::distanceToGround(const float cosZenithAngle, const float observerAltitude) const
+{
+    const float Robs=params_.earthRadius+observerAltitude;
+    const float discriminant=sqr(params_.earthRadius)-sqr(Robs)*(1-sqr(cosZenithAngle));
+    return std::max(-safeSqrt(discriminant)-Robs*cosZenithAngle, 0.f);
+}
+
+void SkyRadianceQuery::computeGeometry(Scene const& scene, glm::vec3 const*const viewDirs, DirectionBlock& block) const
+{
+    const float earthRadius=params_.earthRadius, atmosphereHeight=params_.atmosphereHeight;
+    const glm::vec3 earthCenter(0,0,-earthRadius);
+    const glm::vec3 sunDirection(std::cos(scene.sunAzimuth)*std::sin(scene.sunZenithAngle),
+                                 std::sin(scene.sunAzimuth)*std::sin(scene.sunZenithAngle),
+                                 std::cos(scene.sunZenithAngle));
+    // NOTE: like the renderer, we simply clamp negative altitudes to zero
+    const float cameraAltitude=std::max(float(scene.altitude), 0.f);
+
+    for(unsigned i=0; i<block.size; ++i)
+    {
+        const glm::vec3 viewDir=viewDirs[i];
+        glm::vec3 cameraPosition(0,0,cameraAltitude);
+        float altitude=cameraAltitude;
+
+        // If the camera is in space, move it along the view ray to the top of the atmosphere
+        const glm::vec3 pSpace = cameraPosition - earthCenter;
+        const float pSpace_dot_v = dot(pSpace, viewDir);
+        const float distanceToTOA = -pSpace_dot_v - std::sqrt(sqr(earthRadius+atmosphereHeight) -
+                                                               (dot(pSpace, pSpace) - sqr(pSpace_dot_v)));
+        const bool inSpace = altitude>atmosphereHeight;
+        const bool rayEntersAtmosphere = distanceToTOA>=0;
+        // Selects instead of a branch. The distance is NaN if the ray misses the atmosphere, so it's selected
+        // before multiplication.
+        const bool moveToTOA = inSpace && rayEntersAtmosphere;
+        cameraPosition += viewDir*(moveToTOA ? distanceToTOA : 0.f);
+        altitude = moveToTOA ? atmosphereHeight : altitude;
+        block.lookingIntoAtmosphere[i] = !inSpace || rayEntersAtmosphere;
+
+        const glm::vec3 zenith=normalize(cameraPosition-earthCenter);
+        const float cosViewZenithAngle=dot(zenith,viewDir);
+
+        const glm::vec3 p = cameraPosition - earthCenter;
+        const float p_dot_v = dot(p, viewDir);
+        const float squaredDistBetweenViewRayAndEarthCenter = dot(p, p) - sqr(p_dot_v);
+        const float distanceToIntersection = -p_dot_v - std::sqrt(sqr(earthRadius) - squaredDistBetweenViewRayAndEarthCenter);
+        // altitude==0 is a special case where distance to intersection calculation
+        // is unreliable (has a lot of noise in its sign), so check it separately
+        block.viewRayIntersectsGround[i] = distanceToIntersection>0 || (altitude==0 && cosViewZenithAngle<0);
+
+        block.viewDir[i] = viewDir;
+        block.zenith[i] = zenith;
+        block.altitude[i] = altitude;
+        block.cosViewZenithAngle[i] = cosViewZenithAngle;
+        block.cosSunZenithAngle[i] = dot(zenith,sunDirection);
+        block.dotViewSun[i] = dot(viewDir,sunDirection);
+        block.valid[i] = dot(viewDir,viewDir)!=0;
+    }
+}
+
+void SkyRadianceQuery::evaluateBlock(Scene const& scene, DirectionBlock const& block, const unsigned components,
+                                     float*const output) const
+{
+    const auto wlSetCount=wlSetTextures_.size();
+    const float sunAngularRadius = std::isnan(scene.sunAngularRadius) ? params_.sunAngularRadius : scene.sunAngularRadius;
+    const float cosSunAngularRadius = std::cos(sunAngularRadius);
+    const float lightPollutionGroundLuminance = scene.lightPollutionGroundLuminance;
+    const glm::vec3 sunDirection(std::cos(scene.sunAzimuth)*std::sin(scene.sunZenithAngle),
+                                 std::sin(scene.sunAzimuth)*std::sin(scene.sunZenithAngle),
+                                 std::cos(scene.sunZenithAngle));
+    const bool needScatteringCoords = components & (SingleScattering|MultipleScattering);
+    const bool needLightPollution = (components & LightPollution) && lightPollutionGroundLuminance!=0;
+
+    for(unsigned i=0; i<block.size; ++i)
+    {
+        const auto spectrum = output+size_t(i)*4*wlSetCount;
+        std::fill_n(spectrum, 4*wlSetCount, 0.f);
+        if(!block.valid[i]) continue;
+
+        const float altitude=block.altitude[i];
+        const float cosViewZenithAngle=block.cosViewZenithAngle[i];
+        const float dotViewSun=block.dotViewSun[i];
+        const bool viewRayIntersectsGround=block.viewRayIntersectsGround[i];
+        const bool lookingIntoAtmosphere=block.lookingIntoAtmosphere[i];
+
+        // Texture coordinates don't depend on wavelengths, so they are shared by all the wavelength sets
+        const auto scatteringTexCoords = needScatteringCoords && lookingIntoAtmosphere ?
+            scatteringTexVarsToTex3DCoords(block.cosSunZenithAngle[i], cosViewZenithAngle, dotViewSun,
+                                           altitude, viewRayIntersectsGround) : glm::vec3(0);
+        const auto lightPollutionTexCoords = needLightPollution && lookingIntoAtmosphere ?
+            lightPollutionTexVarsToTexCoords(altitude, cosViewZenithAngle, viewRayIntersectsGround) : glm::vec2(0);
+
+        float distToGround=0;
+        glm::vec2 groundIrradianceTexCoords(0);
+        if((components & ZeroOrderScattering) && viewRayIntersectsGround)
+        {
+            distToGround = distanceToGround(cosViewZenithAngle, altitude);
+            const glm::vec3 groundNormal = normalize(block.zenith[i]*(params_.earthRadius+altitude)+block.viewDir[i]*distToGround);
+            groundIrradianceTexCoords = irradianceTexVarsToTexCoord(dot(groundNormal, sunDirection), 0);
+        }
+
+        for(unsigned wlSetIndex=0; wlSetIndex<wlSetCount; ++wlSetIndex)
+        {
+            const auto& textures=wlSetTextures_[wlSetIndex];
+            glm::vec4 radiance(0);
+            if(components & ZeroOrderScattering)
+            {
+                if(viewRayIntersectsGround)
+                {
+                    const auto transmittanceToGround=transmittance(textures, cosViewZenithAngle, altitude,
+                                                                   distToGround, viewRayIntersectsGround);
+                    const auto groundIrradiance = textures.irradiance.sample(groundIrradianceTexCoords);
+                    // Radiation scattered by the ground
+                    const float groundBRDF = 1/PI; // Assuming Lambertian BRDF, which is constant
+                    radiance += transmittanceToGround*groundAlbedo_[wlSetIndex]*groundIrradiance*groundBRDF
+                              + lightPollutionGroundLuminance*lightPollutionRelativeRadiance_[wlSetIndex];
+                }
+                else if(dotViewSun>cosSunAngularRadius)
+                {
+                    const auto solarRadiance = params_.solarIrradianceAtTOA[wlSetIndex]/(PI*sqr(sunAngularRadius));
+                    if(lookingIntoAtmosphere)
+                        radiance += glm::exp(-opticalDepthToAtmosphereBorder(textures, cosViewZenithAngle, altitude))*solarRadiance;
+                    else
+                        radiance += solarRadiance;
+                }
+            }
+            if(!lookingIntoAtmosphere)
+            {
+                std::copy_n(&radiance[0], 4, spectrum+4*wlSetIndex);
+                continue;
+            }
+
+            if(components & SingleScattering)
+            {
+                for(const auto& [name, texturesPerWLSet] : singleScatteringTextures_)
+                {
+                    const auto& ssTextures=texturesPerWLSet[wlSetIndex];
+                    const auto scattering = ssTextures.haveGuides() ? sample3DTextureGuided(ssTextures, scatteringTexCoords)
+                                                                    : ssTextures.scattering.sample(scatteringTexCoords);
+                    radiance += scattering*phaseFunctions_.at(name)[wlSetIndex](dotViewSun);
+                }
+            }
+            if((components & MultipleScattering) && !textures.multipleScattering.empty())
+                radiance += textures.multipleScattering.sample(scatteringTexCoords);
+            if(needLightPollution && !textures.lightPollution.empty())
+                radiance += lightPollutionGroundLuminance*textures.lightPollution.sample(lightPollutionTexCoords);
+
+            std::copy_n(&radiance[0], 4, spectrum+4*wlSetIndex);
+        }
+    }
+}
+
+std::vector<float> SkyRadianceQuery::radiance(Scene const& scene, std::vector<glm::vec3> const& viewDirs,
+                                              const unsigned components)
+{
+    const auto wlSetCount=wlSetTextures_.size();
+
+    if(components & ZeroOrderScattering)
+    {
+        if(groundAlbedo_.size()!=wlSetCount || lightPollutionRelativeRadiance_.size()!=wlSetCount)
+            throw DataLoadError{QObject::tr("Ground spectra needed for zero-order scattering are not available")};
+    }
+    if(components & SingleScattering)
+    {
+        for(const auto& [name, functions] : phaseFunctions_)
+            for(unsigned wlSetIndex=0; wlSetIndex<functions.size(); ++wlSetIndex)
+                if(!functions[wlSetIndex])
+                    throw DataLoadError{QObject::tr("Phase function of scatterer \"%1\" for wavelength set %2 "
+                                                    "is not set").arg(name).arg(wlSetIndex)};
+    }
+
+    // XXX: keep in sync with AtmosphereRenderer::altitudeUnitRangeTexCoord()
+    const double H = params_.atmosphereHeight;
+    const double h = std::clamp(scene.altitude, 0., H);
+    const double R = params_.earthRadius;
+    const float altitudeCoord = std::sqrt(h*(h+2*R) / ( H*(H+2*R) ));
+    if(altitudeCoord != loadedAltitudeCoord_ && (components & (SingleScattering|MultipleScattering)))
+        loadScatteringTextures(altitudeCoord);
+
+    std::vector<float> result(viewDirs.size()*4*wlSetCount);
+    const size_t blockCount = (viewDirs.size()+DirectionBlock::capacity-1)/DirectionBlock::capacity;
+    std::atomic<size_t> nextBlock{0};
+    const auto worker=[&]
+    {
+        DirectionBlock block;
+        for(size_t blockIndex; (blockIndex=nextBlock++) < blockCount;)
+        {
+            const auto first = blockIndex*DirectionBlock::capacity;
+            block.size = std::min<size_t>(DirectionBlock::capacity, viewDirs.size()-first);
+            computeGeometry(scene, &viewDirs[first], block);
+            evaluateBlock(scene, block, components, &result[first*4*wlSetCount]);
+        }
+    };
+
+    const unsigned threadCount = std::min<size_t>(threadCount_ ? threadCount_ : std::max(1u, std::thread::hardware_concurrency()),
+                                                  blockCount);
+    std::vector<std::thread> threads;
+    for(unsigned n=1; n<threadCount; ++n)
+        threads.emplace_back(worker);
+    worker();
+    for(auto& thread : threads)
+        thread.join();
+
+    return result;
+}
@@ -0,0 +1,140 @@
+#ifndef INCLUDE_ONCE_A93C2F17_64D8_4E0B_B5A2_7F1C08E3D5B9
+#define INCLUDE_ONCE_A93C2F17_64D8_4E0B_B5A2_7F1C08E3D5B9
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+#include <QString>
+#include "CPUTexture.hpp"
+#include "../../common/AtmosphereParameters.hpp"
+
+/**
+ * \brief Computes sky radiance for arbitrary view directions on the CPU, without an OpenGL context.
+ *
+ * The query loads the same textures as AtmosphereRenderer and samples them using the same texture coordinate
+ * mapping and interpolation (including the interpolation guides for single scattering) as the GLSL rendering code,
+ * so its results match the radiance rendered by AtmosphereRenderer for the same scene up to the differences of
+ * floating-point arithmetic and texture filtering hardware.
+ *
+ * Only data computed with <tt>calcmysky --radiance</tt> are supported. Eclipses, pseudo-mirror sky below horizon
+ * and modification of the solar spectrum are not.
+ *
+ * Phase functions of the scatterers are written in GLSL in the atmosphere description, so they can't be evaluated
+ * here. Single scattering of a scatterer can only be computed after its phase function has been supplied with
+ * #setPhaseFunction or #setPhaseFunctionTable.
+ */
+class SkyRadianceQuery
+{
+public:
+    //! Observation conditions shared by all the directions of a query
+    struct Scene
+    {
+        double altitude=0; //!< Altitude of the observer, in meters
+        double sunAzimuth=0; //!< In radians
+        double sunZenithAngle=0; //!< In radians
+        double sunAngularRadius=NAN; //!< In radians; NaN means the value from the atmosphere description
+        double lightPollutionGroundLuminance=0; //!< In cd/m²
+    };
+    enum Component
+    {
+        ZeroOrderScattering = 1<<0,
+        SingleScattering    = 1<<1,
+        MultipleScattering  = 1<<2,
+        LightPollution      = 1<<3,
+        AllComponents       = ZeroOrderScattering|SingleScattering|MultipleScattering|LightPollution,
+    };
+    using PhaseFunction = std::function<glm::vec4(float dotViewSun)>;
+
+    //! Reads atmosphere description and altitude-independent textures from \p pathToData
+    explicit SkyRadianceQuery(QString const& pathToData);
+
+    AtmosphereParameters const& atmosphereParameters() const { return params_; }
+    //! All wavelengths in nm, in the order of the spectra returned by #radiance
+    std::vector<float> wavelengths() const;
+
+    //! Sets the phase function of a scatterer for the wavelength set with index \p wlSetIndex
+    void setPhaseFunction(QString const& scattererName, unsigned wlSetIndex, PhaseFunction const& function);
+    /**
+     * \brief Sets the phase function of a scatterer as a table of values.
+     *
+     * The values are sampled uniformly in scattering angle, from 0 (dotViewSun=1) to π (dotViewSun=-1), and are
+     * linearly interpolated between the samples.
+     */
+    void setPhaseFunctionTable(QString const& scattererName, unsigned wlSetIndex, std::vector<glm::vec4> const& values);
+    /**
+     * \brief Sets the spectra needed for radiance of the ground in zero-order scattering.
+     *
+     * These spectra are taken from the atmosphere description if all the files it refers to are available, otherwise
+     * they must be set here before querying zero-order scattering.
+     */
+    void setGroundSpectra(std::vector<glm::vec4> const& groundAlbedo,
+                          std::vector<glm::vec4> const& lightPollutionRelativeRadiance);
+    //! Number of threads used by #radiance, zero meaning the number of hardware threads
+    void setThreadCount(unsigned count) { threadCount_=count; }
+
+    /**
+     * \brief Computes spectral radiance for each of \p viewDirs.
+     *
+     * View directions are unit vectors in the horizontal coordinate system with zenith along the \a z axis and
+     * azimuth measured from the \a x axis towards \a y, as in AtmosphereRenderer. The spectrum of each direction
+     * occupies consecutive elements of the result, in the order of #wavelengths.
+     *
+     * If the altitude of \p scene differs from that of the previous query, scattering textures for the new altitude
+     * are loaded first, like AtmosphereRenderer does when altitude changes.
+     *
+     * \param components a combination of Component flags specifying which contributions to add up.
+     */
+    std::vector<float> radiance(Scene const& scene, std::vector<glm::vec3> const& viewDirs,
+                                unsigned components=AllComponents);
+
+private:
+    struct WavelengthSetTextures
+    {
+        CPUTexture2D<glm::vec4> transmittance;
+        CPUTexture2D<glm::vec4> irradiance;
+        CPUTexture2D<glm::vec4> lightPollution;
+        CPUTexture3D<glm::vec4> multipleScattering;
+    };
+    struct SingleScatteringTextures
+    {
+        CPUTexture3D<glm::vec4> scattering;
+        CPUTexture3D<float> guides01, guides02;
+        bool haveGuides() const { return !guides01.empty() && !guides02.empty(); }
+    };
+    struct DirectionBlock;
+
+    QString pathToData_;
+    AtmosphereParameters params_;
+    std::vector<glm::vec4> groundAlbedo_;
+    std::vector<glm::vec4> lightPollutionRelativeRadiance_;
+    std::vector<WavelengthSetTextures> wlSetTextures_;
+    // Per scatterer name, per wavelength set
+    std::map<QString, std::vector<SingleScatteringTextures>> singleScatteringTextures_;
+    std::map<QString, std::vector<PhaseFunction>> phaseFunctions_;
+    float loadedAltitudeCoord_=NAN;
+    unsigned threadCount_=0;
+
+    void loadScatteringTextures(float altitudeCoord);
+    void computeGeometry(Scene const& scene, glm::vec3 const* viewDirs, DirectionBlock& block) const;
+    void evaluateBlock(Scene const& scene, DirectionBlock const& block, unsigned components, float* output) const;
+
+    float distanceToAtmosphereBorder(float cosZenithAngle, float observerAltitude) const;
+    float distanceToGround(float cosZenithAngle, float observerAltitude) const;
+    float cosSZAToUnitRangeTexCoord(float cosSunZenithAngle) const;
+    glm::vec2 transmittanceTexVarsToTexCoord(float cosVZA, float altitude) const;
+    glm::vec2 irradianceTexVarsToTexCoord(float cosSunZenithAngle, float altitude) const;
+    glm::vec3 scatteringTexVarsToTex3DCoords(float cosSunZenithAngle, float cosViewZenithAngle,
+                                             float dotViewSun, float altitude, bool viewRayIntersectsGround) const;
+    glm::vec2 lightPollutionTexVarsToTexCoords(float altitude, float cosViewZenithAngle, bool viewRayIntersectsGround) const;
+    float findGuide01Angle(CPUTexture3D<float> const& guides, glm::vec3 const& indices) const;
+    float findGuide02Angle(CPUTexture3D<float> const& guides, glm::vec3 const& indices) const;
+    glm::vec4 sample3DTextureGuided01_log(SingleScatteringTextures const& textures, glm::vec3 const& indices) const;
+    glm::vec4 sample3DTextureGuided(SingleScatteringTextures const& textures, glm::vec3 const& texCoords) const;
+    glm::vec4 opticalDepthToAtmosphereBorder(WavelengthSetTextures const& textures, float cosViewZenithAngle, float altitude) const;
+    glm::vec4 transmittance(WavelengthSetTextures const& textures, float cosViewZenithAngle, float altitude,
+                            float dist, bool viewRayIntersectsGround) const;
+};
+
+#endif
@@ -13,6 +13,18 @@ QByteArray readFullFile(QString const& filename)
     return data;
 }
 
+QByteArray withDefinitionsInserted(QByteArray sourceCode, QByteArray const& definitions)
+{
+    if(definitions.isEmpty()) return sourceCode;
+
+    // #version must remain the first directive, so the definitions go to the line after it
+    const auto versionPos=sourceCode.indexOf("#version");
+    const auto insertPos = versionPos<0 ? 0 : sourceCode.indexOf('\n', versionPos)+1;
+    if(insertPos==0 && versionPos>=0)
+        return sourceCode+'\n'+definitions;
+    return sourceCode.insert(insertPos, definitions);
+}
+
 void addShaderCode(QOpenGLShaderProgram& program, const QOpenGLShader::ShaderType type,
                    QString const& description, QByteArray sourceCode)
 {
@@ -12,6 +12,14 @@ inline void addShaderFile(QOpenGLShaderProgram& program, QOpenGLShader::ShaderTy
 { addShaderCode(program, type, QObject::tr("shader file \"%1\"").arg(filename), readFullFile(filename)); }
 inline void addShaderFile(QOpenGLShaderProgram& program, QOpenGLShader::ShaderType type, std::filesystem::path const& filename)
 { addShaderFile(program, type, QString::fromStdString(filename.u8string())); }
+//! Inserts \p definitions (a set of \c \#define lines) right after the \c \#version directive of \p sourceCode
+QByteArray withDefinitionsInserted(QByteArray sourceCode, QByteArray const& definitions);
+inline void addShaderFile(QOpenGLShaderProgram& program, QOpenGLShader::ShaderType type, std::filesystem::path const& filename,
+                          QByteArray const& definitions)
+{
+    const auto name=QString::fromStdString(filename.u8string());
+    addShaderCode(program, type, QObject::tr("shader file \"%1\"").arg(name), withDefinitionsInserted(readFullFile(name), definitions));
+}
 void link(QOpenGLShaderProgram& program, QString const& description);
 
 #endif
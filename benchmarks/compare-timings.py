@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Compare two stage timing files saved by calcmysky --timings-json.
+
+Prints the times of each stage in both runs and their ratio. Exits with status 1 if
+any stage, or the total, got slower than the threshold allows.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    stages = {stage["name"]: stage for stage in data["stages"]}
+    return data, stages
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("baseline", help="timings of the reference run")
+    parser.add_argument("current", help="timings of the run to check")
+    parser.add_argument("--metric", choices=["wall", "gpu"], default="wall",
+                        help="which time to compare (default: wall)")
+    parser.add_argument("--threshold", type=float, default=0.1,
+                        help="relative slowdown that counts as a regression (default: 0.1)")
+    parser.add_argument("--min-time", type=float, default=0.05,
+                        help="ignore slowdowns smaller than this many seconds, they are mostly noise (default: 0.05)")
+    args = parser.parse_args()
+
+    baseData, baseStages = load(args.baseline)
+    currData, currStages = load(args.current)
+    key = args.metric + "_time_s"
+
+    if baseData.get("gl_renderer") != currData.get("gl_renderer"):
+        print("Warning: the runs used different OpenGL renderers: \"{}\" and \"{}\""
+              .format(baseData.get("gl_renderer"), currData.get("gl_renderer")))
+
+    rows = [(name, baseStages.get(name, {}).get(key), currStages.get(name, {}).get(key))
+            for name in list(baseStages) + [name for name in currStages if name not in baseStages]]
+    rows.append(("TOTAL", baseData["total_wall_time_s"] if args.metric == "wall" else None,
+                          currData["total_wall_time_s"] if args.metric == "wall" else None))
+
+    nameWidth = max(len(name) for name, _, _ in rows)
+    print("{:{}}  {:>10}  {:>10}  {:>7}".format("stage", nameWidth, "baseline", "current", "ratio"))
+    regressions = []
+    for name, base, curr in rows:
+        if base is None or curr is None:
+            if base is not None or curr is not None:
+                print("{:{}}  {:>10}  {:>10}".format(name, nameWidth,
+                                                   "-" if base is None else "{:.3f}".format(base),
+                                                   "-" if curr is None else "{:.3f}".format(curr)))
+            continue
+        ratio = curr / base if base > 0 else float("inf") if curr > 0 else 1
+        mark = ""
+        if ratio > 1 + args.threshold and curr - base > args.min_time:
+            mark = "  SLOWER"
+            regressions.append(name)
+        elif ratio < 1 - args.threshold and base - curr > args.min_time:
+            mark = "  faster"
+        print("{:{}}  {:10.3f}  {:10.3f}  {:7.3f}{}".format(name, nameWidth, base, curr, ratio, mark))
+
+    if regressions:
+        print("\n{} stage(s) slower by more than {:g}%: {}".format(len(regressions), 100*args.threshold,
+                                                                   ", ".join(regressions)))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
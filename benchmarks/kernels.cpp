@@ -0,0 +1,131 @@
+// Compares the kernels from common/kernels.hpp with the scalar loops they replace, on arrays of the size of a large
+// 4D texture. Exits with status 1 if the results differ.
+//
+//   kernel-benchmark [megabytes per array]
+
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include "../common/kernels.hpp"
+
+namespace
+{
+
+constexpr int repetitions=5;
+
+// Returns the best time of several runs in seconds, restoring the inputs with prepare() before each run
+double measure(std::function<void()> const& prepare, std::function<void()> const& run)
+{
+    double best=std::numeric_limits<double>::infinity();
+    for(int i=0; i<repetitions; ++i)
+    {
+        prepare();
+        const auto t0=std::chrono::steady_clock::now();
+        run();
+        const auto t1=std::chrono::steady_clock::now();
+        best=std::min(best, std::chrono::duration<double>(t1-t0).count());
+    }
+    return best;
+}
+
+bool sameBits(void const* a, void const* b, const size_t bytes)
+{
+    return std::memcmp(a, b, bytes)==0;
+}
+
+bool report(std::string const& name, const double bytesProcessed, const double scalarTime, const double kernelTime,
+            const bool resultsMatch)
+{
+    std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << bytesProcessed/scalarTime/1e9
+              << std::setw(12) << bytesProcessed/kernelTime/1e9
+              << std::setw(10) << scalarTime/kernelTime << "x"
+              << (resultsMatch ? "" : "   RESULTS DIFFER") << "\n";
+    return resultsMatch;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const size_t megabytes = argc>1 ? std::stoul(argv[1]) : 256;
+    const size_t vectorCount = megabytes*1024*1024/sizeof(glm::vec4);
+    const size_t floatCount = 4*vectorCount;
+    const double bytes = floatCount*sizeof(float);
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> dist(0, 1e3f);
+    std::vector<glm::vec4> src(vectorCount), other(vectorCount);
+    for(size_t i=0; i<vectorCount; ++i)
+    {
+        src[i]=glm::vec4(dist(gen), dist(gen), dist(gen), dist(gen));
+        other[i]=glm::vec4(dist(gen), dist(gen), dist(gen), dist(gen));
+    }
+    // A few NaNs, like in a texture computed with a bug
+    for(size_t i=0; i<floatCount; i+=floatCount/7+1)
+        reinterpret_cast<float*>(other.data())[i]=NAN;
+    glm::mat4 matrix;
+    for(int c=0; c<4; ++c)
+        for(int r=0; r<4; ++r)
+            matrix[c][r]=dist(gen)/1e3f;
+
+    std::vector<glm::vec4> expected(vectorCount), actual(vectorCount);
+    const auto copyTo=[&](std::vector<glm::vec4>& dst){ return [&]{ std::copy(src.begin(), src.end(), dst.begin()); }; };
+    bool ok=true;
+
+    std::cout << "Arrays of " << megabytes << " MiB, best of " << repetitions << " runs, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+    std::cout << std::left << std::setw(32) << "Kernel" << std::right
+              << std::setw(12) << "scalar GB/s" << std::setw(12) << "kernel GB/s" << std::setw(11) << "speedup" << "\n";
+
+    {
+        const auto tScalar=measure(copyTo(expected), [&]{ for(auto& v : expected) v = matrix*v; });
+        const auto tKernel=measure(copyTo(actual), [&]{ transformVectors(matrix, actual.data(), vectorCount); });
+        ok &= report("transformVectors", bytes, tScalar, tKernel, sameBits(expected.data(), actual.data(), bytes));
+    }
+    {
+        const auto tScalar=measure(copyTo(expected), [&]{ for(size_t i=0; i<vectorCount; ++i) expected[i] += matrix*other[i]; });
+        const auto tKernel=measure(copyTo(actual), [&]{ accumulateTransformedVectors(matrix, other.data(), actual.data(), vectorCount); });
+        ok &= report("accumulateTransformedVectors", 2*bytes, tScalar, tKernel, sameBits(expected.data(), actual.data(), bytes));
+    }
+    {
+        const float t=0.37f;
+        const auto tScalar=measure([]{}, [&]{ for(size_t i=0; i<vectorCount; ++i) expected[i] = src[i] + t*(other[i]-src[i]); });
+        const auto tKernel=measure([]{}, [&]{ lerpVectors(src.data(), other.data(), t, actual.data(), vectorCount); });
+        ok &= report("lerpVectors", 2*bytes, tScalar, tKernel, sameBits(expected.data(), actual.data(), bytes));
+    }
+    {
+        const uint32_t mask=~((1u<<(std::numeric_limits<float>::digits-10))-1);
+        const auto tScalar=measure(copyTo(expected), [&]
+        {
+            const auto data=reinterpret_cast<float*>(expected.data());
+            for(size_t i=0; i<floatCount; ++i)
+            {
+                uint32_t x;
+                std::memcpy(&x, &data[i], sizeof x);
+                x &= mask;
+                std::memcpy(&data[i], &x, sizeof x);
+            }
+        });
+        const auto tKernel=measure(copyTo(actual), [&]{ maskFloatBits(reinterpret_cast<float*>(actual.data()), floatCount, mask); });
+        ok &= report("maskFloatBits", bytes, tScalar, tKernel, sameBits(expected.data(), actual.data(), bytes));
+    }
+    {
+        const auto data=reinterpret_cast<const float*>(other.data());
+        size_t expectedCount=0, actualCount=0;
+        const auto tScalar=measure([]{}, [&]{ expectedCount=std::count_if(data, data+floatCount, [](const float x){ return std::isnan(x); }); });
+        const auto tKernel=measure([]{}, [&]{ actualCount=countNaNs(data, floatCount); });
+        ok &= report("countNaNs", bytes, tScalar, tKernel, expectedCount==actualCount);
+    }
+
+    return ok ? 0 : 1;
+}
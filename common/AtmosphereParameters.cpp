@@ -455,7 +455,13 @@ void AtmosphereParameters::parse(QString const& atmoDescrFileName, const ForceNo
     {
         throw DataLoadError{QString("Failed to open atmosphere description file: %1").arg(atmoDescr.errorString())};
     }
-    descriptionFileText=atmoDescr.readAll();
+    parseText(atmoDescr.readAll(), atmoDescrFileName, forceNoEDSTextures, skipSpectra);
+}
+
+void AtmosphereParameters::parseText(QString const& text, QString const& atmoDescrFileName,
+                                     const ForceNoEDSTextures forceNoEDSTextures, const SkipSpectra skipSpectra)
+{
+    descriptionFileText=text;
     QTextStream stream(&descriptionFileText, QIODevice::ReadOnly);
     int lineNumber=1;
     int version=0;
@@ -510,10 +516,24 @@ void AtmosphereParameters::parse(QString const& atmoDescrFileName, const ForceNo
             transmittanceTexH=getUInt(value,1,GLSIZEI_MAX, atmoDescrFileName, lineNumber);
         else if(key=="transmittance integration points")
             numTransmittanceIntegrationPoints=getUInt(value,1,INT_MAX, atmoDescrFileName, lineNumber);
+        else if(key=="transmittance quadrature")
+            transmittanceQuadrature=parseQuadratureScheme(value, atmoDescrFileName, lineNumber);
         else if(key=="radial integration points")
             radialIntegrationPoints=getUInt(value,1,INT_MAX, atmoDescrFileName, lineNumber);
+        else if(key=="radial quadrature")
+            radialQuadrature=parseQuadratureScheme(value, atmoDescrFileName, lineNumber);
+        else if(key=="quadrature scale height")
+            quadratureScaleHeight=getQuantity(value,1,1e6,LengthQuantity{},atmoDescrFileName,lineNumber);
         else if(key=="angular integration points")
             angularIntegrationPoints=getUInt(value,1,INT_MAX, atmoDescrFileName, lineNumber);
+        else if(key=="angular integration scheme")
+            angularIntegrationScheme=parseAngularIntegrationScheme(value, atmoDescrFileName, lineNumber);
+        else if(key=="profile tabulation points")
+        {
+            profileTabulationPoints=getUInt(value,0,GLSIZEI_MAX, atmoDescrFileName, lineNumber);
+            if(profileTabulationPoints==1)
+                throw ParsingError{atmoDescrFileName,lineNumber,QString("value for \"%1\" must be 0 or at least 2").arg(key)};
+        }
         else if(key=="angular integration points for eclipse")
             eclipseAngularIntegrationPoints=getUInt(value,1,INT_MAX, atmoDescrFileName, lineNumber);
         else if(key=="irradiance texture size for sza")
@@ -93,8 +93,13 @@ struct AtmosphereParameters
     unsigned eclipsedDoubleScatteringNumberOfElevationPairsToSample;
     unsigned scatteringOrdersToCompute;
     GLint numTransmittanceIntegrationPoints;
+    QuadratureScheme transmittanceQuadrature=QuadratureScheme::Midpoint;
     GLint radialIntegrationPoints;
+    QuadratureScheme radialQuadrature=QuadratureScheme::Midpoint;
+    GLfloat quadratureScaleHeight=8000; // used by the altitude-adapted quadrature
     GLint angularIntegrationPoints;
+    AngularIntegrationScheme angularIntegrationScheme=AngularIntegrationScheme::Uniform;
+    GLint profileTabulationPoints=0; // 0 means the profiles are evaluated directly
     GLint eclipseAngularIntegrationPoints;
     GLint lightPollutionAngularIntegrationPoints;
     GLfloat earthRadius;
@@ -119,6 +124,11 @@ struct AtmosphereParameters
     void parse(QString const& atmoDescrFileName,
                ForceNoEDSTextures forceNoEDSTextures=ForceNoEDSTextures{false},
                SkipSpectra skipSpectra=SkipSpectra{false});
+    // Parses the description from memory. The file name is used in error messages and to find spectrum files given by
+    // relative paths.
+    void parseText(QString const& text, QString const& atmoDescrFileName,
+                   ForceNoEDSTextures forceNoEDSTextures=ForceNoEDSTextures{false},
+                   SkipSpectra skipSpectra=SkipSpectra{false});
     // XXX: keep in sync with those in previewer and renderer
     auto scatTexWidth()  const { return GLsizei(scatteringTextureSize[0]); }
     auto scatTexHeight() const { return GLsizei(scatteringTextureSize[1]*scatteringTextureSize[2]); }
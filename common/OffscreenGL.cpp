@@ -0,0 +1,96 @@
+#include "OffscreenGL.hpp"
+
+#include <QOffscreenSurface>
+#include <QGuiApplication>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include "util.hpp"
+
+namespace
+{
+
+OffscreenGLBackend selectedBackend=OffscreenGLBackend::Qt;
+
+QString findBackendName(const int argc, char** argv)
+{
+    const QString option=QString("--")+GL_BACKEND_OPTION_NAME;
+    for(int i=1; i<argc; ++i)
+    {
+        const QString arg=argv[i];
+        if(arg==option && i+1<argc)
+            return argv[i+1];
+        if(arg.startsWith(option+"="))
+            return arg.mid(option.size()+1);
+    }
+    return qEnvironmentVariable("SHOWMYSKY_GL_BACKEND");
+}
+
+// Sets the variable unless the user has already set it, e.g. to use a different eglfs integration
+void setDefaultEnv(const char* name, const char* value)
+{
+    if(!qEnvironmentVariableIsSet(name))
+        qputenv(name, value);
+}
+
+}
+
+OffscreenGLBackend selectOffscreenGLBackend(const int argc, char** argv)
+{
+    const auto name=findBackendName(argc, argv).toLower();
+    if(name.isEmpty() || name=="qt")
+    {
+        selectedBackend=OffscreenGLBackend::Qt;
+    }
+    else if(name=="egl")
+    {
+        selectedBackend=OffscreenGLBackend::SurfacelessEGL;
+        // The generic eglfs integration takes the default EGL display, which Mesa creates on the platform given in
+        // EGL_PLATFORM. There's no screen and no input devices to use.
+        setDefaultEnv("QT_QPA_PLATFORM", "eglfs");
+        setDefaultEnv("QT_QPA_EGLFS_INTEGRATION", "none");
+        setDefaultEnv("EGL_PLATFORM", "surfaceless");
+        setDefaultEnv("QT_QPA_EGLFS_DISABLE_INPUT", "1");
+        setDefaultEnv("QT_QPA_EGLFS_HIDECURSOR", "1");
+        // Without these the integration would query the framebuffer device for the screen size
+        setDefaultEnv("QT_QPA_EGLFS_WIDTH", "1");
+        setDefaultEnv("QT_QPA_EGLFS_HEIGHT", "1");
+        setDefaultEnv("QT_QPA_EGLFS_PHYSICAL_WIDTH", "1");
+        setDefaultEnv("QT_QPA_EGLFS_PHYSICAL_HEIGHT", "1");
+    }
+    else
+    {
+        throw InitializationError{QObject::tr("Unknown OpenGL backend \"%1\", expected \"qt\" or \"egl\"").arg(name)};
+    }
+    return selectedBackend;
+}
+
+std::pair<std::unique_ptr<QOffscreenSurface>, std::unique_ptr<QOpenGLContext>> createOffscreenGLContext()
+{
+    if(selectedBackend==OffscreenGLBackend::SurfacelessEGL && QGuiApplication::platformName()!="eglfs")
+    {
+        throw InitializationError{QObject::tr("Surfaceless EGL backend was requested, but Qt has loaded the \"%1\" "
+                                              "platform plugin instead of \"eglfs\"").arg(QGuiApplication::platformName())};
+    }
+
+    QSurfaceFormat format;
+    format.setVersion(3,3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    // EGL defaults to OpenGL ES, which has no core profile
+    format.setRenderableType(QSurfaceFormat::OpenGL);
+
+    auto context=std::make_unique<QOpenGLContext>();
+    context->setFormat(format);
+    if(!context->create())
+        throw InitializationError{QObject::tr("Failed to create OpenGL %1.%2 context").arg(format.majorVersion()).arg(format.minorVersion())};
+
+    auto surface=std::make_unique<QOffscreenSurface>();
+    surface->setFormat(format);
+    surface->create();
+    if(!surface->isValid())
+        throw InitializationError{QObject::tr("Failed to create OpenGL %1.%2 offscreen surface").arg(format.majorVersion()).arg(format.minorVersion())};
+
+    if(!context->makeCurrent(surface.get()))
+        throw InitializationError{QObject::tr("Failed to make OpenGL %1.%2 context current").arg(format.majorVersion()).arg(format.minorVersion())};
+
+    return {std::move(surface), std::move(context)};
+}
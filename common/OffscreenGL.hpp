@@ -0,0 +1,34 @@
+#ifndef INCLUDE_ONCE_C5E348C2_616B_4FF8_8CE3_50A454771968
+#define INCLUDE_ONCE_C5E348C2_616B_4FF8_8CE3_50A454771968
+
+#include <memory>
+#include <utility>
+#include <QString>
+
+class QOpenGLContext;
+class QOffscreenSurface;
+
+// Backends of the offscreen OpenGL 3.3 core context used by the command-line tools:
+//  * "qt" is the default platform plugin of Qt, which on Linux needs an X server (or Xvfb).
+//  * "egl" is Qt's eglfs plugin over the surfaceless EGL platform of Mesa, which needs neither an X server nor a
+//    display. Combined with LIBGL_ALWAYS_SOFTWARE=1 it renders with llvmpipe, so it works on any compute node.
+// The backend is selected by the --gl-backend command-line option, or by the SHOWMYSKY_GL_BACKEND environment
+// variable if the option is absent.
+enum class OffscreenGLBackend
+{
+    Qt,
+    SurfacelessEGL,
+};
+
+inline constexpr char GL_BACKEND_OPTION_NAME[]="gl-backend";
+inline constexpr char GL_BACKEND_OPTION_DESCRIPTION[]="OpenGL backend: \"qt\" for the default Qt platform plugin, or \"egl\" "
+                                                      "for surfaceless EGL that works without an X server";
+
+// Must be called before the application object is created, because that's when Qt loads its platform plugin. Throws
+// InitializationError if the backend name is unknown.
+OffscreenGLBackend selectOffscreenGLBackend(int argc, char** argv);
+// Creates an OpenGL 3.3 core context with an offscreen surface and makes it current. Throws InitializationError on
+// failure.
+std::pair<std::unique_ptr<QOffscreenSurface>, std::unique_ptr<QOpenGLContext>> createOffscreenGLContext();
+
+#endif
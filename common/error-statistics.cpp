@@ -0,0 +1,46 @@
+#include "error-statistics.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+ErrorStatistics computeErrorStatistics(std::vector<double>& errors)
+{
+    ErrorStatistics stats;
+    stats.count=errors.size();
+    if(errors.empty()) return stats;
+
+    double sum=0;
+    for(const auto err : errors) sum+=err;
+    stats.mean=sum/errors.size();
+
+    // A partial sort is enough: everything after the percentile is not smaller than it
+    const auto percentile=errors.begin()+size_t(0.99*(errors.size()-1));
+    std::nth_element(errors.begin(), percentile, errors.end());
+    stats.percentile99=*percentile;
+    stats.max=*std::max_element(percentile, errors.end());
+    return stats;
+}
+
+std::vector<double> relativeComponentErrors(std::vector<glm::vec4> const& reference, std::vector<glm::vec4> const& tested)
+{
+    float maxReference=0;
+    for(const auto& v : reference)
+        maxReference=std::max({maxReference, v[0], v[1], v[2], v[3]});
+    const float minReference=1e-4f*maxReference;
+
+    std::vector<double> errors;
+    for(size_t i=0; i<reference.size(); ++i)
+    {
+        for(int c=0; c<4; ++c)
+        {
+            if(reference[i][c] > minReference)
+                errors.push_back(std::abs(double(tested[i][c])-reference[i][c])/reference[i][c]);
+        }
+    }
+    return errors;
+}
+
+std::ostream& operator<<(std::ostream& os, ErrorStatistics const& stats)
+{
+    return os << "mean " << stats.mean << ", 99th percentile " << stats.percentile99 << ", max " << stats.max;
+}
@@ -0,0 +1,29 @@
+#ifndef INCLUDE_ONCE_DBCB8E09_7C57_4F88_92FE_D9FE9898D7DB
+#define INCLUDE_ONCE_DBCB8E09_7C57_4F88_92FE_D9FE9898D7DB
+
+#include <vector>
+#include <cstddef>
+#include <ostream>
+#include <glm/glm.hpp>
+
+// Statistics of errors of approximations with respect to reference data, as reported by the debug checks of CalcMySky
+// and ShowMySky. The 99th percentile is the main figure: the maximum is often dominated by a few samples near the
+// horizon, where the computed functions are nearly discontinuous.
+struct ErrorStatistics
+{
+    size_t count=0; // number of the errors; the other members are zero if it's zero
+    double mean=0;
+    double percentile99=0;
+    double max=0;
+};
+
+// Reorders the errors
+ErrorStatistics computeErrorStatistics(std::vector<double>& errors);
+// Relative errors of the components of the tested data with respect to the reference. The components of the reference
+// much smaller than its maximum don't affect the results, but would dominate the statistics, so they are skipped.
+std::vector<double> relativeComponentErrors(std::vector<glm::vec4> const& reference, std::vector<glm::vec4> const& tested);
+
+// Prints "mean X, 99th percentile Y, max Z"
+std::ostream& operator<<(std::ostream& os, ErrorStatistics const& stats);
+
+#endif
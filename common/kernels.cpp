@@ -0,0 +1,168 @@
+#include "kernels.hpp"
+
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define KERNELS_USE_SSE2
+#endif
+
+static_assert(sizeof(glm::vec4) == 4*sizeof(float));
+
+namespace
+{
+
+// Smaller arrays are processed by the calling thread: starting the threads would take longer than the work
+constexpr size_t minFloatsPerThread = 1u<<20;
+
+// Calls process(begin, end) for contiguous ranges that cover [0, count), in parallel if count is large. Each range
+// except the last one has a multiple of 4 elements, so that vectors of 4 floats don't straddle the ranges.
+template<typename Process>
+void forEachRange(const size_t count, const size_t floatsPerElement, Process const& process)
+{
+    const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t threadCount = std::clamp<size_t>(count*floatsPerElement/minFloatsPerThread, 1, maxThreads);
+    if(threadCount==1)
+    {
+        process(size_t(0), count);
+        return;
+    }
+
+    const size_t rangeSize = (count/threadCount+3) & ~size_t(3);
+    std::vector<std::thread> threads;
+    for(size_t begin=rangeSize; begin<count; begin+=rangeSize)
+        threads.emplace_back(process, begin, std::min(begin+rangeSize, count));
+    process(size_t(0), std::min(rangeSize, count));
+    for(auto& thread : threads)
+        thread.join();
+}
+
+#ifdef KERNELS_USE_SSE2
+template<int component>
+__m128 broadcast(const __m128 v)
+{
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(component,component,component,component));
+}
+
+struct Matrix
+{
+    __m128 columns[4];
+    explicit Matrix(glm::mat4 const& m)
+    {
+        for(int i=0; i<4; ++i)
+            columns[i]=_mm_loadu_ps(&m[i][0]);
+    }
+    // Same order of operations as in glm's operator*(mat4, vec4)
+    __m128 operator*(const __m128 v) const
+    {
+        const __m128 sum01=_mm_add_ps(_mm_mul_ps(columns[0], broadcast<0>(v)), _mm_mul_ps(columns[1], broadcast<1>(v)));
+        const __m128 sum23=_mm_add_ps(_mm_mul_ps(columns[2], broadcast<2>(v)), _mm_mul_ps(columns[3], broadcast<3>(v)));
+        return _mm_add_ps(sum01, sum23);
+    }
+};
+#endif
+
+}
+
+void transformVectors(glm::mat4 const& matrix, glm::vec4*const data, const size_t count)
+{
+    forEachRange(count, 4, [&](const size_t begin, const size_t end)
+    {
+#ifdef KERNELS_USE_SSE2
+        const Matrix m(matrix);
+        for(size_t i=begin; i<end; ++i)
+            _mm_storeu_ps(&data[i][0], m*_mm_loadu_ps(&data[i][0]));
+#else
+        for(size_t i=begin; i<end; ++i)
+            data[i] = matrix*data[i];
+#endif
+    });
+}
+
+void accumulateTransformedVectors(glm::mat4 const& matrix, glm::vec4 const*const src, glm::vec4*const accum, const size_t count)
+{
+    forEachRange(count, 4, [&](const size_t begin, const size_t end)
+    {
+#ifdef KERNELS_USE_SSE2
+        const Matrix m(matrix);
+        for(size_t i=begin; i<end; ++i)
+        {
+            const __m128 product=m*_mm_loadu_ps(&src[i][0]);
+            _mm_storeu_ps(&accum[i][0], _mm_add_ps(_mm_loadu_ps(&accum[i][0]), product));
+        }
+#else
+        for(size_t i=begin; i<end; ++i)
+            accum[i] += matrix*src[i];
+#endif
+    });
+}
+
+void lerpVectors(glm::vec4 const*const a, glm::vec4 const*const b, const float t, glm::vec4*const out, const size_t count)
+{
+    forEachRange(count, 4, [&](const size_t begin, const size_t end)
+    {
+#ifdef KERNELS_USE_SSE2
+        const __m128 tt=_mm_set1_ps(t);
+        for(size_t i=begin; i<end; ++i)
+        {
+            const __m128 va=_mm_loadu_ps(&a[i][0]);
+            const __m128 vb=_mm_loadu_ps(&b[i][0]);
+            _mm_storeu_ps(&out[i][0], _mm_add_ps(va, _mm_mul_ps(tt, _mm_sub_ps(vb, va))));
+        }
+#else
+        for(size_t i=begin; i<end; ++i)
+            out[i] = a[i] + t*(b[i]-a[i]);
+#endif
+    });
+}
+
+void maskFloatBits(float*const data, const size_t count, const uint32_t mask)
+{
+    forEachRange(count, 1, [&](const size_t begin, const size_t end)
+    {
+        size_t i=begin;
+#ifdef KERNELS_USE_SSE2
+        const __m128i m=_mm_set1_epi32(mask);
+        for(; i+4<=end; i+=4)
+        {
+            const __m128i x=_mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data+i), _mm_and_si128(x, m));
+        }
+#endif
+        for(; i<end; ++i)
+        {
+            uint32_t x;
+            std::memcpy(&x, &data[i], sizeof x);
+            x &= mask;
+            std::memcpy(&data[i], &x, sizeof x);
+        }
+    });
+}
+
+size_t countNaNs(float const*const data, const size_t count)
+{
+    std::atomic<size_t> total{0};
+    forEachRange(count, 1, [&](const size_t begin, const size_t end)
+    {
+        size_t n=0;
+        size_t i=begin;
+#ifdef KERNELS_USE_SSE2
+        // Number of set bits in each 4-bit mask
+        static constexpr unsigned char bitCounts[16]={0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4};
+        for(; i+4<=end; i+=4)
+        {
+            const __m128 x=_mm_loadu_ps(data+i);
+            n += bitCounts[_mm_movemask_ps(_mm_cmpunord_ps(x, x))];
+        }
+#endif
+        for(; i<end; ++i)
+            n += std::isnan(data[i]);
+        // Only once per range, so the threads don't contend for the counter
+        total += n;
+    });
+    return total;
+}
@@ -0,0 +1,22 @@
+#ifndef INCLUDE_ONCE_708BC21C_E1A0_4A57_B523_3C8E9AAB0C88
+#define INCLUDE_ONCE_708BC21C_E1A0_4A57_B523_3C8E9AAB0C88
+
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Streaming kernels for the passes over whole textures in host memory. They use SSE2 where available, and split
+// arrays larger than a few megabytes between all the CPU cores. The arithmetic is done in the same order as in glm, so
+// the results match those of the scalar loops. The arrays needn't be aligned, but mustn't overlap except as noted.
+
+// data[i] = matrix * data[i]
+void transformVectors(glm::mat4 const& matrix, glm::vec4* data, size_t count);
+// accum[i] += matrix * src[i]
+void accumulateTransformedVectors(glm::mat4 const& matrix, glm::vec4 const* src, glm::vec4* accum, size_t count);
+// out[i] = a[i] + t*(b[i]-a[i]); out may coincide with a or b
+void lerpVectors(glm::vec4 const* a, glm::vec4 const* b, float t, glm::vec4* out, size_t count);
+// Replaces each float with the float whose bits are its bits ANDed with the mask
+void maskFloatBits(float* data, size_t count, uint32_t mask);
+size_t countNaNs(float const* data, size_t count);
+
+#endif
@@ -32,6 +32,55 @@ inline PhaseFunctionType parsePhaseFunctionType(QString const& type, QString con
     throw ParsingError(filename, lineNumber, QObject::tr("bad phase function type %1").arg(type));
 }
 
+enum class AngularIntegrationScheme
+{
+    Uniform,    //!< Quasi-uniform spherical Fibonacci lattice
+    Importance, //!< Directions concentrated near the horizon and in the forward scattering peaks around view and Sun directions
+};
+
+inline QString toString(AngularIntegrationScheme scheme)
+{
+    switch(scheme)
+    {
+    case AngularIntegrationScheme::Uniform:    return "uniform";
+    case AngularIntegrationScheme::Importance: return "importance";
+    }
+    return QString("bad scheme %1").arg(static_cast<int>(scheme));
+}
+
+inline AngularIntegrationScheme parseAngularIntegrationScheme(QString const& scheme, QString const& filename, const int lineNumber)
+{
+    if(scheme=="uniform")    return AngularIntegrationScheme::Uniform;
+    if(scheme=="importance") return AngularIntegrationScheme::Importance;
+    throw ParsingError(filename, lineNumber, QObject::tr("bad angular integration scheme %1").arg(scheme));
+}
+
+enum class QuadratureScheme
+{
+    Midpoint,        //!< Composite midpoint rule on equal intervals
+    AltitudeAdapted, //!< Midpoint rule on intervals growing away from the lowest point of the ray
+    GaussLegendre,   //!< Composite Gauss-Legendre rule on equal panels
+};
+
+inline QString toString(QuadratureScheme scheme)
+{
+    switch(scheme)
+    {
+    case QuadratureScheme::Midpoint:        return "midpoint";
+    case QuadratureScheme::AltitudeAdapted: return "altitude-adapted";
+    case QuadratureScheme::GaussLegendre:   return "gauss-legendre";
+    }
+    return QString("bad scheme %1").arg(static_cast<int>(scheme));
+}
+
+inline QuadratureScheme parseQuadratureScheme(QString const& scheme, QString const& filename, const int lineNumber)
+{
+    if(scheme=="midpoint")         return QuadratureScheme::Midpoint;
+    if(scheme=="altitude-adapted") return QuadratureScheme::AltitudeAdapted;
+    if(scheme=="gauss-legendre")   return QuadratureScheme::GaussLegendre;
+    throw ParsingError(filename, lineNumber, QObject::tr("bad quadrature scheme %1").arg(scheme));
+}
+
 enum SingleScatteringRenderMode
 {
     SSRM_ON_THE_FLY,
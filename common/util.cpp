@@ -2,6 +2,7 @@
 #include <cstring>
 #include <qopengl.h>
 #include "../common/cie-xyzw-functions.hpp"
+#include "../common/kernels.hpp"
 
 std::string openglErrorString(const GLenum error)
 {
@@ -85,21 +86,14 @@ glm::mat4 radianceToLuminance(const unsigned texIndex, std::vector<glm::vec4> co
                                       wavelengthToXYZW(allWavelengths[texIndex][3])) * dlambda;
 }
 
-void roundTexData(GLfloat*const data, const size_t size, const int bitsOfPrecision)
+uint32_t texDataRoundingMask(const int bitsOfPrecision)
 {
-    using Float = GLfloat;
-    using FloatAsInt = uint32_t;
-    static_assert(sizeof(FloatAsInt) == sizeof(Float));
-    constexpr unsigned maxPrecision = std::numeric_limits<Float>::digits;
-
-    const FloatAsInt mask = ~((1u << (maxPrecision - bitsOfPrecision)) - 1);
-    std::cerr << "mask: 0x" << std::hex << mask << std::dec << " ... ";
+    constexpr unsigned maxPrecision = std::numeric_limits<GLfloat>::digits;
+    return ~((1u << (maxPrecision - bitsOfPrecision)) - 1);
+}
 
-    for(size_t i = 0; i < size; ++i)
-    {
-        uint32_t x;
-        std::memcpy(&x, &data[i], sizeof x);
-        x &= mask;
-        std::memcpy(&data[i], &x, sizeof x);
-    }
+void roundTexData(GLfloat*const data, const size_t size, const int bitsOfPrecision)
+{
+    static_assert(sizeof(GLfloat) == sizeof(float));
+    maskFloatBits(data, size, texDataRoundingMask(bitsOfPrecision));
 }
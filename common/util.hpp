@@ -133,6 +133,8 @@ Number clampCosine(const Number x)
 
 glm::mat4 radianceToLuminance(unsigned texIndex, std::vector<glm::vec4> const& allWavelengths);
 
+// Returns the mask that roundTexData() applies to the bits of each float.
+uint32_t texDataRoundingMask(int precision);
 // Rounds each float to \p precision bits.
 void roundTexData(GLfloat* data, size_t size, int precision);
 
@@ -5,6 +5,8 @@
 #include "texture-coordinates.h.glsl"
 #include "texture-sampling-functions.h.glsl"
 #include "total-scattering-coefficient.h.glsl"
+#include "scattering-density-integration.h.glsl"
+#include "radial-quadrature.h.glsl"
 
 uniform sampler3D scatteringDensityTexture;
 
@@ -18,20 +20,18 @@ vec4 computeScatteringDensity(const float cosSunZenithAngle, const float cosView
     CONST float sunDirY = sqrt(max(1-sqr(sunDirX)-sqr(cosSunZenithAngle), 0));
     CONST vec3 sunDir=vec3(sunDirX, sunDirY, sunDirZ);
 
-    // XXX: Might be a good idea to increase sampling density near horizon and decrease near zenith&nadir.
-    // XXX: Also sampling should be more dense near the light source, since there often is a strong forward
-    //       scattering peak like that of Mie phase functions.
-    // TODO:At the very least, the phase functions should be lowpass-filtered to avoid aliasing, before
-    //       sampling them here.
-
-    CONST float dSolidAngle = sphereIntegrationSolidAngleDifferential(angularIntegrationPoints);
+    // The set of directions depends on the angular integration scheme selected in the atmosphere description,
+    // see scatteringDensityIntegrationSample().
+    // TODO:The phase functions should be lowpass-filtered to avoid aliasing, before sampling them here.
 
     vec4 scatteringDensity = vec4(0);
     // Iterate over all incident directions
-    for(int k=0; k<angularIntegrationPoints; ++k)
+    for(int k=0; k<scatteringDensityIntegrationPoints; ++k)
     {
+        CONST vec4 incDirAndSolidAngle = scatteringDensityIntegrationSample(k, viewDir, sunDir);
         // Direction to the source of incident ray
-        CONST vec3 incDir = sphereIntegrationSampleDir(k, angularIntegrationPoints);
+        CONST vec3 incDir = incDirAndSolidAngle.xyz;
+        CONST float dSolidAngle = incDirAndSolidAngle.w;
         CONST float cosIncZenithAngle=incDir.z;
 
         CONST bool incRayIntersectsGround=rayIntersectsGround(cosIncZenithAngle, altitude);
@@ -77,13 +77,14 @@ vec4 computeMultipleScattering(const float cosSunZenithAngle, const float cosVie
                                const float altitude, const bool viewRayIntersectsGround)
 {
     CONST float r=earthRadius+altitude;
-    // Using the midpoint rule for quadrature
-    CONST float dl = distanceToNearestAtmosphereBoundary(cosViewZenithAngle, altitude, viewRayIntersectsGround) /
-                                                  radialIntegrationPoints;
+    CONST RayQuadrature quadrature=radialQuadratureInit(distanceToNearestAtmosphereBoundary(cosViewZenithAngle, altitude,
+                                                                                            viewRayIntersectsGround),
+                                                        cosViewZenithAngle, altitude);
     vec4 radiance=vec4(0);
-    for(int n=0; n<radialIntegrationPoints; ++n)
+    for(int n=0; n<radialQuadraturePoints; ++n)
     {
-        CONST float dist=(n+0.5)*dl;
+        CONST vec2 distAndWeight=radialQuadratureSample(quadrature, n);
+        CONST float dist=distAndWeight.x;
         // Clamping only guards against rounding errors here, we don't try to handle here the case when the
         // endpoint of the view ray intentionally appears in outer space.
         CONST float altAtDist=clampAltitude(sqrt(sqr(dist)+sqr(r)+2*r*dist*cosViewZenithAngle)-earthRadius);
@@ -93,7 +94,7 @@ vec4 computeMultipleScattering(const float cosSunZenithAngle, const float cosVie
         CONST vec4 scDensity=sample4DTexture(scatteringDensityTexture, cosSZAatDist, cosVZAatDist,
                                              dotViewSun, altAtDist, viewRayIntersectsGround);
         CONST vec4 xmittance=transmittance(cosViewZenithAngle, altitude, dist, viewRayIntersectsGround);
-        radiance += scDensity*xmittance*dl;
+        radiance += scDensity*xmittance*distAndWeight.y;
     }
     return radiance;
 }
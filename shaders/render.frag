@@ -1,6 +1,6 @@
 #version 330
 
-#definitions (RENDERING_ANY_ECLIPSED_SINGLE_SCATTERING, RENDERING_ANY_LIGHT_POLLUTION, RENDERING_ANY_NORMAL_SINGLE_SCATTERING, RENDERING_ANY_SINGLE_SCATTERING, RENDERING_ANY_ZERO_SCATTERING, RENDERING_ECLIPSED_DOUBLE_SCATTERING_PRECOMPUTED_LUMINANCE, RENDERING_ECLIPSED_DOUBLE_SCATTERING_PRECOMPUTED_RADIANCE, RENDERING_ECLIPSED_SINGLE_SCATTERING_ON_THE_FLY, RENDERING_ECLIPSED_SINGLE_SCATTERING_PRECOMPUTED_LUMINANCE, RENDERING_ECLIPSED_SINGLE_SCATTERING_PRECOMPUTED_RADIANCE, RENDERING_ECLIPSED_ZERO_SCATTERING, RENDERING_LIGHT_POLLUTION_LUMINANCE, RENDERING_LIGHT_POLLUTION_RADIANCE, RENDERING_MULTIPLE_SCATTERING_LUMINANCE, RENDERING_MULTIPLE_SCATTERING_RADIANCE, RENDERING_SINGLE_SCATTERING_ON_THE_FLY, RENDERING_SINGLE_SCATTERING_PRECOMPUTED_LUMINANCE, RENDERING_SINGLE_SCATTERING_PRECOMPUTED_RADIANCE, RENDERING_ZERO_SCATTERING)
+#definitions (RENDERING_ANY_ECLIPSED_SINGLE_SCATTERING, RENDERING_ANY_LIGHT_POLLUTION, RENDERING_ANY_NORMAL_SINGLE_SCATTERING, RENDERING_ANY_SINGLE_SCATTERING, RENDERING_ANY_ZERO_SCATTERING, RENDERING_ECLIPSED_DOUBLE_SCATTERING_PRECOMPUTED_LUMINANCE, RENDERING_ECLIPSED_DOUBLE_SCATTERING_PRECOMPUTED_RADIANCE, RENDERING_ECLIPSED_SINGLE_SCATTERING_ON_THE_FLY, RENDERING_ECLIPSED_SINGLE_SCATTERING_PRECOMPUTED_LUMINANCE, RENDERING_ECLIPSED_SINGLE_SCATTERING_PRECOMPUTED_RADIANCE, RENDERING_ECLIPSED_ZERO_SCATTERING, RENDERING_LIGHT_POLLUTION_LUMINANCE, RENDERING_LIGHT_POLLUTION_RADIANCE, RENDERING_MULTIPLE_SCATTERING_LUMINANCE, RENDERING_MULTIPLE_SCATTERING_RADIANCE, RENDERING_MULTIPLE_SCATTERING_RADIANCE_MRT, RENDERING_SINGLE_SCATTERING_ON_THE_FLY, RENDERING_SINGLE_SCATTERING_PRECOMPUTED_LUMINANCE, RENDERING_SINGLE_SCATTERING_PRECOMPUTED_RADIANCE, RENDERING_ZERO_SCATTERING)
 
 #include "version.h.glsl"
 #include "const.h.glsl"
@@ -18,18 +18,46 @@
 uniform sampler3D scatteringTextureInterpolationGuides01;
 uniform sampler3D scatteringTextureInterpolationGuides02;
 uniform sampler3D scatteringTexture;
+#ifdef WLSET_UNIFORM_INDEX
+// Layers of the array are the wavelength sets
+uniform sampler2DArray eclipsedScatteringTexture;
+# define ECLIPSED_SCATTERING_TEXCOORDS(texCoords) vec3(texCoords, wlSetIndex)
+#else
 uniform sampler2D eclipsedScatteringTexture;
+# define ECLIPSED_SCATTERING_TEXCOORDS(texCoords) (texCoords)
+#endif
 uniform sampler3D eclipsedDoubleScatteringTexture;
-uniform vec3 cameraPosition;
-uniform vec3 sunDirection;
-uniform vec3 moonPosition;
-uniform float lightPollutionGroundLuminance;
-uniform vec4 solarIrradianceFixup=vec4(1); // Used when we want to alter solar irradiance post-precomputation
-uniform bool pseudoMirrorSkyBelowHorizon = false;
+// Values shared by all the rendering programs, updated once per frame.
+// XXX: keep in sync with AtmosphereRenderer::PerFrameUniforms
+layout(std140) uniform PerFrameUniforms
+{
+    vec3 cameraPosition;
+    vec3 sunDirection;
+    vec3 moonPosition;
+    float lightPollutionGroundLuminance;
+    bool pseudoMirrorSkyBelowHorizon;
+};
+// Used when we want to alter solar irradiance post-precomputation
+layout(std140) uniform PerWavelengthSetUniforms
+{
+    vec4 solarIrradianceFixups[wlSetCount];
+};
+#define solarIrradianceFixup solarIrradianceFixups[wlSetIndex]
 uniform bool useInterpolationGuides=false;
 in vec3 position;
 layout(location=0) out vec4 luminance;
+#if RENDERING_MULTIPLE_SCATTERING_RADIANCE_MRT
+// Several wavelength sets are rendered in a single pass, each into its own color attachment.
+// XXX: keep in sync with AtmosphereRenderer::maxWLSetsPerPass
+#define MAX_WL_SETS_PER_PASS 7
+uniform sampler3D scatteringTextures[MAX_WL_SETS_PER_PASS];
+uniform mat4 radianceToLuminances[MAX_WL_SETS_PER_PASS];
+uniform int firstWLSetIndexInPass;
+uniform int wlSetsInPass;
+layout(location=1) out vec4 radianceOutputs[MAX_WL_SETS_PER_PASS];
+#else
 layout(location=1) out vec4 radianceOutput;
+#endif
 
 vec4 solarRadiance()
 {
@@ -70,7 +98,12 @@ void main()
             lookingIntoAtmosphere=false;
 #else
             luminance=vec4(0);
+#if RENDERING_MULTIPLE_SCATTERING_RADIANCE_MRT
+            for(int i=0; i<MAX_WL_SETS_PER_PASS; ++i)
+                radianceOutputs[i]=vec4(0);
+#else
             radianceOutput=vec4(0);
+#endif
             return;
 #endif
         }
@@ -221,7 +254,7 @@ void main()
     // an artifact at the point where azimuth texture coordinate changes from 1 to 0 (at azimuthRelativeToSun crossing
     // 0). This happens when I simply call texture(eclipsedScatteringTexture, texCoords) without specifying LOD.
     // Apparently, the driver uses the derivative for some reason, even though it shouldn't.
-    CONST vec4 scattering = textureLod(eclipsedScatteringTexture, texCoords, 0);
+    CONST vec4 scattering = textureLod(eclipsedScatteringTexture, ECLIPSED_SCATTERING_TEXCOORDS(texCoords), 0);
     vec4 radiance=scattering*phaseFuncValue;
     radiance*=solarIrradianceFixup;
     luminance=radianceToLuminance*radiance;
@@ -291,6 +324,26 @@ void main()
     radiance*=solarIrradianceFixup;
     luminance=radianceToLuminance*radiance;
     radianceOutput=radiance;
+#elif RENDERING_MULTIPLE_SCATTERING_RADIANCE_MRT
+    // Samplers in arrays can only be indexed by constant expressions, hence the unrolled sampling
+    vec4 radiances[MAX_WL_SETS_PER_PASS];
+    for(int i=0; i<MAX_WL_SETS_PER_PASS; ++i)
+        radiances[i]=vec4(0);
+    if(wlSetsInPass>0) radiances[0]=sample3DTexture(scatteringTextures[0], cosSunZenithAngle, cosViewZenithAngle, dotViewSun, altitude, viewRayIntersectsGround);
+    if(wlSetsInPass>1) radiances[1]=sample3DTexture(scatteringTextures[1], cosSunZenithAngle, cosViewZenithAngle, dotViewSun, altitude, viewRayIntersectsGround);
+    if(wlSetsInPass>2) radiances[2]=sample3DTexture(scatteringTextures[2], cosSunZenithAngle, cosViewZenithAngle, dotViewSun, altitude, viewRayIntersectsGround);
+    if(wlSetsInPass>3) radiances[3]=sample3DTexture(scatteringTextures[3], cosSunZenithAngle, cosViewZenithAngle, dotViewSun, altitude, viewRayIntersectsGround);
+    if(wlSetsInPass>4) radiances[4]=sample3DTexture(scatteringTextures[4], cosSunZenithAngle, cosViewZenithAngle, dotViewSun, altitude, viewRayIntersectsGround);
+    if(wlSetsInPass>5) radiances[5]=sample3DTexture(scatteringTextures[5], cosSunZenithAngle, cosViewZenithAngle, dotViewSun, altitude, viewRayIntersectsGround);
+    if(wlSetsInPass>6) radiances[6]=sample3DTexture(scatteringTextures[6], cosSunZenithAngle, cosViewZenithAngle, dotViewSun, altitude, viewRayIntersectsGround);
+    luminance=vec4(0);
+    for(int i=0; i<wlSetsInPass; ++i)
+    {
+        radiances[i]*=solarIrradianceFixups[firstWLSetIndexInPass+i];
+        luminance+=radianceToLuminances[i]*radiances[i];
+    }
+    for(int i=0; i<MAX_WL_SETS_PER_PASS; ++i)
+        radianceOutputs[i]=radiances[i];
 #elif RENDERING_LIGHT_POLLUTION_RADIANCE
     vec4 radiance=lightPollutionGroundLuminance*lightPollutionScattering(altitude, cosViewZenithAngle, viewRayIntersectsGround);
     luminance=radianceToLuminance*radiance;
@@ -4,6 +4,7 @@
 #include "common-functions.h.glsl"
 #include "texture-sampling-functions.h.glsl"
 #include "total-scattering-coefficient.h.glsl"
+#include "radial-quadrature.h.glsl"
 
 // This function omits ground luminance: it is to be applied somewhere in the calling code.
 vec4 computeSingleScatteringForLightPollutionIntegrand(const float cosViewZenithAngle, const float altitude,
@@ -47,13 +48,14 @@ vec4 computeSingleScatteringForLightPollution(const float cosViewZenithAngle, co
 {
     CONST float integrInterval=distanceToNearestAtmosphereBoundary(cosViewZenithAngle, altitude, viewRayIntersectsGround);
 
-    // Using the midpoint rule for quadrature
     vec4 spectrum=vec4(0);
-    CONST float dl=integrInterval/radialIntegrationPoints;
-    for(int n=0; n<radialIntegrationPoints; ++n)
+    CONST RayQuadrature quadrature=radialQuadratureInit(integrInterval, cosViewZenithAngle, altitude);
+    for(int n=0; n<radialQuadraturePoints; ++n)
     {
-        CONST float dist=(n+0.5)*dl;
-        spectrum += computeSingleScatteringForLightPollutionIntegrand(cosViewZenithAngle, altitude, dist, viewRayIntersectsGround);
+        CONST vec2 distAndWeight=radialQuadratureSample(quadrature, n);
+        spectrum += distAndWeight.y*computeSingleScatteringForLightPollutionIntegrand(cosViewZenithAngle, altitude,
+                                                                                      distAndWeight.x,
+                                                                                      viewRayIntersectsGround);
     }
-    return spectrum*dl*lightPollutionRelativeRadiance;
+    return spectrum*lightPollutionRelativeRadiance;
 }
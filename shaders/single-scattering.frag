@@ -5,6 +5,7 @@
 #include "common-functions.h.glsl"
 #include "single-scattering.h.glsl"
 #include "texture-sampling-functions.h.glsl"
+#include "radial-quadrature.h.glsl"
 
 // This function omits phase function and solar irradiance: these are to be applied somewhere in the calling code.
 vec4 computeSingleScatteringIntegrand(const float cosSunZenithAngle, const float cosViewZenithAngle,
@@ -31,15 +32,14 @@ vec4 computeSingleScattering(const float cosSunZenithAngle, const float cosViewZ
 {
     CONST float integrInterval=distanceToNearestAtmosphereBoundary(cosViewZenithAngle, altitude,
                                                                    viewRayIntersectsGround);
-    // Using the midpoint rule for quadrature
     vec4 spectrum=vec4(0);
-    CONST float dl=integrInterval/radialIntegrationPoints;
-    for(int n=0; n<radialIntegrationPoints; ++n)
+    CONST RayQuadrature quadrature=radialQuadratureInit(integrInterval, cosViewZenithAngle, altitude);
+    for(int n=0; n<radialQuadraturePoints; ++n)
     {
-        CONST float dist=(n+0.5)*dl;
-        spectrum += computeSingleScatteringIntegrand(cosSunZenithAngle, cosViewZenithAngle, dotViewSun,
-                                                     altitude, dist, viewRayIntersectsGround);
+        CONST vec2 distAndWeight=radialQuadratureSample(quadrature, n);
+        spectrum += distAndWeight.y*computeSingleScatteringIntegrand(cosSunZenithAngle, cosViewZenithAngle, dotViewSun,
+                                                                     altitude, distAndWeight.x, viewRayIntersectsGround);
     }
-    spectrum *= dl*solarIrradianceAtTOA*scatteringCrossSection();
+    spectrum *= solarIrradianceAtTOA*scatteringCrossSection();
     return spectrum;
 }
@@ -6,9 +6,29 @@
 
 const float LENGTH_OF_HORIZ_RAY_FROM_GROUND_TO_TOA=sqrt(atmosphereHeight*(atmosphereHeight+2*earthRadius));
 
+#ifdef WLSET_TEXTURE_ARRAYS
+uniform sampler2DArray transmittanceTexture;
+#else
 uniform sampler2D transmittanceTexture;
+#endif
 uniform vec3 eclipsedDoubleScatteringTextureSize;
 
+#ifdef WLSET_UNIFORM_INDEX
+// The 3D textures of all the wavelength sets are stacked along depth, and wlSetIndex selects the set. Depth coordinate
+// is clamped to the centers of the outermost texels of the set, so that filtering doesn't mix in the neighboring sets.
+vec3 wlSetTexCoords3D(const sampler3D tex, const vec3 coords)
+{
+    CONST float depth=float(textureSize(tex,0).z)/wlSetCount;
+    CONST float z=clamp(coords.z, 0.5/depth, 1-0.5/depth);
+    return vec3(coords.xy, (wlSetIndex+z)/wlSetCount);
+}
+#else
+vec3 wlSetTexCoords3D(const sampler3D tex, const vec3 coords)
+{
+    return coords;
+}
+#endif
+
 struct Scattering4DCoords
 {
     float cosSunZenithAngle;
@@ -252,7 +272,7 @@ vec3 scattering4DCoordsToTex3DCoords(const Scattering4DCoords coords)
 // Sample interpolation guides texture at the given coordinate
 float sampleGuide(const sampler3D guides, const vec3 coords)
 {
-    return texture(guides, coords).r;
+    return texture(guides, wlSetTexCoords3D(guides, coords)).r;
 }
 float findGuide01Angle(const sampler3D guides, const vec3 indices)
 {
@@ -317,8 +337,8 @@ vec4 sample3DTextureGuided01_log(const sampler3D tex, const sampler3D interpolat
     CONST vec3 coordsNextRow = indicesToTexCoords(indicesNextRow, scatteringTextureSize.stp);
     CONST vec3 coordsCurrRow = indicesToTexCoords(indicesCurrRow, scatteringTextureSize.stp);
 
-    CONST vec4 valueCurrRow = texture(tex, coordsCurrRow);
-    CONST vec4 valueNextRow = texture(tex, coordsNextRow);
+    CONST vec4 valueCurrRow = texture(tex, wlSetTexCoords3D(tex, coordsCurrRow));
+    CONST vec4 valueNextRow = texture(tex, wlSetTexCoords3D(tex, coordsNextRow));
     CONST float epsilon = 1e-37; // Prevents passing zero to log
     CONST vec4 logValNextRow = log(max(valueNextRow, vec4(epsilon)));
     CONST vec4 logValCurrRow = log(max(valueCurrRow, vec4(epsilon)));
@@ -402,7 +422,7 @@ vec4 sample3DTexture(const sampler3D tex, const float cosSunZenithAngle, const f
     CONST Scattering4DCoords coords4d = scatteringTexVarsTo4DCoords(cosSunZenithAngle,cosViewZenithAngle,
                                                                     dotViewSun,altitude,viewRayIntersectsGround);
     CONST vec3 texCoords=scattering4DCoordsToTex3DCoords(coords4d);
-    return texture(tex, texCoords);
+    return texture(tex, wlSetTexCoords3D(tex, texCoords));
 }
 
 ScatteringTexVars scatteringTex4DCoordsToTexVars(const Scattering4DCoords coords)
@@ -5,18 +5,30 @@
 #include "common-functions.h.glsl"
 #include "texture-coordinates.h.glsl"
 
+#ifdef WLSET_TEXTURE_ARRAYS
+// The renderer may keep textures of all wavelength sets as layers of a single array texture
+uniform sampler2DArray transmittanceTexture;
+uniform sampler2DArray irradianceTexture;
+# define WLSET_TEXCOORDS(texCoords) vec3(texCoords, wlSetIndex)
+#else
 uniform sampler2D transmittanceTexture;
 uniform sampler2D irradianceTexture;
+# define WLSET_TEXCOORDS(texCoords) (texCoords)
+#endif
 
 uniform sampler3D firstScatteringTexture;
 uniform sampler3D multipleScatteringTexture;
 
+#ifdef WLSET_TEXTURE_ARRAYS
+uniform sampler2DArray lightPollutionScatteringTexture;
+#else
 uniform sampler2D lightPollutionScatteringTexture;
+#endif
 
 vec4 irradiance(const float cosSunZenithAngle, const float altitude)
 {
     CONST vec2 texCoords=irradianceTexVarsToTexCoord(cosSunZenithAngle, altitude);
-    return texture(irradianceTexture, texCoords);
+    return texture(irradianceTexture, WLSET_TEXCOORDS(texCoords));
 }
 
 vec4 opticalDepthToAtmosphereBorder(const float cosViewZenithAngle, const float altitude)
@@ -27,7 +39,7 @@ vec4 opticalDepthToAtmosphereBorder(const float cosViewZenithAngle, const float
     // transmittance texture for altitude being 4096). This happens when I simply call texture(eclipsedScatteringTexture,
     // texCoords) without specifying LOD.
     // Apparently, the driver uses the derivative for some reason, even though it shouldn't.
-    return textureLod(transmittanceTexture, texCoords, 0);
+    return textureLod(transmittanceTexture, WLSET_TEXCOORDS(texCoords), 0);
 }
 
 vec4 transmittanceToAtmosphereBorder(const float cosViewZenithAngle, const float altitude)
@@ -82,5 +94,5 @@ vec4 scattering(const float cosSunZenithAngle, const float cosViewZenithAngle,
 vec4 lightPollutionScattering(const float altitude, const float cosViewZenithAngle, const bool viewRayIntersectsGround)
 {
     CONST vec2 coords = lightPollutionTexVarsToTexCoords(altitude, cosViewZenithAngle, viewRayIntersectsGround);
-    return texture(lightPollutionScatteringTexture, coords);
+    return texture(lightPollutionScatteringTexture, WLSET_TEXCOORDS(coords));
 }
@@ -0,0 +1,31 @@
+# Computes the reference model with calcmysky, renders the reference scene with showmysky-batch and has it compare the
+# radiance of each frame with that of the CPU sky radiance query. Fails if the 99th percentile of the relative
+# difference exceeds TOLERANCE in any frame.
+#
+#   cmake -DCALCMYSKY=... -DSHOWMYSKY_BATCH=... -DATMOSPHERE=... -DFRAMES=... -DWORK_DIR=... -DTOLERANCE=... -P check.cmake
+foreach(var CALCMYSKY SHOWMYSKY_BATCH ATMOSPHERE FRAMES WORK_DIR TOLERANCE)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} must be defined")
+    endif()
+endforeach()
+
+# Software rendering makes the results independent of GPU drivers, and lets the check run on machines without a GPU
+set(ENV{LIBGL_ALWAYS_SOFTWARE} 1)
+set(ENV{GALLIUM_DRIVER} llvmpipe)
+
+set(modelDir "${WORK_DIR}/model")
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${modelDir}")
+
+execute_process(COMMAND "${CALCMYSKY}" "${ATMOSPHERE}" --radiance --out-dir "${modelDir}"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "calcmysky failed: ${result}")
+endif()
+
+execute_process(COMMAND "${SHOWMYSKY_BATCH}" --cpu-check-tolerance "${TOLERANCE}" "${modelDir}" "${FRAMES}"
+                WORKING_DIRECTORY "${WORK_DIR}"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "GPU and CPU radiance differ more than allowed, or showmysky-batch failed: ${result}")
+endif()
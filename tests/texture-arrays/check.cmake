@@ -0,0 +1,42 @@
+# Computes the luminance-only model with calcmysky, renders the scene with showmysky-batch with separate per-wavelength-set
+# textures, then with texture arrays, and has the latter run compare its luminance with the former. Fails if the 99th
+# percentile of the relative error exceeds TOLERANCE in any frame.
+#
+#   cmake -DCALCMYSKY=... -DSHOWMYSKY_BATCH=... -DATMOSPHERE=... -DFRAMES=... -DWORK_DIR=... -DTOLERANCE=... -P check.cmake
+foreach(var CALCMYSKY SHOWMYSKY_BATCH ATMOSPHERE FRAMES WORK_DIR TOLERANCE)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} must be defined")
+    endif()
+endforeach()
+
+# Software rendering makes the results independent of GPU drivers, and lets the check run on machines without a GPU
+set(ENV{LIBGL_ALWAYS_SOFTWARE} 1)
+set(ENV{GALLIUM_DRIVER} llvmpipe)
+
+set(modelDir "${WORK_DIR}/model")
+set(separateDir "${WORK_DIR}/separate")
+set(arraysDir "${WORK_DIR}/arrays")
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${modelDir}" "${separateDir}" "${arraysDir}")
+
+# Without --radiance: luminance data are the default output
+execute_process(COMMAND "${CALCMYSKY}" "${ATMOSPHERE}" --out-dir "${modelDir}"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "calcmysky failed: ${result}")
+endif()
+
+execute_process(COMMAND "${SHOWMYSKY_BATCH}" "${modelDir}" "${FRAMES}"
+                WORKING_DIRECTORY "${separateDir}"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "showmysky-batch failed without texture arrays: ${result}")
+endif()
+
+execute_process(COMMAND "${SHOWMYSKY_BATCH}" --texture-arrays --luminance-reference "${separateDir}"
+                        --luminance-reference-tolerance "${TOLERANCE}" "${modelDir}" "${FRAMES}"
+                WORKING_DIRECTORY "${arraysDir}"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Luminance rendered with texture arrays differs more than allowed, or showmysky-batch failed: ${result}")
+endif()